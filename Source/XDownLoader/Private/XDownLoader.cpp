@@ -10,6 +10,8 @@
 
 #define LOCTEXT_NAMESPACE "FXDownLoaderModule"
 
+DEFINE_LOG_CATEGORY(LogXDownloader);
+
 void FXDownLoaderModule::RegisterXDownloaderSettings()
 {
 #if WITH_EDITOR
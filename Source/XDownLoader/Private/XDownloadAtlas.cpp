@@ -0,0 +1,284 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadAtlas.h"
+
+#include "ImageCore.h"
+#include "Engine/Texture2D.h"
+#include "TextureResource.h"
+#include "XDownloaderStats.h"
+
+namespace XDownloadAtlas
+{
+	//pixels of edge colour around every image
+	static constexpr int32 Padding = 1;
+
+	//an image may use a shelf up to this much higher than itself
+	static constexpr float MaxShelfWaste = 1.5f;
+}
+
+FXDownloadAtlas::FXDownloadAtlas(int32 InPageSize, int32 InMaxImageSize)
+	: PageSize(InPageSize)
+	, MaxImageSize(FMath::Min(InMaxImageSize, InPageSize - 2 * XDownloadAtlas::Padding))
+{
+}
+
+FXDownloadAtlas::~FXDownloadAtlas()
+{
+	DEC_DWORD_STAT_BY(STAT_XDownloaderAtlasPages, GetPageNum());
+	DEC_DWORD_STAT_BY(STAT_XDownloaderAtlasImages, Entries.Num());
+}
+
+bool FXDownloadAtlas::CanAdd(int32 SizeX, int32 SizeY) const
+{
+	return SizeX > 0 && SizeY > 0 && SizeX <= MaxImageSize && SizeY <= MaxImageSize;
+}
+
+bool FXDownloadAtlas::FindRegion(const FString& ContentHash, FXDownloadAtlasRegion& OutRegion)
+{
+	check(IsInGameThread());
+	FEntry* Entry = Entries.Find(ContentHash);
+	if (!Entry)
+	{
+		return false;
+	}
+	++Entry->RefNum;
+	OutRegion = MakeRegion(ContentHash, *Entry);
+	return true;
+}
+
+bool FXDownloadAtlas::AddImage(const FString& ContentHash, const FImage& Image, FXDownloadAtlasRegion& OutRegion)
+{
+	using namespace XDownloadAtlas;
+	check(IsInGameThread());
+	if (FindRegion(ContentHash, OutRegion))
+	{
+		return true;
+	}
+	int32 PageIndex = 0;
+	int32 ShelfIndex = 0;
+	int32 X = 0;
+	const int32 PaddedWidth = Image.SizeX + 2 * Padding;
+	const int32 PaddedHeight = Image.SizeY + 2 * Padding;
+	if (!CanAdd(Image.SizeX, Image.SizeY) || !Allocate(PaddedWidth, PaddedHeight, PageIndex, ShelfIndex, X))
+	{
+		return false;
+	}
+	FPage& Page = Pages[PageIndex];
+	FEntry& Entry = Entries.Add(ContentHash);
+	Entry.PageIndex = PageIndex;
+	Entry.ShelfIndex = ShelfIndex;
+	Entry.Rect = FIntRect(X, Page.Shelves[ShelfIndex].Y, X + PaddedWidth, Page.Shelves[ShelfIndex].Y + PaddedHeight);
+	Entry.RefNum = 1;
+	++Page.EntryNum;
+	INC_DWORD_STAT(STAT_XDownloaderAtlasImages);
+
+	//the render thread frees the copy once uploaded
+	FImage BGRAImage;
+	Image.CopyTo(BGRAImage, ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+	const TArrayView64<FColor> Source = BGRAImage.AsBGRA8();
+	FColor* PaddedData = static_cast<FColor*>(FMemory::Malloc(PaddedWidth * PaddedHeight * sizeof(FColor)));
+	for (int32 Y = 0; Y < PaddedHeight; ++Y)
+	{
+		const int32 SourceY = FMath::Clamp(Y - Padding, 0, Image.SizeY - 1);
+		for (int32 PaddedX = 0; PaddedX < PaddedWidth; ++PaddedX)
+		{
+			PaddedData[Y * PaddedWidth + PaddedX] = Source[static_cast<int64>(SourceY) * Image.SizeX + FMath::Clamp(PaddedX - Padding, 0, Image.SizeX - 1)];
+		}
+	}
+	FUpdateTextureRegion2D* UpdateRegion = new FUpdateTextureRegion2D(Entry.Rect.Min.X, Entry.Rect.Min.Y, 0, 0, PaddedWidth, PaddedHeight);
+	Page.Texture->UpdateTextureRegions(0, 1, UpdateRegion, PaddedWidth * sizeof(FColor), sizeof(FColor), reinterpret_cast<uint8*>(PaddedData),
+		[](uint8* SrcData, const FUpdateTextureRegion2D* Regions)
+		{
+			FMemory::Free(SrcData);
+			delete Regions;
+		});
+	OutRegion = MakeRegion(ContentHash, Entry);
+	return true;
+}
+
+void FXDownloadAtlas::AddReference(const FString& ContentHash)
+{
+	check(IsInGameThread());
+	if (FEntry* Entry = Entries.Find(ContentHash))
+	{
+		++Entry->RefNum;
+	}
+}
+
+void FXDownloadAtlas::Release(const FString& ContentHash)
+{
+	check(IsInGameThread());
+	FEntry* Entry = Entries.Find(ContentHash);
+	if (!Entry || --Entry->RefNum > 0)
+	{
+		return;
+	}
+	FPage& Page = Pages[Entry->PageIndex];
+	FShelf& Shelf = Page.Shelves[Entry->ShelfIndex];
+	//give the span back, merged with its free neighbours
+	int32 SpanIndex = 0;
+	while (SpanIndex < Shelf.FreeSpans.Num() && Shelf.FreeSpans[SpanIndex].X < Entry->Rect.Min.X)
+	{
+		++SpanIndex;
+	}
+	Shelf.FreeSpans.Insert(FIntPoint(Entry->Rect.Min.X, Entry->Rect.Width()), SpanIndex);
+	if (SpanIndex + 1 < Shelf.FreeSpans.Num() && Shelf.FreeSpans[SpanIndex].X + Shelf.FreeSpans[SpanIndex].Y == Shelf.FreeSpans[SpanIndex + 1].X)
+	{
+		Shelf.FreeSpans[SpanIndex].Y += Shelf.FreeSpans[SpanIndex + 1].Y;
+		Shelf.FreeSpans.RemoveAt(SpanIndex + 1);
+	}
+	if (SpanIndex > 0 && Shelf.FreeSpans[SpanIndex - 1].X + Shelf.FreeSpans[SpanIndex - 1].Y == Shelf.FreeSpans[SpanIndex].X)
+	{
+		Shelf.FreeSpans[SpanIndex - 1].Y += Shelf.FreeSpans[SpanIndex].Y;
+		Shelf.FreeSpans.RemoveAt(SpanIndex);
+	}
+	//empty shelves at the bottom give their height back
+	while (Page.Shelves.Num() && Page.Shelves.Last().FreeSpans.Num() == 1 && Page.Shelves.Last().FreeSpans[0].Y == PageSize)
+	{
+		Page.ShelvesBottom = Page.Shelves.Last().Y;
+		Page.Shelves.Pop();
+	}
+	--Page.EntryNum;
+	//the first page stays for the next images, the slot of another empty page is reused by the next new page
+	if (Page.EntryNum == 0 && Entry->PageIndex > 0)
+	{
+		Page.Texture = nullptr;
+		Page.Shelves.Empty();
+		Page.ShelvesBottom = 0;
+		DEC_DWORD_STAT(STAT_XDownloaderAtlasPages);
+	}
+	Entries.Remove(ContentHash);
+	DEC_DWORD_STAT(STAT_XDownloaderAtlasImages);
+}
+
+int32 FXDownloadAtlas::GetPageNum() const
+{
+	int32 PageNum = 0;
+	for (const FPage& Page : Pages)
+	{
+		PageNum += Page.Texture ? 1 : 0;
+	}
+	return PageNum;
+}
+
+void FXDownloadAtlas::GetPages(TArray<UTexture2D*>& OutPages) const
+{
+	for (const FPage& Page : Pages)
+	{
+		if (Page.Texture)
+		{
+			OutPages.Add(Page.Texture);
+		}
+	}
+}
+
+void FXDownloadAtlas::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	for (FPage& Page : Pages)
+	{
+		Collector.AddReferencedObject(Page.Texture);
+	}
+}
+
+bool FXDownloadAtlas::Allocate(int32 Width, int32 Height, int32& OutPageIndex, int32& OutShelfIndex, int32& OutX)
+{
+	using namespace XDownloadAtlas;
+	for (int32 PageIndex = 0; PageIndex < Pages.Num(); ++PageIndex)
+	{
+		FPage& Page = Pages[PageIndex];
+		if (!Page.Texture)
+		{
+			continue;
+		}
+		for (int32 ShelfIndex = 0; ShelfIndex < Page.Shelves.Num(); ++ShelfIndex)
+		{
+			FShelf& Shelf = Page.Shelves[ShelfIndex];
+			//an empty shelf takes any image it can hold, a used one only images of a close height
+			const bool bShelfEmpty = Shelf.FreeSpans.Num() == 1 && Shelf.FreeSpans[0].Y == PageSize;
+			if (Height <= Shelf.Height && (bShelfEmpty || Shelf.Height <= Height * MaxShelfWaste) && AllocateInShelf(Shelf, Width, OutX))
+			{
+				OutPageIndex = PageIndex;
+				OutShelfIndex = ShelfIndex;
+				return true;
+			}
+		}
+		if (Page.ShelvesBottom + Height <= PageSize)
+		{
+			FShelf& Shelf = Page.Shelves.AddDefaulted_GetRef();
+			Shelf.Y = Page.ShelvesBottom;
+			Shelf.Height = Height;
+			Shelf.FreeSpans.Add(FIntPoint(0, PageSize));
+			Page.ShelvesBottom += Height;
+			OutPageIndex = PageIndex;
+			OutShelfIndex = Page.Shelves.Num() - 1;
+			return AllocateInShelf(Shelf, Width, OutX);
+		}
+	}
+	UTexture2D* Texture = CreatePage();
+	if (!Texture)
+	{
+		return false;
+	}
+	INC_DWORD_STAT(STAT_XDownloaderAtlasPages);
+	int32 PageIndex = Pages.IndexOfByPredicate([](const FPage& Page) { return !Page.Texture; });
+	if (PageIndex == INDEX_NONE)
+	{
+		PageIndex = Pages.AddDefaulted();
+	}
+	Pages[PageIndex].Texture = Texture;
+	return Allocate(Width, Height, OutPageIndex, OutShelfIndex, OutX);
+}
+
+bool FXDownloadAtlas::AllocateInShelf(FShelf& Shelf, int32 Width, int32& OutX)
+{
+	for (int32 SpanIndex = 0; SpanIndex < Shelf.FreeSpans.Num(); ++SpanIndex)
+	{
+		FIntPoint& Span = Shelf.FreeSpans[SpanIndex];
+		if (Span.Y >= Width)
+		{
+			OutX = Span.X;
+			Span.X += Width;
+			Span.Y -= Width;
+			if (Span.Y == 0)
+			{
+				Shelf.FreeSpans.RemoveAt(SpanIndex);
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+UTexture2D* FXDownloadAtlas::CreatePage() const
+{
+	LLM_SCOPE_BYTAG(XDownloader_Textures);
+	UTexture2D* Texture = UTexture2D::CreateTransient(PageSize, PageSize, PF_B8G8R8A8);
+	if (!Texture)
+	{
+		return nullptr;
+	}
+	Texture->SRGB = true;
+	Texture->NeverStream = true;
+	Texture->LODGroup = TEXTUREGROUP_UI;
+	FByteBulkData& BulkData = Texture->GetPlatformData()->Mips[0].BulkData;
+	FMemory::Memzero(BulkData.Lock(LOCK_READ_WRITE), BulkData.GetBulkDataSize());
+	BulkData.Unlock();
+	Texture->UpdateResource();
+	return Texture;
+}
+
+FXDownloadAtlasRegion FXDownloadAtlas::MakeRegion(const FString& ContentHash, const FEntry& Entry) const
+{
+	using namespace XDownloadAtlas;
+	FXDownloadAtlasRegion Region;
+	Region.ContentHash = ContentHash;
+	Region.Page = Pages[Entry.PageIndex].Texture;
+	Region.Size = FIntPoint(Entry.Rect.Width() - 2 * Padding, Entry.Rect.Height() - 2 * Padding);
+	Region.UVMin = FVector2D(Entry.Rect.Min.X + Padding, Entry.Rect.Min.Y + Padding) / PageSize;
+	Region.UVMax = FVector2D(Entry.Rect.Max.X - Padding, Entry.Rect.Max.Y - Padding) / PageSize;
+	Region.Brush.SetResourceObject(Region.Page);
+	Region.Brush.ImageSize = FVector2D(Region.Size);
+	Region.Brush.SetUVRegion(FBox2f(FVector2f(Region.UVMin), FVector2f(Region.UVMax)));
+	return Region;
+}
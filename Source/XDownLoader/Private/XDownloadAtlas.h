@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/GCObject.h"
+#include "XDownloaderTypes.h"
+
+struct FImage;
+class UTexture2D;
+
+/**
+ * @class FXDownloadAtlas
+ * @brief Packs small downloaded images into shared atlas pages, see the bThumbnailAtlas setting.
+ *
+ * Each page is split into shelves, rows as high as the first image placed in them. An image goes to the first shelf
+ * of a close height with a free span wide enough, or to a new shelf, or to a new page. Images are keyed by content hash
+ * and reference counted, a released image frees its span, an empty last shelf gives its height back and an empty page
+ * other than the first one is dropped. Every image is surrounded by a one pixel border of its own edge pixels,
+ * so bilinear filtering never bleeds between neighbours. Game thread only.
+ */
+class FXDownloadAtlas : public FGCObject
+{
+public:
+	FXDownloadAtlas(int32 InPageSize, int32 InMaxImageSize);
+
+	virtual ~FXDownloadAtlas() override;
+
+	//whether an image of this size is packed rather than given its own texture
+	bool CanAdd(int32 SizeX, int32 SizeY) const;
+
+	/**
+	 * @brief Finds the region of an image already in the atlas and adds a reference to it.
+	 *
+	 * @return False if the image is not in the atlas.
+	 */
+	bool FindRegion(const FString& ContentHash, FXDownloadAtlasRegion& OutRegion);
+
+	/**
+	 * @brief Copies an image into a page and adds a reference to it, or only adds the reference if it is already packed.
+	 *
+	 * @param ContentHash The content hash of the compressed image bytes.
+	 * @param Image The decoded image.
+	 * @param OutRegion The region of the image.
+	 * @return False if the image is too large for the atlas.
+	 */
+	bool AddImage(const FString& ContentHash, const FImage& Image, FXDownloadAtlasRegion& OutRegion);
+
+	//adds a reference to an image already in the atlas, for another copy of its region
+	void AddReference(const FString& ContentHash);
+
+	//drops a reference, the space of the image is reclaimed with the last one
+	void Release(const FString& ContentHash);
+
+	//the pages holding a texture, the slots of dropped pages are not counted
+	int32 GetPageNum() const;
+
+	void GetPages(TArray<UTexture2D*>& OutPages) const;
+
+	//FGCObject
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override { return TEXT("FXDownloadAtlas"); }
+
+private:
+	struct FShelf
+	{
+		int32 Y = 0;
+
+		int32 Height = 0;
+
+		//free horizontal spans, X and width, sorted by X
+		TArray<FIntPoint> FreeSpans;
+	};
+
+	struct FPage
+	{
+		UTexture2D* Texture = nullptr;
+
+		TArray<FShelf> Shelves;
+
+		//top of the unused space below the last shelf
+		int32 ShelvesBottom = 0;
+
+		int32 EntryNum = 0;
+	};
+
+	struct FEntry
+	{
+		int32 PageIndex = 0;
+
+		int32 ShelfIndex = 0;
+
+		//the padded rectangle of the image in its page
+		FIntRect Rect;
+
+		int32 RefNum = 0;
+	};
+
+	//finds room for a padded image, adding a shelf or a page if needed
+	bool Allocate(int32 Width, int32 Height, int32& OutPageIndex, int32& OutShelfIndex, int32& OutX);
+
+	static bool AllocateInShelf(FShelf& Shelf, int32 Width, int32& OutX);
+
+	UTexture2D* CreatePage() const;
+
+	FXDownloadAtlasRegion MakeRegion(const FString& ContentHash, const FEntry& Entry) const;
+
+	int32 PageSize = 2048;
+
+	int32 MaxImageSize = 256;
+
+	TArray<FPage> Pages;
+
+	TMap<FString, FEntry> Entries;
+};
@@ -0,0 +1,133 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadBandwidth.h"
+
+#include "XDownloaderSettings.h"
+#include "XDownloaderStats.h"
+
+FXDownloadBandwidthLimiter& FXDownloadBandwidthLimiter::Get()
+{
+	static FXDownloadBandwidthLimiter BandwidthLimiter;
+	return BandwidthLimiter;
+}
+
+FXDownloadBandwidthLimiter::FXDownloadBandwidthLimiter()
+{
+	ResetLimits();
+}
+
+void FXDownloadBandwidthLimiter::SetLimitKBps(EXDownloadTrafficClass TrafficClass, int32 LimitKBps)
+{
+	FScopeLock ScopeLock(&Lock);
+	FBucket& Bucket = Buckets[static_cast<int32>(TrafficClass)];
+	Refill(Bucket);
+	const bool bWasUnlimited = Bucket.BytesPerSecond <= 0.0;
+	Bucket.BytesPerSecond = FMath::Max(LimitKBps, 0) * 1024.0;
+	//a newly limited class starts with a full bucket, a lowered limit drops the tokens above it
+	Bucket.Tokens = bWasUnlimited ? Bucket.BytesPerSecond : FMath::Min(Bucket.Tokens, Bucket.BytesPerSecond);
+}
+
+int32 FXDownloadBandwidthLimiter::GetLimitKBps(EXDownloadTrafficClass TrafficClass) const
+{
+	FScopeLock ScopeLock(&Lock);
+	return FMath::RoundToInt(Buckets[static_cast<int32>(TrafficClass)].BytesPerSecond / 1024.0);
+}
+
+void FXDownloadBandwidthLimiter::ResetLimits()
+{
+	const UXDownloaderSettings* Settings = GetDefault<UXDownloaderSettings>();
+	SetLimitKBps(EXDownloadTrafficClass::Foreground, Settings->GetForegroundBandwidthKBps());
+	SetLimitKBps(EXDownloadTrafficClass::Prefetch, Settings->GetPrefetchBandwidthKBps());
+}
+
+bool FXDownloadBandwidthLimiter::CanStart(EXDownloadTrafficClass TrafficClass)
+{
+	FScopeLock ScopeLock(&Lock);
+	FBucket& Bucket = Buckets[static_cast<int32>(TrafficClass)];
+	Refill(Bucket);
+	return Bucket.WaitingStarts.IsEmpty() && HasTokens(Bucket);
+}
+
+void FXDownloadBandwidthLimiter::StartPaced(EXDownloadTrafficClass TrafficClass, TFunction<void()> Start)
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+		FBucket& Bucket = Buckets[static_cast<int32>(TrafficClass)];
+		Refill(Bucket);
+		//first come first started, a request never overtakes one already waiting
+		if (!Bucket.WaitingStarts.IsEmpty() || !HasTokens(Bucket))
+		{
+			Bucket.WaitingStarts.Add(MoveTemp(Start));
+			INC_DWORD_STAT(STAT_XDownloaderPacedStarts);
+			INC_DWORD_STAT(STAT_XDownloaderBandwidthWaiting);
+			return;
+		}
+	}
+	//the request may complete and start the next one right away, so it runs outside the lock
+	Start();
+}
+
+void FXDownloadBandwidthLimiter::Consume(EXDownloadTrafficClass TrafficClass, int64 Bytes)
+{
+	if (Bytes <= 0)
+	{
+		return;
+	}
+	FScopeLock ScopeLock(&Lock);
+	FBucket& Bucket = Buckets[static_cast<int32>(TrafficClass)];
+	if (Bucket.BytesPerSecond > 0.0)
+	{
+		Refill(Bucket);
+		Bucket.Tokens -= Bytes;
+	}
+}
+
+void FXDownloadBandwidthLimiter::Tick()
+{
+	check(IsInGameThread());
+	TArray<TFunction<void()>> ReadyStarts;
+	{
+		FScopeLock ScopeLock(&Lock);
+		for (FBucket& Bucket : Buckets)
+		{
+			Refill(Bucket);
+			//one request per refill unless the class is unlimited now, its body is taken from the bucket as it is read
+			if (!Bucket.WaitingStarts.IsEmpty() && HasTokens(Bucket))
+			{
+				const int32 ReadyNum = Bucket.BytesPerSecond > 0.0 ? 1 : Bucket.WaitingStarts.Num();
+				for (int32 Index = 0; Index < ReadyNum; ++Index)
+				{
+					ReadyStarts.Add(MoveTemp(Bucket.WaitingStarts[Index]));
+				}
+				Bucket.WaitingStarts.RemoveAt(0, ReadyNum, false);
+			}
+		}
+		SET_DWORD_STAT(STAT_XDownloaderBandwidthWaiting, GetWaitingNum());
+	}
+	for (const TFunction<void()>& Start : ReadyStarts)
+	{
+		Start();
+	}
+}
+
+int32 FXDownloadBandwidthLimiter::GetWaitingNum() const
+{
+	FScopeLock ScopeLock(&Lock);
+	int32 WaitingNum = 0;
+	for (const FBucket& Bucket : Buckets)
+	{
+		WaitingNum += Bucket.WaitingStarts.Num();
+	}
+	return WaitingNum;
+}
+
+void FXDownloadBandwidthLimiter::Refill(FBucket& Bucket) const
+{
+	const double Now = FPlatformTime::Seconds();
+	if (Bucket.BytesPerSecond > 0.0)
+	{
+		Bucket.Tokens = FMath::Min(Bucket.Tokens + Bucket.BytesPerSecond * (Now - Bucket.RefillTime), Bucket.BytesPerSecond);
+	}
+	Bucket.RefillTime = Now;
+}
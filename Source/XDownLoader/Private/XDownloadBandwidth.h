@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "XDownloaderTypes.h"
+
+/**
+ * @class FXDownloadBandwidthLimiter
+ * @brief The token buckets pacing the HTTP downloads, one per EXDownloadTrafficClass.
+ *
+ * Shared by every game instance of the process, as they share the link, and reset to the settings by
+ * UXDownloaderSubsystem::Initialize. A request starts only while its bucket
+ * holds tokens, and the bytes of its body are taken from the bucket as they are read. A large body may overdraw
+ * the bucket, which then holds the next requests back until it has refilled, so the rate over a few seconds stays
+ * at the limit. The HTTP module cannot pause a body, an in-flight request is never stalled.
+ * A bucket refills at its limit and holds at most one second of it. Thread-safe.
+ */
+class FXDownloadBandwidthLimiter
+{
+public:
+	static FXDownloadBandwidthLimiter& Get();
+
+	/**
+	 * @brief Changes the budget of a traffic class, takes effect for the next request started.
+	 *
+	 * @param TrafficClass The traffic class.
+	 * @param LimitKBps The budget in KB per second, 0 for unlimited.
+	 */
+	void SetLimitKBps(EXDownloadTrafficClass TrafficClass, int32 LimitKBps);
+
+	int32 GetLimitKBps(EXDownloadTrafficClass TrafficClass) const;
+
+	//back to the ForegroundBandwidthKBps and PrefetchBandwidthKBps settings
+	void ResetLimits();
+
+	//whether a request of the class may start now
+	bool CanStart(EXDownloadTrafficClass TrafficClass);
+
+	/**
+	 * @brief Starts a request now if its bucket holds tokens and no earlier request is waiting, or in a later Tick.
+	 *
+	 * @param TrafficClass The traffic class of the request.
+	 * @param Start Starts the request, on the calling thread or on the game thread.
+	 */
+	void StartPaced(EXDownloadTrafficClass TrafficClass, TFunction<void()> Start);
+
+	//takes the bytes of a body read from the bucket
+	void Consume(EXDownloadTrafficClass TrafficClass, int64 Bytes);
+
+	//starts the waiting requests whose bucket has refilled, game thread
+	void Tick();
+
+	//requests waiting for their bucket to refill
+	int32 GetWaitingNum() const;
+
+private:
+	FXDownloadBandwidthLimiter();
+
+	struct FBucket
+	{
+		//0 for unlimited
+		double BytesPerSecond = 0.0;
+
+		//may go negative after a large body
+		double Tokens = 0.0;
+
+		double RefillTime = 0.0;
+
+		TArray<TFunction<void()>> WaitingStarts;
+	};
+
+	void Refill(FBucket& Bucket) const;
+
+	static bool HasTokens(const FBucket& Bucket) { return Bucket.BytesPerSecond <= 0.0 || Bucket.Tokens > 0.0; }
+
+	mutable FCriticalSection Lock;
+
+	FBucket Buckets[static_cast<int32>(EXDownloadTrafficClass::Num)];
+};
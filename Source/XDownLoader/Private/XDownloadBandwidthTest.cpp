@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && !UE_BUILD_SHIPPING
+
+#include "HttpManager.h"
+#include "HttpModule.h"
+#include "Containers/Ticker.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "XDownloadBandwidth.h"
+#include "XDownloaderBenchmarkServer.h"
+
+namespace XDownloadBandwidthTest
+{
+	static constexpr int32 RequestNum = 16;
+
+	static constexpr int32 MaxInFlightNum = 4;
+
+	static constexpr double TimeoutSeconds = 60.0;
+}
+
+//shared with the request callbacks, which may still run after a timed out test has returned
+struct FXDownloadLoopbackRun
+{
+	TArray<FString> ImageURLs;
+	int32 PayloadSize = 0;
+	int32 StartedNum = 0;
+	int32 InFlightNum = 0;
+	int32 FinishedNum = 0;
+	int32 FailedNum = 0;
+	int64 ReceivedBytes = 0;
+	TArray<TSharedRef<IHttpRequest, ESPMode::ThreadSafe>> HttpRequests;
+};
+
+//keeps at most MaxInFlightNum requests started or waiting for the bucket
+static void StartLoopbackRequests(const TSharedRef<FXDownloadLoopbackRun>& Run)
+{
+	while (Run->StartedNum < Run->ImageURLs.Num() && Run->InFlightNum < XDownloadBandwidthTest::MaxInFlightNum)
+	{
+		const FString ImageURL = Run->ImageURLs[Run->StartedNum++];
+		++Run->InFlightNum;
+		FXDownloadBandwidthLimiter::Get().StartPaced(EXDownloadTrafficClass::Foreground, [WeakRun = TWeakPtr<FXDownloadLoopbackRun>(Run), ImageURL]()
+		{
+			const TSharedPtr<FXDownloadLoopbackRun> PinnedRun = WeakRun.Pin();
+			if (!PinnedRun.IsValid())
+			{
+				return;
+			}
+			const TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+			const TSharedRef<int32> ProgressBytes = MakeShared<int32>(0);
+			HttpRequest->SetURL(ImageURL);
+			HttpRequest->SetVerb(TEXT("GET"));
+			HttpRequest->OnRequestProgress().BindLambda([ProgressBytes](FHttpRequestPtr, int32, int32 BytesReceived)
+			{
+				FXDownloadBandwidthLimiter::Get().Consume(EXDownloadTrafficClass::Foreground, BytesReceived - *ProgressBytes);
+				*ProgressBytes = BytesReceived;
+			});
+			HttpRequest->OnProcessRequestComplete().BindLambda([WeakRun, ProgressBytes](FHttpRequestPtr, FHttpResponsePtr Response, bool bWasSuccessful)
+			{
+				const int32 BodyBytes = bWasSuccessful && Response.IsValid() ? Response->GetContent().Num() : 0;
+				FXDownloadBandwidthLimiter::Get().Consume(EXDownloadTrafficClass::Foreground, BodyBytes - *ProgressBytes);
+				if (const TSharedPtr<FXDownloadLoopbackRun> FinishedRun = WeakRun.Pin())
+				{
+					FinishedRun->ReceivedBytes += BodyBytes;
+					FinishedRun->FailedNum += BodyBytes == FinishedRun->PayloadSize ? 0 : 1;
+					--FinishedRun->InFlightNum;
+					++FinishedRun->FinishedNum;
+					StartLoopbackRequests(FinishedRun.ToSharedRef());
+				}
+			});
+			PinnedRun->HttpRequests.Add(HttpRequest);
+			HttpRequest->ProcessRequest();
+		});
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FXDownloadBandwidthLimitTest, "XDownloader.Bandwidth.LoopbackWithinBudget",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+//downloads from the loopback server through the foreground bucket, the way UXDownloadManager paces its requests
+bool FXDownloadBandwidthLimitTest::RunTest(const FString& Parameters)
+{
+	using namespace XDownloadBandwidthTest;
+	FXDownloaderBenchmarkProfile Profile;
+	//apart from the port of a running benchmark
+	Profile.Port = 8091;
+	Profile.LatencyMs = 0.f;
+	FXDownloaderBenchmarkServer Server(Profile);
+	if (!Server.Start())
+	{
+		AddError(FString::Printf(TEXT("Could not bind the loopback server on port %d"), Profile.Port));
+		return false;
+	}
+	//two payloads a second, the batch takes several seconds past the burst of the bucket
+	const int32 LimitKBps = FMath::Max(Server.GetPayloadSize() * 2 / 1024, 1);
+	FXDownloadBandwidthLimiter& BandwidthLimiter = FXDownloadBandwidthLimiter::Get();
+	BandwidthLimiter.SetLimitKBps(EXDownloadTrafficClass::Foreground, LimitKBps);
+
+	const TSharedRef<FXDownloadLoopbackRun> Run = MakeShared<FXDownloadLoopbackRun>();
+	Run->PayloadSize = Server.GetPayloadSize();
+	for (int32 Index = 0; Index < RequestNum; ++Index)
+	{
+		Run->ImageURLs.Add(Server.GetImageURL(FString::Printf(TEXT("XDownloadBandwidthTest_%d.%s"), Index, *Profile.Format)));
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	StartLoopbackRequests(Run);
+	double LastTime = StartTime;
+	while (Run->FinishedNum < RequestNum && FPlatformTime::Seconds() - StartTime < TimeoutSeconds)
+	{
+		const double Now = FPlatformTime::Seconds();
+		const float DeltaTime = Now - LastTime;
+		LastTime = Now;
+		FHttpModule::Get().GetHttpManager().Tick(DeltaTime);
+		FTSTicker::GetCoreTicker().Tick(DeltaTime);
+		BandwidthLimiter.Tick();
+		FPlatformProcess::Sleep(0.005f);
+	}
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+	for (const TSharedRef<IHttpRequest, ESPMode::ThreadSafe>& HttpRequest : Run->HttpRequests)
+	{
+		HttpRequest->OnRequestProgress().Unbind();
+		HttpRequest->OnProcessRequestComplete().Unbind();
+		HttpRequest->CancelRequest();
+	}
+	BandwidthLimiter.ResetLimits();
+	Server.Stop();
+
+	TestEqual(TEXT("Finished requests"), Run->FinishedNum, RequestNum);
+	TestEqual(TEXT("Failed requests"), Run->FailedNum, 0);
+	//the one second burst of the bucket and the bodies already in flight may exceed the rate, as in the throttled benchmark
+	const double AllowedBytes = LimitKBps * 1024.0 * (Seconds + 1.0) + static_cast<double>(MaxInFlightNum) * Server.GetPayloadSize();
+	if (Run->ReceivedBytes > AllowedBytes)
+	{
+		AddError(FString::Printf(TEXT("%.1f KB/s over %.1f seconds for a limit of %d KB/s"), Run->ReceivedBytes / Seconds / 1024.0, Seconds, LimitKBps));
+	}
+	return !HasAnyErrors();
+}
+
+#endif
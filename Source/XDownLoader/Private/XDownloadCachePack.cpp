@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadCachePack.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "XDownLoader.h"
+
+TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe> FXDownloadCachePack::Mount(const FString& PackPath)
+{
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*PackPath, FILEREAD_Silent));
+	if (!Reader)
+	{
+		return nullptr;
+	}
+	uint32 PackMagic = 0;
+	uint32 PackVersion = 0;
+	int32 EntryNum = 0;
+	int64 IndexOffset = 0;
+	*Reader << PackMagic << PackVersion << EntryNum << IndexOffset;
+	if (PackMagic != Magic || PackVersion != Version || EntryNum < 0 || IndexOffset <= 0 || IndexOffset >= Reader->TotalSize())
+	{
+		UE_LOG(LogXDownloader, Warning, TEXT("%s is not a cache pack!!!"), *PackPath);
+		return nullptr;
+	}
+	const TSharedRef<FXDownloadCachePack, ESPMode::ThreadSafe> Pack = MakeShared<FXDownloadCachePack, ESPMode::ThreadSafe>();
+	Pack->PackPath = PackPath;
+	Pack->Entries.Reserve(EntryNum);
+	Reader->Seek(IndexOffset);
+	for (int32 Index = 0; Index < EntryNum && !Reader->IsError(); ++Index)
+	{
+		FString ImageID;
+		FEntry Entry;
+		*Reader << ImageID << Entry.Offset << Entry.Size;
+		if (Entry.Offset < 0 || Entry.Size <= 0 || Entry.Offset + Entry.Size > IndexOffset)
+		{
+			UE_LOG(LogXDownloader, Warning, TEXT("Cache pack %s has a broken index!!!"), *PackPath);
+			return nullptr;
+		}
+		Pack->Entries.Add(MoveTemp(ImageID), Entry);
+	}
+	if (Reader->IsError())
+	{
+		return nullptr;
+	}
+
+	Pack->MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*PackPath));
+	if (Pack->MappedFile)
+	{
+		Pack->MappedRegion.Reset(Pack->MappedFile->MapRegion(0, IndexOffset));
+	}
+	if (!Pack->MappedRegion)
+	{
+		Pack->MappedFile.Reset();
+		Pack->FileReader = MoveTemp(Reader);
+	}
+	UE_LOG(LogXDownloader, Log, TEXT("Mounted cache pack %s, %d images%s"), *PackPath, EntryNum, Pack->MappedRegion ? TEXT(", mapped") : TEXT(""));
+	return Pack;
+}
+
+int32 FXDownloadCachePack::Build(const FString& SourceDirectory, const FString& PackPath, TFunctionRef<bool(const TArray<uint8>&)> IsValidImage)
+{
+	TArray<FString> FileNames;
+	IFileManager::Get().FindFiles(FileNames, *FPaths::Combine(SourceDirectory, TEXT("*")), true, false);
+	FileNames.Sort();
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*PackPath));
+	if (!Writer)
+	{
+		return INDEX_NONE;
+	}
+	uint32 PackMagic = Magic;
+	uint32 PackVersion = Version;
+	int32 EntryNum = 0;
+	int64 IndexOffset = 0;
+	//the header is written again once the index offset is known
+	*Writer << PackMagic << PackVersion << EntryNum << IndexOffset;
+	TArray<TPair<FString, FEntry>> PackedEntries;
+	for (const FString& FileName : FileNames)
+	{
+		TArray<uint8> ImageData;
+		if (!FFileHelper::LoadFileToArray(ImageData, *FPaths::Combine(SourceDirectory, FileName)) || !IsValidImage(ImageData))
+		{
+			UE_LOG(LogXDownloader, Warning, TEXT("BuildPack: skip %s, not an image"), *FileName);
+			continue;
+		}
+		FEntry Entry;
+		Entry.Offset = Writer->Tell();
+		Entry.Size = ImageData.Num();
+		Writer->Serialize(ImageData.GetData(), ImageData.Num());
+		PackedEntries.Emplace(FileName, Entry);
+	}
+	IndexOffset = Writer->Tell();
+	EntryNum = PackedEntries.Num();
+	for (TPair<FString, FEntry>& PackedEntry : PackedEntries)
+	{
+		*Writer << PackedEntry.Key << PackedEntry.Value.Offset << PackedEntry.Value.Size;
+	}
+	Writer->Seek(0);
+	*Writer << PackMagic << PackVersion << EntryNum << IndexOffset;
+	return Writer->Close() ? EntryNum : INDEX_NONE;
+}
+
+bool FXDownloadCachePack::Read(const FString& ImageID, TArray<uint8>& OutImageData) const
+{
+	const FEntry* Entry = Entries.Find(ImageID);
+	if (!Entry)
+	{
+		return false;
+	}
+	if (MappedRegion)
+	{
+		OutImageData = TArray<uint8>(MappedRegion->GetMappedPtr() + Entry->Offset, Entry->Size);
+		return true;
+	}
+	FScopeLock ScopeLock(&FileReaderLock);
+	OutImageData.SetNumUninitialized(Entry->Size);
+	FileReader->Seek(Entry->Offset);
+	FileReader->Serialize(OutImageData.GetData(), Entry->Size);
+	return !FileReader->IsError();
+}
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/MappedFileHandle.h"
+
+/**
+ * @class FXDownloadCachePack
+ * @brief A read-only pack of compressed images shipped with the build, the lowest cache tier.
+ *
+ * Layout: a header (magic, version, entry count, index offset), the image bodies back to back,
+ * then the index of (ImageID, offset, size) entries. The file is memory-mapped where the platform supports it
+ * and read through a file handle otherwise. Lookups are thread-safe, the mounted pack is shared with the batches reading it.
+ * Packs are built from a directory of images with "-run=XDownloaderCache -Mode=BuildPack".
+ */
+class FXDownloadCachePack
+{
+public:
+	/**
+	 * @brief Opens a pack and reads its index.
+	 *
+	 * @param PackPath The path of the .xdpack file.
+	 * @return The mounted pack, or null if the file is missing or not a pack.
+	 */
+	static TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe> Mount(const FString& PackPath);
+
+	/**
+	 * @brief Builds a pack from every file of a directory, named by its file name.
+	 *
+	 * @param SourceDirectory The directory holding the images.
+	 * @param PackPath The path of the .xdpack file to write.
+	 * @param IsValidImage Filters out the files that are not decodable images.
+	 * @return The number of packed images, or INDEX_NONE if the pack cannot be written.
+	 */
+	static int32 Build(const FString& SourceDirectory, const FString& PackPath, TFunctionRef<bool(const TArray<uint8>&)> IsValidImage);
+
+	bool Contains(const FString& ImageID) const { return Entries.Contains(ImageID); }
+
+	//copies the compressed bytes of an image, returns false if the pack does not hold it
+	bool Read(const FString& ImageID, TArray<uint8>& OutImageData) const;
+
+	const FString& GetPackPath() const { return PackPath; }
+
+	int32 GetEntryNum() const { return Entries.Num(); }
+
+	//bytes of the pack mapped into the address space, zero when read through the file handle
+	int64 GetMappedBytes() const { return MappedRegion ? MappedRegion->GetMappedSize() : 0; }
+
+private:
+	struct FEntry
+	{
+		int64 Offset = 0;
+		int64 Size = 0;
+	};
+
+	static constexpr uint32 Magic = 0x4B504458; //XDPK
+
+	static constexpr uint32 Version = 1;
+
+	FString PackPath;
+
+	TMap<FString, FEntry> Entries;
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	//fallback when the platform can not map the file
+	TUniquePtr<FArchive> FileReader;
+
+	mutable FCriticalSection FileReaderLock;
+};
@@ -0,0 +1,326 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadCacheTier.h"
+
+#include "Async/Async.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "XDownloadCachePack.h"
+#include "XDownloadFileCache.h"
+#include "XDownloadScheduler.h"
+#include "XDownloaderSaveGame.h"
+#include "XDownloaderStats.h"
+
+bool FXDownloadCacheFreshness::IsStale(int32 DefaultTTLSeconds) const
+{
+	const FDateTime UtcNow = FDateTime::UtcNow();
+	if (ExpireTime != FDateTime())
+	{
+		return ExpireTime <= UtcNow;
+	}
+	return DefaultTTLSeconds > 0 && StoredTime != FDateTime() && StoredTime + FTimespan::FromSeconds(DefaultTTLSeconds) <= UtcNow;
+}
+
+FXDownloadCacheFreshness FXDownloadCacheFreshness::FromHeaders(const FString& CacheControl, const FString& Expires)
+{
+	FXDownloadCacheFreshness Freshness = Now();
+	bool bNoCache = false;
+	int64 MaxAgeSeconds = INDEX_NONE;
+	TArray<FString> Directives;
+	CacheControl.ParseIntoArray(Directives, TEXT(","));
+	for (FString& Directive : Directives)
+	{
+		Directive.TrimStartAndEndInline();
+		Freshness.bNoStore |= Directive.Equals(TEXT("no-store"), ESearchCase::IgnoreCase);
+		bNoCache |= Directive.Equals(TEXT("no-cache"), ESearchCase::IgnoreCase);
+		FString Name;
+		FString MaxAge;
+		if (Directive.Split(TEXT("="), &Name, &MaxAge) && Name.TrimEnd().Equals(TEXT("max-age"), ESearchCase::IgnoreCase))
+		{
+			MaxAge.TrimStartAndEndInline();
+			MaxAge.TrimQuotesInline();
+			if (MaxAge.IsNumeric())
+			{
+				MaxAgeSeconds = FMath::Max<int64>(FCString::Atoi64(*MaxAge), 0);
+			}
+		}
+	}
+	//no-cache is stored but revalidated before it is used again, a no-store response is not stored at all
+	if (Freshness.bNoStore || bNoCache)
+	{
+		Freshness.ExpireTime = Freshness.StoredTime;
+		return Freshness;
+	}
+	if (MaxAgeSeconds != INDEX_NONE)
+	{
+		Freshness.ExpireTime = Freshness.StoredTime + FTimespan::FromSeconds(MaxAgeSeconds);
+		return Freshness;
+	}
+	FDateTime ExpireTime;
+	if (!Expires.IsEmpty())
+	{
+		//an invalid date such as "0" means already expired
+		Freshness.ExpireTime = FDateTime::ParseHttpDate(Expires, ExpireTime) ? ExpireTime : Freshness.StoredTime;
+	}
+	return Freshness;
+}
+
+FXDownloadCacheFreshness FXDownloadCacheFreshness::FromResponse(const IHttpResponse& Response, bool bCacheControl)
+{
+	FXDownloadCacheFreshness Freshness = bCacheControl ? FromHeaders(Response.GetHeader(TEXT("Cache-Control")), Response.GetHeader(TEXT("Expires"))) : Now();
+	Freshness.ETag = Response.GetHeader(TEXT("ETag"));
+	Freshness.LastModified = Response.GetHeader(TEXT("Last-Modified"));
+	return Freshness;
+}
+
+FXDownloadCacheFreshness FXDownloadCacheFreshness::Now()
+{
+	FXDownloadCacheFreshness Freshness;
+	Freshness.StoredTime = FDateTime::UtcNow();
+	return Freshness;
+}
+
+FXDownloadMemoryCache::FXDownloadMemoryCache(int64 InMaxBytes)
+	: MaxBytes(InMaxBytes)
+{
+}
+
+FXDownloadMemoryCache::~FXDownloadMemoryCache()
+{
+	Empty();
+}
+
+bool FXDownloadMemoryCache::Read(const FString& ImageID, TArray<uint8>& OutImageData, FXDownloadCacheFreshness& OutFreshness)
+{
+	FScopeLock ScopeLock(&Lock);
+	//timed once the lock is taken, the wait for it is not part of the read
+	XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderCacheRead);
+	FEntry* Entry = Entries.Find(ImageID);
+	if (!Entry)
+	{
+		return false;
+	}
+	UseOrder.RemoveNode(Entry->UseNode, false);
+	UseOrder.AddHead(Entry->UseNode);
+	OutImageData = Entry->ImageData;
+	OutFreshness = Entry->Freshness;
+	return true;
+}
+
+void FXDownloadMemoryCache::Write(const FString& ImageID, const TArray<uint8>& ImageData, const FXDownloadCacheFreshness& Freshness)
+{
+	if (ImageData.Num() == 0 || ImageData.Num() > MaxBytes)
+	{
+		return;
+	}
+	LLM_SCOPE_BYTAG(XDownloader_Results);
+	FScopeLock ScopeLock(&Lock);
+	FEntry& Entry = Entries.FindOrAdd(ImageID);
+	if (Entry.UseNode)
+	{
+		UseOrder.RemoveNode(Entry.UseNode, false);
+		Bytes -= Entry.ImageData.Num();
+		DEC_MEMORY_STAT_BY(STAT_XDownloaderMemoryCacheSize, Entry.ImageData.Num());
+	}
+	else
+	{
+		Entry.UseNode = new TDoubleLinkedList<FString>::TDoubleLinkedListNode(ImageID);
+	}
+	UseOrder.AddHead(Entry.UseNode);
+	Entry.ImageData = ImageData;
+	Entry.Freshness = Freshness;
+	Bytes += ImageData.Num();
+	INC_MEMORY_STAT_BY(STAT_XDownloaderMemoryCacheSize, ImageData.Num());
+	while (Bytes > MaxBytes)
+	{
+		TDoubleLinkedList<FString>::TDoubleLinkedListNode* LeastRecent = UseOrder.GetTail();
+		const int32 EvictedNum = Entries.FindChecked(LeastRecent->GetValue()).ImageData.Num();
+		Bytes -= EvictedNum;
+		DEC_MEMORY_STAT_BY(STAT_XDownloaderMemoryCacheSize, EvictedNum);
+		Entries.Remove(LeastRecent->GetValue());
+		UseOrder.RemoveNode(LeastRecent);
+	}
+}
+
+void FXDownloadMemoryCache::Renew(const FString& ImageID, const FXDownloadCacheFreshness& Freshness)
+{
+	FScopeLock ScopeLock(&Lock);
+	if (FEntry* Entry = Entries.Find(ImageID))
+	{
+		Entry->Freshness = Freshness;
+	}
+}
+
+void FXDownloadMemoryCache::Empty()
+{
+	FScopeLock ScopeLock(&Lock);
+	DEC_MEMORY_STAT_BY(STAT_XDownloaderMemoryCacheSize, Bytes);
+	Entries.Empty();
+	UseOrder.Empty();
+	Bytes = 0;
+}
+
+int64 FXDownloadMemoryCache::GetBytes() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Bytes;
+}
+
+void FXDownloadMemoryTier::Read(const FString& ImageID, TFunction<void(FXDownloadCacheHit*)> OnRead)
+{
+	FXDownloadCacheHit Hit;
+	OnRead(MemoryCache->Read(ImageID, Hit.ImageData, Hit.Freshness) ? &Hit : nullptr);
+}
+
+void FXDownloadMemoryTier::Write(const FString& ImageID, const FString& ImageURL, const TArray<uint8>& ImageData, const FXDownloadCacheFreshness& Freshness)
+{
+	MemoryCache->Write(ImageID, ImageData, Freshness);
+}
+
+void FXDownloadLocalFileTier::Read(const FString& ImageID, TFunction<void(FXDownloadCacheHit*)> OnRead)
+{
+	const FString FilePath = FPaths::Combine(Directory, ImageID);
+	FileCache->Read(FilePath, [OnRead = MoveTemp(OnRead), FilePath](TArray<uint8>* FileContent)
+	{
+		if (!FileContent)
+		{
+			OnRead(nullptr);
+			return;
+		}
+		FXDownloadCacheHit Hit;
+		{
+			XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderCacheRead);
+			Hit.ImageData = MoveTemp(*FileContent);
+			//the files have no index for the response headers, they age from their write, a queued file is not on disk yet
+			const FDateTime FileTime = IFileManager::Get().GetTimeStamp(*FilePath);
+			Hit.Freshness.StoredTime = FileTime > FDateTime::MinValue() ? FileTime : FDateTime::UtcNow();
+		}
+		OnRead(&Hit);
+	});
+}
+
+void FXDownloadLocalFileTier::Write(const FString& ImageID, const FString& ImageURL, const TArray<uint8>& ImageData, const FXDownloadCacheFreshness& Freshness)
+{
+	FileCache->Write(FPaths::Combine(Directory, ImageID), ImageData);
+	WriteValidators(*FileCache, Directory, ImageID, Freshness);
+}
+
+FString FXDownloadLocalFileTier::GetValidatorsPath(const FString& InDirectory, const FString& ImageID)
+{
+	return FPaths::Combine(InDirectory, TEXT("Validators"), ImageID + TEXT(".json"));
+}
+
+void FXDownloadLocalFileTier::WriteValidators(FXDownloadFileCache& InFileCache, const FString& InDirectory, const FString& ImageID, const FXDownloadCacheFreshness& Freshness)
+{
+	//validators of older bytes would make the server confirm the wrong image
+	if (!Freshness.HasValidator())
+	{
+		InFileCache.Delete(GetValidatorsPath(InDirectory, ImageID));
+		return;
+	}
+	const TSharedRef<FJsonObject> ValidatorsObject = MakeShared<FJsonObject>();
+	ValidatorsObject->SetStringField(TEXT("etag"), Freshness.ETag);
+	ValidatorsObject->SetStringField(TEXT("lastModified"), Freshness.LastModified);
+	FString ValidatorsString;
+	FJsonSerializer::Serialize(ValidatorsObject, TJsonWriterFactory<>::Create(&ValidatorsString));
+	const FTCHARToUTF8 ValidatorsConverter(*ValidatorsString);
+	InFileCache.Write(GetValidatorsPath(InDirectory, ImageID), TArray<uint8>(reinterpret_cast<const uint8*>(ValidatorsConverter.Get()), ValidatorsConverter.Length()));
+}
+
+void FXDownloadLocalFileTier::ReadValidators(FXDownloadFileCache& InFileCache, const FString& InDirectory, const FString& ImageID, TFunction<void(const FXDownloadCacheFreshness&)> OnRead)
+{
+	InFileCache.Read(GetValidatorsPath(InDirectory, ImageID), [OnRead = MoveTemp(OnRead)](TArray<uint8>* ValidatorsContent)
+	{
+		FXDownloadCacheFreshness Freshness;
+		TSharedPtr<FJsonObject> ValidatorsObject;
+		if (ValidatorsContent)
+		{
+			const FUTF8ToTCHAR ValidatorsConverter(reinterpret_cast<const ANSICHAR*>(ValidatorsContent->GetData()), ValidatorsContent->Num());
+			FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(FString(ValidatorsConverter.Length(), ValidatorsConverter.Get())), ValidatorsObject);
+		}
+		if (ValidatorsObject.IsValid())
+		{
+			ValidatorsObject->TryGetStringField(TEXT("etag"), Freshness.ETag);
+			ValidatorsObject->TryGetStringField(TEXT("lastModified"), Freshness.LastModified);
+		}
+		OnRead(Freshness);
+	});
+}
+
+void FXDownloadSaveGameTier::Read(const FString& ImageID, TFunction<void(FXDownloadCacheHit*)> OnRead)
+{
+	FXDownloadCacheHit Hit;
+	bool bHit = false;
+	{
+		FScopeLock ScopeLock(&Scheduler->GetLock());
+		//timed once the lock is taken, the wait for it is not part of the read
+		XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderCacheRead);
+		UXDownloaderSaveGame* DownloaderSaveGame = SaveGame.Get();
+		if (const FXDownloadImageCached* Cache = DownloaderSaveGame ? DownloaderSaveGame->GetImageCache(ImageID) : nullptr)
+		{
+			if (const TArray<uint8>* ImageData = DownloaderSaveGame->GetImageData(*Cache))
+			{
+				Hit.ImageData = *ImageData;
+			}
+			Hit.Freshness.StoredTime = Cache->ImageTime;
+			Hit.Freshness.ExpireTime = Cache->ExpireTime;
+			Hit.Freshness.ETag = Cache->ETag;
+			Hit.Freshness.LastModified = Cache->LastModified;
+			Hit.ContentHash = Cache->ContentHash;
+			bHit = true;
+		}
+	}
+	OnRead(bHit ? &Hit : nullptr);
+}
+
+void FXDownloadSaveGameTier::Write(const FString& ImageID, const FString& ImageURL, const TArray<uint8>& ImageData, const FXDownloadCacheFreshness& Freshness)
+{
+	FXDownloadImageCached ImageCached;
+	ImageCached.ImageID = ImageID;
+	ImageCached.ImageURL = ImageURL;
+	ImageCached.ImageData = ImageData;
+	ImageCached.ImageTime = Freshness.StoredTime;
+	ImageCached.ExpireTime = Freshness.ExpireTime;
+	ImageCached.ETag = Freshness.ETag;
+	ImageCached.LastModified = Freshness.LastModified;
+	//the slot is a UObject the GC walks, it is only changed on the game thread
+	if (!IsInGameThread())
+	{
+		AsyncTask(ENamedThreads::GameThread, [SaveGame = SaveGame, SlotName = SlotName, Scheduler = Scheduler, ImageCached = MoveTemp(ImageCached)]()
+		{
+			WriteOnGameThread(SaveGame.Get(), SlotName, *Scheduler, ImageCached);
+		});
+		return;
+	}
+	WriteOnGameThread(SaveGame.Get(), SlotName, *Scheduler, ImageCached);
+}
+
+void FXDownloadSaveGameTier::WriteOnGameThread(UXDownloaderSaveGame* DownloaderSaveGame, const FString& SlotName, FXDownloadScheduler& Scheduler, const FXDownloadImageCached& ImageCached)
+{
+	check(IsInGameThread());
+	if (!DownloaderSaveGame)
+	{
+		return;
+	}
+	//the lookups of the batches read the slot on background threads
+	FScopeLock ScopeLock(&Scheduler.GetLock());
+	DownloaderSaveGame->UpdateImageCache(ImageCached, SlotName);
+}
+
+void FXDownloadPackTier::Read(const FString& ImageID, TFunction<void(FXDownloadCacheHit*)> OnRead)
+{
+	FXDownloadCacheHit Hit;
+	bool bHit = false;
+	{
+		XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderCacheRead);
+		for (int32 Index = 0; Index < CachePacks.Num() && !bHit; ++Index)
+		{
+			bHit = CachePacks[Index]->Read(ImageID, Hit.ImageData);
+		}
+	}
+	OnRead(bHit ? &Hit : nullptr);
+}
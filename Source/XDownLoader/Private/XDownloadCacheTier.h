@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/List.h"
+#include "XDownloaderTypes.h"
+
+class FXDownloadCachePack;
+class FXDownloadFileCache;
+class IHttpResponse;
+class FXDownloadScheduler;
+class UXDownloaderSaveGame;
+
+//when a cached image was stored and until when it is fresh, a default FDateTime where a tier does not know
+struct FXDownloadCacheFreshness
+{
+	//UTC, the packs shipped with the build leave it default and never go stale
+	FDateTime StoredTime;
+
+	//UTC, from the response headers, DefaultCacheTTL after StoredTime applies without it
+	FDateTime ExpireTime;
+
+	//validators of the response, sent back as If-None-Match and If-Modified-Since when the image is revalidated
+	FString ETag;
+
+	FString LastModified;
+
+	//the response asked not to be stored, by a Cache-Control no-store
+	bool bNoStore = false;
+
+	bool IsStale(int32 DefaultTTLSeconds) const;
+
+	bool HasValidator() const { return !ETag.IsEmpty() || !LastModified.IsEmpty(); }
+
+	/**
+	 * @brief The freshness of a response stored now.
+	 *
+	 * max-age of Cache-Control wins over Expires, no-cache makes the image stale right away and no-store sets bNoStore.
+	 */
+	static FXDownloadCacheFreshness FromHeaders(const FString& CacheControl, const FString& Expires);
+
+	/**
+	 * @brief The freshness and validators of a response stored now.
+	 *
+	 * @param Response The response.
+	 * @param bCacheControl Whether Cache-Control and Expires are read, see UXDownloaderSettings::IsCacheControlEnabled.
+	 */
+	static FXDownloadCacheFreshness FromResponse(const IHttpResponse& Response, bool bCacheControl);
+
+	//stored now, fresh for the DefaultCacheTTL
+	static FXDownloadCacheFreshness Now();
+};
+
+//an image found in a cache tier
+struct FXDownloadCacheHit
+{
+	TArray<uint8> ImageData;
+
+	FXDownloadCacheFreshness Freshness;
+
+	//the FXDownloadImageCached::ContentHash of the bytes if the tier already knows it, empty otherwise
+	FString ContentHash;
+};
+
+/**
+ * @class IXDownloadCacheTier
+ * @brief One level of the cache lookup chain of a batch, see UXDownloadManager::LookupCache.
+ *
+ * The manager reads the tiers in the order of UXDownloaderSettings::GetCacheTiers and stops at the first hit,
+ * which is then promoted into the writable tiers before it. A downloaded image is written to every writable tier.
+ */
+class IXDownloadCacheTier
+{
+public:
+	virtual ~IXDownloadCacheTier() = default;
+
+	virtual EXDownloadCacheTier GetTier() const = 0;
+
+	/**
+	 * @brief Looks an image up.
+	 *
+	 * @param ImageID The ID of the image.
+	 * @param OnRead Called on any thread with the hit, or nullptr if the tier does not hold the image.
+	 */
+	virtual void Read(const FString& ImageID, TFunction<void(FXDownloadCacheHit*)> OnRead) = 0;
+
+	//stores or replaces an image, can be called from any thread
+	virtual void Write(const FString& ImageID, const FString& ImageURL, const TArray<uint8>& ImageData, const FXDownloadCacheFreshness& Freshness) = 0;
+
+	//whether Write stores anything
+	virtual bool IsWritable() const { return true; }
+
+	//whether the tier outlives the session, a hit of a read-only persistent tier is only promoted into the others
+	virtual bool IsPersistent() const { return true; }
+};
+
+/**
+ * @class FXDownloadMemoryCache
+ * @brief The encoded images of this session, shared by the batches of a game instance and evicted least recently used first.
+ */
+class FXDownloadMemoryCache
+{
+public:
+	explicit FXDownloadMemoryCache(int64 InMaxBytes);
+
+	~FXDownloadMemoryCache();
+
+	bool Read(const FString& ImageID, TArray<uint8>& OutImageData, FXDownloadCacheFreshness& OutFreshness);
+
+	//an image larger than the whole cache is not stored
+	void Write(const FString& ImageID, const TArray<uint8>& ImageData, const FXDownloadCacheFreshness& Freshness);
+
+	//replaces the freshness of a cached image the server confirmed unchanged
+	void Renew(const FString& ImageID, const FXDownloadCacheFreshness& Freshness);
+
+	void Empty();
+
+	int64 GetBytes() const;
+
+private:
+	struct FEntry
+	{
+		TArray<uint8> ImageData;
+
+		FXDownloadCacheFreshness Freshness;
+
+		TDoubleLinkedList<FString>::TDoubleLinkedListNode* UseNode = nullptr;
+	};
+
+	mutable FCriticalSection Lock;
+
+	TMap<FString, FEntry> Entries;
+
+	//the most recently used image at the head
+	TDoubleLinkedList<FString> UseOrder;
+
+	int64 MaxBytes = 0;
+
+	int64 Bytes = 0;
+};
+
+class FXDownloadMemoryTier : public IXDownloadCacheTier
+{
+public:
+	explicit FXDownloadMemoryTier(const TSharedRef<FXDownloadMemoryCache, ESPMode::ThreadSafe>& InMemoryCache) : MemoryCache(InMemoryCache) {}
+
+	virtual EXDownloadCacheTier GetTier() const override { return EXDownloadCacheTier::Memory; }
+	virtual void Read(const FString& ImageID, TFunction<void(FXDownloadCacheHit*)> OnRead) override;
+	virtual void Write(const FString& ImageID, const FString& ImageURL, const TArray<uint8>& ImageData, const FXDownloadCacheFreshness& Freshness) override;
+	virtual bool IsPersistent() const override { return false; }
+
+private:
+	TSharedRef<FXDownloadMemoryCache, ESPMode::ThreadSafe> MemoryCache;
+};
+
+class FXDownloadLocalFileTier : public IXDownloadCacheTier
+{
+public:
+	FXDownloadLocalFileTier(const TSharedRef<FXDownloadFileCache, ESPMode::ThreadSafe>& InFileCache, const FString& InDirectory)
+		: FileCache(InFileCache), Directory(InDirectory) {}
+
+	virtual EXDownloadCacheTier GetTier() const override { return EXDownloadCacheTier::LocalFile; }
+	virtual void Read(const FString& ImageID, TFunction<void(FXDownloadCacheHit*)> OnRead) override;
+	virtual void Write(const FString& ImageID, const FString& ImageURL, const TArray<uint8>& ImageData, const FXDownloadCacheFreshness& Freshness) override;
+
+	//the validators of a cached file, <Directory>/Validators/<ImageID>.json, only read to revalidate a stale image
+	static FString GetValidatorsPath(const FString& InDirectory, const FString& ImageID);
+
+	//queues the validators of a cached file with the file cache, or their deletion if the response had none
+	static void WriteValidators(FXDownloadFileCache& InFileCache, const FString& InDirectory, const FString& ImageID, const FXDownloadCacheFreshness& Freshness);
+
+	//reads the validators of a cached file without blocking, OnRead gets them in the ETag and LastModified of a freshness, empty if there are none
+	static void ReadValidators(FXDownloadFileCache& InFileCache, const FString& InDirectory, const FString& ImageID, TFunction<void(const FXDownloadCacheFreshness&)> OnRead);
+
+private:
+	TSharedRef<FXDownloadFileCache, ESPMode::ThreadSafe> FileCache;
+
+	FString Directory;
+};
+
+//the loaded slot of a batch, read under the scheduler lock on any thread and written on the game thread
+class FXDownloadSaveGameTier : public IXDownloadCacheTier
+{
+public:
+	FXDownloadSaveGameTier(UXDownloaderSaveGame* InSaveGame, const FString& InSlotName, const TSharedRef<FXDownloadScheduler, ESPMode::ThreadSafe>& InScheduler)
+		: SaveGame(InSaveGame), SlotName(InSlotName), Scheduler(InScheduler) {}
+
+	virtual EXDownloadCacheTier GetTier() const override { return EXDownloadCacheTier::SaveGame; }
+	virtual void Read(const FString& ImageID, TFunction<void(FXDownloadCacheHit*)> OnRead) override;
+	virtual void Write(const FString& ImageID, const FString& ImageURL, const TArray<uint8>& ImageData, const FXDownloadCacheFreshness& Freshness) override;
+
+private:
+	static void WriteOnGameThread(UXDownloaderSaveGame* DownloaderSaveGame, const FString& SlotName, FXDownloadScheduler& Scheduler, const FXDownloadImageCached& ImageCached);
+
+	TWeakObjectPtr<UXDownloaderSaveGame> SaveGame;
+
+	FString SlotName;
+
+	TSharedRef<FXDownloadScheduler, ESPMode::ThreadSafe> Scheduler;
+};
+
+//the read-only packs mounted by the subsystem
+class FXDownloadPackTier : public IXDownloadCacheTier
+{
+public:
+	//the packs mounted when the batch started, a batch does not see the packs mounted after it
+	explicit FXDownloadPackTier(TArray<TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe>> InCachePacks) : CachePacks(MoveTemp(InCachePacks)) {}
+
+	virtual EXDownloadCacheTier GetTier() const override { return EXDownloadCacheTier::Pack; }
+	virtual void Read(const FString& ImageID, TFunction<void(FXDownloadCacheHit*)> OnRead) override;
+	virtual void Write(const FString& ImageID, const FString& ImageURL, const TArray<uint8>& ImageData, const FXDownloadCacheFreshness& Freshness) override {}
+	virtual bool IsWritable() const override { return false; }
+
+private:
+	const TArray<TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe>> CachePacks;
+};
@@ -0,0 +1,300 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadFileCache.h"
+
+#include "Async/Async.h"
+#include "Async/AsyncFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "XDownLoader.h"
+#include "XDownloaderSettings.h"
+#include "XDownloaderStats.h"
+
+namespace XDownloadFileCache
+{
+	//one asynchronous read, the requests are released before the handle
+	struct FFileRead
+	{
+		//held while a request is issued, so its completion never releases the read before the request is stored
+		FCriticalSection Lock;
+
+		TUniquePtr<IAsyncReadFileHandle> Handle;
+
+		TUniquePtr<IAsyncReadRequest> SizeRequest;
+
+		TUniquePtr<IAsyncReadRequest> ReadRequest;
+
+		TArray<uint8> Data;
+
+		TFunction<void(TArray<uint8>*)> OnRead;
+	};
+
+	static void Finish(const TSharedRef<FFileRead, ESPMode::ThreadSafe>& FileRead, bool bSucceed)
+	{
+		{
+			FScopeLock ScopeLock(&FileRead->Lock);
+			FileRead->ReadRequest.Reset();
+			FileRead->SizeRequest.Reset();
+			FileRead->Handle.Reset();
+		}
+		FileRead->OnRead(bSucceed ? &FileRead->Data : nullptr);
+	}
+
+	//the request comes from its callback, the member may not be stored yet
+	static void OnReadDone(const TSharedRef<FFileRead, ESPMode::ThreadSafe>& FileRead, IAsyncReadRequest* Request, bool bWasCancelled)
+	{
+		Request->WaitCompletion();
+		Finish(FileRead, !bWasCancelled && Request->GetReadResults() != nullptr);
+	}
+
+	static void OnSizeDone(const TSharedRef<FFileRead, ESPMode::ThreadSafe>& FileRead, IAsyncReadRequest* Request, int64 Size)
+	{
+		Request->WaitCompletion();
+		if (Size <= 0)
+		{
+			Finish(FileRead, false);
+			return;
+		}
+		LLM_SCOPE_BYTAG(XDownloader_FileCache);
+		FileRead->Data.SetNumUninitialized(Size);
+		FAsyncFileCallBack ReadCallback = [FileRead](bool bWasCancelled, IAsyncReadRequest* ReadRequest)
+		{
+			//a request can not be deleted from its own callback
+			AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [FileRead, ReadRequest, bWasCancelled]() { OnReadDone(FileRead, ReadRequest, bWasCancelled); });
+		};
+		FScopeLock ScopeLock(&FileRead->Lock);
+		FileRead->ReadRequest.Reset(FileRead->Handle->ReadRequest(0, Size, AIOP_Normal, &ReadCallback, FileRead->Data.GetData()));
+	}
+}
+
+void FXDownloadFileCache::Read(const FString& FilePath, TFunction<void(TArray<uint8>*)> OnRead)
+{
+	LLM_SCOPE_BYTAG(XDownloader_FileCache);
+	TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> PendingData;
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		if (const FPendingWrite* PendingWrite = PendingWrites.Find(FilePath))
+		{
+			PendingData = PendingWrite->Data;
+		}
+	}
+	if (PendingData.IsValid())
+	{
+		TArray<uint8> Data = *PendingData;
+		//a queued deletion
+		OnRead(Data.Num() ? &Data : nullptr);
+		return;
+	}
+	ReadFile(FilePath, MoveTemp(OnRead));
+}
+
+void FXDownloadFileCache::ReadFile(const FString& FilePath, TFunction<void(TArray<uint8>*)> OnRead)
+{
+	using namespace XDownloadFileCache;
+	const TSharedRef<FFileRead, ESPMode::ThreadSafe> FileRead = MakeShared<FFileRead, ESPMode::ThreadSafe>();
+	FileRead->OnRead = MoveTemp(OnRead);
+	FileRead->Handle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenAsyncRead(*FilePath));
+	if (!FileRead->Handle)
+	{
+		FileRead->OnRead(nullptr);
+		return;
+	}
+	FAsyncFileCallBack SizeCallback = [FileRead](bool bWasCancelled, IAsyncReadRequest* Request)
+	{
+		const int64 Size = bWasCancelled ? INDEX_NONE : Request->GetSizeResults();
+		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [FileRead, Request, Size]() { OnSizeDone(FileRead, Request, Size); });
+	};
+	FScopeLock ScopeLock(&FileRead->Lock);
+	FileRead->SizeRequest.Reset(FileRead->Handle->SizeRequest(&SizeCallback));
+}
+
+void FXDownloadFileCache::Write(const FString& FilePath, TArray<uint8> Data)
+{
+	LLM_SCOPE_BYTAG(XDownloader_FileCache);
+	const UXDownloaderSettings* Settings = GetDefault<UXDownloaderSettings>();
+	const int64 MaxPendingBytes = Settings->GetFileCacheMaxPendingMB() * 1024ll * 1024ll;
+	bool bFlush = false;
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		const int32 DataSize = Data.Num();
+		//the game thread never writes inline, a full queue drops its write and the image is downloaded again next session
+		if (IsInGameThread() && DataSize > 0 && PendingBytes > MaxPendingBytes && !PendingWrites.Contains(FilePath))
+		{
+			UE_LOG(LogXDownloader, Verbose, TEXT("Cache file %s dropped, the write queue is full"), *FilePath);
+			bFlush = true;
+		}
+		else if (FPendingWrite* PendingWrite = PendingWrites.Find(FilePath))
+		{
+			INC_DWORD_STAT(STAT_XDownloaderFileWritesCoalesced);
+			PendingBytes -= PendingWrite->Data->Num();
+			PendingBytes += DataSize;
+			//a write in flight keeps its writer, which queues the file again once done
+			PendingWrite->Data = MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Data));
+		}
+		else
+		{
+			if (PendingWrites.IsEmpty())
+			{
+				FirstPendingTime = FPlatformTime::Seconds();
+			}
+			PendingWrites.Add(FilePath, FPendingWrite{MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Data))});
+			PendingBytes += DataSize;
+		}
+		SET_MEMORY_STAT(STAT_XDownloaderFileWritesPending, PendingBytes);
+		bFlush = bFlush || PendingBytes >= Settings->GetFileCacheFlushThresholdKB() * 1024ll;
+	}
+	if (bFlush)
+	{
+		StartWriter();
+	}
+	//bounded memory, a producer off the game thread pays for the writes the writer can not keep up with
+	while (!IsInGameThread() && GetPendingBytes() > MaxPendingBytes && WriteNext())
+	{
+	}
+}
+
+void FXDownloadFileCache::Delete(const FString& FilePath)
+{
+	Write(FilePath, TArray<uint8>());
+}
+
+bool FXDownloadFileCache::Exists(const FString& FilePath) const
+{
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		if (const FPendingWrite* PendingWrite = PendingWrites.Find(FilePath))
+		{
+			return PendingWrite->Data->Num() > 0;
+		}
+	}
+	return FPaths::FileExists(FilePath);
+}
+
+void FXDownloadFileCache::Tick()
+{
+	bool bFlush = false;
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		bFlush = !bWriterRunning && PendingWrites.Num()
+			&& (FPlatformTime::Seconds() - FirstPendingTime) * 1000.0 >= GetDefault<UXDownloaderSettings>()->GetFileCacheFlushIntervalMs();
+	}
+	if (bFlush)
+	{
+		StartWriter();
+	}
+}
+
+void FXDownloadFileCache::Flush()
+{
+	for (;;)
+	{
+		while (WriteNext())
+		{
+		}
+		{
+			FScopeLock ScopeLock(&PendingLock);
+			if (PendingWrites.IsEmpty())
+			{
+				return;
+			}
+		}
+		//the rest is held by the background writer, wait until it is written or handed back
+		WriteDoneEvent->Wait(10);
+	}
+}
+
+int64 FXDownloadFileCache::GetPendingBytes() const
+{
+	FScopeLock ScopeLock(&PendingLock);
+	return PendingBytes;
+}
+
+bool FXDownloadFileCache::WriteNext()
+{
+	FString FilePath;
+	TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> Data;
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		for (TPair<FString, FPendingWrite>& PendingWrite : PendingWrites)
+		{
+			if (!PendingWrite.Value.bWriting)
+			{
+				PendingWrite.Value.bWriting = true;
+				FilePath = PendingWrite.Key;
+				Data = PendingWrite.Value.Data;
+				break;
+			}
+		}
+	}
+	if (!Data.IsValid())
+	{
+		return false;
+	}
+	if (Data->Num())
+	{
+		WriteFileAtomically(FilePath, *Data);
+	}
+	else
+	{
+		IFileManager::Get().Delete(*FilePath, false, false, true);
+	}
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		//a newer write of the file stays queued for the next writer, only one writer at a time renames a file
+		FPendingWrite* PendingWrite = PendingWrites.Find(FilePath);
+		if (PendingWrite && &PendingWrite->Data.Get() == Data.Get())
+		{
+			PendingBytes -= Data->Num();
+			PendingWrites.Remove(FilePath);
+		}
+		else if (PendingWrite)
+		{
+			PendingWrite->bWriting = false;
+		}
+		SET_MEMORY_STAT(STAT_XDownloaderFileWritesPending, PendingBytes);
+	}
+	WriteDoneEvent->Trigger();
+	return true;
+}
+
+void FXDownloadFileCache::StartWriter()
+{
+	{
+		FScopeLock ScopeLock(&PendingLock);
+		if (bWriterRunning || PendingWrites.IsEmpty())
+		{
+			return;
+		}
+		bWriterRunning = true;
+	}
+	AsyncTask(ENamedThreads::BackgroundThreadPriority, [This = AsShared()]()
+	{
+		while (This->WriteNext())
+		{
+		}
+		FScopeLock ScopeLock(&This->PendingLock);
+		This->bWriterRunning = false;
+	});
+}
+
+bool FXDownloadFileCache::WriteFileAtomically(const FString& FilePath, const TArray<uint8>& Data)
+{
+	XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderCacheWrite);
+	//the temp files live next to the cache, so the rename stays on one volume
+	const FString TempDirectory = FPaths::Combine(FPaths::GetPath(FilePath), TEXT("Temp"));
+	const FString TempFilePath = FPaths::CreateTempFilename(*TempDirectory, *FPaths::GetCleanFilename(FilePath), TEXT(".tmp"));
+	if (!FFileHelper::SaveArrayToFile(Data, *TempFilePath))
+	{
+		UE_LOG(LogXDownloader, Warning, TEXT("Cache file %s can not be written!!!"), *FilePath);
+		return false;
+	}
+	if (!IFileManager::Get().Move(*FilePath, *TempFilePath, true, true))
+	{
+		UE_LOG(LogXDownloader, Warning, TEXT("Cache file %s can not be replaced!!!"), *FilePath);
+		IFileManager::Get().Delete(*TempFilePath, false, false, true);
+		return false;
+	}
+	return true;
+}
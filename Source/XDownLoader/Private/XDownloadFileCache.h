@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Event.h"
+
+/**
+ * @class FXDownloadFileCache
+ * @brief The asynchronous I/O stage of the local file cache tier.
+ *
+ * Reads go through IAsyncReadFileHandle, so no thread blocks on the disk. Writes are queued and written behind
+ * by one background writer, to a temp file renamed over the cached file once complete, so a reader never sees a torn image.
+ * Writes to the same file coalesce while queued and a read of a queued file is served from the queue.
+ * A deletion is queued like a write, so it never races a queued write of the file.
+ * The queue is flushed once it holds FileCacheFlushThresholdKB or its oldest write is FileCacheFlushIntervalMs old,
+ * while the queue is over FileCacheMaxPendingMB a producer writes inline, or drops its write on the game thread.
+ */
+class FXDownloadFileCache : public TSharedFromThis<FXDownloadFileCache, ESPMode::ThreadSafe>
+{
+public:
+	/**
+	 * @brief Reads a cached file without blocking.
+	 *
+	 * @param FilePath The path of the cached file.
+	 * @param OnRead Called on a background thread, or right away for a queued file, with the file content or nullptr if it is missing.
+	 */
+	void Read(const FString& FilePath, TFunction<void(TArray<uint8>*)> OnRead);
+
+	//reads any file through IAsyncReadFileHandle, without looking at the queued writes
+	static void ReadFile(const FString& FilePath, TFunction<void(TArray<uint8>*)> OnRead);
+
+	//queues a file for the writer, can be called from any thread
+	void Write(const FString& FilePath, TArray<uint8> Data);
+
+	//queues the deletion of a file for the writer, can be called from any thread
+	void Delete(const FString& FilePath);
+
+	//whether the file is cached or queued, stats the disk
+	bool Exists(const FString& FilePath) const;
+
+	//starts the writer once the flush interval has passed, game thread
+	void Tick();
+
+	//writes every queued file on the calling thread, and waits for the ones the background writer is writing
+	void Flush();
+
+	int64 GetPendingBytes() const;
+
+private:
+	struct FPendingWrite
+	{
+		//empty for a deletion
+		TSharedRef<const TArray<uint8>, ESPMode::ThreadSafe> Data;
+
+		//set while a writer writes the file, a newer write of the file is picked up once it is done
+		bool bWriting = false;
+	};
+
+	//writes the oldest queued file that no writer holds, returns false if there is none
+	bool WriteNext();
+
+	void StartWriter();
+
+	static bool WriteFileAtomically(const FString& FilePath, const TArray<uint8>& Data);
+
+	mutable FCriticalSection PendingLock;
+
+	TMap<FString, FPendingWrite> PendingWrites;
+
+	int64 PendingBytes = 0;
+
+	//time the queue became non-empty, for the flush interval
+	double FirstPendingTime = 0.0;
+
+	bool bWriterRunning = false;
+
+	//triggered each time a writer is done with a file, wakes Flush
+	FEventRef WriteDoneEvent;
+};
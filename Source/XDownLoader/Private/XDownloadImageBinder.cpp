@@ -0,0 +1,184 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadImageBinder.h"
+
+#include "Components/Image.h"
+#include "Engine/Texture2D.h"
+#include "XDownloadListener.h"
+#include "XDownloadManager.h"
+#include "XDownloaderStats.h"
+#include "XDownloaderSubsystem.h"
+
+FXDownloadImageBinder::FXDownloadImageBinder(UXDownloaderSubsystem* InDownloaderSubsystem)
+	: DownloaderSubsystem(InDownloaderSubsystem)
+{
+}
+
+void FXDownloadImageBinder::Bind(UImage* Image, const FImageDownloadTask& Task, const FString& InSaveGameSlotName, bool bMatchSize)
+{
+	check(IsInGameThread());
+	if (!Image)
+	{
+		return;
+	}
+	//the same image again, e.g. a list entry set to the item it already shows
+	if (FBinding* Binding = Bindings.Find(Image); Binding && Binding->ImageID == Task.ImageID)
+	{
+		SetVisible(Image, true);
+		return;
+	}
+	//a recycled entry no longer needs its previous image
+	Unbind(Image);
+	FBinding& Binding = Bindings.Add(Image);
+	Binding.ImageID = Task.ImageID;
+	Binding.ImageURL = Task.ImageURL;
+	Binding.SaveGameSlotName = InSaveGameSlotName;
+	Binding.bMatchSize = bMatchSize;
+	if (UTexture2D* PlaceholderTexture = DownloaderSubsystem->GetPlaceholderTexture(Task.ImageID, InSaveGameSlotName))
+	{
+		Image->SetBrushFromTexture(PlaceholderTexture, false);
+	}
+	StartLoad(Image, Binding);
+	SET_DWORD_STAT(STAT_XDownloaderBoundImages, Bindings.Num());
+}
+
+void FXDownloadImageBinder::Reload(const FString& ImageID)
+{
+	check(IsInGameThread());
+	for (TPair<TWeakObjectPtr<UImage>, FBinding>& Binding : Bindings)
+	{
+		//a binding still loading gets the refreshed bytes from the cache anyway
+		if (UImage* Image = Binding.Key.Get(); Image && Binding.Value.ImageID == ImageID && !Binding.Value.DownloadManager.IsValid())
+		{
+			StartLoad(Image, Binding.Value);
+		}
+	}
+}
+
+void FXDownloadImageBinder::StartLoad(UImage* Image, FBinding& Binding)
+{
+	Binding.Serial = ++NextSerial;
+	FImageDownloadTask Task;
+	Task.ImageID = Binding.ImageID;
+	Task.ImageURL = Binding.ImageURL;
+	Task.Priority = Binding.Priority;
+	//the widget owns the batch, so it is cancelled if the widget is collected
+	UXDownloadManager* DownloadManager = UXDownloadManager::DownloadImages({Task}, Binding.SaveGameSlotName, true, Image);
+	UXDownloadListener* Listener = NewObject<UXDownloadListener>();
+	Listener->OnSubTask = [WeakThis = AsWeak(), WeakImage = TWeakObjectPtr<UImage>(Image), Serial = Binding.Serial](const FDownloadResult& Result)
+	{
+		if (const TSharedPtr<FXDownloadImageBinder> Binder = WeakThis.Pin())
+		{
+			Binder->OnImageLoaded(WeakImage, Serial, Result);
+		}
+	};
+	Listener->Listen(DownloadManager);
+	Binding.DownloadManager = DownloadManager;
+	Binding.Listener.Reset(Listener);
+}
+
+void FXDownloadImageBinder::SetVisible(UImage* Image, bool bVisible)
+{
+	if (FBinding* Binding = Bindings.Find(Image))
+	{
+		Binding->bVisibleByCaller = bVisible;
+	}
+}
+
+void FXDownloadImageBinder::Unbind(UImage* Image)
+{
+	FBinding Binding;
+	if (Bindings.RemoveAndCopyValue(Image, Binding))
+	{
+		Release(Binding);
+		SET_DWORD_STAT(STAT_XDownloaderBoundImages, Bindings.Num());
+	}
+}
+
+void FXDownloadImageBinder::Tick()
+{
+	for (auto It = Bindings.CreateIterator(); It; ++It)
+	{
+		FBinding& Binding = It->Value;
+		const UImage* Image = It->Key.Get();
+		if (!Image)
+		{
+			Release(Binding);
+			It.RemoveCurrent();
+			continue;
+		}
+		UXDownloadManager* DownloadManager = Binding.DownloadManager.Get();
+		if (!DownloadManager)
+		{
+			continue;
+		}
+		const bool bVisible = Binding.bVisibleByCaller && Image->IsVisible() && Image->GetCachedWidget().IsValid();
+		const EXDownloadPriority Priority = bVisible ? EXDownloadPriority::Visible : EXDownloadPriority::Offscreen;
+		if (Binding.Priority != Priority)
+		{
+			Binding.Priority = Priority;
+			DownloadManager->SetImagePriority(Binding.ImageID, Priority);
+		}
+	}
+	SET_DWORD_STAT(STAT_XDownloaderBoundImages, Bindings.Num());
+}
+
+void FXDownloadImageBinder::UnbindAll()
+{
+	for (TPair<TWeakObjectPtr<UImage>, FBinding>& Binding : Bindings)
+	{
+		Release(Binding.Value);
+	}
+	Bindings.Empty();
+	SET_DWORD_STAT(STAT_XDownloaderBoundImages, 0);
+}
+
+void FXDownloadImageBinder::OnImageLoaded(const TWeakObjectPtr<UImage>& WeakImage, uint32 Serial, const FDownloadResult& Result)
+{
+	UImage* Image = WeakImage.Get();
+	FBinding* Binding = Image ? Bindings.Find(Image) : nullptr;
+	if (!Binding || Binding->Serial != Serial)
+	{
+		//unbound since, the region reference of the result is not needed
+		FXDownloadAtlasRegion AtlasRegion = Result.AtlasRegion;
+		DownloaderSubsystem->ReleaseAtlasRegion(AtlasRegion);
+		return;
+	}
+	Binding->DownloadManager.Reset();
+	Binding->Listener.Reset();
+	if (Result.Status != EDownloadStatus::Success)
+	{
+		return;
+	}
+	//a reload replaces what the widget showed before
+	DownloaderSubsystem->ReleaseAtlasRegion(Binding->AtlasRegion);
+	Binding->ImageHandle.Reset();
+	if (Result.AtlasRegion.IsValid())
+	{
+		Binding->AtlasRegion = Result.AtlasRegion;
+		FSlateBrush Brush = Result.AtlasRegion.Brush;
+		if (!Binding->bMatchSize)
+		{
+			Brush.ImageSize = Image->GetBrush().ImageSize;
+		}
+		Image->SetBrush(Brush);
+	}
+	else if (Result.Texture)
+	{
+		Binding->ImageHandle = Result.ImageHandle;
+		Image->SetBrushFromTexture(Result.Texture, Binding->bMatchSize);
+	}
+}
+
+void FXDownloadImageBinder::Release(FBinding& Binding) const
+{
+	if (UXDownloadManager* DownloadManager = Binding.DownloadManager.Get())
+	{
+		DownloadManager->CancelAll();
+	}
+	//a batch dropped without a result never calls the listener back
+	Binding.Listener.Reset();
+	DownloaderSubsystem->ReleaseAtlasRegion(Binding.AtlasRegion);
+	Binding.ImageHandle.Reset();
+}
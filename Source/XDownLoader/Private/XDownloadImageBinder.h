@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/StrongObjectPtr.h"
+#include "XDownloadListener.h"
+#include "XDownloaderTypes.h"
+
+class UImage;
+class UXDownloadManager;
+class UXDownloaderSubsystem;
+
+/**
+ * @class FXDownloadImageBinder
+ * @brief Loads single images into UImage widgets at the priority of their visibility, see UXDownloadImageLibrary.
+ *
+ * Every bound widget runs a one image batch at Visible priority, lowered to Offscreen while the widget is hidden,
+ * not constructed or reported out of view by the caller. Binding another image to the same widget, as a recycled
+ * list entry does, cancels the previous one. Owned by UXDownloaderSubsystem, game thread only.
+ */
+class FXDownloadImageBinder : public TSharedFromThis<FXDownloadImageBinder>
+{
+public:
+	explicit FXDownloadImageBinder(UXDownloaderSubsystem* InDownloaderSubsystem);
+
+	/**
+	 * @brief Starts loading an image into a widget, showing its placeholder until it is ready.
+	 *
+	 * @param Image The widget.
+	 * @param Task The image, its priority is ignored.
+	 * @param InSaveGameSlotName The slot the image is cached in, the default slot if empty.
+	 * @param bMatchSize Whether the widget takes the size of the image.
+	 */
+	void Bind(UImage* Image, const FImageDownloadTask& Task, const FString& InSaveGameSlotName, bool bMatchSize);
+
+	//marks a widget as scrolled in or out of view, an image not loaded yet changes priority
+	void SetVisible(UImage* Image, bool bVisible);
+
+	//cancels the image of a widget if it is still loading and releases what the widget holds
+	void Unbind(UImage* Image);
+
+	//loads a refreshed image again into the widgets that already show it, they keep the stale one until it is ready
+	void Reload(const FString& ImageID);
+
+	//updates the priorities from the widget visibility and drops the bindings of destroyed widgets
+	void Tick();
+
+	void UnbindAll();
+
+	int32 GetBindingNum() const { return Bindings.Num(); }
+
+private:
+	struct FBinding
+	{
+		FString ImageID;
+
+		FString ImageURL;
+
+		FString SaveGameSlotName;
+
+		//the one image batch, null once it has finished
+		TWeakObjectPtr<UXDownloadManager> DownloadManager;
+
+		//forwards the result of the batch, dropped with the binding or once the result arrived
+		TStrongObjectPtr<UXDownloadListener> Listener;
+
+		//tells a late result of a previous binding of the same widget apart
+		uint32 Serial = 0;
+
+		EXDownloadPriority Priority = EXDownloadPriority::Visible;
+
+		//cleared by SetVisible
+		bool bVisibleByCaller = true;
+
+		bool bMatchSize = false;
+
+		//keeps the texture shown by the widget alive
+		FXDownloadImageHandle ImageHandle;
+
+		FXDownloadAtlasRegion AtlasRegion;
+	};
+
+	//runs the one image batch of a binding at its priority under a new serial
+	void StartLoad(UImage* Image, FBinding& Binding);
+
+	void OnImageLoaded(const TWeakObjectPtr<UImage>& WeakImage, uint32 Serial, const FDownloadResult& Result);
+
+	void Release(FBinding& Binding) const;
+
+	UXDownloaderSubsystem* DownloaderSubsystem = nullptr;
+
+	TMap<TWeakObjectPtr<UImage>, FBinding> Bindings;
+
+	uint32 NextSerial = 0;
+};
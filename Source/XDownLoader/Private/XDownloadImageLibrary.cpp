@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadImageLibrary.h"
+
+#include "Components/Image.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "XDownLoader.h"
+#include "XDownloadImageBinder.h"
+#include "XDownloaderSubsystem.h"
+
+static FXDownloadImageBinder* FindImageBinder(const UImage* Image)
+{
+	const UWorld* World = Image ? Image->GetWorld() : nullptr;
+	const UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+	UXDownloaderSubsystem* DownloaderSubsystem = GameInstance ? GameInstance->GetSubsystem<UXDownloaderSubsystem>() : nullptr;
+	return DownloaderSubsystem ? DownloaderSubsystem->GetImageBinder() : nullptr;
+}
+
+void UXDownloadImageLibrary::LoadImageAsync(UImage* Image, const FImageDownloadTask& Task, bool bMatchSize, const FString& InSaveGameSlotName)
+{
+	FXDownloadImageBinder* ImageBinder = FindImageBinder(Image);
+	if (!ImageBinder)
+	{
+		UE_LOG(LogXDownloader, Warning, TEXT("LoadImageAsync needs an image in a game world!!! ImageID :%s"), *Task.ImageID);
+		return;
+	}
+	ImageBinder->Bind(Image, Task, InSaveGameSlotName, bMatchSize);
+}
+
+void UXDownloadImageLibrary::SetImageVisible(UImage* Image, bool bVisible)
+{
+	if (FXDownloadImageBinder* ImageBinder = FindImageBinder(Image))
+	{
+		ImageBinder->SetVisible(Image, bVisible);
+	}
+}
+
+void UXDownloadImageLibrary::CancelImageLoad(UImage* Image)
+{
+	if (FXDownloadImageBinder* ImageBinder = FindImageBinder(Image))
+	{
+		ImageBinder->Unbind(Image);
+	}
+}
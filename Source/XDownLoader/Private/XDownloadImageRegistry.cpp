@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadImageRegistry.h"
+
+#include "Async/Async.h"
+#include "Engine/Texture2D.h"
+#include "XDownloaderStats.h"
+
+FXDownloadImageRef::~FXDownloadImageRef()
+{
+	if (const TSharedPtr<FXDownloadImageRegistry, ESPMode::ThreadSafe> PinnedRegistry = Registry.Pin())
+	{
+		PinnedRegistry->Release(Texture);
+	}
+}
+
+FXDownloadImageHandle FXDownloadImageRegistry::Acquire(UTexture2D* Texture, const FString& ImageID)
+{
+	check(IsInGameThread());
+	FXDownloadImageHandle Handle;
+	if (!Texture)
+	{
+		return Handle;
+	}
+	FScopeLock ScopeLock(&ImagesLock);
+	TWeakPtr<FXDownloadImageRef, ESPMode::ThreadSafe>& Image = Images.FindOrAdd(Texture);
+	Handle.Ref = Image.Pin();
+	if (!Handle.Ref.IsValid())
+	{
+		Handle.Ref = MakeShared<FXDownloadImageRef, ESPMode::ThreadSafe>(Texture, ImageID, AsShared());
+		Image = Handle.Ref;
+		INC_DWORD_STAT(STAT_XDownloaderImageHandles);
+	}
+	return Handle;
+}
+
+int32 FXDownloadImageRegistry::GetImageNum() const
+{
+	FScopeLock ScopeLock(&ImagesLock);
+	return Images.Num();
+}
+
+void FXDownloadImageRegistry::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	FScopeLock ScopeLock(&ImagesLock);
+	for (TPair<UTexture2D*, TWeakPtr<FXDownloadImageRef, ESPMode::ThreadSafe>>& Image : Images)
+	{
+		Collector.AddReferencedObject(Image.Key);
+	}
+}
+
+void FXDownloadImageRegistry::Release(UTexture2D* Texture)
+{
+	{
+		FScopeLock ScopeLock(&ImagesLock);
+		const TWeakPtr<FXDownloadImageRef, ESPMode::ThreadSafe>* Image = Images.Find(Texture);
+		//a handle acquired again since, on another frame
+		if (!Image || Image->IsValid())
+		{
+			return;
+		}
+		Images.Remove(Texture);
+		DEC_DWORD_STAT(STAT_XDownloaderImageHandles);
+	}
+	if (!IsInGameThread())
+	{
+		AsyncTask(ENamedThreads::GameThread, [WeakThis = AsWeak(), Texture]()
+		{
+			const TSharedPtr<FXDownloadImageRegistry, ESPMode::ThreadSafe> Registry = WeakThis.Pin();
+			if (!Registry.IsValid() || !Registry->OnImageReleased)
+			{
+				return;
+			}
+			{
+				FScopeLock ScopeLock(&Registry->ImagesLock);
+				if (Registry->Images.Contains(Texture))
+				{
+					return;
+				}
+			}
+			Registry->OnImageReleased(Texture);
+		});
+		return;
+	}
+	if (OnImageReleased)
+	{
+		OnImageReleased(Texture);
+	}
+}
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/GCObject.h"
+#include "XDownloaderTypes.h"
+
+class UTexture2D;
+class FXDownloadImageRegistry;
+
+/**
+ * @struct FXDownloadImageRef
+ * @brief The shared state of the handles of one texture, see FXDownloadImageHandle.
+ *
+ * Destroyed with the last handle, which tells the registry the texture is no longer used.
+ */
+struct FXDownloadImageRef
+{
+	FXDownloadImageRef(UTexture2D* InTexture, const FString& InImageID, const TWeakPtr<FXDownloadImageRegistry, ESPMode::ThreadSafe>& InRegistry)
+		: Texture(InTexture)
+		, ImageID(InImageID)
+		, Registry(InRegistry)
+	{
+	}
+
+	~FXDownloadImageRef();
+
+	//kept alive by the registry while this exists
+	UTexture2D* Texture = nullptr;
+
+	FString ImageID;
+
+	TWeakPtr<FXDownloadImageRegistry, ESPMode::ThreadSafe> Registry;
+};
+
+/**
+ * @class FXDownloadImageRegistry
+ * @brief Keeps the textures handed out through FXDownloadImageHandle alive, without the root set.
+ *
+ * The textures are reported to the garbage collector as long as a handle to them exists. Once the last handle
+ * of a texture is gone, OnImageReleased lets the cache tiers drop their own references so the texture can be collected.
+ * Handles are acquired on the game thread, the last one may be dropped on any thread.
+ */
+class FXDownloadImageRegistry : public FGCObject, public TSharedFromThis<FXDownloadImageRegistry, ESPMode::ThreadSafe>
+{
+public:
+	/**
+	 * @brief Returns a handle to a texture, sharing the reference count of its existing handles. Game thread only.
+	 *
+	 * @param Texture The texture of the image.
+	 * @param ImageID The ID the image was requested with.
+	 * @return The handle, invalid for a null texture.
+	 */
+	FXDownloadImageHandle Acquire(UTexture2D* Texture, const FString& ImageID);
+
+	//number of textures with at least one live handle
+	int32 GetImageNum() const;
+
+	//called on the game thread once the last handle of a texture has been dropped
+	TFunction<void(UTexture2D*)> OnImageReleased;
+
+	//FGCObject
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override { return TEXT("FXDownloadImageRegistry"); }
+
+private:
+	friend struct FXDownloadImageRef;
+
+	void Release(UTexture2D* Texture);
+
+	mutable FCriticalSection ImagesLock;
+
+	TMap<UTexture2D*, TWeakPtr<FXDownloadImageRef, ESPMode::ThreadSafe>> Images;
+};
@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadListener.h"
+
+#include "XDownloadManager.h"
+
+void UXDownloadListener::Listen(UXDownloadManager* InDownloadManager)
+{
+	InDownloadManager->OnTotalDownloadProgress.AddDynamic(this, &UXDownloadListener::HandleProgress);
+	InDownloadManager->OnSubTaskResult.AddDynamic(this, &UXDownloadListener::HandleSubTask);
+	InDownloadManager->OnTotalDownloadSucceed.AddDynamic(this, &UXDownloadListener::HandleSucceed);
+	InDownloadManager->OnTotalDownloadFailed.AddDynamic(this, &UXDownloadListener::HandleFailed);
+}
+
+void UXDownloadListener::HandleProgress(const FTotalDownloadResult& DownloadProgress)
+{
+	if (OnProgress)
+	{
+		OnProgress(DownloadProgress);
+	}
+}
+
+void UXDownloadListener::HandleSubTask(const FDownloadResult& SubTaskResult)
+{
+	if (OnSubTask)
+	{
+		OnSubTask(SubTaskResult);
+	}
+}
+
+void UXDownloadListener::HandleSucceed(const FTotalDownloadResult& DownloadResult)
+{
+	if (OnFinished)
+	{
+		OnFinished(DownloadResult, true);
+	}
+}
+
+void UXDownloadListener::HandleFailed(const FTotalDownloadResult& DownloadResult)
+{
+	if (OnFinished)
+	{
+		OnFinished(DownloadResult, false);
+	}
+}
@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "XDownloaderTypes.h"
+#include "XDownloadListener.generated.h"
+
+class UXDownloadManager;
+
+/**
+ * @class UXDownloadListener
+ * @brief Forwards the dynamic events of a UXDownloadManager to native callbacks.
+ *
+ * Used by native tooling (benchmark, commandlets) that needs to follow a batch without a Blueprint.
+ * The listener is not rooted, the caller keeps it alive for as long as it wants the callbacks, e.g. with a TStrongObjectPtr.
+ * A batch dropped before it finished never calls OnFinished.
+ */
+UCLASS()
+class UXDownloadListener : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	//called on the game thread for each finalized sub task with the accumulated batch result
+	TFunction<void(const FTotalDownloadResult&)> OnProgress;
+
+	//called on the game thread for each finalized sub task with only that sub task, also in streaming mode
+	TFunction<void(const FDownloadResult&)> OnSubTask;
+
+	//called on the game thread once the batch has finished, bSucceed is false if any sub task failed
+	TFunction<void(const FTotalDownloadResult&, bool)> OnFinished;
+
+	/**
+	 * @brief Binds the listener to the events of a download manager.
+	 *
+	 * @param InDownloadManager The manager returned by UXDownloadManager::DownloadImages.
+	 */
+	void Listen(UXDownloadManager* InDownloadManager);
+
+	UFUNCTION()
+	void HandleProgress(const FTotalDownloadResult& DownloadProgress);
+
+	UFUNCTION()
+	void HandleSubTask(const FDownloadResult& SubTaskResult);
+
+	UFUNCTION()
+	void HandleSucceed(const FTotalDownloadResult& DownloadResult);
+
+	UFUNCTION()
+	void HandleFailed(const FTotalDownloadResult& DownloadResult);
+};
@@ -10,40 +10,203 @@
 #include "Engine/Texture2DDynamic.h"
 #include "Interfaces/IHttpRequest.h"
 #include "Interfaces/IHttpResponse.h"
+#include "ImageCore.h"
+#include "XDownLoader.h"
+#include "XDownloaderStats.h"
+#include "XDownloadPartial.h"
+#include "XDownloadFileCache.h"
+#include "XDownloadScheduler.h"
+#include "XDownloadTransport.h"
+#include "XDownloadPreview.h"
+#include "XDownloadPlaceholder.h"
+#include "XDownloadAtlas.h"
+#include "XDownloadCacheTier.h"
+#include "XDownloadNegativeCache.h"
+#include "XDownloadBandwidth.h"
+#include "Containers/Ticker.h"
+#include "ProfilingDebugging/CountersTrace.h"
 
-int32 UXDownloadManager::MaxParallelDownloads = 5;
-int32 UXDownloadManager::CurrentParallelDownloads = 0;
-static FCriticalSection ExecutingXDownloadTaskPoolLock;
-TQueue<FImageDownloadTask> UXDownloadManager::TaskQueue;
-UWorld* UXDownloadManager::GameWorld = nullptr;
-TArray<UXDownloadManager*> UXDownloadManager::DownloadManagers;
+TRACE_DECLARE_FLOAT_COUNTER(XDownloaderQueueWaitMs, TEXT("XDownloader/QueueWaitMs"));
+TRACE_DECLARE_FLOAT_COUNTER(XDownloaderNetworkMs, TEXT("XDownloader/NetworkMs"));
+TRACE_DECLARE_INT_COUNTER(XDownloaderBytesDownloaded, TEXT("XDownloader/BytesDownloaded"));
+
+#if STATS || COUNTERSTRACE_ENABLED
+//hits per EXDownloadCacheTier, misses counted under Num
+static int32 CacheTierHitNums[static_cast<uint8>(EXDownloadCacheTier::Num) + 1] = {};
+static int64 DownloadedBytes = 0;
+#endif
+
+#if STATS
+//the samples of a duration since start, shown as their average and peak rather than the last one
+struct FXDownloadDurationStat
+{
+	int32 Num = 0;
+	double SumMs = 0.0;
+	float MaxMs = 0.f;
+
+	void Add(float Ms)
+	{
+		++Num;
+		SumMs += Ms;
+		MaxMs = FMath::Max(MaxMs, Ms);
+	}
+
+	float GetAverageMs() const { return Num ? SumMs / Num : 0.f; }
+};
+
+//written from the game thread, the HTTP callbacks and the lookup threads
+static FCriticalSection DurationStatsLock;
+static FXDownloadDurationStat QueueWaitStat;
+static FXDownloadDurationStat NetworkStat;
+//reads per EXDownloadCacheTier, hit or miss
+static FXDownloadDurationStat CacheReadStats[static_cast<uint8>(EXDownloadCacheTier::Num)];
+
+#define XDOWNLOADER_SET_TIER_STATS(TierName, ReadStat, HitNum) \
+	SET_DWORD_STAT(STAT_XDownloader##TierName##Reads, ReadStat.Num); \
+	SET_FLOAT_STAT(STAT_XDownloader##TierName##ReadAvgMs, ReadStat.GetAverageMs()); \
+	SET_FLOAT_STAT(STAT_XDownloader##TierName##ReadMaxMs, ReadStat.MaxMs); \
+	SET_FLOAT_STAT(STAT_XDownloader##TierName##HitRatio, ReadStat.Num ? static_cast<float>(HitNum) / ReadStat.Num : 0.f)
+
+//the reads and the hit ratio of one tier, the ratio of the reads that reached the tier and were served from it
+static void SetCacheTierStats(EXDownloadCacheTier Tier)
+{
+	FScopeLock ScopeLock(&DurationStatsLock);
+	const FXDownloadDurationStat& ReadStat = CacheReadStats[static_cast<uint8>(Tier)];
+	const int32 HitNum = CacheTierHitNums[static_cast<uint8>(Tier)];
+	switch (Tier)
+	{
+	case EXDownloadCacheTier::Memory:
+		XDOWNLOADER_SET_TIER_STATS(Memory, ReadStat, HitNum);
+		break;
+	case EXDownloadCacheTier::LocalFile:
+		XDOWNLOADER_SET_TIER_STATS(LocalFile, ReadStat, HitNum);
+		break;
+	case EXDownloadCacheTier::SaveGame:
+		XDOWNLOADER_SET_TIER_STATS(SaveGame, ReadStat, HitNum);
+		break;
+	case EXDownloadCacheTier::Pack:
+		XDOWNLOADER_SET_TIER_STATS(Pack, ReadStat, HitNum);
+		break;
+	default:
+		break;
+	}
+}
+
+#undef XDOWNLOADER_SET_TIER_STATS
+#endif
+
+//the tier a sub task was served from, EXDownloadCacheTier::Num for a miss, feeds the hit ratio stats
+static void RecordCacheLookup(EXDownloadCacheTier Tier, int32 Bytes)
+{
+#if STATS || COUNTERSTRACE_ENABLED
+	FPlatformAtomics::InterlockedIncrement(&CacheTierHitNums[static_cast<uint8>(Tier)]);
+	const int32 MemoryHits = CacheTierHitNums[static_cast<uint8>(EXDownloadCacheTier::Memory)];
+	const int32 SaveGameHits = CacheTierHitNums[static_cast<uint8>(EXDownloadCacheTier::SaveGame)];
+	const int32 LocalFileHits = CacheTierHitNums[static_cast<uint8>(EXDownloadCacheTier::LocalFile)];
+	const int32 PackHits = CacheTierHitNums[static_cast<uint8>(EXDownloadCacheTier::Pack)];
+	const int32 Misses = CacheTierHitNums[static_cast<uint8>(EXDownloadCacheTier::Num)];
+	const int32 Hits = MemoryHits + SaveGameHits + LocalFileHits + PackHits;
+	SET_DWORD_STAT(STAT_XDownloaderMemoryHits, MemoryHits);
+	SET_DWORD_STAT(STAT_XDownloaderSaveGameHits, SaveGameHits);
+	SET_DWORD_STAT(STAT_XDownloaderLocalFileHits, LocalFileHits);
+	SET_DWORD_STAT(STAT_XDownloaderPackHits, PackHits);
+	SET_DWORD_STAT(STAT_XDownloaderCacheMisses, Misses);
+	SET_FLOAT_STAT(STAT_XDownloaderHitRatio, static_cast<float>(Hits) / (Hits + Misses));
+	if (Tier != EXDownloadCacheTier::Num)
+	{
+		INC_MEMORY_STAT_BY(STAT_XDownloaderBytesFromCache, Bytes);
+	}
+#endif
+#if STATS
+	if (Tier != EXDownloadCacheTier::Num)
+	{
+		SetCacheTierStats(Tier);
+	}
+#endif
+}
+
+//the latency of a read of a tier, hit or miss
+static void RecordCacheRead(EXDownloadCacheTier Tier, double ReadStartTime)
+{
+#if STATS
+	if (Tier == EXDownloadCacheTier::Num)
+	{
+		return;
+	}
+	{
+		FScopeLock ScopeLock(&DurationStatsLock);
+		CacheReadStats[static_cast<uint8>(Tier)].Add((FPlatformTime::Seconds() - ReadStartTime) * 1000.0);
+	}
+	SetCacheTierStats(Tier);
+#endif
+}
+
+//the time a sub task waited in the scheduler queue
+static void RecordQueueWait(double EnqueueTime)
+{
+#if STATS || COUNTERSTRACE_ENABLED
+	const float QueueWaitMs = (FPlatformTime::Seconds() - EnqueueTime) * 1000.0;
+	TRACE_COUNTER_SET(XDownloaderQueueWaitMs, QueueWaitMs);
+#endif
+#if STATS
+	FScopeLock ScopeLock(&DurationStatsLock);
+	QueueWaitStat.Add(QueueWaitMs);
+	SET_DWORD_STAT(STAT_XDownloaderQueueWaits, QueueWaitStat.Num);
+	SET_FLOAT_STAT(STAT_XDownloaderQueueWaitAvgMs, QueueWaitStat.GetAverageMs());
+	SET_FLOAT_STAT(STAT_XDownloaderQueueWaitMaxMs, QueueWaitStat.MaxMs);
+#endif
+}
+
+static void RecordDownload(const FHttpRequestPtr& HttpRequest, int32 Bytes)
+{
+#if STATS || COUNTERSTRACE_ENABLED
+	const float NetworkMs = HttpRequest.IsValid() ? HttpRequest->GetElapsedTime() * 1000.f : 0.f;
+	INC_MEMORY_STAT_BY(STAT_XDownloaderBytesDownloaded, Bytes);
+	TRACE_COUNTER_SET(XDownloaderNetworkMs, NetworkMs);
+	TRACE_COUNTER_SET(XDownloaderBytesDownloaded, FPlatformAtomics::InterlockedAdd(&DownloadedBytes, Bytes) + Bytes);
+#endif
+#if STATS
+	FScopeLock ScopeLock(&DurationStatsLock);
+	NetworkStat.Add(NetworkMs);
+	SET_DWORD_STAT(STAT_XDownloaderNetworkRequests, NetworkStat.Num);
+	SET_FLOAT_STAT(STAT_XDownloaderNetworkAvgMs, NetworkStat.GetAverageMs());
+	SET_FLOAT_STAT(STAT_XDownloaderNetworkMaxMs, NetworkStat.MaxMs);
+#endif
+}
 
 void UXDownloadManager::InitParas(const FString& InSaveGameSlotName)
 {
-	DownloaderSubsystem = UGameInstance::GetSubsystem<UXDownloaderSubsystem>(GameWorld->GetGameInstance());
-	if (!DownloaderSubsystem)
+	DownloaderSubsystem = GameWorld.IsValid() ? UGameInstance::GetSubsystem<UXDownloaderSubsystem>(GameWorld->GetGameInstance()) : nullptr;
+	if (!DownloaderSubsystem || !DownloaderSubsystem->GetScheduler().IsValid())
 	{
 		//log
-		UE_LOG(LogTemp, Error, TEXT("DownloaderSubsystem is null,you need run the XDownloader at Runtime!!!,if you need editor mode , please contect me by github issuse!!!"));
+		UE_LOG(LogXDownloader, Error, TEXT("DownloaderSubsystem is null,you need run the XDownloader at Runtime!!!,if you need editor mode , please contect me by github issuse!!!"));
 		return;
 	}
+	//each game instance schedules its own batches
+	Scheduler = DownloaderSubsystem->GetScheduler();
+	Scheduler->AddManager(this);
 	SaveGameSlotName = InSaveGameSlotName.IsEmpty() ? DownloaderSubsystem->GetXDownloadSettings()->GetSaveGameDefaultSlotName() : InSaveGameSlotName;
-	CacheType = DownloaderSubsystem->GetXDownloadSettings()->GetCacheType();
-	DownloaderSaveGame = DownloaderSubsystem->GetSaveGame(SaveGameSlotName);
-	MaxParallelDownloads = DownloaderSubsystem->GetXDownloadSettings()->GetMaxParallelDownloads();
+	//a chain without the SaveGame tier does not need the slot, otherwise the tasks wait in CurrentTasks until it is loaded
+	bWaitingForSaveGame = DownloaderSubsystem->HasCacheTier(EXDownloadCacheTier::SaveGame);
+	if (bWaitingForSaveGame)
+	{
+		DownloaderSubsystem->LoadSaveGameAsync(SaveGameSlotName, FOnXDownloaderSaveGameLoaded::CreateUObject(this, &UXDownloadManager::OnSaveGameLoaded));
+	}
 	MaxRetryTimes = DownloaderSubsystem->GetXDownloadSettings()->GetMaxRetryTimes();
 	DownloadTimeoutSecond = DownloaderSubsystem->GetXDownloadSettings()->GetDownloadTimeout();
 	DownloadImageDefaultPath = DownloaderSubsystem->GetXDownloadSettings()->GetDownloadImageDefaultPath();
 }
 
-UXDownloadManager* UXDownloadManager::DownloadImages(const TArray<FImageDownloadTask>& Tasks, FString InSaveGameSlotName)
+UXDownloadManager* UXDownloadManager::DownloadImages(const TArray<FImageDownloadTask>& Tasks, FString InSaveGameSlotName, bool bStreamResults, UObject* WorldContextObject)
 {
-	GameWorld = GetGameWorld();
-	FScopeLock ScopeLock(&ExecutingXDownloadTaskPoolLock);
+	UWorld* World = WorldContextObject && GEngine ? GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull) : nullptr;
 	UXDownloadManager* DownloadMgr = NewObject<UXDownloadManager>();
-	DownloadMgr->AddToRoot(); // 防止垃圾回收
-	DownloadManagers.Add(DownloadMgr);
+	DownloadMgr->GameWorld = World ? World : GetGameWorld();
 	DownloadMgr->InitTask();
+	DownloadMgr->bStreamResults = bStreamResults;
+	DownloadMgr->Owner = WorldContextObject;
+	DownloadMgr->bHasOwner = WorldContextObject != nullptr;
 	DownloadMgr->InitParas(InSaveGameSlotName);
 	DownloadMgr->ExecuteTask(Tasks);
 	return DownloadMgr;
@@ -52,201 +215,461 @@ UXDownloadManager* UXDownloadManager::DownloadImages(const TArray<FImageDownload
 void UXDownloadManager::ExecuteTask(const TArray<FImageDownloadTask>& Tasks, int32 MaxDownloads)
 {
 	//get game instance subsystem
-	if (!IsGameWorldValid())
+	if (!IsGameWorldValid() || !Scheduler.IsValid())
 	{
 		return;
 	}
 	TotalDownloadResult.TotalNum = Tasks.Num();
+	StartTime = FPlatformTime::Seconds();
 	CurrentTasks = Tasks;
-	// FScopeLock ScopeLock(&ExecutingXDownloadTaskPoolLock);
-	for (auto ImageDownloadTask : Tasks)
+	const double EnqueueTime = FPlatformTime::Seconds();
+	for (FImageDownloadTask& ImageDownloadTask : CurrentTasks)
 	{
-		TaskQueue.Enqueue(ImageDownloadTask);
+		ImageDownloadTask.EnqueueTime = EnqueueTime;
 	}
-	// const int32 CanDownloadNum = FMath::Min(FMath::Min(MaxParallelDownloads - CurrentParallelDownloads, Tasks.Num()), MaxDownloads);
-	int32 CanDownloadNum = FMath::Min(MaxParallelDownloads - CurrentParallelDownloads, Tasks.Num());
-	for (int i = 0; i < CanDownloadNum; ++i)
+	if (!bWaitingForSaveGame)
+	{
+		EnqueueCurrentTasks();
+	}
+}
+
+void UXDownloadManager::EnqueueCurrentTasks()
+{
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	BuildCacheTiers();
+	Scheduler->Enqueue(this, CurrentTasks);
+}
+
+void UXDownloadManager::BuildCacheTiers()
+{
+	CacheTiers.Reset();
+	for (const EXDownloadCacheTier Tier : DownloaderSubsystem->GetCacheTiers())
 	{
-		FImageDownloadTask Task;
-		if (TaskQueue.Dequeue(Task))
+		switch (Tier)
 		{
-			if (const FImageDownloadTask* FinishItem = CurrentTasks.FindByKey(Task.ImageID))
-			{
-				const FImageDownloadTask RemoveItem = *FinishItem;
-				CurrentTasks.Remove(RemoveItem);
-				ExecuteDownloadTask(Task);
-			}
+		case EXDownloadCacheTier::Memory:
+			CacheTiers.Add(MakeShared<FXDownloadMemoryTier, ESPMode::ThreadSafe>(DownloaderSubsystem->GetMemoryCache()));
+			break;
+		case EXDownloadCacheTier::LocalFile:
+			CacheTiers.Add(MakeShared<FXDownloadLocalFileTier, ESPMode::ThreadSafe>(DownloaderSubsystem->GetFileCache().AsShared(), DownloadImageDefaultPath));
+			break;
+		case EXDownloadCacheTier::SaveGame:
+			CacheTiers.Add(MakeShared<FXDownloadSaveGameTier, ESPMode::ThreadSafe>(DownloaderSaveGame, SaveGameSlotName, Scheduler.ToSharedRef()));
+			break;
+		case EXDownloadCacheTier::Pack:
+			CacheTiers.Add(MakeShared<FXDownloadPackTier, ESPMode::ThreadSafe>(DownloaderSubsystem->GetCachePacks()));
+			break;
+		default:
+			break;
 		}
 	}
 }
 
+void UXDownloadManager::OnSaveGameLoaded(UXDownloaderSaveGame* InSaveGame)
+{
+	DownloaderSaveGame = InSaveGame;
+	bWaitingForSaveGame = false;
+	//cancelled or finished while the slot was loading
+	if (bAllTaskFinished || !DownloaderSaveGame)
+	{
+		return;
+	}
+	EnqueueCurrentTasks();
+}
+
 void UXDownloadManager::OnSubTaskFinished(TSharedPtr<IHttpRequest> HttpRequest, TSharedPtr<IHttpResponse> Response, bool bWasSuccessful, FString ImageID, FString ImageURL)
 {
+	LLM_SCOPE_BYTAG(XDownloader_Results);
+	TArray<uint8> Body = TakeResponseBody(ImageID, Response);
 	if (bStopDownload)
 	{
-		bStopDownload = true;
+		MakeSubTaskCancelled(ImageID, ImageURL, true);
+		return;
+	}
+	{
+		FScopeLock ScopeLock(&Scheduler->GetLock());
+		if (HttpRequest.IsValid())
+		{
+			DownLoadRequests.Remove(HttpRequest.ToSharedRef());
+		}
+		//the rest of the body not reported by the progress callback
+		int32 ProgressBytes = 0;
+		InFlightReceivedBytes.RemoveAndCopyValue(ImageID, ProgressBytes);
+		FXDownloadBandwidthLimiter::Get().Consume(EXDownloadTrafficClass::Foreground, Body.Num() - ProgressBytes);
+	}
+	//a 206 continues the partial body on disk, which is read without blocking first
+	if (Response.IsValid() && Response->GetResponseCode() == EHttpResponseCodes::PartialContent)
+	{
+		FXDownloadPartial::Load(DownloaderSubsystem->GetFileCache(), GetPartialDownloadPath(), ImageID, true,
+			[WeakThis = TWeakObjectPtr<UXDownloadManager>(this), HttpRequest, Response, bWasSuccessful, ImageID, ImageURL, Body = MoveTemp(Body)](FXDownloadPartial* Partial) mutable
+		{
+			const TSharedPtr<FXDownloadPartial> LoadedPartial = Partial ? MakeShared<FXDownloadPartial>(MoveTemp(*Partial)) : nullptr;
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, HttpRequest, Response, bWasSuccessful, ImageID, ImageURL, Body = MoveTemp(Body), LoadedPartial]()
+			{
+				if (UXDownloadManager* DownloadManager = WeakThis.Get())
+				{
+					DownloadManager->FinishHttpResponse(HttpRequest, Response, bWasSuccessful, ImageID, ImageURL, Body, LoadedPartial.Get());
+				}
+			});
+		});
+		return;
+	}
+	FinishHttpResponse(HttpRequest, Response, bWasSuccessful, ImageID, ImageURL, Body, nullptr);
+}
+
+void UXDownloadManager::FinishHttpResponse(const FHttpRequestPtr& HttpRequest, const FHttpResponsePtr& Response, bool bWasSuccessful, const FString& ImageID, const FString& ImageURL,
+	const TArray<uint8>& Body, const FXDownloadPartial* Partial)
+{
+	//stopped while the partial body was read, the request is no longer tracked by the batch
+	if (bStopDownload)
+	{
+		MakeSubTaskCancelled(ImageID, ImageURL, true);
 		return;
 	}
 	FDownloadResult Result;
 	Result.ImageID = ImageID;
 	Result.ImageURL = ImageURL;
-	if (bWasSuccessful)
+	const int32 ResponseCode = Response.IsValid() ? Response->GetResponseCode() : 0;
+	TArray<uint8> Content;
+	bool bSucceed = false;
+	//416 Range Not Satisfiable, or a 206 that does not continue the partial body, either way the partial body is dropped
+	bool bRangeRefused = ResponseCode == 416;
+	if (bWasSuccessful && Response.IsValid() && Response->GetContentLength() > 0)
 	{
-		if (Response.IsValid() && Response->GetContentLength() > 0)
+		if (ResponseCode == EHttpResponseCodes::PartialContent)
 		{
-			const TArray<uint8> Content = Response->GetContent();
-			Result.ImageData = Content;
-			Result.Status = EDownloadStatus::Success;
-			Result.Texture = FImageUtils::ImportBufferAsTexture2D(Content);
-			if (CacheType == ECacheType::CT_LocalFile)
-			{
-				//save to disk
-				const FString FilePath = FPaths::Combine(DownloadImageDefaultPath, ImageID);
-				FFileHelper::SaveArrayToFile(Content, *FilePath);
-			}
-			else if (CacheType == ECacheType::CT_SaveGame)
+			bSucceed = ResumePartialDownload(ImageID, Response, Body, Partial, Content);
+			bRangeRefused = !bSucceed;
+			if (bSucceed)
 			{
-				//save to disk
-				FXDownloadImageCached ImageCached;
-				ImageCached.ImageID = ImageID;
-				ImageCached.ImageURL = ImageURL;
-				ImageCached.ImageData = Content;
-				ImageCached.Texture = Result.Texture;
-				DownloaderSaveGame->AddImageCache(ImageCached, SaveGameSlotName);
+				INC_MEMORY_STAT_BY(STAT_XDownloaderBytesResumed, Partial->Data.Num());
 			}
-			else
-			{
-				const FString FilePath = FPaths::Combine(DownloadImageDefaultPath, ImageID);
-				FFileHelper::SaveArrayToFile(Content, *FilePath);
-				//save to disk
-				FXDownloadImageCached ImageCached;
-				ImageCached.ImageID = ImageID;
-				ImageCached.ImageURL = ImageURL;
-				ImageCached.ImageData = Content;
-				ImageCached.Texture = Result.Texture;
-				DownloaderSaveGame->AddImageCache(ImageCached, SaveGameSlotName);
-			}
-			MakeSubTaskSucceed(Result);
 		}
-		else
+		else if (EHttpResponseCodes::IsOk(ResponseCode))
 		{
-			Result.Status = EDownloadStatus::Failed;
-			MakeSubTaskError(Result);
+			Content = Body;
+			bSucceed = true;
+		}
+	}
+	if (bSucceed)
+	{
+		if (HttpRequest.IsValid() && !HttpRequest->GetHeader(TEXT("Range")).IsEmpty())
+		{
+			FXDownloadPartial::Delete(DownloaderSubsystem->GetFileCache(), GetPartialDownloadPath(), ImageID);
 		}
+		RecordDownload(HttpRequest, Body.Num());
+		DownloaderSubsystem->GetNegativeCache().Remove(ImageURL);
+		Result.ImageData = Content;
+		Result.Status = EDownloadStatus::Success;
+		StoreInCache(ImageID, ImageURL, Content, FXDownloadCacheFreshness::FromResponse(*Response, DownloaderSubsystem->GetXDownloadSettings()->IsCacheControlEnabled()));
+		MakeSubTaskSucceed(Result);
 	}
 	else
 	{
+		SavePartialDownload(ImageID, ImageURL, Response, Body, Partial);
+		//the retry finds no partial body and requests the whole image without a Range header, right away and whatever retries are left
+		if (bRangeRefused && !RangeRefusedImageIDs.Contains(ImageID))
+		{
+			RangeRefusedImageIDs.Add(ImageID);
+			PreviewStates.Remove(ImageID);
+			UE_LOG(LogXDownloader, Verbose, TEXT("Download range refused, retrying the whole image!!! ImageID :%s ,URL:%s"), *ImageID, *ImageURL);
+			DownloadImage(ImageURL, ImageID);
+			return;
+		}
+		//connection errors, timeouts and server errors are retried, resuming from the saved partial body
+		const bool bCanRetry = ResponseCode == 0 || ResponseCode >= EHttpResponseCodes::ServerError || ResponseCode == EHttpResponseCodes::RequestTimeout
+			|| ResponseCode == EHttpResponseCodes::PartialContent || bRangeRefused;
+		int32& RetryTimes = RetryTimesMap.FindOrAdd(ImageID);
+		if (bCanRetry && RetryTimes < MaxRetryTimes)
+		{
+			++RetryTimes;
+			//the retry starts a new body, or resumes one that can not be previewed
+			PreviewStates.Remove(ImageID);
+			const float BackoffSeconds = GetRetryBackoffSeconds(RetryTimes);
+			UE_LOG(LogXDownloader, Verbose, TEXT("Download retry %d/%d in %.2fs!!! ImageID :%s ,URL:%s"), RetryTimes, MaxRetryTimes, BackoffSeconds, *ImageID, *ImageURL);
+			//the slot stays held during the backoff, a cancelled image is dropped when its request would be sent
+			FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateWeakLambda(this, [this, ImageURL, ImageID](float)
+			{
+				DownloadImage(ImageURL, ImageID);
+				return false;
+			}), BackoffSeconds);
+			return;
+		}
+		//later batches fail the URL right away until the TTL of its status expires
+		DownloaderSubsystem->GetNegativeCache().Add(ImageURL, ResponseCode);
 		Result.Status = EDownloadStatus::Failed;
 		MakeSubTaskError(Result);
 	}
 }
 
+float UXDownloadManager::GetRetryBackoffSeconds(int32 RetryTimes) const
+{
+	const UXDownloaderSettings* Settings = DownloaderSubsystem->GetXDownloadSettings();
+	//doubled per retry up to the cap, the random half spreads the retries of a batch failed together
+	const double BackoffMs = FMath::Min(Settings->GetRetryBackoffMs() * FMath::Pow(2.0, FMath::Max(RetryTimes - 1, 0)), static_cast<double>(Settings->GetRetryMaxBackoffMs()));
+	return BackoffMs * FMath::FRandRange(0.5, 1.0) / 1000.0;
+}
+
+void UXDownloadManager::OnTransportFetched(TArray<uint8>* Content, FString ImageID, FString ImageURL, bool bCacheResult)
+{
+	LLM_SCOPE_BYTAG(XDownloader_Results);
+	if (bStopDownload)
+	{
+		MakeSubTaskCancelled(ImageID, ImageURL, true);
+		return;
+	}
+	FDownloadResult Result;
+	Result.ImageID = ImageID;
+	Result.ImageURL = ImageURL;
+	if (!Content || Content->Num() == 0)
+	{
+		//a local source fails the same way on every attempt, it is not retried
+		Result.Status = EDownloadStatus::Failed;
+		MakeSubTaskError(Result);
+		return;
+	}
+	Result.ImageData = MoveTemp(*Content);
+	Result.Status = EDownloadStatus::Success;
+	if (bCacheResult)
+	{
+		StoreInCache(ImageID, ImageURL, Result.ImageData, FXDownloadCacheFreshness::Now());
+	}
+	MakeSubTaskSucceed(Result);
+}
+
+void UXDownloadManager::StoreInCache(const FString& ImageID, const FString& ImageURL, const TArray<uint8>& Content, const FXDownloadCacheFreshness& Freshness)
+{
+	//the result is still handed out, it is only kept out of the cache
+	if (Freshness.bNoStore)
+	{
+		return;
+	}
+	XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderCacheWrite);
+	for (const TSharedPtr<IXDownloadCacheTier, ESPMode::ThreadSafe>& CacheTier : CacheTiers)
+	{
+		if (CacheTier->IsWritable())
+		{
+			CacheTier->Write(ImageID, ImageURL, Content, Freshness);
+		}
+	}
+}
+
+FString UXDownloadManager::GetPartialDownloadPath() const
+{
+	return FPaths::Combine(DownloadImageDefaultPath, TEXT("Partial"));
+}
+
+TArray<uint8> UXDownloadManager::TakeResponseBody(const FString& ImageID, const FHttpResponsePtr& Response)
+{
+	TSharedPtr<FXDownloadBodyStream, ESPMode::ThreadSafe> BodyStream;
+	{
+		FScopeLock ScopeLock(&Scheduler->GetLock());
+		if (const TSharedRef<FXDownloadBodyStream, ESPMode::ThreadSafe>* FoundStream = BodyStreams.Find(ImageID))
+		{
+			BodyStream = *FoundStream;
+			BodyStreams.Remove(ImageID);
+		}
+	}
+	if (BodyStream.IsValid())
+	{
+		return BodyStream->TakeData();
+	}
+	return Response.IsValid() ? Response->GetContent() : TArray<uint8>();
+}
+
+bool UXDownloadManager::ResumePartialDownload(const FString& ImageID, const FHttpResponsePtr& Response, const TArray<uint8>& Body, const FXDownloadPartial* Partial, TArray<uint8>& OutContent) const
+{
+	const int64 RangeStart = FXDownloadPartial::ParseContentRangeStart(Response->GetHeader(TEXT("Content-Range")));
+	if (!Partial || RangeStart != Partial->Data.Num())
+	{
+		//the range does not continue the partial body, drop it so the retry fetches the whole image
+		FXDownloadPartial::Delete(DownloaderSubsystem->GetFileCache(), GetPartialDownloadPath(), ImageID);
+		return false;
+	}
+	OutContent = Partial->Data;
+	OutContent.Append(Body);
+	return true;
+}
+
+void UXDownloadManager::SavePartialDownload(const FString& ImageID, const FString& ImageURL, const FHttpResponsePtr& Response, const TArray<uint8>& Body, const FXDownloadPartial* LoadedPartial) const
+{
+	const int32 ResponseCode = Response.IsValid() ? Response->GetResponseCode() : 0;
+	//416 Range Not Satisfiable, the saved partial body is stale
+	if (ResponseCode == 416)
+	{
+		FXDownloadPartial::Delete(DownloaderSubsystem->GetFileCache(), GetPartialDownloadPath(), ImageID);
+		return;
+	}
+	//only an interrupted body with a validator from a range-capable server can be resumed
+	if ((ResponseCode != EHttpResponseCodes::Ok && ResponseCode != EHttpResponseCodes::PartialContent) || Body.Num() == 0
+		|| Response->GetHeader(TEXT("Accept-Ranges")).Equals(TEXT("none"), ESearchCase::IgnoreCase))
+	{
+		return;
+	}
+	FXDownloadPartial Partial;
+	Partial.ImageURL = ImageURL;
+	Partial.Validator = Response->GetHeader(TEXT("ETag"));
+	if (Partial.Validator.IsEmpty())
+	{
+		Partial.Validator = Response->GetHeader(TEXT("Last-Modified"));
+	}
+	if (Partial.Validator.IsEmpty())
+	{
+		return;
+	}
+	if (ResponseCode == EHttpResponseCodes::PartialContent && !ResumePartialDownload(ImageID, Response, Body, LoadedPartial, Partial.Data))
+	{
+		return;
+	}
+	if (ResponseCode == EHttpResponseCodes::Ok)
+	{
+		Partial.Data = Body;
+	}
+	//written behind by the file cache, the completion never waits for the disk
+	FXDownloadPartial::Save(DownloaderSubsystem->GetFileCache(), GetPartialDownloadPath(), ImageID, Partial);
+}
+
 void UXDownloadManager::ExecuteDownloadTask(const FImageDownloadTask& Task)
 {
 	FPlatformAtomics::InterlockedIncrement(&CurrentTaskDownloadingNum);
-	FPlatformAtomics::InterlockedIncrement(&CurrentParallelDownloads);
-	AsyncTask(ENamedThreads::BackgroundThreadPriority, [this,Task]()
+	Scheduler->AcquireSlot();
+	if (!DispatchTimes.Contains(Task.ImageID))
 	{
-		const FString FilePath = FPaths::Combine(DownloadImageDefaultPath, Task.ImageID);
-		TArray<uint8> Content;
-		FScopeLock ScopeLock(&ExecutingXDownloadTaskPoolLock);
+		DispatchTimes.Add(Task.ImageID, FPlatformTime::Seconds());
+	}
+	RecordQueueWait(Task.EnqueueTime);
+	//the lookup leaves the scheduler lock, the local file tier reads without blocking
+	//a shut down batch is dropped by the scheduler, it may be collected before the lookup runs
+	AsyncTask(ENamedThreads::BackgroundThreadPriority, [WeakThis = TWeakObjectPtr<UXDownloadManager>(this), Task]()
+	{
+		if (UXDownloadManager* DownloadManager = WeakThis.Get())
 		{
-			bool HasCache = false;
-			switch (CacheType)
-			{
-			case ECacheType::CT_SaveGame:
+			DownloadManager->LookupCache(Task, 0);
+		}
+	});
+}
 
-				if (const FXDownloadImageCached* Cache = DownloaderSaveGame->GetImageCache(Task.ImageID))
-				{
-					FDownloadResult Result;
-					Result.ImageID = Task.ImageID;
-					Result.ImageURL = Task.ImageURL;
-					Result.Status = EDownloadStatus::Success;
-					Result.ImageData = Cache->ImageData;
-					Result.Texture = Cache->Texture;
-					HasCache = true;
-					MakeSubTaskSucceed(Result);
-				}
-				else
-				{
-					HasCache = false;
-				}
-				break;
-			case ECacheType::CT_LocalFile:
-				if (ImageHasCached(Task.ImageID))
-				{
-					FFileHelper::LoadFileToArray(Content, *FilePath);
-					FDownloadResult Result;
-					Result.ImageID = Task.ImageID;
-					Result.ImageURL = Task.ImageURL;
-					Result.Status = EDownloadStatus::Success;
-					Result.ImageData = Content;
-					Result.Texture = FImageUtils::ImportBufferAsTexture2D(Content);
-					HasCache = true;
-					MakeSubTaskSucceed(Result);
-				}
-				else
-				{
-					HasCache = false;
-				}
-				break;
-			case ECacheType::CT_BothSaveGameAndFile:
-				if (ImageHasCached(Task.ImageID))
-				{
-					FFileHelper::LoadFileToArray(Content, *FilePath);
-					FDownloadResult Result;
-					Result.ImageID = Task.ImageID;
-					Result.ImageURL = Task.ImageURL;
-					Result.Status = EDownloadStatus::Success;
-					Result.ImageData = Content;
-					Result.Texture = FImageUtils::ImportBufferAsTexture2D(Content);
-					if (!DownloaderSaveGame->HasImageCache(Task.ImageID))
-					{
-						FXDownloadImageCached ImageCached;
-						ImageCached.ImageID = Task.ImageID;
-						ImageCached.ImageURL = Task.ImageURL;
-						ImageCached.ImageData = Content;
-						ImageCached.Texture = Result.Texture;
-						DownloaderSaveGame->AddImageCache(ImageCached, SaveGameSlotName);
-					}
-					HasCache = true;
-					MakeSubTaskSucceed(Result);
-				}
-				else if (const FXDownloadImageCached* Cache = DownloaderSaveGame->GetImageCache(Task.ImageID))
-				{
-					FDownloadResult Result;
-					Result.ImageID = Task.ImageID;
-					Result.ImageURL = Task.ImageURL;
-					Result.Status = EDownloadStatus::Success;
-					Result.ImageData = Cache->ImageData;
-					Result.Texture = Cache->Texture;
-					{
-						//image file cache
-						Content = Cache->ImageData;
-						FFileHelper::SaveArrayToFile(Content, *FilePath);
-					}
-					HasCache = true;
-					MakeSubTaskSucceed(Result);
-				}
-				else
-				{
-					HasCache = false;
-				}
-				break;
-			}
-			if (!HasCache)
-			{
-				DownloadImage(Task.ImageURL, Task.ImageID);
-			}
+void UXDownloadManager::LookupCache(const FImageDownloadTask& Task, int32 TierIndex)
+{
+	if (bStopDownload)
+	{
+		MakeSubTaskCancelled(Task.ImageID, Task.ImageURL, true);
+		return;
+	}
+	if (!CacheTiers.IsValidIndex(TierIndex))
+	{
+		RecordCacheLookup(EXDownloadCacheTier::Num, 0);
+		int32 FailedStatusCode = 0;
+		if (DownloaderSubsystem->GetNegativeCache().IsFailed(Task.ImageURL, &FailedStatusCode))
+		{
+			INC_DWORD_STAT(STAT_XDownloaderFailedFast);
+			UE_LOG(LogXDownloader, Verbose, TEXT("Download failed recently with %d, not requested again!!! ImageID :%s ,URL:%s"), FailedStatusCode, *Task.ImageID, *Task.ImageURL);
+			FDownloadResult Result;
+			Result.ImageID = Task.ImageID;
+			Result.ImageURL = Task.ImageURL;
+			Result.Status = EDownloadStatus::Failed;
+			MakeSubTaskError(Result);
+			return;
+		}
+		DownloadImage(Task.ImageURL, Task.ImageID);
+		return;
+	}
+	//the tiers time their own reads, a synchronous tier looks up the next one from within its read
+	const TSharedPtr<IXDownloadCacheTier, ESPMode::ThreadSafe> CacheTier = CacheTiers[TierIndex];
+	const double ReadStartTime = FPlatformTime::Seconds();
+	CacheTier->Read(Task.ImageID, [WeakThis = TWeakObjectPtr<UXDownloadManager>(this), Task, TierIndex, Tier = CacheTier->GetTier(), ReadStartTime](FXDownloadCacheHit* Hit)
+	{
+		UXDownloadManager* DownloadManager = WeakThis.Get();
+		if (!DownloadManager)
+		{
+			return;
+		}
+		RecordCacheRead(Tier, ReadStartTime);
+		if (!Hit || !DownloadManager->ServeStaleHit(Task, *Hit))
+		{
+			DownloadManager->LookupCache(Task, TierIndex + 1);
+			return;
 		}
+		DownloadManager->OnCacheHit(Task, TierIndex, *Hit);
 	});
 }
 
+bool UXDownloadManager::ServeStaleHit(const FImageDownloadTask& Task, const FXDownloadCacheHit& Hit) const
+{
+	const UXDownloaderSettings* Settings = DownloaderSubsystem->GetXDownloadSettings();
+	if (!Hit.Freshness.IsStale(Settings->GetDefaultCacheTTL()))
+	{
+		return true;
+	}
+	INC_DWORD_STAT(STAT_XDownloaderStaleHits);
+	if (!Settings->IsStaleWhileRevalidateEnabled())
+	{
+		return false;
+	}
+	//a SaveGame hit holding only a texture has no bytes to compare, any refreshed bytes count as changed
+	const FString StaleContentHash = !Hit.ContentHash.IsEmpty() || !Hit.ImageData.Num() ? Hit.ContentHash : FXDownloadImageCached::ComputeContentHash(Hit.ImageData);
+	//the validators of the hit let the server answer 304 instead of sending the image again
+	AsyncTask(ENamedThreads::GameThread, [WeakSubsystem = TWeakObjectPtr<UXDownloaderSubsystem>(DownloaderSubsystem), Task, SlotName = SaveGameSlotName, StaleContentHash, Freshness = Hit.Freshness]()
+	{
+		if (UXDownloaderSubsystem* Subsystem = WeakSubsystem.Get())
+		{
+			Subsystem->RefreshImage(Task, SlotName, StaleContentHash, Freshness);
+		}
+	});
+	return true;
+}
+
+void UXDownloadManager::OnCacheHit(const FImageDownloadTask& Task, int32 TierIndex, FXDownloadCacheHit& Hit)
+{
+	if (bStopDownload)
+	{
+		MakeSubTaskCancelled(Task.ImageID, Task.ImageURL, true);
+		return;
+	}
+	LLM_SCOPE_BYTAG(XDownloader_Results);
+	const TSharedPtr<IXDownloadCacheTier, ESPMode::ThreadSafe>& HitTier = CacheTiers[TierIndex];
+	RecordCacheLookup(HitTier->GetTier(), Hit.ImageData.Num());
+	//the faster tiers get a copy behind the result, the read-only packs already persist and are only copied into memory
+	TArray<TSharedPtr<IXDownloadCacheTier, ESPMode::ThreadSafe>> PromoteTiers;
+	for (int32 Index = 0; Index < TierIndex; ++Index)
+	{
+		if (CacheTiers[Index]->IsWritable() && (HitTier->IsWritable() || !CacheTiers[Index]->IsPersistent()))
+		{
+			PromoteTiers.Add(CacheTiers[Index]);
+		}
+	}
+	if (PromoteTiers.Num() && Hit.ImageData.Num())
+	{
+		//the copies keep the age of the hit, a stale image stays stale until its refresh lands
+		AsyncTask(ENamedThreads::BackgroundThreadPriority, [PromoteTiers, ImageID = Task.ImageID, ImageURL = Task.ImageURL, ImageData = Hit.ImageData, Freshness = Hit.Freshness]()
+		{
+			XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderCacheWrite);
+			for (const TSharedPtr<IXDownloadCacheTier, ESPMode::ThreadSafe>& CacheTier : PromoteTiers)
+			{
+				CacheTier->Write(ImageID, ImageURL, ImageData, Freshness);
+				INC_DWORD_STAT(STAT_XDownloaderCachePromotions);
+			}
+		});
+	}
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	if (!Hit.ContentHash.IsEmpty())
+	{
+		ContentHashes.Add(Task.ImageID, Hit.ContentHash);
+	}
+	FDownloadResult Result;
+	Result.ImageID = Task.ImageID;
+	Result.ImageURL = Task.ImageURL;
+	Result.Status = EDownloadStatus::Success;
+	Result.ImageData = MoveTemp(Hit.ImageData);
+	MakeSubTaskSucceed(Result);
+}
+
 void UXDownloadManager::InitTask()
 {
 	OnTotalDownloadSucceed.Clear();
 	OnTotalDownloadFailed.Clear();
 	OnTotalDownloadProgress.Clear();
+	OnSubTaskDownloaded.Clear();
 	DownloadFailNum = 0;
 	TotalDownloadResult = FTotalDownloadResult();
 }
@@ -261,17 +684,26 @@ void UXDownloadManager::DestroyTask()
 		// UE_LOG(LogTemp, Warning, TEXT("DownloadManager http request unbind  url is  %s !!!!"), *DownLoadRequest->GetURL());
 	}
 	DownLoadRequests.Empty();
-	DownloadManagers.Remove(this);
-	UE_LOG(LogTemp, Warning, TEXT("DownloadManager Destroy!!!"));
-	RemoveFromRoot();
+	InFlightReceivedBytes.Empty();
+	BodyStreams.Empty();
+	DispatchTimes.Empty();
+	ContentHashes.Empty();
+	RangeRefusedImageIDs.Empty();
+	PreviewStates.Empty();
+	PreviewTextures.Empty();
+	if (Scheduler.IsValid())
+	{
+		Scheduler->RemoveManager(this);
+	}
+	UE_LOG(LogXDownloader, Verbose, TEXT("DownloadManager Destroy!!!"));
 }
 
 void UXDownloadManager::MakeSubTaskSucceed(const FDownloadResult& InTaskResult)
 {
-	FPlatformAtomics::InterlockedDecrement(&CurrentParallelDownloads);
+	Scheduler->ReleaseSlot();
 	FPlatformAtomics::InterlockedDecrement(&CurrentTaskDownloadingNum);
 	//log succeed
-	UE_LOG(LogTemp, Warning, TEXT("Download Succeed!!! ImageID :%s ,URL:%s"), * InTaskResult.ImageID, *InTaskResult.ImageURL);
+	UE_LOG(LogXDownloader, Verbose, TEXT("Download Succeed!!! ImageID :%s ,URL:%s"), * InTaskResult.ImageID, *InTaskResult.ImageURL);
 	UpdateAllProgress(InTaskResult);
 
 	if (!IsGameWorldValid())
@@ -288,22 +720,20 @@ void UXDownloadManager::MakeSubTaskSucceed(const FDownloadResult& InTaskResult)
 	}
 	else
 	{
-		ExecuteNextTask();
+		Scheduler->ExecuteNextTask();
 	}
 }
 
 void UXDownloadManager::MakeSubTaskError(const FDownloadResult& InTaskResult)
 {
-	FScopeLock ScopeLock(&ExecutingXDownloadTaskPoolLock);
+	FScopeLock ScopeLock(&Scheduler->GetLock());
 	{
-		//log error
-		UE_LOG(LogTemp, Error, TEXT("Download failed!!!"));
 		FPlatformAtomics::InterlockedIncrement(&DownloadFailNum);
-		FPlatformAtomics::InterlockedDecrement(&CurrentParallelDownloads);
+		Scheduler->ReleaseSlot();
 		FPlatformAtomics::InterlockedDecrement(&CurrentTaskDownloadingNum);
 		UpdateAllProgress(InTaskResult);
 		//log error  log InTaskResult.ImageID
-		UE_LOG(LogTemp, Error, TEXT("Download failed!!! ImageID :%s ,URL:%s"), * InTaskResult.ImageID, *InTaskResult.ImageURL);
+		UE_LOG(LogXDownloader, Warning, TEXT("Download failed!!! ImageID :%s ,URL:%s"), * InTaskResult.ImageID, *InTaskResult.ImageURL);
 
 		if (CurrentTasks.Num() == 0)
 		{
@@ -314,44 +744,205 @@ void UXDownloadManager::MakeSubTaskError(const FDownloadResult& InTaskResult)
 		}
 		else
 		{
-			ExecuteNextTask();
+			Scheduler->ExecuteNextTask();
 		}
 	}
 }
 
 void UXDownloadManager::UpdateAllProgress(const FDownloadResult& InTaskResult)
 {
-	AsyncTask(ENamedThreads::GameThread, [this,InTaskResult]()
-	{
-		UE_LOG(LogTemp, Warning, TEXT("Download progress!!!"));
-		TotalDownloadResult.SubTaskDownloadResults.Add(InTaskResult);
-		OnTotalDownloadProgress.Broadcast(TotalDownloadResult);
-	});
+	//texture creation and broadcast are spread over frames by the subsystem
+	DownloaderSubsystem->EnqueueFinalization(this, InTaskResult);
 }
 
-void UXDownloadManager::MakeAllTaskFinished()
+void UXDownloadManager::FinalizeSubTask(FDownloadResult& InTaskResult)
 {
-	FScopeLock ScopeLock(&ExecutingXDownloadTaskPoolLock);
+	check(IsInGameThread());
+	//cancelled while its cache lookup or decode was pending, drop the payload
+	if (InTaskResult.Status != EDownloadStatus::Cancelled && (bStopDownload || CancelledImageIDs.Contains(InTaskResult.ImageID)))
+	{
+		InTaskResult.Status = EDownloadStatus::Cancelled;
+		InTaskResult.ImageData.Empty();
+		InTaskResult.Texture = nullptr;
+	}
+	FString ContentHash;
+	{
+		FScopeLock ScopeLock(&Scheduler->GetLock());
+		double DispatchTime = 0.0;
+		if (DispatchTimes.RemoveAndCopyValue(InTaskResult.ImageID, DispatchTime))
+		{
+			InTaskResult.LatencySeconds = FPlatformTime::Seconds() - DispatchTime;
+		}
+		ContentHashes.RemoveAndCopyValue(InTaskResult.ImageID, ContentHash);
+	}
+	FString PlaceholderHash;
+	if (InTaskResult.Status == EDownloadStatus::Success && !InTaskResult.Texture)
 	{
-		AsyncTask(ENamedThreads::GameThread, [this]()
+		//the same bytes under another ID or slot are decoded only once, a SaveGame hit already knows their hash
+		if (ContentHash.IsEmpty())
+		{
+			ContentHash = FXDownloadImageCached::ComputeContentHash(InTaskResult.ImageData);
+		}
+		bool bNeedsPlaceholder = false;
+		if (DownloaderSaveGame)
 		{
-			DownloaderSaveGame->SaveImageCacheData();
-			if (DownloadFailNum)
+			FScopeLock ScopeLock(&Scheduler->GetLock());
+			if (const FXDownloadImageCached* ImageCached = DownloaderSaveGame->GetImageCache(InTaskResult.ImageID))
 			{
-				OnTotalDownloadFailed.Broadcast(TotalDownloadResult);
-				//log failed
-				UE_LOG(LogTemp, Error, TEXT("Download total failed!!!"));
+				bNeedsPlaceholder = ImageCached->PlaceholderHash.IsEmpty();
+				//the texture the slot still holds is only taken here, the GC may collect it while the result is queued
+				if (ImageCached->ContentHash == ContentHash)
+				{
+					InTaskResult.Texture = ImageCached->Texture;
+				}
 			}
-			else
+		}
+		FXDownloadAtlas* Atlas = DownloaderSubsystem->GetXDownloadSettings()->IsThumbnailAtlasEnabled() ? &DownloaderSubsystem->GetAtlas() : nullptr;
+		if (!InTaskResult.Texture && (!Atlas || !Atlas->FindRegion(ContentHash, InTaskResult.AtlasRegion)))
+		{
+			InTaskResult.Texture = DownloaderSubsystem->FindSharedTexture(ContentHash);
+		}
+		if (!InTaskResult.Texture && !InTaskResult.AtlasRegion.IsValid())
+		{
+			LLM_SCOPE_BYTAG(XDownloader_Textures);
+			FImage Image;
+			bool bDecoded = false;
 			{
-				OnTotalDownloadSucceed.Broadcast(TotalDownloadResult);
-				//log succeed
-				UE_LOG(LogTemp, Warning, TEXT("Download total succeed!!!"));
+				XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderDecode);
+				bDecoded = FImageUtils::ImportBufferAsImage(InTaskResult.ImageData.GetData(), InTaskResult.ImageData.Num(), Image);
 			}
-			DestroyTask();
-		});
+			if (bDecoded)
+			{
+				XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderCreateTexture);
+				//small images share atlas pages instead of getting a texture each
+				if (!Atlas || !Atlas->AddImage(ContentHash, Image, InTaskResult.AtlasRegion))
+				{
+					//the preview texture handed out while downloading becomes the full image
+					UTexture2D* PreviewTexture = PreviewTextures.FindRef(InTaskResult.ImageID);
+					InTaskResult.Texture = FXDownloadPreview::UpdateTexture(PreviewTexture, Image) ? PreviewTexture : FImageUtils::CreateTexture2DFromImage(Image);
+					DownloaderSubsystem->AddSharedTexture(ContentHash, InTaskResult.Texture);
+				}
+				if (bNeedsPlaceholder)
+				{
+					PlaceholderHash = FXDownloadPlaceholder::Encode(Image);
+				}
+			}
+		}
+	}
+	if (InTaskResult.Status == EDownloadStatus::Success && InTaskResult.Texture)
+	{
+		InTaskResult.ImageHandle = DownloaderSubsystem->AcquireImageHandle(InTaskResult.Texture, InTaskResult.ImageID);
+	}
+	//the entry is looked up again after decoding, a cache write may have replaced it meanwhile, saved with the slot at the end of the batch
+	if (InTaskResult.Status == EDownloadStatus::Success && DownloaderSaveGame)
+	{
+		FScopeLock ScopeLock(&Scheduler->GetLock());
+		if (FXDownloadImageCached* ImageCached = DownloaderSaveGame->GetImageCache(InTaskResult.ImageID))
+		{
+			if (ImageCached->PlaceholderHash.IsEmpty())
+			{
+				ImageCached->PlaceholderHash = PlaceholderHash;
+			}
+			//backfill the texture of the cache entry added before decoding
+			if (!ImageCached->Texture)
+			{
+				ImageCached->Texture = InTaskResult.Texture;
+			}
+			//ranks the entry for the warm-up of the next start
+			ImageCached->LastUsedTime = FDateTime::UtcNow();
+			++ImageCached->UseCount;
+			DownloaderSaveGame->MarkDirty();
+		}
+	}
+	PreviewStates.Remove(InTaskResult.ImageID);
+	PreviewTextures.Remove(InTaskResult.ImageID);
+	if (InTaskResult.Status == EDownloadStatus::Success)
+	{
+		++TotalDownloadResult.SucceedNum;
+	}
+	else if (InTaskResult.Status == EDownloadStatus::Cancelled)
+	{
+		++TotalDownloadResult.CancelledNum;
+	}
+	else
+	{
+		++TotalDownloadResult.FailedNum;
+		TotalDownloadResult.FailedImageIDs.Add(InTaskResult.ImageID);
+	}
+	TotalDownloadResult.ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+	UE_LOG(LogXDownloader, VeryVerbose, TEXT("Download progress %d/%d"), TotalDownloadResult.SucceedNum + TotalDownloadResult.FailedNum + TotalDownloadResult.CancelledNum, TotalDownloadResult.TotalNum);
+
+	//every copy of the result handed out holds its own reference to the atlas region, a streamed result nobody receives holds none
+	if (InTaskResult.AtlasRegion.IsValid())
+	{
+		const int32 HolderNum = (bStreamResults ? 0 : 1) + (OnSubTaskResult.IsBound() ? 1 : 0) + (OnSubTaskDownloaded.IsBound() ? 1 : 0);
+		if (HolderNum == 0)
+		{
+			DownloaderSubsystem->ReleaseAtlasRegion(InTaskResult.AtlasRegion);
+		}
+		for (int32 HolderIndex = 1; HolderIndex < HolderNum; ++HolderIndex)
+		{
+			DownloaderSubsystem->GetAtlas().AddReference(InTaskResult.AtlasRegion.ContentHash);
+		}
+	}
+	OnSubTaskResult.Broadcast(InTaskResult);
+	if (OnSubTaskDownloaded.IsBound())
+	{
+		FTotalDownloadResult SubTaskResult = MakeItemResult();
+		SubTaskResult.SubTaskDownloadResults.Add(bStreamResults ? MoveTemp(InTaskResult) : InTaskResult);
+		OnSubTaskDownloaded.Broadcast(SubTaskResult);
 	}
-	ExecuteNextTask();
+	if (!bStreamResults)
+	{
+		TotalDownloadResult.SubTaskDownloadResults.Add(InTaskResult);
+	}
+	OnTotalDownloadProgress.Broadcast(TotalDownloadResult);
+}
+
+FTotalDownloadResult UXDownloadManager::MakeItemResult() const
+{
+	FTotalDownloadResult ItemResult;
+	ItemResult.TotalNum = TotalDownloadResult.TotalNum;
+	ItemResult.SucceedNum = TotalDownloadResult.SucceedNum;
+	ItemResult.FailedNum = TotalDownloadResult.FailedNum;
+	ItemResult.CancelledNum = TotalDownloadResult.CancelledNum;
+	ItemResult.ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+	return ItemResult;
+}
+
+void UXDownloadManager::FinalizeAllTask()
+{
+	check(IsInGameThread());
+	TotalDownloadResult.ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+	//the changed slot is saved by the subsystem, once for all the batches finishing meanwhile
+	if (DownloadFailNum || TotalDownloadResult.CancelledNum)
+	{
+		OnTotalDownloadFailed.Broadcast(TotalDownloadResult);
+		//log failed
+		UE_LOG(LogXDownloader, Warning, TEXT("Download total failed!!! %d failed, %d cancelled of %d"), DownloadFailNum, TotalDownloadResult.CancelledNum, TotalDownloadResult.TotalNum);
+	}
+	else
+	{
+		OnTotalDownloadSucceed.Broadcast(TotalDownloadResult);
+		//log succeed
+		UE_LOG(LogXDownloader, Log, TEXT("Download total succeed!!! %d images"), TotalDownloadResult.TotalNum);
+	}
+	DestroyTask();
+}
+
+void UXDownloadManager::MakeAllTaskFinished()
+{
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	{
+		if (bAllTaskFinished)
+		{
+			return;
+		}
+		bAllTaskFinished = true;
+		//queued behind the pending sub task results, so the final broadcast carries all of them
+		DownloaderSubsystem->EnqueueAllTaskFinished(this);
+	}
+	Scheduler->ExecuteNextTask();
 }
 
 void UXDownloadManager::MakeSubTaskProgress(FHttpRequestPtr Request, int32 BytesSent, int32 BytesReceived, FString ImageID)
@@ -362,11 +953,138 @@ void UXDownloadManager::MakeSubTaskProgress(FHttpRequestPtr Request, int32 Bytes
 		return;
 	}
 	const float Progress = static_cast<float>(BytesReceived) / static_cast<float>(Request->GetResponse()->GetContentLength());
+	{
+		FScopeLock ScopeLock(&Scheduler->GetLock());
+		int32& ReceivedBytes = InFlightReceivedBytes.FindOrAdd(ImageID);
+		//the body is taken from the bandwidth budget as it is read, holding the next requests back
+		FXDownloadBandwidthLimiter::Get().Consume(EXDownloadTrafficClass::Foreground, BytesReceived - ReceivedBytes);
+		ReceivedBytes = BytesReceived;
+	}
+	if (OnSubTaskPreview.IsBound() && DownloaderSubsystem->GetXDownloadSettings()->IsProgressivePreviewEnabled())
+	{
+		UpdatePreview(Request, BytesReceived, ImageID);
+	}
+}
+
+void UXDownloadManager::UpdatePreview(const FHttpRequestPtr& Request, int32 BytesReceived, const FString& ImageID)
+{
+	check(IsInGameThread());
+	FXDownloadPreviewState& PreviewState = PreviewStates.FindOrAdd(ImageID);
+	const int32 StepBytes = DownloaderSubsystem->GetXDownloadSettings()->GetPreviewStepKB() * 1024;
+	if (PreviewState.bDecoding || PreviewState.bUnsupported || BytesReceived - PreviewState.DecodedBytes < StepBytes)
+	{
+		return;
+	}
+	//a resumed request only receives the tail of the image
+	if (!Request->GetHeader(TEXT("Range")).IsEmpty())
+	{
+		PreviewState.bUnsupported = true;
+		return;
+	}
+	//the payload of the response is appended by the HTTP thread, the bytes are copied from the body stream of the request
+	TSharedPtr<FXDownloadBodyStream, ESPMode::ThreadSafe> BodyStream;
+	{
+		FScopeLock ScopeLock(&Scheduler->GetLock());
+		if (const TSharedRef<FXDownloadBodyStream, ESPMode::ThreadSafe>* FoundStream = BodyStreams.Find(ImageID))
+		{
+			BodyStream = *FoundStream;
+		}
+	}
+	if (!BodyStream.IsValid())
+	{
+		return;
+	}
+	TArray<uint8> ReceivedData = BodyStream->CopyData();
+	PreviewState.DecodedBytes = BytesReceived;
+	PreviewState.bDecoding = true;
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [WeakThis = TWeakObjectPtr<UXDownloadManager>(this), ImageID, ImageURL = Request->GetURL(), ReceivedData = MoveTemp(ReceivedData)]()
+	{
+		FImage PreviewImage;
+		bool bUnsupported = false;
+		const bool bDecoded = FXDownloadPreview::Decode(ReceivedData, PreviewImage, bUnsupported);
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, ImageID, ImageURL, PreviewImage = MoveTemp(PreviewImage), bDecoded, bUnsupported]() mutable
+		{
+			if (UXDownloadManager* DownloadManager = WeakThis.Get())
+			{
+				DownloadManager->ApplyPreview(ImageID, ImageURL, PreviewImage, bDecoded, bUnsupported);
+			}
+		});
+	});
+}
+
+void UXDownloadManager::ApplyPreview(const FString& ImageID, const FString& ImageURL, FImage& PreviewImage, bool bDecoded, bool bUnsupported)
+{
+	check(IsInGameThread());
+	//finished while decoding
+	FXDownloadPreviewState* PreviewState = PreviewStates.Find(ImageID);
+	if (!PreviewState)
+	{
+		return;
+	}
+	PreviewState->bDecoding = false;
+	PreviewState->bUnsupported = bUnsupported;
+	if (!bDecoded || bStopDownload || CancelledImageIDs.Contains(ImageID))
+	{
+		return;
+	}
+	LLM_SCOPE_BYTAG(XDownloader_Textures);
+	UTexture2D*& PreviewTexture = PreviewTextures.FindOrAdd(ImageID);
+	if (!FXDownloadPreview::UpdateTexture(PreviewTexture, PreviewImage))
+	{
+		XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderCreateTexture);
+		PreviewTexture = FImageUtils::CreateTexture2DFromImage(PreviewImage);
+	}
+	if (!PreviewTexture)
+	{
+		return;
+	}
+	INC_DWORD_STAT(STAT_XDownloaderPreviewsShown);
+	FTotalDownloadResult PreviewResult = MakeItemResult();
+	FDownloadResult& SubTaskResult = PreviewResult.SubTaskDownloadResults.AddDefaulted_GetRef();
+	SubTaskResult.ImageID = ImageID;
+	SubTaskResult.ImageURL = ImageURL;
+	SubTaskResult.Status = EDownloadStatus::InProgress;
+	SubTaskResult.Texture = PreviewTexture;
+	OnSubTaskPreview.Broadcast(PreviewResult);
+}
+
+void UXDownloadManager::CollectMemoryUsage(FXDownloadMemoryReport& OutReport, TArray<FXDownloadMemoryEntry>& OutImageEntries, TSet<UTexture2D*>& OutTextures) const
+{
+	int64 ResultBytes = 0;
+	for (const FDownloadResult& SubTaskResult : TotalDownloadResult.SubTaskDownloadResults)
+	{
+		ResultBytes += SubTaskResult.ImageData.Num();
+		FXDownloadMemoryEntry& ImageEntry = OutImageEntries.AddDefaulted_GetRef();
+		ImageEntry.Name = FString::Printf(TEXT("%s/%s"), *GetName(), *SubTaskResult.ImageID);
+		ImageEntry.Bytes = SubTaskResult.ImageData.Num();
+		if (SubTaskResult.Texture)
+		{
+			OutTextures.Add(SubTaskResult.Texture);
+		}
+	}
+	int64 HttpBytes = 0;
+	for (const TPair<FString, int32>& ReceivedBytes : InFlightReceivedBytes)
+	{
+		HttpBytes += ReceivedBytes.Value;
+	}
+	for (const TPair<FString, UTexture2D*>& PreviewTexture : PreviewTextures)
+	{
+		if (PreviewTexture.Value)
+		{
+			OutTextures.Add(PreviewTexture.Value);
+		}
+	}
+	OutReport.ResultBytes += ResultBytes;
+	OutReport.HttpBytes += HttpBytes;
+	FXDownloadMemoryEntry& ManagerEntry = OutReport.Managers.AddDefaulted_GetRef();
+	ManagerEntry.Name = FString::Printf(TEXT("%s, slot %s, %d/%d finished, %d downloading"), *GetName(), *SaveGameSlotName,
+		TotalDownloadResult.SucceedNum + TotalDownloadResult.FailedNum + TotalDownloadResult.CancelledNum, TotalDownloadResult.TotalNum, DownLoadRequests.Num());
+	ManagerEntry.Bytes = ResultBytes + HttpBytes;
 }
 
-bool UXDownloadManager::IsGameWorldValid()
+bool UXDownloadManager::IsGameWorldValid() const
 {
-	return GameWorld && IsValid(GameWorld);
+	return GameWorld.IsValid();
 }
 
 UWorld* UXDownloadManager::GetGameWorld()
@@ -453,14 +1171,59 @@ bool UXDownloadManager::ImageHasCached(FString FileName)
 {
 	const FString fileFullName = FPaths::Combine(DownloadImageDefaultPath, FileName);
 	//log file full name
-	UE_LOG(LogTemp, Warning, TEXT("ImageHasCached,file name is %s"), *fileFullName);
+	UE_LOG(LogXDownloader, VeryVerbose, TEXT("ImageHasCached,file name is %s"), *fileFullName);
 	return FPaths::FileExists(fileFullName);
 }
 
 void UXDownloadManager::DownloadImage(const FString& ImageURL, const FString& ImageID)
 {
+	//local and mock sources are fetched without the HTTP stack
+	if (const TSharedPtr<IXDownloadTransport, ESPMode::ThreadSafe> Transport = DownloaderSubsystem->FindTransport(ImageURL))
+	{
+		const bool bCacheResult = Transport->ShouldCacheResults();
+		Transport->Fetch(ImageURL, [WeakThis = TWeakObjectPtr<UXDownloadManager>(this), ImageID, ImageURL, bCacheResult](TArray<uint8>* Content)
+		{
+			if (UXDownloadManager* DownloadManager = WeakThis.Get())
+			{
+				DownloadManager->OnTransportFetched(Content, ImageID, ImageURL, bCacheResult);
+			}
+		});
+		return;
+	}
+	//the slot stays held while the request waits for the budget, so the queue behind it waits too
+	FXDownloadBandwidthLimiter::Get().StartPaced(EXDownloadTrafficClass::Foreground, [WeakThis = TWeakObjectPtr<UXDownloadManager>(this), ImageURL, ImageID]()
+	{
+		if (UXDownloadManager* DownloadManager = WeakThis.Get())
+		{
+			DownloadManager->StartHttpRequest(ImageURL, ImageID);
+		}
+	});
+}
+
+void UXDownloadManager::StartHttpRequest(const FString& ImageURL, const FString& ImageID)
+{
+	//the sidecar of an interrupted download is read without blocking, the request is sent once it is known
+	FXDownloadPartial::Load(DownloaderSubsystem->GetFileCache(), GetPartialDownloadPath(), ImageID, false,
+		[WeakThis = TWeakObjectPtr<UXDownloadManager>(this), ImageURL, ImageID](FXDownloadPartial* Partial)
+	{
+		if (UXDownloadManager* DownloadManager = WeakThis.Get())
+		{
+			DownloadManager->SendHttpRequest(ImageURL, ImageID, Partial && Partial->ImageURL == ImageURL ? Partial : nullptr);
+		}
+	});
+}
+
+void UXDownloadManager::SendHttpRequest(const FString& ImageURL, const FString& ImageID, const FXDownloadPartial* Partial)
+{
+	LLM_SCOPE_BYTAG(XDownloader_Http);
 	const TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
-	FScopeLock ScopeLock(&ExecutingXDownloadTaskPoolLock);
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	//cancelled while waiting for the bandwidth budget
+	if (bStopDownload || CancelledImageIDs.Contains(ImageID))
+	{
+		MakeSubTaskCancelled(ImageID, ImageURL, true);
+		return;
+	}
 	{
 		DownLoadRequests.Add(HttpRequest);
 	}
@@ -471,40 +1234,175 @@ void UXDownloadManager::DownloadImage(const FString& ImageURL, const FString& Im
 	HttpRequest->OnProcessRequestComplete().BindUObject(this, &UXDownloadManager::OnSubTaskFinished, ImageID, ImageURL);
 	HttpRequest->SetHeader("ImageID", ImageID);
 	HttpRequest->SetHeader("ImageURL", ImageURL);
+	if (Partial)
+	{
+		//the server answers 206 with the rest of the body, or 200 with the whole body if the image changed
+		HttpRequest->SetHeader(TEXT("Range"), FString::Printf(TEXT("bytes=%lld-"), Partial->Size));
+		HttpRequest->SetHeader(TEXT("If-Range"), Partial->Validator);
+	}
+	//a previewed body is read into a stream of the batch, a resumed one only holds the tail of the image
+	else if (OnSubTaskPreview.IsBound() && DownloaderSubsystem->GetXDownloadSettings()->IsProgressivePreviewEnabled())
+	{
+		const TSharedRef<FXDownloadBodyStream, ESPMode::ThreadSafe> BodyStream = MakeShared<FXDownloadBodyStream, ESPMode::ThreadSafe>();
+		if (HttpRequest->SetResponseBodyReceiveStream(BodyStream))
+		{
+			BodyStreams.Add(ImageID, BodyStream);
+		}
+	}
 	HttpRequest->ProcessRequest();
 }
 
-void UXDownloadManager::ExecuteNextTask()
+void UXDownloadManager::CancelImage(const FString& ImageID)
 {
-	FImageDownloadTask Task;
-	if (TaskQueue.Peek(Task))
+	if (!Scheduler.IsValid())
+	{
+		return;
+	}
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	if (bAllTaskFinished)
+	{
+		return;
+	}
+	CancelledImageIDs.Add(ImageID);
+	if (const FImageDownloadTask* QueuedTask = CurrentTasks.FindByKey(ImageID))
+	{
+		const FImageDownloadTask CancelledTask = *QueuedTask;
+		CurrentTasks.Remove(CancelledTask);
+		MakeSubTaskCancelled(CancelledTask.ImageID, CancelledTask.ImageURL, false);
+		return;
+	}
+	const FString ImageURL = AbortRequest(ImageID);
+	if (!ImageURL.IsEmpty())
 	{
-		for (UXDownloadManager* DownloadManager : DownloadManagers)
+		MakeSubTaskCancelled(ImageID, ImageURL, true);
+	}
+	//otherwise the cache lookup or decode is pending and is dropped in FinalizeSubTask
+}
+
+void UXDownloadManager::SetImagePriority(const FString& ImageID, EXDownloadPriority Priority)
+{
+	if (!Scheduler.IsValid())
+	{
+		return;
+	}
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	FImageDownloadTask* QueuedTask = CurrentTasks.FindByKey(ImageID);
+	if (!QueuedTask || QueuedTask->Priority == Priority)
+	{
+		return;
+	}
+	QueuedTask->Priority = Priority;
+	//still waiting for the slot, the tasks are queued with their priority once it is loaded
+	if (!bWaitingForSaveGame)
+	{
+		Scheduler->Requeue(this, *QueuedTask);
+	}
+}
+
+void UXDownloadManager::CancelAll()
+{
+	if (!Scheduler.IsValid())
+	{
+		return;
+	}
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	if (bAllTaskFinished)
+	{
+		return;
+	}
+	UE_LOG(LogXDownloader, Log, TEXT("Cancel download batch, %d queued, %d running"), CurrentTasks.Num(), CurrentTaskDownloadingNum);
+	bStopDownload = true;
+	//the batch end is checked once below, after every cancelled result has been queued
+	bCancellingAll = true;
+	const TArray<FImageDownloadTask> QueuedTasks = MoveTemp(CurrentTasks);
+	CurrentTasks.Reset();
+	for (const FImageDownloadTask& QueuedTask : QueuedTasks)
+	{
+		MakeSubTaskCancelled(QueuedTask.ImageID, QueuedTask.ImageURL, false);
+	}
+	const TArray<TSharedRef<IHttpRequest, ESPMode::ThreadSafe>> RunningRequests = DownLoadRequests;
+	for (const TSharedRef<IHttpRequest, ESPMode::ThreadSafe>& RunningRequest : RunningRequests)
+	{
+		const FString ImageID = RunningRequest->GetHeader(TEXT("ImageID"));
+		const FString ImageURL = AbortRequest(ImageID);
+		if (!ImageURL.IsEmpty())
 		{
-			if (const FImageDownloadTask* FinishItem = DownloadManager->CurrentTasks.FindByKey(Task.ImageID))
-			{
-				const FImageDownloadTask RemoveItem = *FinishItem;
-				if (DownloadManager->CurrentTasks.Remove(RemoveItem))
-				{
-					if (!TaskQueue.Dequeue(Task))
-					{
-						//log error dequeue failed but alone task object not finish 
-						UE_LOG(LogTemp, Error, TEXT("dequeue failed but alone task object not finish!!!"));
-					}
-					DownloadManager->ExecuteDownloadTask(Task);
-				}
-				return;
-			}
-			else
+			MakeSubTaskCancelled(ImageID, ImageURL, true);
+		}
+	}
+	bCancellingAll = false;
+	if (CurrentTaskDownloadingNum == 0)
+	{
+		MakeAllTaskFinished();
+	}
+}
+
+bool UXDownloadManager::IsOrphaned() const
+{
+	return bHasOwner && !Owner.IsValid();
+}
+
+void UXDownloadManager::Shutdown()
+{
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	//the pending cache lookups and decodes are dropped, the batch end is never queued
+	bStopDownload = true;
+	bAllTaskFinished = true;
+	CurrentTasks.Reset();
+	DestroyTask();
+}
+
+void UXDownloadManager::MakeSubTaskCancelled(const FString& ImageID, const FString& ImageURL, bool bWasRunning)
+{
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	{
+		if (bWasRunning)
+		{
+			Scheduler->ReleaseSlot();
+			FPlatformAtomics::InterlockedDecrement(&CurrentTaskDownloadingNum);
+		}
+		UE_LOG(LogXDownloader, Verbose, TEXT("Download cancelled!!! ImageID :%s ,URL:%s"), *ImageID, *ImageURL);
+		FDownloadResult Result;
+		Result.ImageID = ImageID;
+		Result.ImageURL = ImageURL;
+		Result.Status = EDownloadStatus::Cancelled;
+		UpdateAllProgress(Result);
+
+		if (bCancellingAll)
+		{
+			return;
+		}
+		if (CurrentTasks.Num() == 0)
+		{
+			if (CurrentTaskDownloadingNum == 0)
 			{
-				//log this task does not contains this sub task
-				UE_LOG(LogTemp, Warning, TEXT("this task does not contains this sub task!!!"));
+				MakeAllTaskFinished();
 			}
 		}
+		else if (bWasRunning)
+		{
+			Scheduler->ExecuteNextTask();
+		}
 	}
-	else
+}
+
+FString UXDownloadManager::AbortRequest(const FString& ImageID)
+{
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	const int32 RequestIndex = DownLoadRequests.IndexOfByPredicate([&ImageID](const TSharedRef<IHttpRequest, ESPMode::ThreadSafe>& DownLoadRequest)
+	{
+		return DownLoadRequest->GetHeader(TEXT("ImageID")) == ImageID && !EHttpRequestStatus::IsFinished(DownLoadRequest->GetStatus());
+	});
+	if (RequestIndex == INDEX_NONE)
 	{
-		//log alone task object not finish but queue is empty
-		UE_LOG(LogTemp, Warning, TEXT("TaskQueue peek failed, all task finished dequeue!!!"));
+		return FString();
 	}
+	const TSharedRef<IHttpRequest, ESPMode::ThreadSafe> DownLoadRequest = DownLoadRequests[RequestIndex];
+	DownLoadRequests.RemoveAt(RequestIndex);
+	InFlightReceivedBytes.Remove(ImageID);
+	BodyStreams.Remove(ImageID);
+	DownLoadRequest->OnProcessRequestComplete().Unbind();
+	DownLoadRequest->OnRequestProgress().Unbind();
+	DownLoadRequest->CancelRequest();
+	return DownLoadRequest->GetHeader(TEXT("ImageURL"));
 }
@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadNegativeCache.h"
+
+#include "Dom/JsonObject.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "XDownloaderSettings.h"
+#include "XDownloaderStats.h"
+
+bool FXDownloadNegativeCache::IsFailed(const FString& ImageURL, int32* OutStatusCode)
+{
+	FScopeLock ScopeLock(&Lock);
+	const FEntry* Entry = Entries.Find(ImageURL);
+	if (!Entry)
+	{
+		return false;
+	}
+	if (Entry->ExpireTime <= FDateTime::UtcNow())
+	{
+		Entries.Remove(ImageURL);
+		bDirty = true;
+		SET_DWORD_STAT(STAT_XDownloaderFailedURLs, Entries.Num());
+		return false;
+	}
+	if (OutStatusCode)
+	{
+		*OutStatusCode = Entry->StatusCode;
+	}
+	return true;
+}
+
+void FXDownloadNegativeCache::Add(const FString& ImageURL, int32 StatusCode)
+{
+	const UXDownloaderSettings* Settings = GetDefault<UXDownloaderSettings>();
+	const int32 TTLSeconds = Settings->GetNegativeCacheTTL(StatusCode);
+	if (TTLSeconds <= 0 || Settings->GetNegativeCacheMaxEntries() <= 0)
+	{
+		return;
+	}
+	FScopeLock ScopeLock(&Lock);
+	if (!Entries.Contains(ImageURL))
+	{
+		Trim(Settings->GetNegativeCacheMaxEntries());
+	}
+	FEntry& Entry = Entries.FindOrAdd(ImageURL);
+	Entry.StatusCode = StatusCode;
+	Entry.ExpireTime = FDateTime::UtcNow() + FTimespan::FromSeconds(TTLSeconds);
+	bDirty = true;
+	SET_DWORD_STAT(STAT_XDownloaderFailedURLs, Entries.Num());
+}
+
+void FXDownloadNegativeCache::Remove(const FString& ImageURL)
+{
+	FScopeLock ScopeLock(&Lock);
+	if (Entries.Remove(ImageURL))
+	{
+		bDirty = true;
+		SET_DWORD_STAT(STAT_XDownloaderFailedURLs, Entries.Num());
+	}
+}
+
+void FXDownloadNegativeCache::Empty()
+{
+	FScopeLock ScopeLock(&Lock);
+	bDirty |= Entries.Num() > 0;
+	Entries.Empty();
+	SET_DWORD_STAT(STAT_XDownloaderFailedURLs, 0);
+}
+
+int32 FXDownloadNegativeCache::Num() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Entries.Num();
+}
+
+void FXDownloadNegativeCache::Trim(int32 MaxEntries)
+{
+	const FDateTime Now = FDateTime::UtcNow();
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		if (It.Value().ExpireTime <= Now)
+		{
+			It.RemoveCurrent();
+		}
+	}
+	while (Entries.Num() > 0 && Entries.Num() >= MaxEntries)
+	{
+		const TPair<FString, FEntry>* ExpiringFirst = nullptr;
+		for (const TPair<FString, FEntry>& Pair : Entries)
+		{
+			if (!ExpiringFirst || Pair.Value.ExpireTime < ExpiringFirst->Value.ExpireTime)
+			{
+				ExpiringFirst = &Pair;
+			}
+		}
+		Entries.Remove(FString(ExpiringFirst->Key));
+	}
+}
+
+bool FXDownloadNegativeCache::Load(const FString& FilePath)
+{
+	FString JsonString;
+	if (!FFileHelper::LoadFileToString(JsonString, *FilePath))
+	{
+		return false;
+	}
+	TSharedPtr<FJsonObject> RootObject;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(JsonString), RootObject) || !RootObject.IsValid())
+	{
+		return false;
+	}
+	const TArray<TSharedPtr<FJsonValue>>* EntryValues = nullptr;
+	if (!RootObject->TryGetArrayField(TEXT("entries"), EntryValues))
+	{
+		return false;
+	}
+	const FDateTime Now = FDateTime::UtcNow();
+	const int32 MaxEntries = GetDefault<UXDownloaderSettings>()->GetNegativeCacheMaxEntries();
+	if (MaxEntries <= 0)
+	{
+		return true;
+	}
+	FScopeLock ScopeLock(&Lock);
+	for (const TSharedPtr<FJsonValue>& EntryValue : *EntryValues)
+	{
+		const TSharedPtr<FJsonObject>* EntryObject = nullptr;
+		FString ImageURL;
+		FString ExpireTimeString;
+		FEntry Entry;
+		if (!EntryValue->TryGetObject(EntryObject) || !(*EntryObject)->TryGetStringField(TEXT("url"), ImageURL)
+			|| !(*EntryObject)->TryGetNumberField(TEXT("status"), Entry.StatusCode)
+			|| !(*EntryObject)->TryGetStringField(TEXT("expires"), ExpireTimeString) || !FDateTime::ParseIso8601(*ExpireTimeString, Entry.ExpireTime))
+		{
+			continue;
+		}
+		if (Entry.ExpireTime > Now && !Entries.Contains(ImageURL))
+		{
+			if (Entries.Num() >= MaxEntries)
+			{
+				Trim(MaxEntries);
+			}
+			Entries.Add(ImageURL, Entry);
+		}
+	}
+	SET_DWORD_STAT(STAT_XDownloaderFailedURLs, Entries.Num());
+	return true;
+}
+
+bool FXDownloadNegativeCache::Save(const FString& FilePath)
+{
+	TArray<TSharedPtr<FJsonValue>> EntryValues;
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (!bDirty)
+		{
+			return true;
+		}
+		bDirty = false;
+		const FDateTime Now = FDateTime::UtcNow();
+		for (const TPair<FString, FEntry>& Pair : Entries)
+		{
+			if (Pair.Value.ExpireTime <= Now)
+			{
+				continue;
+			}
+			const TSharedRef<FJsonObject> EntryObject = MakeShared<FJsonObject>();
+			EntryObject->SetStringField(TEXT("url"), Pair.Key);
+			EntryObject->SetNumberField(TEXT("status"), Pair.Value.StatusCode);
+			EntryObject->SetStringField(TEXT("expires"), Pair.Value.ExpireTime.ToIso8601());
+			EntryValues.Add(MakeShared<FJsonValueObject>(EntryObject));
+		}
+	}
+	const TSharedRef<FJsonObject> RootObject = MakeShared<FJsonObject>();
+	RootObject->SetArrayField(TEXT("entries"), EntryValues);
+	FString JsonString;
+	FJsonSerializer::Serialize(RootObject, TJsonWriterFactory<>::Create(&JsonString));
+	return FFileHelper::SaveStringToFile(JsonString, *FilePath);
+}
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * @class FXDownloadNegativeCache
+ * @brief The URLs whose download failed recently, so later batches fail them without opening a connection.
+ *
+ * Entries expire after the TTL configured for their HTTP status, connection errors are never recorded.
+ * Holds at most NegativeCacheMaxEntries URLs, the one expiring first is evicted. Thread-safe.
+ * Saved as <DownloadImageDefaultPath>/FailedURLs.json next to the local file cache, loaded on initialization.
+ */
+class FXDownloadNegativeCache
+{
+public:
+	/**
+	 * @brief Whether the URL failed and has not expired yet.
+	 *
+	 * @param ImageURL The URL of the image.
+	 * @param OutStatusCode The HTTP status of the recorded failure, if any.
+	 */
+	bool IsFailed(const FString& ImageURL, int32* OutStatusCode = nullptr);
+
+	//records a failed download, statuses without a TTL are ignored
+	void Add(const FString& ImageURL, int32 StatusCode);
+
+	//forgets a URL that downloaded fine
+	void Remove(const FString& ImageURL);
+
+	void Empty();
+
+	int32 Num() const;
+
+	bool Load(const FString& FilePath);
+
+	//writes the unexpired entries if anything changed since the last load or save
+	bool Save(const FString& FilePath);
+
+private:
+	struct FEntry
+	{
+		int32 StatusCode = 0;
+
+		//UTC, persisted as is across sessions
+		FDateTime ExpireTime;
+	};
+
+	//drops the expired entries, then the ones expiring first until there is room for one more
+	void Trim(int32 MaxEntries);
+
+	mutable FCriticalSection Lock;
+
+	TMap<FString, FEntry> Entries;
+
+	bool bDirty = false;
+};
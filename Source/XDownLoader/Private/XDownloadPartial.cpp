@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadPartial.h"
+
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "XDownloadFileCache.h"
+
+static FString GetPartialBodyPath(const FString& InDirectory, const FString& ImageID)
+{
+	return FPaths::Combine(InDirectory, ImageID + TEXT(".part"));
+}
+
+static FString GetPartialInfoPath(const FString& InDirectory, const FString& ImageID)
+{
+	return FPaths::Combine(InDirectory, ImageID + TEXT(".json"));
+}
+
+//fills the URL, validator and size of the partial from its sidecar
+static bool ParsePartialInfo(const TArray<uint8>* InfoContent, FXDownloadPartial& OutPartial)
+{
+	TSharedPtr<FJsonObject> InfoObject;
+	if (InfoContent)
+	{
+		const FUTF8ToTCHAR InfoConverter(reinterpret_cast<const ANSICHAR*>(InfoContent->GetData()), InfoContent->Num());
+		const FString InfoString(InfoConverter.Length(), InfoConverter.Get());
+		FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(InfoString), InfoObject);
+	}
+	return InfoObject.IsValid() && InfoObject->TryGetStringField(TEXT("url"), OutPartial.ImageURL)
+		&& InfoObject->TryGetStringField(TEXT("validator"), OutPartial.Validator) && InfoObject->TryGetNumberField(TEXT("size"), OutPartial.Size)
+		&& OutPartial.Size > 0 && !OutPartial.Validator.IsEmpty();
+}
+
+void FXDownloadPartial::Load(FXDownloadFileCache& FileCache, const FString& InDirectory, const FString& ImageID, bool bLoadData, TFunction<void(FXDownloadPartial*)> OnLoaded)
+{
+	FileCache.Read(GetPartialInfoPath(InDirectory, ImageID), [FileCache = FileCache.AsShared(), BodyPath = GetPartialBodyPath(InDirectory, ImageID), bLoadData, OnLoaded = MoveTemp(OnLoaded)](TArray<uint8>* InfoContent) mutable
+	{
+		FXDownloadPartial Partial;
+		if (!ParsePartialInfo(InfoContent, Partial))
+		{
+			OnLoaded(nullptr);
+			return;
+		}
+		if (!bLoadData)
+		{
+			OnLoaded(&Partial);
+			return;
+		}
+		FileCache->Read(BodyPath, [Partial = MoveTemp(Partial), OnLoaded = MoveTemp(OnLoaded)](TArray<uint8>* BodyContent) mutable
+		{
+			//a body from another attempt than its sidecar is not usable
+			if (!BodyContent || BodyContent->Num() != Partial.Size)
+			{
+				OnLoaded(nullptr);
+				return;
+			}
+			Partial.Data = MoveTemp(*BodyContent);
+			OnLoaded(&Partial);
+		});
+	});
+}
+
+void FXDownloadPartial::Save(FXDownloadFileCache& FileCache, const FString& InDirectory, const FString& ImageID, const FXDownloadPartial& InPartial)
+{
+	const TSharedRef<FJsonObject> InfoObject = MakeShared<FJsonObject>();
+	InfoObject->SetStringField(TEXT("url"), InPartial.ImageURL);
+	InfoObject->SetStringField(TEXT("validator"), InPartial.Validator);
+	InfoObject->SetNumberField(TEXT("size"), InPartial.Data.Num());
+	FString InfoString;
+	FJsonSerializer::Serialize(InfoObject, TJsonWriterFactory<>::Create(&InfoString));
+	const FTCHARToUTF8 InfoConverter(*InfoString);
+	//the sidecar records the body size, a sidecar written before its body is never considered usable
+	FileCache.Write(GetPartialBodyPath(InDirectory, ImageID), InPartial.Data);
+	FileCache.Write(GetPartialInfoPath(InDirectory, ImageID), TArray<uint8>(reinterpret_cast<const uint8*>(InfoConverter.Get()), InfoConverter.Length()));
+}
+
+bool FXDownloadPartial::IsUsable(const FString& InDirectory, const FString& ImageID)
+{
+	TArray<uint8> InfoContent;
+	FXDownloadPartial Partial;
+	if (!FFileHelper::LoadFileToArray(InfoContent, *GetPartialInfoPath(InDirectory, ImageID), FILEREAD_Silent) || !ParsePartialInfo(&InfoContent, Partial))
+	{
+		return false;
+	}
+	//same rule as Load, a body from another attempt than its sidecar is not usable
+	return IFileManager::Get().FileSize(*GetPartialBodyPath(InDirectory, ImageID)) == Partial.Size;
+}
+
+void FXDownloadPartial::Delete(FXDownloadFileCache& FileCache, const FString& InDirectory, const FString& ImageID)
+{
+	FileCache.Delete(GetPartialInfoPath(InDirectory, ImageID));
+	FileCache.Delete(GetPartialBodyPath(InDirectory, ImageID));
+}
+
+int64 FXDownloadPartial::ParseContentRangeStart(const FString& ContentRange)
+{
+	FString Range;
+	if (!ContentRange.TrimStartAndEnd().Split(TEXT(" "), nullptr, &Range))
+	{
+		return INDEX_NONE;
+	}
+	FString First;
+	if (!Range.Split(TEXT("-"), &First, nullptr) || !First.IsNumeric())
+	{
+		return INDEX_NONE;
+	}
+	return FCString::Atoi64(*First);
+}
@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FXDownloadFileCache;
+
+/**
+ * @struct FXDownloadPartial
+ * @brief A partially downloaded image body kept on disk, so an interrupted download resumes with a Range request.
+ *
+ * Stored as <Directory>/<ImageID>.part with a <ImageID>.json sidecar holding the URL, the validator and the body size.
+ * Read and written through FXDownloadFileCache, so no thread blocks on the disk.
+ */
+struct FXDownloadPartial
+{
+	FString ImageURL;
+
+	//ETag or Last-Modified of the partial body, sent back as If-Range
+	FString Validator;
+
+	//size of the partial body, from the sidecar
+	int64 Size = 0;
+
+	//the partial body, only filled when loaded with bLoadData
+	TArray<uint8> Data;
+
+	/**
+	 * @brief Loads the partial body of an image without blocking.
+	 *
+	 * @param FileCache The file cache reading the files.
+	 * @param InDirectory The partial download directory.
+	 * @param ImageID The ID of the image.
+	 * @param bLoadData Whether to read the body or only its sidecar.
+	 * @param OnLoaded Called on any thread with the partial body, or nullptr if no usable one exists.
+	 */
+	static void Load(FXDownloadFileCache& FileCache, const FString& InDirectory, const FString& ImageID, bool bLoadData, TFunction<void(FXDownloadPartial*)> OnLoaded);
+
+	//queues the body and its sidecar for the writer of the file cache
+	static void Save(FXDownloadFileCache& FileCache, const FString& InDirectory, const FString& ImageID, const FXDownloadPartial& InPartial);
+
+	/**
+	 * @brief Checks on the calling thread whether the partial body of an image can be resumed, for offline tools only.
+	 *
+	 * @param InDirectory The partial download directory.
+	 * @param ImageID The ID of the image.
+	 * @return True if the sidecar parses and the body has the size it records.
+	 */
+	static bool IsUsable(const FString& InDirectory, const FString& ImageID);
+
+	static void Delete(FXDownloadFileCache& FileCache, const FString& InDirectory, const FString& ImageID);
+
+	/**
+	 * @brief Parses the first byte position of a "bytes first-last/total" Content-Range header.
+	 *
+	 * @return The first byte position, or INDEX_NONE if the header cannot be parsed.
+	 */
+	static int64 ParseContentRangeStart(const FString& ContentRange);
+};
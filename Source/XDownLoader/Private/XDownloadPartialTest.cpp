@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && !UE_BUILD_SHIPPING
+
+#include "HttpManager.h"
+#include "HttpModule.h"
+#include "Containers/Ticker.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "XDownloadPartial.h"
+#include "XDownloaderBenchmarkServer.h"
+
+//sends one GET with the given headers and ticks the HTTP stack and the server until it completes
+static FHttpResponsePtr SendLoopbackRequest(const FString& ImageURL, const TMap<FString, FString>& Headers)
+{
+	static constexpr double TimeoutSeconds = 10.0;
+	const TSharedRef<IHttpRequest, ESPMode::ThreadSafe> HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(ImageURL);
+	HttpRequest->SetVerb(TEXT("GET"));
+	for (const TPair<FString, FString>& Header : Headers)
+	{
+		HttpRequest->SetHeader(Header.Key, Header.Value);
+	}
+	HttpRequest->ProcessRequest();
+	const double StartTime = FPlatformTime::Seconds();
+	double LastTime = StartTime;
+	while (!EHttpRequestStatus::IsFinished(HttpRequest->GetStatus()) && FPlatformTime::Seconds() - StartTime < TimeoutSeconds)
+	{
+		const double Now = FPlatformTime::Seconds();
+		const float DeltaTime = Now - LastTime;
+		LastTime = Now;
+		FHttpModule::Get().GetHttpManager().Tick(DeltaTime);
+		FTSTicker::GetCoreTicker().Tick(DeltaTime);
+		FPlatformProcess::Sleep(0.005f);
+	}
+	if (!EHttpRequestStatus::IsFinished(HttpRequest->GetStatus()))
+	{
+		HttpRequest->CancelRequest();
+		return nullptr;
+	}
+	return HttpRequest->GetResponse();
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FXDownloadPartialResumeTest, "XDownloader.Partial.ResumeAgainstLoopback",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+//the responses UXDownloadManager relies on to resume a partial body, or to fetch the whole image after a 416
+bool FXDownloadPartialResumeTest::RunTest(const FString& Parameters)
+{
+	FXDownloaderBenchmarkProfile Profile;
+	//apart from the ports of a running benchmark and the bandwidth test
+	Profile.Port = 8092;
+	Profile.LatencyMs = 0.f;
+	FXDownloaderBenchmarkServer Server(Profile);
+	if (!Server.Start())
+	{
+		AddError(FString::Printf(TEXT("Could not bind the loopback server on port %d"), Profile.Port));
+		return false;
+	}
+	const FString ImageURL = Server.GetImageURL(FString::Printf(TEXT("XDownloadPartialTest.%s"), *Profile.Format));
+	const TArray<uint8>& Payload = Server.GetPayload();
+	const int32 RangeStart = Payload.Num() / 2;
+
+	//a whole image carries the validator and the range support a partial body needs
+	const FHttpResponsePtr Whole = SendLoopbackRequest(ImageURL, {});
+	if (TestTrue(TEXT("Whole image answered"), Whole.IsValid()))
+	{
+		TestEqual(TEXT("Whole image code"), Whole->GetResponseCode(), static_cast<int32>(EHttpResponseCodes::Ok));
+		TestTrue(TEXT("Whole image body"), Whole->GetContent() == Payload);
+		TestEqual(TEXT("Whole image ETag"), Whole->GetHeader(TEXT("ETag")), Server.GetETag());
+		TestEqual(TEXT("Whole image Accept-Ranges"), Whole->GetHeader(TEXT("Accept-Ranges")), FString(TEXT("bytes")));
+	}
+
+	//a matching validator continues the partial body at its size
+	const FHttpResponsePtr Resumed = SendLoopbackRequest(ImageURL, {
+		{TEXT("Range"), FString::Printf(TEXT("bytes=%d-"), RangeStart)}, {TEXT("If-Range"), Server.GetETag()}});
+	if (TestTrue(TEXT("Resumed image answered"), Resumed.IsValid()))
+	{
+		TestEqual(TEXT("Resumed image code"), Resumed->GetResponseCode(), static_cast<int32>(EHttpResponseCodes::PartialContent));
+		TestEqual(TEXT("Resumed image range start"), FXDownloadPartial::ParseContentRangeStart(Resumed->GetHeader(TEXT("Content-Range"))), static_cast<int64>(RangeStart));
+		TArray<uint8> Content(Payload.GetData(), RangeStart);
+		Content.Append(Resumed->GetContent());
+		TestTrue(TEXT("Partial body followed by the resumed body"), Content == Payload);
+	}
+
+	//a stale validator gets the whole image back, not a range of another version
+	const FHttpResponsePtr Changed = SendLoopbackRequest(ImageURL, {
+		{TEXT("Range"), FString::Printf(TEXT("bytes=%d-"), RangeStart)}, {TEXT("If-Range"), TEXT("\"stale\"")}});
+	if (TestTrue(TEXT("Changed image answered"), Changed.IsValid()))
+	{
+		TestEqual(TEXT("Changed image code"), Changed->GetResponseCode(), static_cast<int32>(EHttpResponseCodes::Ok));
+		TestTrue(TEXT("Changed image body"), Changed->GetContent() == Payload);
+	}
+
+	//a partial body as long as the image is refused, the retry without a Range header gets the whole image
+	const FHttpResponsePtr Refused = SendLoopbackRequest(ImageURL, {
+		{TEXT("Range"), FString::Printf(TEXT("bytes=%d-"), Payload.Num())}, {TEXT("If-Range"), Server.GetETag()}});
+	if (TestTrue(TEXT("Refused range answered"), Refused.IsValid()))
+	{
+		TestEqual(TEXT("Refused range code"), Refused->GetResponseCode(), 416);
+	}
+	const FHttpResponsePtr Retried = SendLoopbackRequest(ImageURL, {});
+	if (TestTrue(TEXT("Retry answered"), Retried.IsValid()))
+	{
+		TestEqual(TEXT("Retry code"), Retried->GetResponseCode(), static_cast<int32>(EHttpResponseCodes::Ok));
+		TestTrue(TEXT("Retry body"), Retried->GetContent() == Payload);
+	}
+	TestEqual(TEXT("Ranges served"), Server.GetRangeServedNum(), 1);
+
+	Server.Stop();
+	return !HasAnyErrors();
+}
+
+#endif
@@ -0,0 +1,193 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadPlaceholder.h"
+
+#include "ImageCore.h"
+#include "ImageUtils.h"
+#include "Engine/Texture2D.h"
+#include "XDownloaderStats.h"
+
+namespace XDownloadPlaceholder
+{
+	static const TCHAR Base83Digits[] = TEXT("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz#$%*+,-.:;=?@[]^_{|}~");
+
+	//cosine components kept per axis, 4x3 suits the landscape images lists usually show
+	static constexpr int32 ComponentsX = 4;
+	static constexpr int32 ComponentsY = 3;
+
+	//size the image is reduced to before the components are computed
+	static constexpr int32 SampleSize = 32;
+
+	static void EncodeBase83(int32 Value, int32 Length, FString& OutHash)
+	{
+		int32 Divisor = 1;
+		for (int32 Digit = 1; Digit < Length; ++Digit)
+		{
+			Divisor *= 83;
+		}
+		for (; Divisor > 0; Divisor /= 83)
+		{
+			OutHash.AppendChar(Base83Digits[(Value / Divisor) % 83]);
+		}
+	}
+
+	static bool DecodeBase83(const FString& Hash, int32 Start, int32 Length, int32& OutValue)
+	{
+		OutValue = 0;
+		for (int32 Index = Start; Index < Start + Length; ++Index)
+		{
+			const TCHAR* Digit = Hash[Index] ? FCString::Strchr(Base83Digits, Hash[Index]) : nullptr;
+			if (!Digit)
+			{
+				return false;
+			}
+			OutValue = OutValue * 83 + static_cast<int32>(Digit - Base83Digits);
+		}
+		return true;
+	}
+
+	static float SignPow(float Value, float Exponent)
+	{
+		return FMath::Sign(Value) * FMath::Pow(FMath::Abs(Value), Exponent);
+	}
+
+	static int32 QuantiseComponent(float Value, float MaxValue)
+	{
+		return FMath::Clamp(FMath::FloorToInt(SignPow(Value / MaxValue, 0.5f) * 9.f + 9.5f), 0, 18);
+	}
+
+	static float DequantiseComponent(int32 Value, float MaxValue)
+	{
+		return SignPow((Value - 9) / 9.f, 2.f) * MaxValue;
+	}
+}
+
+FString FXDownloadPlaceholder::Encode(const FImage& Image)
+{
+	using namespace XDownloadPlaceholder;
+	XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderPlaceholderEncode);
+	if (Image.SizeX <= 0 || Image.SizeY <= 0)
+	{
+		return FString();
+	}
+	FImage Sample;
+	Image.ResizeTo(Sample, FMath::Min(Image.SizeX, SampleSize), FMath::Min(Image.SizeY, SampleSize), ERawImageFormat::RGBA32F, EGammaSpace::Linear);
+	const TArrayView64<FLinearColor> Pixels = Sample.AsRGBA32F();
+	TArray<FLinearColor, TInlineAllocator<ComponentsX * ComponentsY>> Factors;
+	for (int32 ComponentY = 0; ComponentY < ComponentsY; ++ComponentY)
+	{
+		for (int32 ComponentX = 0; ComponentX < ComponentsX; ++ComponentX)
+		{
+			FLinearColor Factor(0.f, 0.f, 0.f, 0.f);
+			for (int32 Y = 0; Y < Sample.SizeY; ++Y)
+			{
+				const float BasisY = FMath::Cos(PI * ComponentY * Y / Sample.SizeY);
+				for (int32 X = 0; X < Sample.SizeX; ++X)
+				{
+					Factor += Pixels[static_cast<int64>(Y) * Sample.SizeX + X] * (BasisY * FMath::Cos(PI * ComponentX * X / Sample.SizeX));
+				}
+			}
+			const float Normalisation = ComponentX == 0 && ComponentY == 0 ? 1.f : 2.f;
+			Factors.Add(Factor * (Normalisation / (Sample.SizeX * Sample.SizeY)));
+		}
+	}
+
+	FString Hash;
+	EncodeBase83((ComponentsX - 1) + (ComponentsY - 1) * 9, 1, Hash);
+	float ActualMax = 0.f;
+	for (int32 Index = 1; Index < Factors.Num(); ++Index)
+	{
+		ActualMax = FMath::Max3(ActualMax, FMath::Abs(Factors[Index].R), FMath::Max(FMath::Abs(Factors[Index].G), FMath::Abs(Factors[Index].B)));
+	}
+	const int32 QuantisedMax = FMath::Clamp(FMath::FloorToInt(ActualMax * 166.f - 0.5f), 0, 82);
+	const float MaxValue = (QuantisedMax + 1) / 166.f;
+	EncodeBase83(QuantisedMax, 1, Hash);
+	const FColor Average = FLinearColor(Factors[0].R, Factors[0].G, Factors[0].B).ToFColor(true);
+	EncodeBase83((Average.R << 16) | (Average.G << 8) | Average.B, 4, Hash);
+	for (int32 Index = 1; Index < Factors.Num(); ++Index)
+	{
+		const FLinearColor& Factor = Factors[Index];
+		EncodeBase83(QuantiseComponent(Factor.R, MaxValue) * 19 * 19 + QuantiseComponent(Factor.G, MaxValue) * 19 + QuantiseComponent(Factor.B, MaxValue), 2, Hash);
+	}
+	return Hash;
+}
+
+bool FXDownloadPlaceholder::Decode(const FString& Hash, int32 Width, int32 Height, TArray<FColor>& OutColors)
+{
+	using namespace XDownloadPlaceholder;
+	int32 SizeFlag = 0;
+	int32 QuantisedMax = 0;
+	int32 Value = 0;
+	if (Width <= 0 || Height <= 0 || Hash.Len() < 6 || !DecodeBase83(Hash, 0, 1, SizeFlag) || !DecodeBase83(Hash, 1, 1, QuantisedMax))
+	{
+		return false;
+	}
+	const int32 NumX = SizeFlag % 9 + 1;
+	const int32 NumY = SizeFlag / 9 + 1;
+	if (Hash.Len() != 4 + 2 * NumX * NumY || !DecodeBase83(Hash, 2, 4, Value))
+	{
+		return false;
+	}
+	const float MaxValue = (QuantisedMax + 1) / 166.f;
+	TArray<FLinearColor, TInlineAllocator<81>> Colors;
+	Colors.Add(FLinearColor(FColor((Value >> 16) & 0xFF, (Value >> 8) & 0xFF, Value & 0xFF)));
+	for (int32 Index = 1; Index < NumX * NumY; ++Index)
+	{
+		if (!DecodeBase83(Hash, 4 + Index * 2, 2, Value))
+		{
+			return false;
+		}
+		Colors.Add(FLinearColor(DequantiseComponent(Value / (19 * 19), MaxValue), DequantiseComponent((Value / 19) % 19, MaxValue), DequantiseComponent(Value % 19, MaxValue), 0.f));
+	}
+
+	//the basis values repeat for every row and column
+	TArray<float, TInlineAllocator<256>> BasisX;
+	TArray<float, TInlineAllocator<256>> BasisY;
+	BasisX.SetNumUninitialized(Width * NumX);
+	BasisY.SetNumUninitialized(Height * NumY);
+	for (int32 X = 0; X < Width; ++X)
+	{
+		for (int32 ComponentX = 0; ComponentX < NumX; ++ComponentX)
+		{
+			BasisX[X * NumX + ComponentX] = FMath::Cos(PI * ComponentX * X / Width);
+		}
+	}
+	for (int32 Y = 0; Y < Height; ++Y)
+	{
+		for (int32 ComponentY = 0; ComponentY < NumY; ++ComponentY)
+		{
+			BasisY[Y * NumY + ComponentY] = FMath::Cos(PI * ComponentY * Y / Height);
+		}
+	}
+	OutColors.SetNumUninitialized(Width * Height);
+	for (int32 Y = 0; Y < Height; ++Y)
+	{
+		for (int32 X = 0; X < Width; ++X)
+		{
+			FLinearColor Pixel(0.f, 0.f, 0.f, 0.f);
+			for (int32 ComponentY = 0; ComponentY < NumY; ++ComponentY)
+			{
+				for (int32 ComponentX = 0; ComponentX < NumX; ++ComponentX)
+				{
+					Pixel += Colors[ComponentY * NumX + ComponentX] * (BasisX[X * NumX + ComponentX] * BasisY[Y * NumY + ComponentY]);
+				}
+			}
+			OutColors[Y * Width + X] = FLinearColor(Pixel.R, Pixel.G, Pixel.B).ToFColor(true);
+		}
+	}
+	return true;
+}
+
+UTexture2D* FXDownloadPlaceholder::CreateTexture(const FString& Hash, int32 Width, int32 Height)
+{
+	check(IsInGameThread());
+	TArray<FColor> Colors;
+	if (!Decode(Hash, Width, Height, Colors))
+	{
+		return nullptr;
+	}
+	FImage Image(Width, Height, ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+	FMemory::Memcpy(Image.RawData.GetData(), Colors.GetData(), Colors.Num() * sizeof(FColor));
+	return FImageUtils::CreateTexture2DFromImage(Image);
+}
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FImage;
+class UTexture2D;
+
+/**
+ * @class FXDownloadPlaceholder
+ * @brief Encodes an image into a BlurHash string of a few dozen characters and decodes it back into a blurred colour grid.
+ *
+ * The hash holds the average colour and the 4x3 lowest cosine components of the image, it is stored with the cache entry
+ * (FXDownloadImageCached::PlaceholderHash) so a blurred stand-in can be drawn before the image is read and decoded.
+ * The format is the one of blurha.sh, hashes can also be computed by a server with any BlurHash encoder.
+ */
+class FXDownloadPlaceholder
+{
+public:
+	/**
+	 * @brief Computes the placeholder hash of a decoded image.
+	 *
+	 * Thread-safe. The image is first resized to at most 32x32, so the cost does not depend on the image size.
+	 *
+	 * @return The hash, or an empty string for an empty image.
+	 */
+	static FString Encode(const FImage& Image);
+
+	/**
+	 * @brief Decodes a placeholder hash into sRGB colours.
+	 *
+	 * Thread-safe. Any grid size can be decoded, a small one drawn stretched with bilinear filtering looks the same.
+	 *
+	 * @param Hash The placeholder hash.
+	 * @param Width The width of the grid.
+	 * @param Height The height of the grid.
+	 * @param OutColors The Width * Height colours, row by row.
+	 * @return False if the hash is malformed.
+	 */
+	static bool Decode(const FString& Hash, int32 Width, int32 Height, TArray<FColor>& OutColors);
+
+	//decodes a placeholder hash into a new transient texture, game thread only
+	static UTexture2D* CreateTexture(const FString& Hash, int32 Width, int32 Height);
+};
@@ -0,0 +1,436 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadPrefetcher.h"
+
+#include "Async/Async.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "XDownloadFileCache.h"
+#include "XDownloadBandwidth.h"
+#include "XDownloadNegativeCache.h"
+#include "XDownloadScheduler.h"
+#include "XDownLoader.h"
+#include "XDownloaderSaveGame.h"
+#include "XDownloaderSettings.h"
+#include "XDownloaderStats.h"
+#include "XDownloaderSubsystem.h"
+
+FXDownloadPrefetcher::FXDownloadPrefetcher(UXDownloaderSubsystem* InDownloaderSubsystem)
+	: DownloaderSubsystem(InDownloaderSubsystem)
+	, ValidatedRefreshes(MakeShared<TQueue<FPrefetchTask, EQueueMode::Mpsc>, ESPMode::ThreadSafe>())
+{
+}
+
+void FXDownloadPrefetcher::Enqueue(const TArray<FImageDownloadTask>& Tasks, const FString& InSaveGameSlotName)
+{
+	check(IsInGameThread());
+	for (const FImageDownloadTask& Task : Tasks)
+	{
+		FPrefetchTask PrefetchTask;
+		PrefetchTask.Task = Task;
+		PrefetchTask.SaveGameSlotName = InSaveGameSlotName;
+		TaskQueue.Enqueue(MoveTemp(PrefetchTask));
+	}
+	QueuedNum += Tasks.Num();
+	SET_DWORD_STAT(STAT_XDownloaderPrefetchPending, GetPendingNum());
+}
+
+void FXDownloadPrefetcher::EnqueueRefresh(const FImageDownloadTask& Task, const FString& InSaveGameSlotName, const FString& StaleContentHash, const FXDownloadCacheFreshness& StaleFreshness)
+{
+	check(IsInGameThread());
+	UXDownloaderSubsystem* Subsystem = DownloaderSubsystem.Get();
+	//a no-cache or max-age=0 image is stale on every hit, it is revalidated at most once per RefreshMinIntervalSeconds
+	const double Now = FPlatformTime::Seconds();
+	const double MinIntervalSeconds = Subsystem->GetXDownloadSettings()->GetRefreshMinIntervalSeconds();
+	const double* RefreshTime = RefreshTimes.Find(Task.ImageID);
+	if (RefreshTime && Now - *RefreshTime < MinIntervalSeconds)
+	{
+		return;
+	}
+	bool bAlreadyRefreshing = false;
+	RefreshingImageIDs.Add(Task.ImageID, &bAlreadyRefreshing);
+	if (bAlreadyRefreshing)
+	{
+		return;
+	}
+	if (RefreshTimes.Num() >= 256)
+	{
+		for (auto It = RefreshTimes.CreateIterator(); It; ++It)
+		{
+			if (Now - It.Value() >= MinIntervalSeconds)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+	RefreshTimes.Add(Task.ImageID, Now);
+	FPrefetchTask RefreshTask;
+	RefreshTask.Task = Task;
+	RefreshTask.SaveGameSlotName = InSaveGameSlotName;
+	RefreshTask.StaleContentHash = StaleContentHash;
+	RefreshTask.StaleFreshness = StaleFreshness;
+	RefreshTask.bRefresh = true;
+	//the local files keep their validators apart, they are read before the refresh is queued
+	if (!StaleFreshness.HasValidator() && Subsystem->HasCacheTier(EXDownloadCacheTier::LocalFile))
+	{
+		++ValidatorReadNum;
+		FXDownloadLocalFileTier::ReadValidators(Subsystem->GetFileCache(), Subsystem->GetXDownloadSettings()->GetDownloadImageDefaultPath(), Task.ImageID,
+			[ValidatedRefreshes = ValidatedRefreshes, RefreshTask = MoveTemp(RefreshTask)](const FXDownloadCacheFreshness& Validators) mutable
+		{
+			RefreshTask.StaleFreshness.ETag = Validators.ETag;
+			RefreshTask.StaleFreshness.LastModified = Validators.LastModified;
+			ValidatedRefreshes->Enqueue(MoveTemp(RefreshTask));
+		});
+		return;
+	}
+	RefreshQueue.Add(MoveTemp(RefreshTask));
+	SET_DWORD_STAT(STAT_XDownloaderPrefetchPending, GetPendingNum());
+}
+
+bool FXDownloadPrefetcher::LoadManifest(const FString& ManifestPath, TArray<FImageDownloadTask>& OutTasks)
+{
+	FString ManifestString;
+	if (!FFileHelper::LoadFileToString(ManifestString, *ManifestPath))
+	{
+		UE_LOG(LogXDownloader, Warning, TEXT("Prefetch manifest %s can not be read!!!"), *ManifestPath);
+		return false;
+	}
+	TSharedPtr<FJsonValue> ManifestValue;
+	if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(ManifestString), ManifestValue) || !ManifestValue.IsValid())
+	{
+		UE_LOG(LogXDownloader, Warning, TEXT("Prefetch manifest %s is not valid json!!!"), *ManifestPath);
+		return false;
+	}
+	const TArray<TSharedPtr<FJsonValue>>* Images = nullptr;
+	const TSharedPtr<FJsonObject>* ManifestObject = nullptr;
+	if (!ManifestValue->TryGetArray(Images) && !(ManifestValue->TryGetObject(ManifestObject) && (*ManifestObject)->TryGetArrayField(TEXT("Images"), Images)))
+	{
+		UE_LOG(LogXDownloader, Warning, TEXT("Prefetch manifest %s has no image list!!!"), *ManifestPath);
+		return false;
+	}
+	for (const TSharedPtr<FJsonValue>& Image : *Images)
+	{
+		const TSharedPtr<FJsonObject>* ImageObject = nullptr;
+		FImageDownloadTask Task;
+		if (Image->TryGetObject(ImageObject) && (*ImageObject)->TryGetStringField(TEXT("ImageID"), Task.ImageID)
+			&& (*ImageObject)->TryGetStringField(TEXT("ImageURL"), Task.ImageURL))
+		{
+			OutTasks.Add(MoveTemp(Task));
+		}
+	}
+	return true;
+}
+
+int64 FXDownloadPrefetcher::GetPendingBytes() const
+{
+	int64 PendingBytes = 0;
+	for (const FPrefetchResult& Result : CompletedResults)
+	{
+		PendingBytes += Result.ImageData.Num();
+	}
+	return PendingBytes;
+}
+
+void FXDownloadPrefetcher::Cancel()
+{
+	for (const FHttpRequestPtr& HttpRequest : InFlightRequests)
+	{
+		HttpRequest->OnProcessRequestComplete().Unbind();
+		HttpRequest->OnRequestProgress().Unbind();
+		HttpRequest->CancelRequest();
+	}
+	InFlightRequests.Empty();
+	InFlightReceivedBytes.Empty();
+	TaskQueue.Empty();
+	QueuedNum = 0;
+	RefreshQueue.Empty();
+	RefreshingImageIDs.Empty();
+	CompletedResults.Empty();
+	SET_DWORD_STAT(STAT_XDownloaderPrefetchPending, 0);
+}
+
+void FXDownloadPrefetcher::Tick(float DeltaTime)
+{
+	UXDownloaderSubsystem* Subsystem = DownloaderSubsystem.Get();
+	if (!Subsystem || GetPendingNum() + DirtySaveGameSlots.Num() == 0)
+	{
+		return;
+	}
+	XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderPrefetch);
+	const UXDownloaderSettings* Settings = Subsystem->GetXDownloadSettings();
+	FXDownloadBandwidthLimiter& BandwidthLimiter = FXDownloadBandwidthLimiter::Get();
+
+	const double BudgetSeconds = Settings->GetPrefetchFrameBudgetMs() / 1000.0;
+	const double StartTime = FPlatformTime::Seconds();
+	auto HasFrameBudget = [StartTime, BudgetSeconds]()
+	{
+		return FPlatformTime::Seconds() - StartTime < BudgetSeconds;
+	};
+
+	FPrefetchTask ValidatedRefresh;
+	while (ValidatedRefreshes->Dequeue(ValidatedRefresh))
+	{
+		--ValidatorReadNum;
+		//cancelled while the validators were read
+		if (RefreshingImageIDs.Contains(ValidatedRefresh.Task.ImageID))
+		{
+			RefreshQueue.Add(MoveTemp(ValidatedRefresh));
+		}
+	}
+
+	while (CompletedResults.Num() && HasFrameBudget())
+	{
+		FPrefetchResult Result = CompletedResults.Pop(false);
+		StoreResult(Result);
+	}
+
+	//foreground batches always come first
+	if (!Subsystem->HasForegroundWork())
+	{
+		FPrefetchTask Task;
+		while (InFlightRequests.Num() < Settings->GetPrefetchParallelDownloads() && BandwidthLimiter.CanStart(EXDownloadTrafficClass::Prefetch)
+			&& HasFrameBudget() && PeekTask(Task))
+		{
+			//never load a slot synchronously here, wait for it instead
+			if (Subsystem->HasCacheTier(EXDownloadCacheTier::SaveGame) && !Subsystem->FindSaveGame(Task.SaveGameSlotName))
+			{
+				if (!Subsystem->IsLoadingSaveGame(Task.SaveGameSlotName))
+				{
+					Subsystem->LoadSaveGameAsync(Task.SaveGameSlotName, FOnXDownloaderSaveGameLoaded());
+				}
+				break;
+			}
+			PopTask(Task);
+			//local and mock sources have no latency to hide, recently failed URLs would fail again, a refresh replaces a cached image
+			if (!Subsystem->FindTransport(Task.Task.ImageURL).IsValid() && !Subsystem->GetNegativeCache().IsFailed(Task.Task.ImageURL)
+				&& (Task.bRefresh || !IsCached(Task)))
+			{
+				StartTask(Task);
+			}
+			else if (Task.bRefresh)
+			{
+				RefreshingImageIDs.Remove(Task.Task.ImageID);
+			}
+		}
+	}
+
+	//the slots are saved by the subsystem
+	if (GetPendingNum() == 0 && DirtySaveGameSlots.Num())
+	{
+		DirtySaveGameSlots.Empty();
+		UE_LOG(LogXDownloader, Log, TEXT("Prefetch finished!!!"));
+	}
+	SET_DWORD_STAT(STAT_XDownloaderPrefetchPending, GetPendingNum());
+}
+
+bool FXDownloadPrefetcher::PeekTask(FPrefetchTask& OutTask) const
+{
+	if (RefreshQueue.Num())
+	{
+		OutTask = RefreshQueue[0];
+		return true;
+	}
+	return TaskQueue.Peek(OutTask);
+}
+
+void FXDownloadPrefetcher::PopTask(const FPrefetchTask& InTask)
+{
+	if (InTask.bRefresh)
+	{
+		RefreshQueue.RemoveAt(0);
+		return;
+	}
+	TaskQueue.Pop();
+	--QueuedNum;
+}
+
+bool FXDownloadPrefetcher::IsCached(const FPrefetchTask& InTask) const
+{
+	UXDownloaderSubsystem* Subsystem = DownloaderSubsystem.Get();
+	const UXDownloaderSettings* Settings = Subsystem->GetXDownloadSettings();
+	const TArray<EXDownloadCacheTier> CacheTiers = Subsystem->GetCacheTiers();
+	if (CacheTiers.Contains(EXDownloadCacheTier::Pack) && Subsystem->IsInCachePacks(InTask.Task.ImageID))
+	{
+		return true;
+	}
+	if (CacheTiers.Contains(EXDownloadCacheTier::LocalFile) && Subsystem->GetFileCache().Exists(FPaths::Combine(Settings->GetDownloadImageDefaultPath(), InTask.Task.ImageID)))
+	{
+		return true;
+	}
+	return CacheTiers.Contains(EXDownloadCacheTier::SaveGame) && Subsystem->GetSaveGame(InTask.SaveGameSlotName)->HasImageCache(InTask.Task.ImageID);
+}
+
+void FXDownloadPrefetcher::StartTask(const FPrefetchTask& InTask)
+{
+	LLM_SCOPE_BYTAG(XDownloader_Http);
+	const FHttpRequestRef HttpRequest = FHttpModule::Get().CreateRequest();
+	HttpRequest->SetURL(InTask.Task.ImageURL);
+	HttpRequest->SetVerb(TEXT("GET"));
+	HttpRequest->SetTimeout(DownloaderSubsystem->GetXDownloadSettings()->GetDownloadTimeout());
+	//the server answers 304 without the image while the stale bytes are still current
+	if (InTask.bRefresh && !InTask.StaleFreshness.ETag.IsEmpty())
+	{
+		HttpRequest->SetHeader(TEXT("If-None-Match"), InTask.StaleFreshness.ETag);
+	}
+	if (InTask.bRefresh && !InTask.StaleFreshness.LastModified.IsEmpty())
+	{
+		HttpRequest->SetHeader(TEXT("If-Modified-Since"), InTask.StaleFreshness.LastModified);
+	}
+	HttpRequest->OnRequestProgress().BindSP(this, &FXDownloadPrefetcher::OnTaskProgress);
+	HttpRequest->OnProcessRequestComplete().BindSP(this, &FXDownloadPrefetcher::OnTaskFinished, InTask);
+	InFlightRequests.Add(HttpRequest);
+	HttpRequest->ProcessRequest();
+}
+
+void FXDownloadPrefetcher::OnTaskFinished(FHttpRequestPtr HttpRequest, FHttpResponsePtr Response, bool bWasSuccessful, FPrefetchTask InTask)
+{
+	InFlightRequests.Remove(HttpRequest);
+	int32 ProgressBytes = 0;
+	InFlightReceivedBytes.RemoveAndCopyValue(HttpRequest, ProgressBytes);
+	FXDownloadBandwidthLimiter::Get().Consume(EXDownloadTrafficClass::Prefetch, (Response.IsValid() ? Response->GetContent().Num() : 0) - ProgressBytes);
+	if (InTask.bRefresh && bWasSuccessful && Response.IsValid() && Response->GetResponseCode() == EHttpResponseCodes::NotModified)
+	{
+		RenewResult(InTask, *Response);
+		return;
+	}
+	if (!bWasSuccessful || !Response.IsValid() || !EHttpResponseCodes::IsOk(Response->GetResponseCode()) || Response->GetContentLength() <= 0)
+	{
+		//best effort, the foreground download retries it if it is ever needed
+		if (bWasSuccessful && Response.IsValid() && DownloaderSubsystem.IsValid())
+		{
+			DownloaderSubsystem->GetNegativeCache().Add(InTask.Task.ImageURL, Response->GetResponseCode());
+		}
+		UE_LOG(LogXDownloader, Verbose, TEXT("Prefetch failed!!! ImageID :%s ,URL:%s"), *InTask.Task.ImageID, *InTask.Task.ImageURL);
+		if (InTask.bRefresh)
+		{
+			//the stale image stays cached, the next hit asks again
+			RefreshingImageIDs.Remove(InTask.Task.ImageID);
+		}
+		return;
+	}
+	LLM_SCOPE_BYTAG(XDownloader_Prefetch);
+	INC_MEMORY_STAT_BY(STAT_XDownloaderBytesPrefetched, Response->GetContent().Num());
+	const FXDownloadCacheFreshness Freshness = FXDownloadCacheFreshness::FromResponse(*Response, DownloaderSubsystem->GetXDownloadSettings()->IsCacheControlEnabled());
+	//a prefetch only fills the cache, an image that may not be stored is dropped
+	if (Freshness.bNoStore)
+	{
+		UE_LOG(LogXDownloader, Verbose, TEXT("Prefetch not stored, the response is no-store!!! ImageID :%s ,URL:%s"), *InTask.Task.ImageID, *InTask.Task.ImageURL);
+		if (InTask.bRefresh)
+		{
+			RefreshingImageIDs.Remove(InTask.Task.ImageID);
+		}
+		return;
+	}
+	FPrefetchResult& Result = CompletedResults.AddDefaulted_GetRef();
+	Result.Task = MoveTemp(InTask);
+	Result.ImageData = Response->GetContent();
+	Result.Freshness = Freshness;
+}
+
+void FXDownloadPrefetcher::RenewResult(const FPrefetchTask& InTask, const IHttpResponse& Response)
+{
+	UXDownloaderSubsystem* Subsystem = DownloaderSubsystem.Get();
+	const UXDownloaderSettings* Settings = Subsystem->GetXDownloadSettings();
+	const FString& ImageID = InTask.Task.ImageID;
+	FXDownloadCacheFreshness Freshness = FXDownloadCacheFreshness::FromResponse(Response, Settings->IsCacheControlEnabled());
+	//a 304 may leave the validators out, the stored ones still apply
+	if (!Freshness.HasValidator())
+	{
+		Freshness.ETag = InTask.StaleFreshness.ETag;
+		Freshness.LastModified = InTask.StaleFreshness.LastModified;
+	}
+	const TArray<EXDownloadCacheTier> CacheTiers = Subsystem->GetCacheTiers();
+	if (CacheTiers.Contains(EXDownloadCacheTier::Memory))
+	{
+		Subsystem->GetMemoryCache()->Renew(ImageID, Freshness);
+	}
+	if (CacheTiers.Contains(EXDownloadCacheTier::SaveGame))
+	{
+		FScopeLock ScopeLock(&Subsystem->GetScheduler()->GetLock());
+		UXDownloaderSaveGame* SaveGame = Subsystem->FindSaveGame(InTask.SaveGameSlotName);
+		if (SaveGame && SaveGame->HasImageCache(ImageID))
+		{
+			//no image data, only the times and validators of the entry are renewed
+			FXDownloadImageCached ImageCached;
+			ImageCached.ImageID = ImageID;
+			ImageCached.ImageURL = InTask.Task.ImageURL;
+			ImageCached.ImageTime = Freshness.StoredTime;
+			ImageCached.ExpireTime = Freshness.ExpireTime;
+			ImageCached.ETag = Freshness.ETag;
+			ImageCached.LastModified = Freshness.LastModified;
+			SaveGame->UpdateImageCache(ImageCached, InTask.SaveGameSlotName);
+		}
+	}
+	if (CacheTiers.Contains(EXDownloadCacheTier::LocalFile))
+	{
+		//the file time is the age of the entry
+		AsyncTask(ENamedThreads::BackgroundThreadPriority, [FilePath = FPaths::Combine(Settings->GetDownloadImageDefaultPath(), ImageID)]()
+		{
+			IFileManager::Get().SetTimeStamp(*FilePath, FDateTime::UtcNow());
+		});
+		FXDownloadLocalFileTier::WriteValidators(Subsystem->GetFileCache(), Settings->GetDownloadImageDefaultPath(), ImageID, Freshness);
+	}
+	RefreshingImageIDs.Remove(ImageID);
+	INC_DWORD_STAT(STAT_XDownloaderRefreshes);
+	INC_DWORD_STAT(STAT_XDownloaderRefreshesNotModified);
+}
+
+void FXDownloadPrefetcher::OnTaskProgress(FHttpRequestPtr HttpRequest, int32 BytesSent, int32 BytesReceived)
+{
+	int32& ReceivedBytes = InFlightReceivedBytes.FindOrAdd(HttpRequest);
+	FXDownloadBandwidthLimiter::Get().Consume(EXDownloadTrafficClass::Prefetch, BytesReceived - ReceivedBytes);
+	ReceivedBytes = BytesReceived;
+}
+
+void FXDownloadPrefetcher::StoreResult(FPrefetchResult& InResult)
+{
+	UXDownloaderSubsystem* Subsystem = DownloaderSubsystem.Get();
+	const UXDownloaderSettings* Settings = Subsystem->GetXDownloadSettings();
+	const FString ImageID = InResult.Task.Task.ImageID;
+	const bool bRefresh = InResult.Task.bRefresh;
+	const bool bChanged = bRefresh && (InResult.Task.StaleContentHash.IsEmpty() || FXDownloadImageCached::ComputeContentHash(InResult.ImageData) != InResult.Task.StaleContentHash);
+	//the persistent tiers only, prefetched images would evict the visible ones from the memory tier, a refreshed one replaces its stale copy
+	const TArray<EXDownloadCacheTier> CacheTiers = Subsystem->GetCacheTiers();
+	const bool bLocalFile = CacheTiers.Contains(EXDownloadCacheTier::LocalFile);
+	if (bRefresh && CacheTiers.Contains(EXDownloadCacheTier::Memory))
+	{
+		Subsystem->GetMemoryCache()->Write(ImageID, InResult.ImageData, InResult.Freshness);
+	}
+	if (CacheTiers.Contains(EXDownloadCacheTier::SaveGame))
+	{
+		//no texture, the first foreground hit decodes it
+		FXDownloadImageCached ImageCached;
+		ImageCached.ImageID = ImageID;
+		ImageCached.ImageURL = InResult.Task.Task.ImageURL;
+		ImageCached.ImageTime = InResult.Freshness.StoredTime;
+		ImageCached.ExpireTime = InResult.Freshness.ExpireTime;
+		ImageCached.ETag = InResult.Freshness.ETag;
+		ImageCached.LastModified = InResult.Freshness.LastModified;
+		ImageCached.ImageData = bLocalFile ? InResult.ImageData : MoveTemp(InResult.ImageData);
+		FScopeLock ScopeLock(&Subsystem->GetScheduler()->GetLock());
+		Subsystem->GetSaveGame(InResult.Task.SaveGameSlotName)->UpdateImageCache(ImageCached, InResult.Task.SaveGameSlotName);
+		DirtySaveGameSlots.Add(InResult.Task.SaveGameSlotName);
+	}
+	if (bLocalFile)
+	{
+		//rewritten even when unchanged, the file time is the age of the entry
+		Subsystem->GetFileCache().Write(FPaths::Combine(Settings->GetDownloadImageDefaultPath(), ImageID), MoveTemp(InResult.ImageData));
+		FXDownloadLocalFileTier::WriteValidators(Subsystem->GetFileCache(), Settings->GetDownloadImageDefaultPath(), ImageID, InResult.Freshness);
+	}
+	if (bRefresh)
+	{
+		RefreshingImageIDs.Remove(ImageID);
+		INC_DWORD_STAT(STAT_XDownloaderRefreshes);
+		if (bChanged)
+		{
+			INC_DWORD_STAT(STAT_XDownloaderRefreshesChanged);
+			Subsystem->NotifyImageRefreshed(ImageID);
+		}
+	}
+}
@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Interfaces/IHttpRequest.h"
+#include "XDownloadCacheTier.h"
+#include "XDownloaderTypes.h"
+
+class UXDownloaderSubsystem;
+
+/**
+ * @class FXDownloadPrefetcher
+ * @brief Fills the cache with images the next screens will need, at the lowest priority.
+ *
+ * Owned and ticked by UXDownloaderSubsystem. A prefetch only starts while no foreground batch is queued, downloading
+ * or finalizing, and stays within the prefetch bandwidth budget of FXDownloadBandwidthLimiter and the per-frame time budget.
+ * Prefetched images are cached as compressed bytes only, their texture is created on the first foreground hit.
+ * Stale cache entries served by a batch are refreshed the same way, see EnqueueRefresh.
+ */
+class FXDownloadPrefetcher : public TSharedFromThis<FXDownloadPrefetcher>
+{
+public:
+	explicit FXDownloadPrefetcher(UXDownloaderSubsystem* InDownloaderSubsystem);
+
+	/**
+	 * @brief Appends images to the prefetch queue.
+	 *
+	 * @param Tasks The images to prefetch, already cached images are skipped when their turn comes.
+	 * @param InSaveGameSlotName The slot the images are cached in, the default slot if empty.
+	 */
+	void Enqueue(const TArray<FImageDownloadTask>& Tasks, const FString& InSaveGameSlotName);
+
+	/**
+	 * @brief Downloads a stale cached image again, ahead of the queued prefetches.
+	 *
+	 * The entry is replaced in every cache tier, UXDownloaderSubsystem::OnImageRefreshed fires if the bytes changed.
+	 * An image already being refreshed, or refreshed less than RefreshMinIntervalSeconds ago, is ignored.
+	 *
+	 * @param Task The image.
+	 * @param InSaveGameSlotName The slot the image is cached in.
+	 * @param StaleContentHash The content hash of the served bytes, empty if unknown.
+	 * @param StaleFreshness The freshness of the served bytes, its validators make the request conditional and a 304 renews the entry.
+	 */
+	void EnqueueRefresh(const FImageDownloadTask& Task, const FString& InSaveGameSlotName, const FString& StaleContentHash, const FXDownloadCacheFreshness& StaleFreshness);
+
+	/**
+	 * @brief Reads a prefetch manifest.
+	 *
+	 * The manifest is a JSON array of {"ImageID": "...", "ImageURL": "..."} objects, or an object holding that array as "Images".
+	 *
+	 * @param ManifestPath The path of the manifest file.
+	 * @param OutTasks The images listed in the manifest.
+	 * @return False if the file cannot be read or parsed.
+	 */
+	static bool LoadManifest(const FString& ManifestPath, TArray<FImageDownloadTask>& OutTasks);
+
+	//drops the queue and aborts the in-flight prefetches
+	void Cancel();
+
+	void Tick(float DeltaTime);
+
+	//queued and in-flight prefetches and refreshes
+	int32 GetPendingNum() const { return QueuedNum + ValidatorReadNum + RefreshQueue.Num() + InFlightRequests.Num() + CompletedResults.Num(); }
+
+	//image bytes downloaded and not stored yet
+	int64 GetPendingBytes() const;
+
+private:
+	struct FPrefetchTask
+	{
+		FImageDownloadTask Task;
+		FString SaveGameSlotName;
+
+		//set for a refresh, empty for a prefetch or an unknown stale content
+		FString StaleContentHash;
+
+		//the validators of the stale bytes, for a refresh
+		FXDownloadCacheFreshness StaleFreshness;
+
+		bool bRefresh = false;
+	};
+
+	struct FPrefetchResult
+	{
+		FPrefetchTask Task;
+		TArray<uint8> ImageData;
+		FXDownloadCacheFreshness Freshness;
+	};
+
+	//takes the next refresh, or else the next prefetch, without starting it
+	bool PeekTask(FPrefetchTask& OutTask) const;
+
+	void PopTask(const FPrefetchTask& InTask);
+
+	bool IsCached(const FPrefetchTask& InTask) const;
+
+	void StartTask(const FPrefetchTask& InTask);
+
+	void OnTaskFinished(FHttpRequestPtr HttpRequest, FHttpResponsePtr Response, bool bWasSuccessful, FPrefetchTask InTask);
+
+	//a refresh answered 304, renews the freshness of the stale entry in every tier without touching its bytes
+	void RenewResult(const FPrefetchTask& InTask, const IHttpResponse& Response);
+
+	//takes the body from the prefetch bandwidth budget as it is read
+	void OnTaskProgress(FHttpRequestPtr HttpRequest, int32 BytesSent, int32 BytesReceived);
+
+	//stores the compressed bytes in the configured cache, files are written off the game thread
+	void StoreResult(FPrefetchResult& InResult);
+
+	TWeakObjectPtr<UXDownloaderSubsystem> DownloaderSubsystem;
+
+	TQueue<FPrefetchTask> TaskQueue;
+
+	//stale images to download again, started before the prefetches
+	TArray<FPrefetchTask> RefreshQueue;
+
+	//queued or in-flight refreshes
+	TSet<FString> RefreshingImageIDs;
+
+	//when each image was last refreshed, for RefreshMinIntervalSeconds
+	TMap<FString, double> RefreshTimes;
+
+	//refreshes whose validators were read from the local file tier, handed back to the game thread by Tick
+	TSharedRef<TQueue<FPrefetchTask, EQueueMode::Mpsc>, ESPMode::ThreadSafe> ValidatedRefreshes;
+
+	//validator reads not handed back yet
+	int32 ValidatorReadNum = 0;
+
+	int32 QueuedNum = 0;
+
+	TArray<FHttpRequestPtr> InFlightRequests;
+
+	//bytes of the in-flight bodies already taken from the bandwidth budget
+	TMap<FHttpRequestPtr, int32> InFlightReceivedBytes;
+
+	//downloaded images waiting to be stored within the frame budget
+	TArray<FPrefetchResult> CompletedResults;
+
+	//slots with prefetched entries since the prefetcher was last idle
+	TSet<FString> DirtySaveGameSlots;
+};
@@ -0,0 +1,288 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadPreview.h"
+
+#include "ImageCore.h"
+#include "ImageUtils.h"
+#include "Engine/Texture2D.h"
+#include "XDownloaderStats.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
+
+namespace XDownloadPreview
+{
+	static uint32 ReadBigEndian(const uint8* Bytes)
+	{
+		return (static_cast<uint32>(Bytes[0]) << 24) | (static_cast<uint32>(Bytes[1]) << 16) | (static_cast<uint32>(Bytes[2]) << 8) | Bytes[3];
+	}
+
+	static int32 PaethPredictor(int32 Left, int32 Up, int32 UpLeft)
+	{
+		const int32 Estimate = Left + Up - UpLeft;
+		const int32 LeftDistance = FMath::Abs(Estimate - Left);
+		const int32 UpDistance = FMath::Abs(Estimate - Up);
+		const int32 UpLeftDistance = FMath::Abs(Estimate - UpLeft);
+		if (LeftDistance <= UpDistance && LeftDistance <= UpLeftDistance)
+		{
+			return Left;
+		}
+		return UpDistance <= UpLeftDistance ? Up : UpLeft;
+	}
+}
+
+bool FXDownloadPreview::Decode(const TArray<uint8>& Data, FImage& OutImage, bool& bOutUnsupported)
+{
+	XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderPreviewDecode);
+	static const uint8 PngSignature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+	if (Data.Num() >= 2 && Data[0] == 0xFF && Data[1] == 0xD8)
+	{
+		return DecodeProgressiveJpeg(Data, OutImage, bOutUnsupported);
+	}
+	if (Data.Num() >= 8 && FMemory::Memcmp(Data.GetData(), PngSignature, 8) == 0)
+	{
+		return DecodeInterlacedPng(Data, OutImage, bOutUnsupported);
+	}
+	bOutUnsupported = Data.Num() >= 8;
+	return false;
+}
+
+bool FXDownloadPreview::DecodeProgressiveJpeg(const TArray<uint8>& Data, FImage& OutImage, bool& bOutUnsupported)
+{
+	bool bProgressive = false;
+	//end of the last complete scan
+	int32 ScansEnd = INDEX_NONE;
+	int32 Pos = 2;
+	while (Pos + 4 <= Data.Num())
+	{
+		if (Data[Pos] != 0xFF)
+		{
+			bOutUnsupported = true;
+			return false;
+		}
+		const uint8 Marker = Data[Pos + 1];
+		if (Marker == 0xFF)
+		{
+			++Pos;
+			continue;
+		}
+		if (Marker == 0xD9)
+		{
+			break;
+		}
+		//any frame but progressive huffman, DHT, JPG and DAC share the range
+		if (Marker >= 0xC0 && Marker <= 0xCF && Marker != 0xC4 && Marker != 0xC8 && Marker != 0xCC)
+		{
+			if (Marker != 0xC2)
+			{
+				bOutUnsupported = true;
+				return false;
+			}
+			bProgressive = true;
+		}
+		int32 Next = Pos + 2 + ((Data[Pos + 2] << 8) | Data[Pos + 3]);
+		if (Marker == 0xDA)
+		{
+			if (!bProgressive)
+			{
+				bOutUnsupported = true;
+				return false;
+			}
+			//the entropy coded data ends at the first marker that is neither a stuffed byte nor a restart
+			while (Next + 1 < Data.Num() && !(Data[Next] == 0xFF && Data[Next + 1] != 0x00 && (Data[Next + 1] < 0xD0 || Data[Next + 1] > 0xD7)))
+			{
+				++Next;
+			}
+			if (Next + 1 >= Data.Num())
+			{
+				break;
+			}
+			ScansEnd = Next;
+		}
+		Pos = Next;
+	}
+	if (ScansEnd == INDEX_NONE)
+	{
+		return false;
+	}
+	//the complete scans closed by an end of image marker are a valid, blurrier JPEG
+	TArray<uint8> Scans(Data.GetData(), ScansEnd);
+	Scans.Add(0xFF);
+	Scans.Add(0xD9);
+	FImage Image;
+	if (!FImageUtils::ImportBufferAsImage(Scans.GetData(), Scans.Num(), Image))
+	{
+		return false;
+	}
+	Image.CopyTo(OutImage, ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+	return true;
+}
+
+bool FXDownloadPreview::DecodeInterlacedPng(const TArray<uint8>& Data, FImage& OutImage, bool& bOutUnsupported)
+{
+	using namespace XDownloadPreview;
+	uint32 Width = 0;
+	uint32 Height = 0;
+	int32 Channels = 0;
+	TArray<uint8> CompressedData;
+	int64 Pos = 8;
+	while (Pos + 8 <= Data.Num())
+	{
+		const uint32 ChunkLength = ReadBigEndian(&Data[Pos]);
+		const uint8* ChunkType = &Data[Pos + 4];
+		const int64 ChunkStart = Pos + 8;
+		const int32 AvailableLength = static_cast<int32>(FMath::Min<int64>(ChunkLength, Data.Num() - ChunkStart));
+		if (FMemory::Memcmp(ChunkType, "IHDR", 4) == 0)
+		{
+			if (AvailableLength < 13)
+			{
+				return false;
+			}
+			Width = ReadBigEndian(&Data[ChunkStart]);
+			Height = ReadBigEndian(&Data[ChunkStart + 4]);
+			const uint8 BitDepth = Data[ChunkStart + 8];
+			const uint8 ColorType = Data[ChunkStart + 9];
+			const uint8 InterlaceMethod = Data[ChunkStart + 12];
+			if (BitDepth != 8 || (ColorType != 2 && ColorType != 6) || InterlaceMethod != 1 || Width == 0 || Height == 0 || Width > 16384 || Height > 16384)
+			{
+				bOutUnsupported = true;
+				return false;
+			}
+			Channels = ColorType == 6 ? 4 : 3;
+		}
+		else if (FMemory::Memcmp(ChunkType, "IDAT", 4) == 0)
+		{
+			CompressedData.Append(&Data[ChunkStart], AvailableLength);
+		}
+		else if (FMemory::Memcmp(ChunkType, "IEND", 4) == 0)
+		{
+			break;
+		}
+		Pos = ChunkStart + ChunkLength + 4;
+	}
+	if (Channels == 0 || CompressedData.IsEmpty())
+	{
+		return false;
+	}
+
+	//the first Adam7 pass holds every 8th pixel of every 8th row, each row prefixed by its filter type
+	const int32 PassWidth = (Width + 7) / 8;
+	const int32 PassHeight = (Height + 7) / 8;
+	const int32 RowBytes = 1 + PassWidth * Channels;
+	TArray<uint8> Pass;
+	Pass.SetNumZeroed(RowBytes * PassHeight);
+	z_stream Stream = {};
+	if (inflateInit(&Stream) != Z_OK)
+	{
+		return false;
+	}
+	Stream.next_in = CompressedData.GetData();
+	Stream.avail_in = CompressedData.Num();
+	Stream.next_out = Pass.GetData();
+	Stream.avail_out = Pass.Num();
+	const int32 InflateResult = inflate(&Stream, Z_SYNC_FLUSH);
+	const int64 InflatedNum = Stream.total_out;
+	inflateEnd(&Stream);
+	if (InflateResult != Z_OK && InflateResult != Z_STREAM_END && InflateResult != Z_BUF_ERROR)
+	{
+		bOutUnsupported = true;
+		return false;
+	}
+	if (InflatedNum < Pass.Num())
+	{
+		return false;
+	}
+	for (int32 Row = 0; Row < PassHeight; ++Row)
+	{
+		const uint8 FilterType = Pass[Row * RowBytes];
+		uint8* Line = &Pass[Row * RowBytes + 1];
+		const uint8* PriorLine = Row > 0 ? &Pass[(Row - 1) * RowBytes + 1] : nullptr;
+		for (int32 Index = 0; Index < RowBytes - 1; ++Index)
+		{
+			const int32 Left = Index >= Channels ? Line[Index - Channels] : 0;
+			const int32 Up = PriorLine ? PriorLine[Index] : 0;
+			const int32 UpLeft = PriorLine && Index >= Channels ? PriorLine[Index - Channels] : 0;
+			switch (FilterType)
+			{
+			case 0:
+				break;
+			case 1:
+				Line[Index] += Left;
+				break;
+			case 2:
+				Line[Index] += Up;
+				break;
+			case 3:
+				Line[Index] += (Left + Up) / 2;
+				break;
+			case 4:
+				Line[Index] += PaethPredictor(Left, Up, UpLeft);
+				break;
+			default:
+				bOutUnsupported = true;
+				return false;
+			}
+		}
+	}
+	OutImage.Init(Width, Height, ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+	TArrayView64<FColor> Pixels = OutImage.AsBGRA8();
+	for (uint32 Y = 0; Y < Height; ++Y)
+	{
+		const uint8* Line = &Pass[(Y / 8) * RowBytes + 1];
+		for (uint32 X = 0; X < Width; ++X)
+		{
+			const uint8* Sample = Line + (X / 8) * Channels;
+			Pixels[static_cast<int64>(Y) * Width + X] = FColor(Sample[0], Sample[1], Sample[2], Channels == 4 ? Sample[3] : 255);
+		}
+	}
+	return true;
+}
+
+bool FXDownloadPreview::UpdateTexture(UTexture2D* Texture, const FImage& Image)
+{
+	check(IsInGameThread());
+	FTexturePlatformData* PlatformData = Texture ? Texture->GetPlatformData() : nullptr;
+	if (!PlatformData || PlatformData->Mips.Num() != 1 || PlatformData->PixelFormat != PF_B8G8R8A8
+		|| PlatformData->SizeX != Image.SizeX || PlatformData->SizeY != Image.SizeY)
+	{
+		return false;
+	}
+	FImage BGRAImage;
+	Image.CopyTo(BGRAImage, ERawImageFormat::BGRA8, EGammaSpace::sRGB);
+	FByteBulkData& BulkData = PlatformData->Mips[0].BulkData;
+	//the mip data of a transient texture may have been discarded after its upload
+	if (BulkData.GetBulkDataSize() != BGRAImage.RawData.Num())
+	{
+		return false;
+	}
+	FMemory::Memcpy(BulkData.Lock(LOCK_READ_WRITE), BGRAImage.RawData.GetData(), BGRAImage.RawData.Num());
+	BulkData.Unlock();
+	Texture->UpdateResource();
+	return true;
+}
+
+FXDownloadBodyStream::FXDownloadBodyStream()
+{
+	SetIsSaving(true);
+}
+
+void FXDownloadBodyStream::Serialize(void* V, int64 Length)
+{
+	LLM_SCOPE_BYTAG(XDownloader_Http);
+	FScopeLock ScopeLock(&Lock);
+	Data.Append(static_cast<const uint8*>(V), Length);
+}
+
+TArray<uint8> FXDownloadBodyStream::CopyData() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Data;
+}
+
+TArray<uint8> FXDownloadBodyStream::TakeData()
+{
+	FScopeLock ScopeLock(&Lock);
+	return MoveTemp(Data);
+}
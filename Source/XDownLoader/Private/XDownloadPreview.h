@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FImage;
+class UTexture2D;
+
+/**
+ * @class FXDownloadPreview
+ * @brief Decodes coarse previews from the first bytes of a download, see UXDownloadManager::OnSubTaskPreview.
+ *
+ * Progressive JPEG previews use the complete scans received so far. Interlaced PNG previews use the first Adam7 pass,
+ * each of its pixels filling an 8x8 block; only 8-bit RGB and RGBA PNGs are supported.
+ * Baseline JPEGs and non-interlaced PNGs draw top to bottom and are not previewed.
+ */
+class FXDownloadPreview
+{
+public:
+	/**
+	 * @brief Decodes a preview with the size of the full image.
+	 *
+	 * Thread-safe.
+	 *
+	 * @param Data The bytes received so far.
+	 * @param OutImage The preview, BGRA8 in sRGB.
+	 * @param bOutUnsupported Set if the image can never be previewed.
+	 * @return False if there is nothing to preview yet.
+	 */
+	static bool Decode(const TArray<uint8>& Data, FImage& OutImage, bool& bOutUnsupported);
+
+	/**
+	 * @brief Writes the full image into a preview texture of the same size, so everything showing it is upgraded in place.
+	 *
+	 * Game thread only.
+	 *
+	 * @return False if the texture cannot take the image, a new texture is then needed.
+	 */
+	static bool UpdateTexture(UTexture2D* Texture, const FImage& Image);
+
+private:
+	static bool DecodeProgressiveJpeg(const TArray<uint8>& Data, FImage& OutImage, bool& bOutUnsupported);
+
+	static bool DecodeInterlacedPng(const TArray<uint8>& Data, FImage& OutImage, bool& bOutUnsupported);
+};
+
+/**
+ * @class FXDownloadBodyStream
+ * @brief Receives the body of a previewed request, see IHttpRequest::SetResponseBodyReceiveStream.
+ *
+ * The HTTP thread appends the body as it reads it, so the game thread never reads the response payload of a request
+ * in flight. The response then holds no content, the complete body is taken from the stream. Thread-safe.
+ */
+class FXDownloadBodyStream : public FArchive
+{
+public:
+	FXDownloadBodyStream();
+
+	virtual void Serialize(void* V, int64 Length) override;
+
+	virtual FString GetArchiveName() const override { return TEXT("FXDownloadBodyStream"); }
+
+	//the bytes received so far
+	TArray<uint8> CopyData() const;
+
+	//the whole body once the request is complete
+	TArray<uint8> TakeData();
+
+private:
+	mutable FCriticalSection Lock;
+
+	TArray<uint8> Data;
+};
@@ -0,0 +1,207 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadScheduler.h"
+
+#include "XDownLoader.h"
+#include "XDownloadManager.h"
+#include "XDownloaderStats.h"
+#include "ProfilingDebugging/CountersTrace.h"
+
+TRACE_DECLARE_INT_COUNTER(XDownloaderQueuedTasks, TEXT("XDownloader/QueuedTasks"));
+TRACE_DECLARE_INT_COUNTER(XDownloaderInFlightTasks, TEXT("XDownloader/InFlightTasks"));
+
+#if STATS || COUNTERSTRACE_ENABLED
+//summed over the game instances
+static int32 QueuedTaskNum = 0;
+static int32 InFlightTaskNum = 0;
+#endif
+
+static void UpdateQueueStats(int32 QueuedDelta, int32 InFlightDelta)
+{
+#if STATS || COUNTERSTRACE_ENABLED
+	const int32 QueuedNum = FPlatformAtomics::InterlockedAdd(&QueuedTaskNum, QueuedDelta) + QueuedDelta;
+	const int32 InFlightNum = FPlatformAtomics::InterlockedAdd(&InFlightTaskNum, InFlightDelta) + InFlightDelta;
+	SET_DWORD_STAT(STAT_XDownloaderQueuedTasks, QueuedNum);
+	SET_DWORD_STAT(STAT_XDownloaderInFlightTasks, InFlightNum);
+	TRACE_COUNTER_SET(XDownloaderQueuedTasks, QueuedNum);
+	TRACE_COUNTER_SET(XDownloaderInFlightTasks, InFlightNum);
+#endif
+}
+
+FXDownloadScheduler::FXDownloadScheduler(int32 InMaxParallelDownloads)
+	: MaxParallelDownloads(FMath::Max(InMaxParallelDownloads, 1))
+{
+}
+
+void FXDownloadScheduler::AddManager(UXDownloadManager* DownloadManager)
+{
+	FScopeLock ScopeLock(&Lock);
+	DownloadManagers.Add(DownloadManager);
+}
+
+void FXDownloadScheduler::RemoveManager(UXDownloadManager* DownloadManager)
+{
+	FScopeLock ScopeLock(&Lock);
+	DownloadManagers.Remove(DownloadManager);
+}
+
+void FXDownloadScheduler::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	FScopeLock ScopeLock(&Lock);
+	Collector.AddReferencedObjects(DownloadManagers);
+}
+
+void FXDownloadScheduler::Enqueue(UXDownloadManager* DownloadManager, const TArray<FImageDownloadTask>& Tasks)
+{
+	FScopeLock ScopeLock(&Lock);
+	if (bShutdown)
+	{
+		return;
+	}
+	for (const FImageDownloadTask& Task : Tasks)
+	{
+		TaskQueues[static_cast<int32>(Task.Priority)].Enqueue(FQueuedTask{DownloadManager, Task});
+	}
+	UpdateQueueStats(Tasks.Num(), 0);
+	while (CurrentParallelDownloads < MaxParallelDownloads && !IsQueueEmpty())
+	{
+		ExecuteNextTask();
+	}
+}
+
+void FXDownloadScheduler::Requeue(UXDownloadManager* DownloadManager, const FImageDownloadTask& Task)
+{
+	Enqueue(DownloadManager, {Task});
+}
+
+bool FXDownloadScheduler::IsQueueEmpty() const
+{
+	for (const TQueue<FQueuedTask>& TaskQueue : TaskQueues)
+	{
+		if (!TaskQueue.IsEmpty())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FXDownloadScheduler::ExecuteNextTask()
+{
+	FScopeLock ScopeLock(&Lock);
+	FQueuedTask QueuedTask;
+	int32 PriorityIndex = 0;
+	while (CurrentParallelDownloads < MaxParallelDownloads && PriorityIndex < UE_ARRAY_COUNT(TaskQueues))
+	{
+		if (!TaskQueues[PriorityIndex].Dequeue(QueuedTask))
+		{
+			++PriorityIndex;
+			continue;
+		}
+		UpdateQueueStats(-1, 0);
+		const FImageDownloadTask* CurrentTask = DownloadManagers.Contains(QueuedTask.DownloadManager) ? QueuedTask.DownloadManager->CurrentTasks.FindByKey(QueuedTask.Task.ImageID) : nullptr;
+		//an entry left behind by a priority change is skipped, the task runs from its new queue
+		if (CurrentTask && CurrentTask->Priority == QueuedTask.Task.Priority)
+		{
+			QueuedTask.DownloadManager->CurrentTasks.Remove(QueuedTask.Task);
+			QueuedTask.DownloadManager->ExecuteDownloadTask(QueuedTask.Task);
+			return;
+		}
+		//the task was cancelled while queued, skip it
+		UE_LOG(LogXDownloader, VeryVerbose, TEXT("skip cancelled task %s"), *QueuedTask.Task.ImageID);
+	}
+	if (IsQueueEmpty())
+	{
+		UE_LOG(LogXDownloader, Verbose, TEXT("TaskQueue peek failed, all task finished dequeue!!!"));
+	}
+}
+
+void FXDownloadScheduler::AcquireSlot()
+{
+	FScopeLock ScopeLock(&Lock);
+	if (!bShutdown)
+	{
+		++CurrentParallelDownloads;
+		UpdateQueueStats(0, 1);
+	}
+}
+
+void FXDownloadScheduler::ReleaseSlot()
+{
+	FScopeLock ScopeLock(&Lock);
+	if (!bShutdown)
+	{
+		--CurrentParallelDownloads;
+		UpdateQueueStats(0, -1);
+	}
+}
+
+void FXDownloadScheduler::SetMaxParallelDownloads(int32 InMaxParallelDownloads)
+{
+	FScopeLock ScopeLock(&Lock);
+	MaxParallelDownloads = FMath::Max(InMaxParallelDownloads, 1);
+	//a raised limit starts the queued tasks right away, a lowered one takes effect as the running ones finish
+	while (CurrentParallelDownloads < MaxParallelDownloads && !IsQueueEmpty())
+	{
+		ExecuteNextTask();
+	}
+}
+
+bool FXDownloadScheduler::HasPendingTasks() const
+{
+	return CurrentParallelDownloads > 0 || !IsQueueEmpty();
+}
+
+void FXDownloadScheduler::CancelOrphanedTasks()
+{
+	check(IsInGameThread());
+	TArray<UXDownloadManager*> Managers;
+	{
+		FScopeLock ScopeLock(&Lock);
+		Managers = DownloadManagers;
+	}
+	for (UXDownloadManager* DownloadManager : Managers)
+	{
+		if (DownloadManager->IsOrphaned())
+		{
+			DownloadManager->CancelAll();
+		}
+	}
+}
+
+void FXDownloadScheduler::CollectMemoryUsage(FXDownloadMemoryReport& OutReport, TArray<FXDownloadMemoryEntry>& OutImageEntries, TSet<UTexture2D*>& OutTextures) const
+{
+	FScopeLock ScopeLock(&Lock);
+	for (const UXDownloadManager* DownloadManager : DownloadManagers)
+	{
+		DownloadManager->CollectMemoryUsage(OutReport, OutImageEntries, OutTextures);
+	}
+}
+
+void FXDownloadScheduler::Shutdown()
+{
+	TArray<UXDownloadManager*> Managers;
+	{
+		FScopeLock ScopeLock(&Lock);
+		int32 QueuedNum = 0;
+		FQueuedTask QueuedTask;
+		for (TQueue<FQueuedTask>& TaskQueue : TaskQueues)
+		{
+			while (TaskQueue.Dequeue(QueuedTask))
+			{
+				++QueuedNum;
+			}
+		}
+		//the aborted requests never release their slots
+		UpdateQueueStats(-QueuedNum, -CurrentParallelDownloads);
+		CurrentParallelDownloads = 0;
+		bShutdown = true;
+		Managers = DownloadManagers;
+	}
+	UE_LOG(LogXDownloader, Log, TEXT("Scheduler shutdown, %d batches dropped"), Managers.Num());
+	for (UXDownloadManager* DownloadManager : Managers)
+	{
+		DownloadManager->Shutdown();
+	}
+}
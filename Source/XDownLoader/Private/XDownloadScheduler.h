@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "UObject/GCObject.h"
+#include "XDownloaderTypes.h"
+
+class UXDownloadManager;
+
+/**
+ * @class FXDownloadScheduler
+ * @brief The task queue and parallel download slots of one game instance.
+ *
+ * Owned by UXDownloaderSubsystem, so each game instance schedules its batches independently, with its own parallel limit.
+ * Shutting one instance down cancels only the batches of that instance. The scheduler is shared with its managers,
+ * so their pending callbacks can still take its lock after the subsystem is gone.
+ */
+class FXDownloadScheduler : public FGCObject, public TSharedFromThis<FXDownloadScheduler, ESPMode::ThreadSafe>
+{
+public:
+	explicit FXDownloadScheduler(int32 InMaxParallelDownloads);
+
+	//guards the queue and the task state of the managers, recursive
+	FCriticalSection& GetLock() { return Lock; }
+
+	void AddManager(UXDownloadManager* DownloadManager);
+
+	void RemoveManager(UXDownloadManager* DownloadManager);
+
+	/**
+	 * @brief Queues the tasks of a manager and starts as many as the free parallel slots allow.
+	 *
+	 * A queued task is started once it is still in the manager's CurrentTasks, a task removed from there is skipped.
+	 *
+	 * @param DownloadManager The manager owning the tasks.
+	 * @param Tasks The tasks to queue.
+	 */
+	void Enqueue(UXDownloadManager* DownloadManager, const TArray<FImageDownloadTask>& Tasks);
+
+	/**
+	 * @brief Queues a task again after its priority changed in the manager's CurrentTasks.
+	 *
+	 * The entry with the old priority stays queued and is skipped once dequeued.
+	 */
+	void Requeue(UXDownloadManager* DownloadManager, const FImageDownloadTask& Task);
+
+	//starts the next queued task of the highest priority if a parallel slot is free
+	void ExecuteNextTask();
+
+	//a sub task started or stopped holding a parallel slot
+	void AcquireSlot();
+
+	void ReleaseSlot();
+
+	void SetMaxParallelDownloads(int32 InMaxParallelDownloads);
+
+	int32 GetMaxParallelDownloads() const { return MaxParallelDownloads; }
+
+	//whether any batch still has queued or downloading images
+	bool HasPendingTasks() const;
+
+	//cancels the batches whose owner has been garbage collected, game thread
+	void CancelOrphanedTasks();
+
+	//adds the memory held by the running batches to a report, see UXDownloaderSubsystem::GetMemoryReport
+	void CollectMemoryUsage(FXDownloadMemoryReport& OutReport, TArray<FXDownloadMemoryEntry>& OutImageEntries, TSet<UTexture2D*>& OutTextures) const;
+
+	//drops the queue and destroys the batches of this instance without broadcasting
+	void Shutdown();
+
+	//FGCObject
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+	virtual FString GetReferencerName() const override { return TEXT("FXDownloadScheduler"); }
+
+private:
+	struct FQueuedTask
+	{
+		UXDownloadManager* DownloadManager = nullptr;
+
+		FImageDownloadTask Task;
+	};
+
+	mutable FCriticalSection Lock;
+
+	//one queue per EXDownloadPriority
+	TQueue<FQueuedTask> TaskQueues[static_cast<int32>(EXDownloadPriority::Num)];
+
+	bool IsQueueEmpty() const;
+
+	//the running batches, kept alive for the garbage collector until they are destroyed
+	TArray<UXDownloadManager*> DownloadManagers;
+
+	int32 MaxParallelDownloads = 5;
+
+	int32 CurrentParallelDownloads = 0;
+
+	bool bShutdown = false;
+};
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadTransport.h"
+
+#include "Async/Async.h"
+#include "GenericPlatform/GenericPlatformHttp.h"
+#include "HAL/PlatformFileManager.h"
+#include "IPlatformFilePak.h"
+#include "XDownLoader.h"
+#include "XDownloadFileCache.h"
+#include "XDownloaderStats.h"
+
+namespace XDownloadTransport
+{
+	//the part of the URL after "scheme://"
+	static FString GetURLPath(const FString& ImageURL)
+	{
+		const int32 SchemeEnd = ImageURL.Find(TEXT("://"));
+		return FGenericPlatformHttp::UrlDecode(SchemeEnd == INDEX_NONE ? ImageURL : ImageURL.Mid(SchemeEnd + 3));
+	}
+}
+
+void FXDownloadFileTransport::Fetch(const FString& ImageURL, TFunction<void(TArray<uint8>*)> OnFetched)
+{
+	FString FilePath = XDownloadTransport::GetURLPath(ImageURL);
+	//file:///D:/Images/a.png
+	if (FilePath.Len() > 2 && FilePath[0] == TEXT('/') && FilePath[2] == TEXT(':'))
+	{
+		FilePath.RightChopInline(1);
+	}
+	if (FPaths::IsRelative(FilePath))
+	{
+		FilePath = FPaths::Combine(FPaths::ProjectDir(), FilePath);
+	}
+	FXDownloadFileCache::ReadFile(FilePath, MoveTemp(OnFetched));
+}
+
+void FXDownloadPakTransport::Fetch(const FString& ImageURL, TFunction<void(TArray<uint8>*)> OnFetched)
+{
+	const FString FilePath = FPaths::Combine(FPaths::RootDir(), XDownloadTransport::GetURLPath(ImageURL));
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [FilePath, OnFetched = MoveTemp(OnFetched)]()
+	{
+		FPakPlatformFile* PakPlatformFile = static_cast<FPakPlatformFile*>(FPlatformFileManager::Get().FindPlatformFile(FPakPlatformFile::GetTypeName()));
+		//the pak layer falls back to loose files, only a file inside a pak is served
+		if (!PakPlatformFile || !PakPlatformFile->FindFileInPakFiles(*FilePath))
+		{
+			UE_LOG(LogXDownloader, Verbose, TEXT("%s is not in a mounted pak!!!"), *FilePath);
+			OnFetched(nullptr);
+			return;
+		}
+		const TUniquePtr<IFileHandle> FileHandle(PakPlatformFile->OpenRead(*FilePath));
+		TArray<uint8> Data;
+		{
+			LLM_SCOPE_BYTAG(XDownloader_Results);
+			Data.SetNumUninitialized(FileHandle ? FileHandle->Size() : 0);
+		}
+		OnFetched(FileHandle && FileHandle->Read(Data.GetData(), Data.Num()) ? &Data : nullptr);
+	});
+}
+
+void FXDownloadMemoryTransport::AddImage(const FString& ImageURL, TArray<uint8> ImageData)
+{
+	FScopeLock ScopeLock(&ImagesLock);
+	Images.Add(ImageURL, MoveTemp(ImageData));
+}
+
+void FXDownloadMemoryTransport::RemoveImage(const FString& ImageURL)
+{
+	FScopeLock ScopeLock(&ImagesLock);
+	Images.Remove(ImageURL);
+}
+
+int32 FXDownloadMemoryTransport::GetFetchNum() const
+{
+	FScopeLock ScopeLock(&ImagesLock);
+	return FetchNum;
+}
+
+void FXDownloadMemoryTransport::Fetch(const FString& ImageURL, TFunction<void(TArray<uint8>*)> OnFetched)
+{
+	TArray<uint8> Data;
+	bool bFound = false;
+	{
+		FScopeLock ScopeLock(&ImagesLock);
+		++FetchNum;
+		if (const TArray<uint8>* ImageData = Images.Find(ImageURL))
+		{
+			Data = *ImageData;
+			bFound = true;
+		}
+	}
+	OnFetched(bFound ? &Data : nullptr);
+}
@@ -0,0 +1,241 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloadWarmup.h"
+
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "ImageUtils.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "XDownloadPlaceholder.h"
+#include "XDownloadScheduler.h"
+#include "XDownLoader.h"
+#include "XDownloaderSaveGame.h"
+#include "XDownloaderSettings.h"
+#include "XDownloaderStats.h"
+#include "XDownloaderSubsystem.h"
+
+FXDownloadWarmup::FXDownloadWarmup(UXDownloaderSubsystem* InDownloaderSubsystem)
+	: DownloaderSubsystem(InDownloaderSubsystem)
+{
+}
+
+void FXDownloadWarmup::Start(const FString& InSaveGameSlotName)
+{
+	check(IsInGameThread());
+	UXDownloaderSubsystem* Subsystem = DownloaderSubsystem.Get();
+	if (!Subsystem || IsRunning())
+	{
+		return;
+	}
+	SaveGameSlotName = InSaveGameSlotName;
+	StartTime = FPlatformTime::Seconds();
+	WarmedNum = 0;
+	bCancelled = false;
+	bDecoding = true;
+	Subsystem->LoadSaveGameAsync(SaveGameSlotName, FOnXDownloaderSaveGameLoaded::CreateSP(this, &FXDownloadWarmup::OnSaveGameLoaded));
+}
+
+void FXDownloadWarmup::Tick()
+{
+	check(IsInGameThread());
+	//idle, or still decoding with nothing to finalize yet
+	if (StartTime == 0.0 || (PendingNum == 0 && bDecoding))
+	{
+		return;
+	}
+	const double BudgetSeconds = GetDefault<UXDownloaderSettings>()->GetFinalizationBudgetMs() / 1000.0;
+	const double TickStartTime = FPlatformTime::Seconds();
+	FWarmupImage WarmupImage;
+	//at least one image per frame so the warm-up always makes progress
+	while (DecodedImages.Dequeue(WarmupImage))
+	{
+		FPlatformAtomics::InterlockedDecrement(&PendingNum);
+		FinalizeImage(WarmupImage);
+		if (FPlatformTime::Seconds() - TickStartTime >= BudgetSeconds)
+		{
+			break;
+		}
+	}
+	if (!IsRunning())
+	{
+		const double WarmupMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+		SET_FLOAT_STAT(STAT_XDownloaderWarmupTime, WarmupMs);
+		UE_LOG(LogXDownloader, Verbose, TEXT("Warm-up of slot %s done, %d images in %.1f ms"), *SaveGameSlotName, WarmedNum, WarmupMs);
+		StartTime = 0.0;
+	}
+}
+
+void FXDownloadWarmup::Cancel()
+{
+	bCancelled = true;
+	DecodedImages.Empty();
+	FPlatformAtomics::InterlockedExchange(&PendingNum, 0);
+	StartTime = 0.0;
+}
+
+void FXDownloadWarmup::OnSaveGameLoaded(UXDownloaderSaveGame* SaveGame)
+{
+	UXDownloaderSubsystem* Subsystem = DownloaderSubsystem.Get();
+	if (bCancelled || !Subsystem || !SaveGame)
+	{
+		bDecoding = false;
+		return;
+	}
+	TArray<FWarmupImage> Images = SelectImages(SaveGame);
+	if (Images.Num() == 0)
+	{
+		bDecoding = false;
+		return;
+	}
+	const UXDownloaderSettings* Settings = Subsystem->GetXDownloadSettings();
+	const int64 BudgetBytes = static_cast<int64>(Settings->GetWarmupBudgetMB()) * 1024 * 1024;
+	const int32 AtlasMaxImageSize = Settings->IsThumbnailAtlasEnabled() ? Settings->GetAtlasMaxImageSize() : 0;
+	//the module is loaded here, a worker thread only uses it
+	FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"));
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [Warmup = AsShared(), Images = MoveTemp(Images), BudgetBytes, AtlasMaxImageSize]() mutable
+	{
+		Warmup->Decode(MoveTemp(Images), BudgetBytes, AtlasMaxImageSize);
+	});
+}
+
+TArray<FXDownloadWarmup::FWarmupImage> FXDownloadWarmup::SelectImages(UXDownloaderSaveGame* SaveGame) const
+{
+	const int32 WarmupImageNum = GetDefault<UXDownloaderSettings>()->GetWarmupImageNum();
+	TArray<const FXDownloadImageCached*> Candidates;
+	TSet<FString> ContentHashes;
+	TArray<FWarmupImage> Images;
+	FScopeLock ScopeLock(&DownloaderSubsystem.Get()->GetScheduler()->GetLock());
+	for (const FXDownloadImageCached& ImageCached : SaveGame->ImageCaches)
+	{
+		//a batch may have decoded it already while the slot was loading
+		if (ImageCached.UseCount > 0 && !ImageCached.Texture && !ImageCached.ContentHash.IsEmpty() && SaveGame->GetImageData(ImageCached))
+		{
+			Candidates.Add(&ImageCached);
+		}
+	}
+	//half of the images by recency, the rest by frequency, so a long unused favourite does not push out the last screen
+	Candidates.Sort([](const FXDownloadImageCached& A, const FXDownloadImageCached& B) { return A.LastUsedTime > B.LastUsedTime; });
+	const int32 RecentNum = FMath::Min((WarmupImageNum + 1) / 2, Candidates.Num());
+	TArray<const FXDownloadImageCached*> Ranked(Candidates.GetData(), RecentNum);
+	TArray<const FXDownloadImageCached*> Frequent(Candidates.GetData() + RecentNum, Candidates.Num() - RecentNum);
+	Frequent.StableSort([](const FXDownloadImageCached& A, const FXDownloadImageCached& B) { return A.UseCount > B.UseCount; });
+	Ranked.Append(Frequent);
+	for (const FXDownloadImageCached* ImageCached : Ranked)
+	{
+		if (Images.Num() >= WarmupImageNum)
+		{
+			break;
+		}
+		//the entries sharing the bytes are all given the texture in FinalizeImage
+		bool bAlreadyInSet = false;
+		ContentHashes.Add(ImageCached->ContentHash, &bAlreadyInSet);
+		if (!bAlreadyInSet)
+		{
+			FWarmupImage& WarmupImage = Images.AddDefaulted_GetRef();
+			WarmupImage.ContentHash = ImageCached->ContentHash;
+			WarmupImage.ImageData = *SaveGame->GetImageData(*ImageCached);
+		}
+	}
+	return Images;
+}
+
+void FXDownloadWarmup::Decode(TArray<FWarmupImage> Images, int64 BudgetBytes, int32 AtlasMaxImageSize)
+{
+	//the headers tell the decoded size, the images past the budget are not decoded at all
+	IImageWrapperModule& ImageWrapperModule = FModuleManager::GetModuleChecked<IImageWrapperModule>(FName("ImageWrapper"));
+	int64 DecodedBytes = 0;
+	for (int32 Index = 0; Index < Images.Num() && !bCancelled; )
+	{
+		FWarmupImage& WarmupImage = Images[Index];
+		const EImageFormat ImageFormat = ImageWrapperModule.DetectImageFormat(WarmupImage.ImageData.GetData(), WarmupImage.ImageData.Num());
+		const TSharedPtr<IImageWrapper> ImageWrapper = ImageFormat != EImageFormat::Invalid ? ImageWrapperModule.CreateImageWrapper(ImageFormat) : nullptr;
+		int64 ImageBytes = -1;
+		if (ImageWrapper.IsValid() && ImageWrapper->SetCompressed(WarmupImage.ImageData.GetData(), WarmupImage.ImageData.Num()))
+		{
+			const int64 Width = ImageWrapper->GetWidth();
+			const int64 Height = ImageWrapper->GetHeight();
+			//the atlas packs the small images when they are first shown, a texture each would waste its pages
+			const bool bAtlasImage = AtlasMaxImageSize > 0 && Width <= AtlasMaxImageSize && Height <= AtlasMaxImageSize;
+			ImageBytes = bAtlasImage ? -1 : Width * Height * 4;
+		}
+		if (ImageBytes < 0 || DecodedBytes + ImageBytes > BudgetBytes)
+		{
+			//a smaller image further down may still fit
+			Images.RemoveAt(Index, 1, false);
+			continue;
+		}
+		DecodedBytes += ImageBytes;
+		++Index;
+	}
+	if (!bCancelled)
+	{
+		ParallelFor(Images.Num(), [&Images, this](int32 Index)
+		{
+			if (bCancelled)
+			{
+				return;
+			}
+			FWarmupImage& WarmupImage = Images[Index];
+			{
+				XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderDecode);
+				WarmupImage.bDecoded = FImageUtils::ImportBufferAsImage(WarmupImage.ImageData.GetData(), WarmupImage.ImageData.Num(), WarmupImage.Image);
+			}
+			if (WarmupImage.bDecoded)
+			{
+				WarmupImage.PlaceholderHash = FXDownloadPlaceholder::Encode(WarmupImage.Image);
+			}
+			//the bytes stay in the slot
+			WarmupImage.ImageData.Empty();
+		});
+	}
+	for (FWarmupImage& WarmupImage : Images)
+	{
+		if (!bCancelled && WarmupImage.bDecoded)
+		{
+			FPlatformAtomics::InterlockedIncrement(&PendingNum);
+			DecodedImages.Enqueue(MoveTemp(WarmupImage));
+		}
+	}
+	bDecoding = false;
+}
+
+void FXDownloadWarmup::FinalizeImage(FWarmupImage& WarmupImage)
+{
+	UXDownloaderSubsystem* Subsystem = DownloaderSubsystem.Get();
+	UXDownloaderSaveGame* SaveGame = Subsystem ? Subsystem->FindSaveGame(SaveGameSlotName) : nullptr;
+	if (!SaveGame)
+	{
+		return;
+	}
+	//a batch may have created the texture while the warm-up was decoding
+	UTexture2D* Texture = Subsystem->FindSharedTexture(WarmupImage.ContentHash);
+	if (!Texture)
+	{
+		LLM_SCOPE_BYTAG(XDownloader_Textures);
+		XDOWNLOADER_SCOPE_STAGE(STAT_XDownloaderCreateTexture);
+		Texture = FImageUtils::CreateTexture2DFromImage(WarmupImage.Image);
+		Subsystem->AddSharedTexture(WarmupImage.ContentHash, Texture);
+	}
+	if (!Texture)
+	{
+		return;
+	}
+	//the entries hold the texture, a batch hitting the slot skips decoding
+	FScopeLock ScopeLock(&Subsystem->GetScheduler()->GetLock());
+	for (FXDownloadImageCached& ImageCached : SaveGame->ImageCaches)
+	{
+		if (ImageCached.ContentHash == WarmupImage.ContentHash && !ImageCached.Texture)
+		{
+			ImageCached.Texture = Texture;
+			if (ImageCached.PlaceholderHash.IsEmpty())
+			{
+				ImageCached.PlaceholderHash = WarmupImage.PlaceholderHash;
+				SaveGame->MarkDirty();
+			}
+		}
+	}
+	++WarmedNum;
+	INC_DWORD_STAT(STAT_XDownloaderWarmedImages);
+}
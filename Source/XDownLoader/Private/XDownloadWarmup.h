@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ImageCore.h"
+#include "Containers/Queue.h"
+#include "HAL/ThreadSafeBool.h"
+
+class UXDownloaderSaveGame;
+class UXDownloaderSubsystem;
+
+/**
+ * @class FXDownloadWarmup
+ * @brief Decodes the most used images of the default slot at startup, so the first screens find their textures ready.
+ *
+ * Started by UXDownloaderSubsystem::Initialize once the slot has loaded asynchronously. The entries used most recently
+ * and most often are ranked by their LastUsedTime and UseCount, up to the WarmupImageNum and WarmupBudgetMB settings.
+ * They are decoded with ParallelFor on a background task, across all worker threads. The textures are created in Tick
+ * on the game thread, within the FinalizationBudgetMs setting and after the results of the batches.
+ */
+class FXDownloadWarmup : public TSharedFromThis<FXDownloadWarmup, ESPMode::ThreadSafe>
+{
+public:
+	explicit FXDownloadWarmup(UXDownloaderSubsystem* InDownloaderSubsystem);
+
+	//loads the slot without blocking and starts decoding, game thread
+	void Start(const FString& InSaveGameSlotName);
+
+	//creates the textures of the decoded images within the frame budget, game thread
+	void Tick();
+
+	//drops the decoded images, a decode in flight is discarded when it completes
+	void Cancel();
+
+	bool IsRunning() const { return bDecoding || PendingNum > 0; }
+
+private:
+	struct FWarmupImage
+	{
+		FString ContentHash;
+
+		TArray<uint8> ImageData;
+
+		FImage Image;
+
+		FString PlaceholderHash;
+
+		bool bDecoded = false;
+	};
+
+	void OnSaveGameLoaded(UXDownloaderSaveGame* SaveGame);
+
+	//the distinct images to decode, most recently used first, then most often used, within the settings
+	TArray<FWarmupImage> SelectImages(UXDownloaderSaveGame* SaveGame) const;
+
+	/**
+	 * @brief Decodes the images in parallel, runs on a background task.
+	 *
+	 * @param Images The ranked images, the ones past the pixel budget are dropped.
+	 * @param BudgetBytes The WarmupBudgetMB setting in bytes.
+	 * @param AtlasMaxImageSize Images this small are left to the thumbnail atlas, 0 without the atlas.
+	 */
+	void Decode(TArray<FWarmupImage> Images, int64 BudgetBytes, int32 AtlasMaxImageSize);
+
+	void FinalizeImage(FWarmupImage& WarmupImage);
+
+	TWeakObjectPtr<UXDownloaderSubsystem> DownloaderSubsystem;
+
+	FString SaveGameSlotName;
+
+	//decoded images waiting for their texture, filled by the background task
+	TQueue<FWarmupImage, EQueueMode::Mpsc> DecodedImages;
+
+	//decoded images not finalized yet
+	int32 PendingNum = 0;
+
+	FThreadSafeBool bDecoding = false;
+
+	FThreadSafeBool bCancelled = false;
+
+	double StartTime = 0.0;
+
+	int32 WarmedNum = 0;
+};
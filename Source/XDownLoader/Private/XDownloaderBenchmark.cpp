@@ -0,0 +1,387 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloaderBenchmark.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "XDownLoader.h"
+#include "Containers/Ticker.h"
+#include "Dom/JsonObject.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/JsonSerializer.h"
+#include "XDownloadBandwidth.h"
+#include "XDownloadListener.h"
+#include "XDownloadPartial.h"
+#include "XDownloadFileCache.h"
+#include "XDownloadManager.h"
+#include "XDownloadScheduler.h"
+#include "XDownloaderSaveGame.h"
+#include "XDownloaderSettings.h"
+#include "XDownloaderSubsystem.h"
+
+static const TCHAR* XDownloaderBenchmarkSlotName = TEXT("XDownload/XDownloaderBenchmark");
+
+static FAutoConsoleCommandWithWorldAndArgs XDownloaderBenchmarkCommand(
+	TEXT("XDownloader.Benchmark"),
+	TEXT("Runs the XDownloader scenarios against a local stand-in server and writes a JSON report to Saved/XDownload/Benchmark.\n")
+	TEXT("Args: Count=100 LatencyMs=20 JitterMs=0 ImageSize=256 Format=jpg|png ErrorRate=0 Stream=false BandwidthKBps=256 Port=8089"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		FXDownloaderBenchmark::Start(Args, World);
+	}));
+
+TSharedPtr<FXDownloaderBenchmark> FXDownloaderBenchmark::CurrentBenchmark;
+
+void FXDownloaderBenchmark::Start(const TArray<FString>& Args, UWorld* World)
+{
+	if (CurrentBenchmark.IsValid())
+	{
+		UE_LOG(LogXDownloader, Warning, TEXT("XDownloader benchmark is already running!!!"));
+		return;
+	}
+	if (!World || !World->GetGameInstance() || !World->GetGameInstance()->GetSubsystem<UXDownloaderSubsystem>())
+	{
+		UE_LOG(LogXDownloader, Error, TEXT("XDownloader benchmark needs a running game world!!!"));
+		return;
+	}
+	const TSharedRef<FXDownloaderBenchmark> Benchmark = MakeShared<FXDownloaderBenchmark>(FXDownloaderBenchmarkProfile::FromArgs(Args));
+	if (!Benchmark->Server.Start())
+	{
+		return;
+	}
+	Benchmark->BenchmarkWorld = World;
+	Benchmark->BuildRuns();
+	CurrentBenchmark = Benchmark;
+	Benchmark->StartNextRun();
+}
+
+FXDownloaderBenchmark::FXDownloaderBenchmark(const FXDownloaderBenchmarkProfile& InProfile)
+	: Profile(InProfile)
+	  , Server(InProfile)
+	  , RunID(FGuid::NewGuid().ToString(EGuidFormats::Digits))
+{
+}
+
+void FXDownloaderBenchmark::BuildRuns()
+{
+	auto AddRun = [this](const FString& Scenario, const TArray<EXDownloadCacheTier>& CacheTiers, const TArray<FImageDownloadTask>& Tasks, bool bRecord, bool bSeedPartials = false)
+		-> FBenchmarkRun&
+	{
+		FBenchmarkRun& Run = Runs.AddDefaulted_GetRef();
+		Run.Scenario = Scenario;
+		Run.CacheTiers = CacheTiers;
+		Run.Tasks = Tasks;
+		Run.bRecord = bRecord;
+		Run.bSeedPartials = bSeedPartials;
+		return Run;
+	};
+
+	//cold: nothing cached, every image goes to the stand-in server
+	AddRun(TEXT("cold"), {EXDownloadCacheTier::SaveGame}, MakeTasks(TEXT("cold"), Profile.Count), true);
+
+	//warm-disk: primed once, then served from the local file cache
+	const TArray<FImageDownloadTask> DiskTasks = MakeTasks(TEXT("disk"), Profile.Count);
+	AddRun(TEXT("warm-disk"), {EXDownloadCacheTier::LocalFile}, DiskTasks, false);
+	AddRun(TEXT("warm-disk"), {EXDownloadCacheTier::LocalFile}, DiskTasks, true);
+
+	//warm-memory: primed once, then served from the memory tier
+	const TArray<FImageDownloadTask> MemoryTasks = MakeTasks(TEXT("memory"), Profile.Count);
+	AddRun(TEXT("warm-memory"), {EXDownloadCacheTier::Memory, EXDownloadCacheTier::LocalFile}, MemoryTasks, false);
+	AddRun(TEXT("warm-memory"), {EXDownloadCacheTier::Memory, EXDownloadCacheTier::LocalFile}, MemoryTasks, true);
+
+	//warm-savegame: primed once, then served from the loaded slot
+	const TArray<FImageDownloadTask> SaveGameTasks = MakeTasks(TEXT("savegame"), Profile.Count);
+	AddRun(TEXT("warm-savegame"), {EXDownloadCacheTier::SaveGame}, SaveGameTasks, false);
+	AddRun(TEXT("warm-savegame"), {EXDownloadCacheTier::SaveGame}, SaveGameTasks, true);
+
+	//mixed: half of the batch primed, the other half cold
+	const TArray<FImageDownloadTask> MixedTasks = MakeTasks(TEXT("mixed"), Profile.Count);
+	AddRun(TEXT("mixed"), {EXDownloadCacheTier::LocalFile, EXDownloadCacheTier::SaveGame}, TArray<FImageDownloadTask>(MixedTasks.GetData(), MixedTasks.Num() / 2), false);
+	AddRun(TEXT("mixed"), {EXDownloadCacheTier::LocalFile, EXDownloadCacheTier::SaveGame}, MixedTasks, true);
+
+	//resume: every image interrupted halfway, completed with a Range request
+	AddRun(TEXT("resume"), {EXDownloadCacheTier::LocalFile}, MakeTasks(TEXT("resume"), Profile.Count), true, true);
+
+	//throttled: nothing cached, downloaded within the foreground bandwidth budget
+	if (Profile.BandwidthKBps > 0)
+	{
+		AddRun(TEXT("throttled"), {EXDownloadCacheTier::LocalFile}, MakeTasks(TEXT("throttled"), Profile.Count), true).BandwidthKBps = Profile.BandwidthKBps;
+	}
+}
+
+TArray<FImageDownloadTask> FXDownloaderBenchmark::MakeTasks(const FString& Scenario, int32 Num) const
+{
+	TArray<FImageDownloadTask> Tasks;
+	Tasks.Reserve(Num);
+	for (int32 Index = 0; Index < Num; ++Index)
+	{
+		FImageDownloadTask& Task = Tasks.AddDefaulted_GetRef();
+		Task.ImageID = FString::Printf(TEXT("XDownloaderBenchmark_%s_%s_%d.%s"), *RunID, *Scenario, Index, *Profile.Format);
+		Task.ImageURL = Server.GetImageURL(Task.ImageID);
+	}
+	return Tasks;
+}
+
+void FXDownloaderBenchmark::StartNextRun()
+{
+	++CurrentRunIndex;
+	if (!Runs.IsValidIndex(CurrentRunIndex) || !BenchmarkWorld.IsValid())
+	{
+		Finish();
+		return;
+	}
+	const FBenchmarkRun& Run = Runs[CurrentRunIndex];
+	UXDownloaderSubsystem* DownloaderSubsystem = BenchmarkWorld->GetGameInstance()->GetSubsystem<UXDownloaderSubsystem>();
+	//the batch of the run is built with the tiers of its scenario
+	if (DownloaderSubsystem)
+	{
+		DownloaderSubsystem->SetCacheTiers(Run.CacheTiers);
+	}
+	//the other scenarios measure the pipeline, not the configured budget
+	FXDownloadBandwidthLimiter::Get().SetLimitKBps(EXDownloadTrafficClass::Foreground, Run.BandwidthKBps);
+	const FString PartialPath = FPaths::Combine(GetDefault<UXDownloaderSettings>()->GetDownloadImageDefaultPath(), TEXT("Partial"));
+	for (const FImageDownloadTask& Task : Run.Tasks)
+	{
+		CreatedImageIDs.AddUnique(Task.ImageID);
+		if (Run.bSeedPartials && DownloaderSubsystem)
+		{
+			FXDownloadPartial Partial;
+			Partial.ImageURL = Task.ImageURL;
+			Partial.Validator = Server.GetETag();
+			Partial.Data = TArray<uint8>(Server.GetPayload().GetData(), Server.GetPayloadSize() / 2);
+			FXDownloadPartial::Save(DownloaderSubsystem->GetFileCache(), PartialPath, Task.ImageID, Partial);
+		}
+	}
+	//warm runs read the disk, not the write-behind queue of the previous run
+	FlushFileCache();
+
+	CurrentReport = FScenarioReport();
+	CurrentReport.Scenario = Run.Scenario;
+	CurrentReport.BandwidthKBps = Run.BandwidthKBps;
+	CurrentReport.LatenciesMs.Reserve(Run.Tasks.Num());
+	RunStartMemory = FPlatformMemory::GetStats().UsedPhysical;
+	RunStartRangeServed = Server.GetRangeServedNum();
+	RunStartTime = FPlatformTime::Seconds();
+
+	const TWeakPtr<FXDownloaderBenchmark> WeakThis = AsShared();
+	//the peak between two results, a run whose results come late still has its memory sampled every frame
+	StopMemorySampling();
+	MemoryTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([WeakThis](float)
+	{
+		if (const TSharedPtr<FXDownloaderBenchmark> This = WeakThis.Pin())
+		{
+			This->SampleMemory();
+			return true;
+		}
+		return false;
+	}));
+
+	Listener.Reset(NewObject<UXDownloadListener>());
+	Listener->OnSubTask = [WeakThis](const FDownloadResult& Result)
+	{
+		if (const TSharedPtr<FXDownloaderBenchmark> This = WeakThis.Pin())
+		{
+			This->OnRunProgress(Result);
+		}
+	};
+	Listener->OnFinished = [WeakThis](const FTotalDownloadResult& DownloadResult, bool bSucceed)
+	{
+		if (const TSharedPtr<FXDownloaderBenchmark> This = WeakThis.Pin())
+		{
+			This->OnRunFinished(DownloadResult, bSucceed);
+		}
+	};
+	Listener->Listen(UXDownloadManager::DownloadImages(Run.Tasks, XDownloaderBenchmarkSlotName, Profile.bStreamResults));
+}
+
+void FXDownloaderBenchmark::OnRunProgress(const FDownloadResult& Result)
+{
+	if (Result.Status == EDownloadStatus::Success)
+	{
+		++CurrentReport.SucceedNum;
+		CurrentReport.Bytes += Result.ImageData.Num();
+		if (Result.ImageData == Server.GetPayload())
+		{
+			++CurrentReport.VerifiedNum;
+		}
+	}
+	else
+	{
+		++CurrentReport.FailedNum;
+	}
+	//from the request leaving the queue, not from the start of the run
+	CurrentReport.LatenciesMs.Add(Result.LatencySeconds * 1000.0);
+	SampleMemory();
+}
+
+void FXDownloaderBenchmark::SampleMemory()
+{
+	const int64 MemoryDelta = static_cast<int64>(FPlatformMemory::GetStats().UsedPhysical) - static_cast<int64>(RunStartMemory);
+	CurrentReport.PeakMemoryDelta = FMath::Max(CurrentReport.PeakMemoryDelta, MemoryDelta);
+}
+
+void FXDownloaderBenchmark::StopMemorySampling()
+{
+	if (MemoryTickerHandle.IsValid())
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(MemoryTickerHandle);
+		MemoryTickerHandle.Reset();
+	}
+}
+
+void FXDownloaderBenchmark::OnRunFinished(const FTotalDownloadResult& DownloadResult, bool bSucceed)
+{
+	CurrentReport.Seconds = FPlatformTime::Seconds() - RunStartTime;
+	SampleMemory();
+	StopMemorySampling();
+	CurrentReport.RangeRequests = Server.GetRangeServedNum() - RunStartRangeServed;
+	if (Runs[CurrentRunIndex].bRecord)
+	{
+		Reports.Add(CurrentReport);
+	}
+	if (CurrentReport.BandwidthKBps > 0 && !IsWithinBandwidthLimit(CurrentReport))
+	{
+		UE_LOG(LogXDownloader, Warning, TEXT("XDownloader benchmark %s exceeded its budget, %.1f KB/s for a limit of %d KB/s!!!"), *CurrentReport.Scenario,
+		       CurrentReport.Bytes / CurrentReport.Seconds / 1024.0, CurrentReport.BandwidthKBps);
+	}
+	//leave the manager's broadcast before starting the next batch
+	const TWeakPtr<FXDownloaderBenchmark> WeakThis = AsShared();
+	FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([WeakThis](float)
+	{
+		if (const TSharedPtr<FXDownloaderBenchmark> This = WeakThis.Pin())
+		{
+			This->StartNextRun();
+		}
+		return false;
+	}));
+}
+
+void FXDownloaderBenchmark::Finish()
+{
+	StopMemorySampling();
+	Listener.Reset();
+	if (UXDownloaderSubsystem* DownloaderSubsystem = BenchmarkWorld.IsValid() && BenchmarkWorld->GetGameInstance()
+		? BenchmarkWorld->GetGameInstance()->GetSubsystem<UXDownloaderSubsystem>() : nullptr)
+	{
+		//back to the CacheTiers setting
+		DownloaderSubsystem->SetCacheTiers({});
+	}
+	FXDownloadBandwidthLimiter::Get().ResetLimits();
+	Server.Stop();
+	WriteReport();
+	CleanupCaches();
+	CurrentBenchmark.Reset();
+}
+
+void FXDownloaderBenchmark::WriteReport() const
+{
+	const TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	const TSharedRef<FJsonObject> ProfileObject = MakeShared<FJsonObject>();
+	ProfileObject->SetNumberField(TEXT("count"), Profile.Count);
+	ProfileObject->SetNumberField(TEXT("latencyMs"), Profile.LatencyMs);
+	ProfileObject->SetNumberField(TEXT("jitterMs"), Profile.JitterMs);
+	ProfileObject->SetNumberField(TEXT("imageSize"), Profile.ImageSize);
+	ProfileObject->SetStringField(TEXT("format"), Profile.Format);
+	ProfileObject->SetNumberField(TEXT("errorRate"), Profile.ErrorRate);
+	ProfileObject->SetBoolField(TEXT("streamResults"), Profile.bStreamResults);
+	ProfileObject->SetNumberField(TEXT("payloadBytes"), Server.GetPayloadSize());
+	ProfileObject->SetNumberField(TEXT("maxParallelDownloads"), GetDefault<UXDownloaderSettings>()->GetMaxParallelDownloads());
+	Root->SetObjectField(TEXT("profile"), ProfileObject);
+
+	TArray<TSharedPtr<FJsonValue>> Scenarios;
+	for (const FScenarioReport& Report : Reports)
+	{
+		TArray<double> Sorted = Report.LatenciesMs;
+		Sorted.Sort();
+		auto Percentile = [&Sorted](double P)
+		{
+			return Sorted.Num() ? Sorted[FMath::Clamp(FMath::CeilToInt(Sorted.Num() * P) - 1, 0, Sorted.Num() - 1)] : 0.0;
+		};
+		const int32 Num = Report.SucceedNum + Report.FailedNum;
+		const TSharedRef<FJsonObject> ScenarioObject = MakeShared<FJsonObject>();
+		ScenarioObject->SetStringField(TEXT("name"), Report.Scenario);
+		ScenarioObject->SetNumberField(TEXT("count"), Num);
+		ScenarioObject->SetNumberField(TEXT("succeeded"), Report.SucceedNum);
+		ScenarioObject->SetNumberField(TEXT("failed"), Report.FailedNum);
+		ScenarioObject->SetNumberField(TEXT("verified"), Report.VerifiedNum);
+		ScenarioObject->SetNumberField(TEXT("rangeRequests"), Report.RangeRequests);
+		ScenarioObject->SetNumberField(TEXT("bytes"), Report.Bytes);
+		ScenarioObject->SetNumberField(TEXT("seconds"), Report.Seconds);
+		ScenarioObject->SetNumberField(TEXT("imagesPerSecond"), Report.Seconds > 0.0 ? Num / Report.Seconds : 0.0);
+		ScenarioObject->SetNumberField(TEXT("bytesPerSecond"), Report.Seconds > 0.0 ? Report.Bytes / Report.Seconds : 0.0);
+		ScenarioObject->SetNumberField(TEXT("p50Ms"), Percentile(0.5));
+		ScenarioObject->SetNumberField(TEXT("p99Ms"), Percentile(0.99));
+		ScenarioObject->SetNumberField(TEXT("peakMemoryDeltaBytes"), Report.PeakMemoryDelta);
+		if (Report.BandwidthKBps > 0)
+		{
+			ScenarioObject->SetNumberField(TEXT("bandwidthLimitKBps"), Report.BandwidthKBps);
+			ScenarioObject->SetNumberField(TEXT("achievedKBps"), Report.Seconds > 0.0 ? Report.Bytes / Report.Seconds / 1024.0 : 0.0);
+			ScenarioObject->SetBoolField(TEXT("withinLimit"), IsWithinBandwidthLimit(Report));
+		}
+		Scenarios.Add(MakeShared<FJsonValueObject>(ScenarioObject));
+	}
+	Root->SetArrayField(TEXT("scenarios"), Scenarios);
+
+	FString Output;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+	FJsonSerializer::Serialize(Root, Writer);
+	const FString ReportPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("XDownload/Benchmark"),
+	                                           FString::Printf(TEXT("Benchmark-%s.json"), *FDateTime::Now().ToString()));
+	FFileHelper::SaveStringToFile(Output, *ReportPath);
+	UE_LOG(LogXDownloader, Display, TEXT("XDownloader benchmark finished, report written to %s"), *ReportPath);
+	UE_LOG(LogXDownloader, Display, TEXT("%s"), *Output);
+}
+
+bool FXDownloaderBenchmark::IsWithinBandwidthLimit(const FScenarioReport& Report) const
+{
+	const double AllowedBytes = Report.BandwidthKBps * 1024.0 * (Report.Seconds + 1.0)
+		+ static_cast<double>(GetDefault<UXDownloaderSettings>()->GetMaxParallelDownloads()) * Server.GetPayloadSize();
+	return Report.Bytes <= AllowedBytes;
+}
+
+void FXDownloaderBenchmark::FlushFileCache() const
+{
+	if (BenchmarkWorld.IsValid() && BenchmarkWorld->GetGameInstance())
+	{
+		if (UXDownloaderSubsystem* DownloaderSubsystem = BenchmarkWorld->GetGameInstance()->GetSubsystem<UXDownloaderSubsystem>())
+		{
+			DownloaderSubsystem->GetFileCache().Flush();
+		}
+	}
+}
+
+void FXDownloaderBenchmark::CleanupCaches()
+{
+	UXDownloaderSubsystem* DownloaderSubsystem = BenchmarkWorld.IsValid() && BenchmarkWorld->GetGameInstance()
+		? BenchmarkWorld->GetGameInstance()->GetSubsystem<UXDownloaderSubsystem>() : nullptr;
+	FlushFileCache();
+	const FString DownloadImageDefaultPath = GetDefault<UXDownloaderSettings>()->GetDownloadImageDefaultPath();
+	for (const FString& ImageID : CreatedImageIDs)
+	{
+		IFileManager::Get().Delete(*FPaths::Combine(DownloadImageDefaultPath, ImageID), false, false, true);
+		if (DownloaderSubsystem)
+		{
+			FXDownloadPartial::Delete(DownloaderSubsystem->GetFileCache(), FPaths::Combine(DownloadImageDefaultPath, TEXT("Partial")), ImageID);
+		}
+	}
+	//the partial bodies are deleted through the write queue
+	FlushFileCache();
+	if (DownloaderSubsystem)
+	{
+		if (UXDownloaderSaveGame* SaveGame = DownloaderSubsystem->GetSaveGame(XDownloaderBenchmarkSlotName))
+		{
+			//written by the deferred save of the subsystem, never next to one of its writes
+			FScopeLock ScopeLock(&DownloaderSubsystem->GetScheduler()->GetLock());
+			SaveGame->ImageCaches.Empty();
+			SaveGame->ImageBlobs.Empty();
+			SaveGame->MarkDirty();
+		}
+	}
+}
+
+#endif
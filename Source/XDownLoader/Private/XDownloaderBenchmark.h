@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "Containers/Ticker.h"
+#include "UObject/StrongObjectPtr.h"
+#include "XDownloadListener.h"
+#include "XDownloaderBenchmarkServer.h"
+#include "XDownloaderTypes.h"
+
+/**
+ * @class FXDownloaderBenchmark
+ * @brief Drives UXDownloadManager::DownloadImages against FXDownloaderBenchmarkServer and reports the results.
+ *
+ * Runs the cold, warm-disk, warm-memory, warm-SaveGame, mixed, resume and throttled scenarios one after another and writes throughput,
+ * p50/p99 latency and peak memory of each scenario as JSON to Saved/XDownload/Benchmark. The throttled scenario also
+ * checks that the achieved rate stays within the foreground bandwidth budget it runs with.
+ * Started with the console command "XDownloader.Benchmark", only available in non-shipping builds.
+ */
+class FXDownloaderBenchmark : public TSharedFromThis<FXDownloaderBenchmark>
+{
+public:
+	/**
+	 * @brief Starts a benchmark run in the given world.
+	 *
+	 * @param Args Profile arguments, see FXDownloaderBenchmarkProfile.
+	 * @param World The game world whose XDownloader subsystem is benchmarked.
+	 */
+	static void Start(const TArray<FString>& Args, UWorld* World);
+
+	explicit FXDownloaderBenchmark(const FXDownloaderBenchmarkProfile& InProfile);
+
+private:
+	//one DownloadImages call, warm-up calls are not recorded
+	struct FBenchmarkRun
+	{
+		FString Scenario;
+		TArray<EXDownloadCacheTier> CacheTiers;
+		TArray<FImageDownloadTask> Tasks;
+		bool bRecord = true;
+		//seed the first half of the payload as an interrupted download of every task
+		bool bSeedPartials = false;
+		//foreground bandwidth budget of the run, 0 for unlimited
+		int32 BandwidthKBps = 0;
+	};
+
+	struct FScenarioReport
+	{
+		FString Scenario;
+		int32 SucceedNum = 0;
+		int32 FailedNum = 0;
+		//succeeded results whose bytes equal the served payload
+		int32 VerifiedNum = 0;
+		int32 RangeRequests = 0;
+		int64 Bytes = 0;
+		double Seconds = 0.0;
+		TArray<double> LatenciesMs;
+		int64 PeakMemoryDelta = 0;
+		int32 BandwidthKBps = 0;
+	};
+
+	//whether a throttled run stayed within its budget, allowing the one second burst of the bucket and the bodies in flight
+	bool IsWithinBandwidthLimit(const FScenarioReport& Report) const;
+
+	void BuildRuns();
+
+	void StartNextRun();
+
+	void OnRunProgress(const FDownloadResult& Result);
+
+	//raises the peak memory of the current run
+	void SampleMemory();
+
+	void StopMemorySampling();
+
+	void OnRunFinished(const FTotalDownloadResult& DownloadResult, bool bSucceed);
+
+	void Finish();
+
+	void WriteReport() const;
+
+	void CleanupCaches();
+
+	//writes the queued local cache files, so a run never reads the previous run from memory
+	void FlushFileCache() const;
+
+	TArray<FImageDownloadTask> MakeTasks(const FString& Scenario, int32 Num) const;
+
+	static TSharedPtr<FXDownloaderBenchmark> CurrentBenchmark;
+
+	FXDownloaderBenchmarkProfile Profile;
+
+	FXDownloaderBenchmarkServer Server;
+
+	TWeakObjectPtr<UWorld> BenchmarkWorld;
+
+	TArray<FBenchmarkRun> Runs;
+
+	TArray<FScenarioReport> Reports;
+
+	FScenarioReport CurrentReport;
+
+	int32 CurrentRunIndex = INDEX_NONE;
+
+	double RunStartTime = 0.0;
+
+	int32 RunStartRangeServed = 0;
+
+	uint64 RunStartMemory = 0;
+
+	//samples the memory of the current run every frame
+	FTSTicker::FDelegateHandle MemoryTickerHandle;
+
+	//follows the batch of the current run
+	TStrongObjectPtr<UXDownloadListener> Listener;
+
+	FString RunID;
+
+	TArray<FString> CreatedImageIDs;
+};
+
+#endif
@@ -0,0 +1,173 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloaderBenchmarkServer.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "XDownLoader.h"
+#include "HttpPath.h"
+#include "HttpServerModule.h"
+#include "HttpServerRequest.h"
+#include "HttpServerResponse.h"
+#include "IHttpRouter.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Containers/Ticker.h"
+
+FXDownloaderBenchmarkProfile FXDownloaderBenchmarkProfile::FromArgs(const TArray<FString>& Args)
+{
+	FXDownloaderBenchmarkProfile Profile;
+	const FString Params = FString::Join(Args, TEXT(" "));
+	FParse::Value(*Params, TEXT("Port="), Profile.Port);
+	FParse::Value(*Params, TEXT("Count="), Profile.Count);
+	FParse::Value(*Params, TEXT("LatencyMs="), Profile.LatencyMs);
+	FParse::Value(*Params, TEXT("JitterMs="), Profile.JitterMs);
+	FParse::Value(*Params, TEXT("ImageSize="), Profile.ImageSize);
+	FParse::Value(*Params, TEXT("Format="), Profile.Format);
+	FParse::Value(*Params, TEXT("ErrorRate="), Profile.ErrorRate);
+	FParse::Bool(*Params, TEXT("Stream="), Profile.bStreamResults);
+	FParse::Value(*Params, TEXT("BandwidthKBps="), Profile.BandwidthKBps);
+	Profile.Count = FMath::Max(Profile.Count, 2);
+	Profile.ImageSize = FMath::Clamp(Profile.ImageSize, 8, 4096);
+	Profile.ErrorRate = FMath::Clamp(Profile.ErrorRate, 0.f, 1.f);
+	return Profile;
+}
+
+FXDownloaderBenchmarkServer::FXDownloaderBenchmarkServer(const FXDownloaderBenchmarkProfile& InProfile)
+	: Profile(InProfile)
+{
+}
+
+FXDownloaderBenchmarkServer::~FXDownloaderBenchmarkServer()
+{
+	Stop();
+}
+
+bool FXDownloaderBenchmarkServer::Start()
+{
+	GeneratePayload();
+	if (Payload.Num() == 0)
+	{
+		UE_LOG(LogXDownloader, Error, TEXT("XDownloader benchmark failed to encode the %s payload!!!"), *Profile.Format);
+		return false;
+	}
+	Router = FHttpServerModule::Get().GetHttpRouter(Profile.Port);
+	if (!Router.IsValid())
+	{
+		UE_LOG(LogXDownloader, Error, TEXT("XDownloader benchmark failed to bind port %d!!!"), Profile.Port);
+		return false;
+	}
+	RouteHandle = Router->BindRoute(FHttpPath(TEXT("/xdownloader")), EHttpServerRequestVerbs::VERB_GET,
+	                                FHttpRequestHandler::CreateRaw(this, &FXDownloaderBenchmarkServer::HandleImageRequest));
+	FHttpServerModule::Get().StartAllListeners();
+	return true;
+}
+
+void FXDownloaderBenchmarkServer::Stop()
+{
+	if (Router.IsValid() && RouteHandle.IsValid())
+	{
+		Router->UnbindRoute(RouteHandle);
+	}
+	RouteHandle.Reset();
+	Router.Reset();
+}
+
+FString FXDownloaderBenchmarkServer::GetImageURL(const FString& ImageID) const
+{
+	return FString::Printf(TEXT("http://127.0.0.1:%d/xdownloader/%s"), Profile.Port, *ImageID);
+}
+
+static FString FindRequestHeader(const FHttpServerRequest& Request, const FString& HeaderName)
+{
+	for (const TPair<FString, TArray<FString>>& Header : Request.Headers)
+	{
+		if (Header.Key.Equals(HeaderName, ESearchCase::IgnoreCase) && Header.Value.Num())
+		{
+			return Header.Value[0];
+		}
+	}
+	return FString();
+}
+
+bool FXDownloaderBenchmarkServer::HandleImageRequest(const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete)
+{
+	++ServedNum;
+	//resume: "bytes=N-" answered with 206 if the client's validator still matches the payload
+	int64 RangeStart = 0;
+	const FString Range = FindRequestHeader(Request, TEXT("Range"));
+	const FString IfRange = FindRequestHeader(Request, TEXT("If-Range"));
+	FString RangeFirst;
+	if (Range.StartsWith(TEXT("bytes=")) && Range.Mid(6).Split(TEXT("-"), &RangeFirst, nullptr) && RangeFirst.IsNumeric()
+		&& (IfRange.IsEmpty() || IfRange == ETag))
+	{
+		RangeStart = FCString::Atoi64(*RangeFirst);
+	}
+	const bool bFail = FMath::FRand() < Profile.ErrorRate;
+	if (bFail)
+	{
+		++FailedNum;
+	}
+	const float DelaySeconds = (Profile.LatencyMs + FMath::FRandRange(0.f, Profile.JitterMs)) / 1000.f;
+	const FString ContentType = Profile.Format == TEXT("png") ? TEXT("image/png") : TEXT("image/jpeg");
+	TUniquePtr<FHttpServerResponse> Response = MakeUnique<FHttpServerResponse>();
+	if (bFail)
+	{
+		Response->Code = EHttpServerResponseCodes::ServerError;
+	}
+	else if (RangeStart >= Payload.Num())
+	{
+		//416 Range Not Satisfiable
+		Response->Code = static_cast<EHttpServerResponseCodes>(416);
+		Response->Headers.Add(TEXT("Content-Range"), {FString::Printf(TEXT("bytes */%d"), Payload.Num())});
+	}
+	else
+	{
+		Response->Code = RangeStart > 0 ? EHttpServerResponseCodes::PartialContent : EHttpServerResponseCodes::Ok;
+		Response->Body = TArray<uint8>(Payload.GetData() + RangeStart, Payload.Num() - RangeStart);
+		Response->Headers.Add(TEXT("Content-Type"), {ContentType});
+		if (RangeStart > 0)
+		{
+			++RangeServedNum;
+			Response->Headers.Add(TEXT("Content-Range"), {FString::Printf(TEXT("bytes %lld-%d/%d"), RangeStart, Payload.Num() - 1, Payload.Num())});
+		}
+	}
+	Response->Headers.Add(TEXT("Accept-Ranges"), {TEXT("bytes")});
+	Response->Headers.Add(TEXT("ETag"), {ETag});
+	//the server ticks on the game thread, so the latency is simulated by a ticker instead of sleeping
+	//delegates must be copyable, so the response is held by a shared pointer until it is sent
+	const TSharedRef<TUniquePtr<FHttpServerResponse>> PendingResponse = MakeShared<TUniquePtr<FHttpServerResponse>>(MoveTemp(Response));
+	FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([OnComplete, PendingResponse](float)
+	{
+		OnComplete(MoveTemp(*PendingResponse));
+		return false;
+	}), DelaySeconds);
+	return true;
+}
+
+void FXDownloaderBenchmarkServer::GeneratePayload()
+{
+	IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(FName("ImageWrapper"));
+	const TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(Profile.Format == TEXT("png") ? EImageFormat::PNG : EImageFormat::JPEG);
+	if (!ImageWrapper.IsValid())
+	{
+		return;
+	}
+	//noise keeps the encoded size close to a real photo
+	TArray<FColor> Pixels;
+	Pixels.SetNumUninitialized(Profile.ImageSize * Profile.ImageSize);
+	FRandomStream RandomStream(Profile.ImageSize);
+	for (FColor& Pixel : Pixels)
+	{
+		Pixel = FColor(RandomStream.RandHelper(256), RandomStream.RandHelper(256), RandomStream.RandHelper(256), 255);
+	}
+	if (ImageWrapper->SetRaw(Pixels.GetData(), Pixels.Num() * sizeof(FColor), Profile.ImageSize, Profile.ImageSize, ERGBFormat::BGRA, 8))
+	{
+		const TArray64<uint8>& Compressed = ImageWrapper->GetCompressed(90);
+		Payload = TArray<uint8>(Compressed.GetData(), Compressed.Num());
+		ETag = FString::Printf(TEXT("\"%08x\""), FCrc::MemCrc32(Payload.GetData(), Payload.Num()));
+	}
+}
+
+#endif
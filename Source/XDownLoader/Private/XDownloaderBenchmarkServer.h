@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "HttpRouteHandle.h"
+#include "HttpResultCallback.h"
+
+class IHttpRouter;
+struct FHttpServerRequest;
+
+/**
+ * @struct FXDownloaderBenchmarkProfile
+ * @brief The payload, latency and error profile served by FXDownloaderBenchmarkServer.
+ *
+ * Parsed from console arguments such as "Count=200 LatencyMs=30 JitterMs=10 ImageSize=512 Format=png ErrorRate=0.05 Stream=true BandwidthKBps=128".
+ */
+struct FXDownloaderBenchmarkProfile
+{
+	//loopback port of the stand-in server
+	int32 Port = 8089;
+
+	//images per scenario
+	int32 Count = 100;
+
+	//fixed delay before each response
+	float LatencyMs = 20.f;
+
+	//random extra delay in [0, JitterMs]
+	float JitterMs = 0.f;
+
+	//width and height of the synthetic image
+	int32 ImageSize = 256;
+
+	//jpg or png
+	FString Format = TEXT("jpg");
+
+	//probability in [0, 1] of answering with 500
+	float ErrorRate = 0.f;
+
+	//download in streaming mode, see UXDownloadManager::DownloadImages
+	bool bStreamResults = false;
+
+	//foreground budget of the throttled scenario, 0 skips it
+	int32 BandwidthKBps = 256;
+
+	static FXDownloaderBenchmarkProfile FromArgs(const TArray<FString>& Args);
+};
+
+/**
+ * @class FXDownloaderBenchmarkServer
+ * @brief A loopback HTTP server standing in for an image CDN.
+ *
+ * Serves one synthetic JPEG or PNG payload for every GET under /xdownloader/, delayed and failed
+ * according to its FXDownloaderBenchmarkProfile. Honours "Range: bytes=N-" with 206 when If-Range matches
+ * its ETag, so the resume path can be exercised. Only available in non-shipping builds.
+ */
+class FXDownloaderBenchmarkServer
+{
+public:
+	explicit FXDownloaderBenchmarkServer(const FXDownloaderBenchmarkProfile& InProfile);
+	~FXDownloaderBenchmarkServer();
+
+	//generates the payload and binds the route, returns false if the port could not be bound
+	bool Start();
+
+	void Stop();
+
+	FString GetImageURL(const FString& ImageID) const;
+
+	int32 GetPayloadSize() const { return Payload.Num(); }
+
+	const TArray<uint8>& GetPayload() const { return Payload; }
+
+	//strong validator of the payload, sent as ETag and matched against If-Range
+	const FString& GetETag() const { return ETag; }
+
+	int32 GetRangeServedNum() const { return RangeServedNum; }
+
+	int32 GetServedNum() const { return ServedNum; }
+
+	int32 GetFailedNum() const { return FailedNum; }
+
+private:
+	bool HandleImageRequest(const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete);
+
+	void GeneratePayload();
+
+	FXDownloaderBenchmarkProfile Profile;
+
+	TSharedPtr<IHttpRouter> Router;
+
+	FHttpRouteHandle RouteHandle;
+
+	TArray<uint8> Payload;
+
+	FString ETag;
+
+	int32 ServedNum = 0;
+
+	int32 RangeServedNum = 0;
+
+	int32 FailedNum = 0;
+};
+
+#endif
@@ -0,0 +1,536 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloaderCacheCommandlet.h"
+
+#include "HAL/FileManager.h"
+#include "HttpManager.h"
+#include "HttpModule.h"
+#include "ImageCore.h"
+#include "ImageUtils.h"
+#include "Containers/Ticker.h"
+#include "Interfaces/IHttpResponse.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/FileHelper.h"
+#include "XDownLoader.h"
+#include "XDownloadCachePack.h"
+#include "XDownloadCacheTier.h"
+#include "XDownloadPartial.h"
+#include "XDownloadPlaceholder.h"
+#include "XDownloadPrefetcher.h"
+#include "XDownloaderSaveGame.h"
+#include "XDownloaderSettings.h"
+#include "XDownloaderSubsystem.h"
+
+UXDownloaderCacheCommandlet::UXDownloaderCacheCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+	HelpDescription = TEXT("Populates, verifies, compacts or evicts an XDownloader cache, or builds a cache pack, without running the game.");
+	HelpUsage = TEXT("-run=XDownloaderCache -Mode=Populate|Verify|Compact|Evict [-Manifest=Images.json] [-Slot=SlotName] ")
+		TEXT("[-Tiers=LocalFile,SaveGame] [-Parallel=16] [-Mirror=Dir] [-Fix] [-MaxSizeMB=N] [-PartialMaxAgeDays=7]\n")
+		TEXT("-run=XDownloaderCache -Mode=BuildPack -Source=Dir -Pack=Images.xdpack");
+}
+
+int32 UXDownloaderCacheCommandlet::Main(const FString& Params)
+{
+	const UXDownloaderSettings* Settings = GetDefault<UXDownloaderSettings>();
+	CacheTiers = Settings->GetCacheTiers();
+	SaveGameSlotName = Settings->GetSaveGameDefaultSlotName();
+	DownloadImageDefaultPath = Settings->GetDownloadImageDefaultPath();
+	MaxRetryTimes = Settings->GetMaxRetryTimes();
+	DownloadTimeoutSecond = Settings->GetDownloadTimeout();
+
+	FString Mode;
+	FParse::Value(*Params, TEXT("Mode="), Mode);
+	if (Mode == TEXT("BuildPack"))
+	{
+		FString SourceDirectory;
+		FString PackPath;
+		if (!FParse::Value(*Params, TEXT("Source="), SourceDirectory) || !FParse::Value(*Params, TEXT("Pack="), PackPath))
+		{
+			UE_LOG(LogXDownloader, Error, TEXT("Usage: %s"), *HelpUsage);
+			return 1;
+		}
+		const int32 PackedNum = FXDownloadCachePack::Build(SourceDirectory, PackPath, &IsValidImage);
+		UE_LOG(LogXDownloader, Display, TEXT("BuildPack: %d images packed into %s"), PackedNum, *PackPath);
+		return PackedNum == INDEX_NONE ? 1 : 0;
+	}
+	FParse::Value(*Params, TEXT("Slot="), SaveGameSlotName);
+	FParse::Value(*Params, TEXT("Parallel="), MaxParallelDownloads);
+	MaxParallelDownloads = FMath::Max(MaxParallelDownloads, 1);
+	FParse::Value(*Params, TEXT("Mirror="), MirrorPath);
+	FParse::Value(*Params, TEXT("PartialMaxAgeDays="), PartialMaxAgeDays);
+	FString TierNames;
+	if (FParse::Value(*Params, TEXT("Tiers="), TierNames, false))
+	{
+		CacheTiers.Reset();
+		TArray<FString> TierNameArray;
+		TierNames.ParseIntoArray(TierNameArray, TEXT(","));
+		for (const FString& TierName : TierNameArray)
+		{
+			const int64 Tier = StaticEnum<EXDownloadCacheTier>()->GetValueByNameString(TierName.TrimStartAndEnd());
+			if (Tier == INDEX_NONE || Tier == static_cast<int64>(EXDownloadCacheTier::Num))
+			{
+				UE_LOG(LogXDownloader, Error, TEXT("Unknown cache tier %s, usage: %s"), *TierName, *HelpUsage);
+				return 1;
+			}
+			CacheTiers.AddUnique(static_cast<EXDownloadCacheTier>(Tier));
+		}
+	}
+	//the memory tier lives for a session and packs are read-only, only the persistent tiers are maintained here
+	if (!CacheTiers.Contains(EXDownloadCacheTier::LocalFile) && !CacheTiers.Contains(EXDownloadCacheTier::SaveGame))
+	{
+		UE_LOG(LogXDownloader, Error, TEXT("No LocalFile or SaveGame tier in the cache tier chain, nothing to maintain"));
+		return 1;
+	}
+	TArray<FImageDownloadTask> Tasks;
+	FString ManifestPath;
+	if (FParse::Value(*Params, TEXT("Manifest="), ManifestPath) && !FXDownloadPrefetcher::LoadManifest(ManifestPath, Tasks))
+	{
+		return 1;
+	}
+	if (CacheTiers.Contains(EXDownloadCacheTier::SaveGame))
+	{
+		DownloaderSaveGame = UXDownloaderSubsystem::LoadSaveGame(SaveGameSlotName);
+	}
+
+	int32 Result = 1;
+	if (Mode == TEXT("Populate") && Tasks.Num())
+	{
+		Result = Populate(Tasks);
+	}
+	else if (Mode == TEXT("Verify"))
+	{
+		Result = Verify(Tasks, FParse::Param(*Params, TEXT("Fix")));
+	}
+	else if (Mode == TEXT("Compact"))
+	{
+		Result = Compact();
+	}
+	else if (Mode == TEXT("Evict"))
+	{
+		int32 MaxSizeMB = 0;
+		FParse::Value(*Params, TEXT("MaxSizeMB="), MaxSizeMB);
+		Result = Evict(Tasks, static_cast<int64>(MaxSizeMB) * 1024 * 1024);
+	}
+	else
+	{
+		UE_LOG(LogXDownloader, Error, TEXT("Usage: %s"), *HelpUsage);
+		return 1;
+	}
+	if (bSaveGameDirty && DownloaderSaveGame)
+	{
+		UGameplayStatics::SaveGameToSlot(DownloaderSaveGame, SaveGameSlotName, UXDownloaderSaveGame::UserIndex);
+	}
+	return Result;
+}
+
+int32 UXDownloaderCacheCommandlet::Populate(const TArray<FImageDownloadTask>& Tasks)
+{
+	TArray<FImageDownloadTask> PendingTasks;
+	int32 CachedNum = 0;
+	int32 MirroredNum = 0;
+	for (const FImageDownloadTask& Task : Tasks)
+	{
+		TArray<uint8> ImageData;
+		if (IsCached(Task.ImageID))
+		{
+			++CachedNum;
+		}
+		else if (!MirrorPath.IsEmpty() && FFileHelper::LoadFileToArray(ImageData, *FPaths::Combine(MirrorPath, Task.ImageID), FILEREAD_Silent) && IsValidImage(ImageData))
+		{
+			StoreCached(Task, ImageData);
+			++MirroredNum;
+		}
+		else
+		{
+			PendingTasks.Add(Task);
+		}
+	}
+	UE_LOG(LogXDownloader, Display, TEXT("Populate: %d cached, %d from mirror, %d to download with %d parallel requests"),
+	       CachedNum, MirroredNum, PendingTasks.Num(), MaxParallelDownloads);
+
+	const double StartTime = FPlatformTime::Seconds();
+	int32 NextTask = 0;
+	int32 InFlightNum = 0;
+	int32 SucceedNum = 0;
+	int32 FailedNum = 0;
+	int64 DownloadedBytes = 0;
+	TMap<FString, int32> RetryTimesMap;
+	auto StartTask = [&](const FImageDownloadTask Task)
+	{
+		++InFlightNum;
+		const FHttpRequestRef HttpRequest = FHttpModule::Get().CreateRequest();
+		HttpRequest->SetURL(Task.ImageURL);
+		HttpRequest->SetVerb(TEXT("GET"));
+		HttpRequest->SetTimeout(DownloadTimeoutSecond);
+		HttpRequest->OnProcessRequestComplete().BindLambda([&, Task](FHttpRequestPtr, FHttpResponsePtr Response, bool bWasSuccessful)
+		{
+			--InFlightNum;
+			const int32 ResponseCode = Response.IsValid() ? Response->GetResponseCode() : 0;
+			if (bWasSuccessful && EHttpResponseCodes::IsOk(ResponseCode) && IsValidImage(Response->GetContent()))
+			{
+				StoreCached(Task, Response->GetContent());
+				DownloadedBytes += Response->GetContent().Num();
+				++SucceedNum;
+				return;
+			}
+			const bool bCanRetry = ResponseCode == 0 || ResponseCode >= EHttpResponseCodes::ServerError || ResponseCode == EHttpResponseCodes::RequestTimeout;
+			int32& RetryTimes = RetryTimesMap.FindOrAdd(Task.ImageID);
+			if (bCanRetry && RetryTimes < MaxRetryTimes)
+			{
+				++RetryTimes;
+				PendingTasks.Add(Task);
+				return;
+			}
+			++FailedNum;
+			UE_LOG(LogXDownloader, Warning, TEXT("Populate failed (%d)!!! ImageID :%s ,URL:%s"), ResponseCode, *Task.ImageID, *Task.ImageURL);
+		});
+		HttpRequest->ProcessRequest();
+	};
+	TickHttpUntil([&]()
+	{
+		while (InFlightNum < MaxParallelDownloads && PendingTasks.IsValidIndex(NextTask))
+		{
+			StartTask(PendingTasks[NextTask++]);
+		}
+		return InFlightNum == 0 && !PendingTasks.IsValidIndex(NextTask);
+	});
+
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+	UE_LOG(LogXDownloader, Display, TEXT("Populate: %d downloaded (%lld bytes) in %.2fs, %d failed"), SucceedNum, DownloadedBytes, Seconds, FailedNum);
+	return FailedNum ? 1 : 0;
+}
+
+int32 UXDownloaderCacheCommandlet::Verify(const TArray<FImageDownloadTask>& Tasks, bool bFix)
+{
+	TArray<FString> ImageIDs;
+	for (const FImageDownloadTask& Task : Tasks)
+	{
+		ImageIDs.Add(Task.ImageID);
+	}
+	if (ImageIDs.IsEmpty())
+	{
+		ImageIDs = GetCachedImageIDs();
+	}
+	int32 ValidNum = 0;
+	int32 MissingNum = 0;
+	int32 CorruptNum = 0;
+	for (const FString& ImageID : ImageIDs)
+	{
+		//every tier holding the image has to hold a decodable copy
+		bool bValid = true;
+		bool bFound = false;
+		TArray<uint8> ImageData;
+		const FString FilePath = FPaths::Combine(DownloadImageDefaultPath, ImageID);
+		if (CacheTiers.Contains(EXDownloadCacheTier::LocalFile) && FFileHelper::LoadFileToArray(ImageData, *FilePath, FILEREAD_Silent))
+		{
+			bFound = true;
+			bValid &= IsValidImage(ImageData);
+		}
+		if (const TArray<uint8>* CachedImageData = DownloaderSaveGame ? DownloaderSaveGame->GetImageData(ImageID) : nullptr)
+		{
+			bFound = true;
+			bValid &= IsValidImage(*CachedImageData);
+		}
+		if (!bFound)
+		{
+			++MissingNum;
+			UE_LOG(LogXDownloader, Warning, TEXT("Verify: %s is missing"), *ImageID);
+		}
+		else if (!bValid)
+		{
+			++CorruptNum;
+			UE_LOG(LogXDownloader, Warning, TEXT("Verify: %s is corrupt%s"), *ImageID, bFix ? TEXT(", removed") : TEXT(""));
+			if (bFix)
+			{
+				RemoveCached(ImageID);
+			}
+		}
+		else
+		{
+			++ValidNum;
+		}
+	}
+	UE_LOG(LogXDownloader, Display, TEXT("Verify: %d valid, %d missing, %d corrupt"), ValidNum, MissingNum, CorruptNum);
+	return MissingNum || (CorruptNum && !bFix) ? 1 : 0;
+}
+
+int32 UXDownloaderCacheCommandlet::Compact()
+{
+	int32 RemovedNum = 0;
+	int64 RemovedBytes = 0;
+	if (DownloaderSaveGame)
+	{
+		//the first entry of an image wins, it is the one GetImageCache finds
+		TSet<FString> SeenImageIDs;
+		TArray<FXDownloadImageCached> ImageCaches;
+		for (FXDownloadImageCached& ImageCached : DownloaderSaveGame->ImageCaches)
+		{
+			bool bAlreadySeen = false;
+			SeenImageIDs.Add(ImageCached.ImageID, &bAlreadySeen);
+			const TArray<uint8>* CachedImageData = DownloaderSaveGame->GetImageData(ImageCached);
+			if (bAlreadySeen || !CachedImageData || !IsValidImage(*CachedImageData))
+			{
+				++RemovedNum;
+				continue;
+			}
+			ImageCaches.Add(MoveTemp(ImageCached));
+		}
+		ImageCaches.Shrink();
+		DownloaderSaveGame->ImageCaches = MoveTemp(ImageCaches);
+		RemovedBytes += DownloaderSaveGame->RemoveUnusedBlobs();
+		bSaveGameDirty = true;
+	}
+	if (CacheTiers.Contains(EXDownloadCacheTier::LocalFile))
+	{
+		TArray<FString> FileNames;
+		IFileManager::Get().FindFiles(FileNames, *FPaths::Combine(DownloadImageDefaultPath, TEXT("*")), true, false);
+		for (const FString& FileName : FileNames)
+		{
+			const FString FilePath = FPaths::Combine(DownloadImageDefaultPath, FileName);
+			if (IFileManager::Get().FileSize(*FilePath) == 0)
+			{
+				++RemovedNum;
+				IFileManager::Get().Delete(*FilePath, false, false, true);
+			}
+		}
+	}
+	//partial bodies that can no longer resume: unusable, of an image cached since, or older than -PartialMaxAgeDays
+	const FString PartialPath = FPaths::Combine(DownloadImageDefaultPath, TEXT("Partial"));
+	const FDateTime PartialMinTime = FDateTime::UtcNow() - FTimespan::FromDays(PartialMaxAgeDays);
+	//the oldest write of either file of each partial
+	TMap<FString, FDateTime> PartialTimes;
+	IFileManager::Get().IterateDirectoryStat(*PartialPath, [&PartialTimes](const TCHAR* FilePath, const FFileStatData& StatData)
+	{
+		if (!StatData.bIsDirectory)
+		{
+			const FString ImageID = FPaths::GetBaseFilename(FilePath);
+			const FDateTime* PartialTime = PartialTimes.Find(ImageID);
+			PartialTimes.Add(ImageID, PartialTime ? FMath::Min(*PartialTime, StatData.ModificationTime) : StatData.ModificationTime);
+		}
+		return true;
+	});
+	for (const TPair<FString, FDateTime>& PartialTime : PartialTimes)
+	{
+		const FString& ImageID = PartialTime.Key;
+		if (PartialTime.Value < PartialMinTime || IsCached(ImageID) || !FXDownloadPartial::IsUsable(PartialPath, ImageID))
+		{
+			const FString BodyPath = FPaths::Combine(PartialPath, ImageID + TEXT(".part"));
+			++RemovedNum;
+			RemovedBytes += FMath::Max<int64>(IFileManager::Get().FileSize(*BodyPath), 0);
+			IFileManager::Get().Delete(*BodyPath, false, false, true);
+			IFileManager::Get().Delete(*FPaths::Combine(PartialPath, ImageID + TEXT(".json")), false, false, true);
+		}
+	}
+	//temp files of interrupted cache writes, never read back
+	const FString TempPath = FPaths::Combine(DownloadImageDefaultPath, TEXT("Temp"));
+	if (IFileManager::Get().DirectoryExists(*TempPath))
+	{
+		IFileManager::Get().DeleteDirectory(*TempPath, false, true);
+	}
+	UE_LOG(LogXDownloader, Display, TEXT("Compact: %d entries removed, %lld bytes reclaimed"), RemovedNum, RemovedBytes);
+	return 0;
+}
+
+FDateTime UXDownloaderCacheCommandlet::GetLastUsedTime(const FXDownloadImageCached& ImageCached)
+{
+	//an entry no batch got yet counts from when it was cached
+	return FMath::Max(ImageCached.LastUsedTime, ImageCached.ImageTime);
+}
+
+int32 UXDownloaderCacheCommandlet::Evict(const TArray<FImageDownloadTask>& Tasks, int64 MaxBytes)
+{
+	int32 EvictedNum = 0;
+	if (Tasks.Num())
+	{
+		TSet<FString> KeptImageIDs;
+		for (const FImageDownloadTask& Task : Tasks)
+		{
+			KeptImageIDs.Add(Task.ImageID);
+		}
+		for (const FString& ImageID : GetCachedImageIDs())
+		{
+			if (!KeptImageIDs.Contains(ImageID))
+			{
+				RemoveCached(ImageID);
+				++EvictedNum;
+			}
+		}
+	}
+	if (MaxBytes > 0 && CacheTiers.Contains(EXDownloadCacheTier::LocalFile))
+	{
+		struct FCachedFile
+		{
+			FString FilePath;
+			FFileStatData StatData;
+			FDateTime LastUsedTime;
+		};
+		TArray<FCachedFile> CachedFiles;
+		int64 TotalBytes = 0;
+		IFileManager::Get().IterateDirectoryStat(*DownloadImageDefaultPath, [&CachedFiles, &TotalBytes](const TCHAR* FilePath, const FFileStatData& StatData)
+		{
+			if (!StatData.bIsDirectory)
+			{
+				CachedFiles.Add({FilePath, StatData});
+				TotalBytes += StatData.Size;
+			}
+			return true;
+		});
+		//least recently used first, the write time of the file for an image without a slot entry
+		for (FCachedFile& CachedFile : CachedFiles)
+		{
+			const FXDownloadImageCached* ImageCached = DownloaderSaveGame ? DownloaderSaveGame->GetImageCache(FPaths::GetCleanFilename(CachedFile.FilePath)) : nullptr;
+			CachedFile.LastUsedTime = ImageCached ? GetLastUsedTime(*ImageCached) : CachedFile.StatData.ModificationTime;
+		}
+		CachedFiles.Sort([](const FCachedFile& A, const FCachedFile& B) { return A.LastUsedTime < B.LastUsedTime; });
+		for (const FCachedFile& CachedFile : CachedFiles)
+		{
+			if (TotalBytes <= MaxBytes)
+			{
+				break;
+			}
+			TotalBytes -= CachedFile.StatData.Size;
+			IFileManager::Get().Delete(*CachedFile.FilePath, false, false, true);
+			IFileManager::Get().Delete(*FXDownloadLocalFileTier::GetValidatorsPath(DownloadImageDefaultPath, FPaths::GetCleanFilename(CachedFile.FilePath)), false, false, true);
+			++EvictedNum;
+		}
+	}
+	if (MaxBytes > 0 && DownloaderSaveGame)
+	{
+		//a blob is only freed once the last entry sharing it is evicted
+		TMap<FString, int32> BlobRefNums;
+		for (const FXDownloadImageCached& ImageCached : DownloaderSaveGame->ImageCaches)
+		{
+			++BlobRefNums.FindOrAdd(ImageCached.ContentHash);
+		}
+		int64 TotalBytes = 0;
+		for (const TPair<FString, FXDownloadImageBlob>& ImageBlob : DownloaderSaveGame->ImageBlobs)
+		{
+			TotalBytes += ImageBlob.Value.ImageData.Num();
+		}
+		//least recently used first
+		TArray<FXDownloadImageCached>& ImageCaches = DownloaderSaveGame->ImageCaches;
+		TArray<int32> EvictOrder;
+		for (int32 Index = 0; Index < ImageCaches.Num(); ++Index)
+		{
+			EvictOrder.Add(Index);
+		}
+		EvictOrder.StableSort([&ImageCaches](int32 A, int32 B) { return GetLastUsedTime(ImageCaches[A]) < GetLastUsedTime(ImageCaches[B]); });
+		TBitArray<> Evicted(false, ImageCaches.Num());
+		int32 EvictNum = 0;
+		while (TotalBytes > MaxBytes && EvictOrder.IsValidIndex(EvictNum))
+		{
+			const int32 Index = EvictOrder[EvictNum++];
+			Evicted[Index] = true;
+			const FString& ContentHash = ImageCaches[Index].ContentHash;
+			if (--BlobRefNums.FindChecked(ContentHash) == 0)
+			{
+				if (const FXDownloadImageBlob* ImageBlob = DownloaderSaveGame->ImageBlobs.Find(ContentHash))
+				{
+					TotalBytes -= ImageBlob->ImageData.Num();
+				}
+			}
+		}
+		for (int32 Index = ImageCaches.Num() - 1; Index >= 0; --Index)
+		{
+			if (Evicted[Index])
+			{
+				ImageCaches.RemoveAt(Index, 1, false);
+			}
+		}
+		DownloaderSaveGame->RemoveUnusedBlobs();
+		EvictedNum += EvictNum;
+		bSaveGameDirty |= EvictNum > 0;
+	}
+	UE_LOG(LogXDownloader, Display, TEXT("Evict: %d entries removed"), EvictedNum);
+	return 0;
+}
+
+bool UXDownloaderCacheCommandlet::IsCached(const FString& ImageID) const
+{
+	//cached once every persistent tier of the chain holds it
+	if (CacheTiers.Contains(EXDownloadCacheTier::LocalFile) && !FPaths::FileExists(FPaths::Combine(DownloadImageDefaultPath, ImageID)))
+	{
+		return false;
+	}
+	return !DownloaderSaveGame || DownloaderSaveGame->HasImageCache(ImageID);
+}
+
+void UXDownloaderCacheCommandlet::StoreCached(const FImageDownloadTask& Task, const TArray<uint8>& ImageData)
+{
+	if (CacheTiers.Contains(EXDownloadCacheTier::LocalFile))
+	{
+		FFileHelper::SaveArrayToFile(ImageData, *FPaths::Combine(DownloadImageDefaultPath, Task.ImageID));
+	}
+	if (DownloaderSaveGame && !DownloaderSaveGame->HasImageCache(Task.ImageID))
+	{
+		//compressed bytes only, the texture is created when the game loads the slot
+		FXDownloadImageCached ImageCached;
+		ImageCached.ImageID = Task.ImageID;
+		ImageCached.ImageURL = Task.ImageURL;
+		ImageCached.ImageData = ImageData;
+		//the placeholder is ready before the game first decodes the image
+		FImage Image;
+		if (FImageUtils::ImportBufferAsImage(ImageData.GetData(), ImageData.Num(), Image))
+		{
+			ImageCached.PlaceholderHash = FXDownloadPlaceholder::Encode(Image);
+		}
+		DownloaderSaveGame->AddImageCache(ImageCached, SaveGameSlotName);
+		bSaveGameDirty = true;
+	}
+}
+
+void UXDownloaderCacheCommandlet::RemoveCached(const FString& ImageID)
+{
+	if (CacheTiers.Contains(EXDownloadCacheTier::LocalFile))
+	{
+		IFileManager::Get().Delete(*FPaths::Combine(DownloadImageDefaultPath, ImageID), false, false, true);
+		IFileManager::Get().Delete(*FXDownloadLocalFileTier::GetValidatorsPath(DownloadImageDefaultPath, ImageID), false, false, true);
+	}
+	if (DownloaderSaveGame && DownloaderSaveGame->HasImageCache(ImageID))
+	{
+		DownloaderSaveGame->RemoveImageCache(ImageID);
+		bSaveGameDirty = true;
+	}
+}
+
+TArray<FString> UXDownloaderCacheCommandlet::GetCachedImageIDs() const
+{
+	TArray<FString> ImageIDs;
+	if (CacheTiers.Contains(EXDownloadCacheTier::LocalFile))
+	{
+		IFileManager::Get().FindFiles(ImageIDs, *FPaths::Combine(DownloadImageDefaultPath, TEXT("*")), true, false);
+	}
+	if (DownloaderSaveGame)
+	{
+		for (const FXDownloadImageCached& ImageCached : DownloaderSaveGame->ImageCaches)
+		{
+			ImageIDs.AddUnique(ImageCached.ImageID);
+		}
+	}
+	return ImageIDs;
+}
+
+bool UXDownloaderCacheCommandlet::IsValidImage(const TArray<uint8>& ImageData)
+{
+	FImage Image;
+	return ImageData.Num() && FImageUtils::ImportBufferAsImage(ImageData.GetData(), ImageData.Num(), Image);
+}
+
+void UXDownloaderCacheCommandlet::TickHttpUntil(const TFunctionRef<bool()>& Update)
+{
+	double LastTime = FPlatformTime::Seconds();
+	while (!Update())
+	{
+		const double Now = FPlatformTime::Seconds();
+		const float DeltaTime = Now - LastTime;
+		LastTime = Now;
+		FHttpModule::Get().GetHttpManager().Tick(DeltaTime);
+		FTSTicker::GetCoreTicker().Tick(DeltaTime);
+		FPlatformProcess::Sleep(0.001f);
+	}
+}
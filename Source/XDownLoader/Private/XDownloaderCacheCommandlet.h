@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "XDownloaderTypes.h"
+#include "XDownloaderCacheCommandlet.generated.h"
+
+class UXDownloaderSaveGame;
+
+/**
+ * @class UXDownloaderCacheCommandlet
+ * @brief Populates and maintains an XDownloader cache without a game world.
+ *
+ * Runs the download and cache pipeline headless, with full parallelism and no per-frame budgets.
+ * Usage: -run=XDownloaderCache -Mode=Populate|Verify|Compact|Evict [-Manifest=Images.json] [-Slot=SlotName]
+ *        [-Tiers=LocalFile,SaveGame] [-Parallel=16] [-Mirror=Dir] [-Fix] [-MaxSizeMB=N] [-PartialMaxAgeDays=7]
+ *
+ * The LocalFile and SaveGame tiers of UXDownloaderSettings::GetCacheTiers are maintained, -Tiers overrides the chain.
+ *
+ * - Populate downloads every manifest image missing from the cache, reading <Mirror>/<ImageID> first if a mirror is given.
+ * - Verify decodes every cached image and reports the corrupt and missing ones, -Fix removes the corrupt ones.
+ * - Compact drops empty, duplicate and undecodable entries, zero-byte files and temp files, keeping the first entry of an image as the game does.
+ *   Partial downloads are dropped once unusable, of an image cached since or older than -PartialMaxAgeDays.
+ * - Evict removes the images not listed in the manifest, then the least recently used ones until the cache fits -MaxSizeMB.
+ * - BuildPack writes every image of -Source into the read-only cache pack -Pack, see FXDownloadCachePack.
+ */
+UCLASS()
+class UXDownloaderCacheCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UXDownloaderCacheCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	int32 Populate(const TArray<FImageDownloadTask>& Tasks);
+
+	int32 Verify(const TArray<FImageDownloadTask>& Tasks, bool bFix);
+
+	int32 Compact();
+
+	int32 Evict(const TArray<FImageDownloadTask>& Tasks, int64 MaxBytes);
+
+	bool IsCached(const FString& ImageID) const;
+
+	void StoreCached(const FImageDownloadTask& Task, const TArray<uint8>& ImageData);
+
+	void RemoveCached(const FString& ImageID);
+
+	//every image ID present in any tier of the cache
+	TArray<FString> GetCachedImageIDs() const;
+
+	static bool IsValidImage(const TArray<uint8>& ImageData);
+
+	//the LastUsedTime of a slot entry, or its ImageTime if no batch got it yet
+	static FDateTime GetLastUsedTime(const FXDownloadImageCached& ImageCached);
+
+	//ticks the http manager until Update returns true, Update may start new requests
+	static void TickHttpUntil(const TFunctionRef<bool()>& Update);
+
+	//the configured lookup chain, only its LocalFile and SaveGame tiers are touched
+	TArray<EXDownloadCacheTier> CacheTiers;
+
+	FString SaveGameSlotName;
+
+	FString DownloadImageDefaultPath;
+
+	int32 MaxParallelDownloads = 16;
+
+	int32 MaxRetryTimes = 3;
+
+	float DownloadTimeoutSecond = 10.f;
+
+	//directory holding <ImageID> files read before the network
+	FString MirrorPath;
+
+	//partial downloads older than this are dropped by Compact
+	int32 PartialMaxAgeDays = 7;
+
+	UPROPERTY(Transient)
+	UXDownloaderSaveGame* DownloaderSaveGame = nullptr;
+
+	bool bSaveGameDirty = false;
+};
@@ -5,6 +5,7 @@
 
 #include "ImageUtils.h"
 #include "Kismet/GameplayStatics.h"
+#include "XDownloaderStats.h"
 
 int32 UXDownloaderSaveGame::UserIndex = 0;
 
@@ -15,8 +16,55 @@ void UXDownloaderSaveGame::SetSlotName(const FString& InSlotName)
 
 void UXDownloaderSaveGame::AddImageCache(const FXDownloadImageCached& IMageInstance, FString NewSlotName)
 {
+	LLM_SCOPE_BYTAG(XDownloader_SaveGame);
 	SlotNameOverride = NewSlotName.IsEmpty() ? DefaultSlotName : NewSlotName;
-	ImageCaches.AddUnique(IMageInstance);
+	if (ImageCaches.Contains(IMageInstance))
+	{
+		return;
+	}
+	FXDownloadImageCached& ImageCached = ImageCaches.Add_GetRef(IMageInstance);
+	MarkDirty();
+	if (ImageCached.ImageData.Num())
+	{
+		ImageCached.ContentHash = FXDownloadImageCached::ComputeContentHash(ImageCached.ImageData);
+		if (ImageBlobs.Contains(ImageCached.ContentHash))
+		{
+			INC_DWORD_STAT(STAT_XDownloaderDedupBlobHits);
+			INC_MEMORY_STAT_BY(STAT_XDownloaderDedupBlobBytesSaved, ImageCached.ImageData.Num());
+		}
+		else
+		{
+			ImageBlobs.Add(ImageCached.ContentHash).ImageData = MoveTemp(ImageCached.ImageData);
+		}
+		ImageCached.ImageData.Empty();
+	}
+}
+
+bool UXDownloaderSaveGame::UpdateImageCache(const FXDownloadImageCached& IMageInstance, FString NewSlotName)
+{
+	FXDownloadImageCached* ImageCached = GetImageCache(IMageInstance.ImageID);
+	if (!ImageCached)
+	{
+		AddImageCache(IMageInstance, NewSlotName);
+		return true;
+	}
+	SlotNameOverride = NewSlotName.IsEmpty() ? DefaultSlotName : NewSlotName;
+	MarkDirty();
+	ImageCached->ImageTime = IMageInstance.ImageTime;
+	ImageCached->ExpireTime = IMageInstance.ExpireTime;
+	ImageCached->ETag = IMageInstance.ETag;
+	ImageCached->LastModified = IMageInstance.LastModified;
+	if (IMageInstance.ImageData.IsEmpty() || FXDownloadImageCached::ComputeContentHash(IMageInstance.ImageData) == ImageCached->ContentHash)
+	{
+		return false;
+	}
+	//the server sent other bytes, the old texture and blob go with the old entry
+	FXDownloadImageCached NewImageCached = IMageInstance;
+	NewImageCached.LastUsedTime = ImageCached->LastUsedTime;
+	NewImageCached.UseCount = ImageCached->UseCount;
+	RemoveImageCache(IMageInstance.ImageID);
+	AddImageCache(NewImageCached, NewSlotName);
+	return true;
 }
 
 FXDownloadImageCached* UXDownloaderSaveGame::GetImageCache(const FString& ImageID)
@@ -29,15 +77,76 @@ bool UXDownloaderSaveGame::HasImageCache(const FString& ImageID) const
 	return ImageCaches.Contains(ImageID);
 }
 
-void UXDownloaderSaveGame::ReleaseSaveGame(bool bClearImageCaches)
+const TArray<uint8>* UXDownloaderSaveGame::GetImageData(const FString& ImageID) const
+{
+	const FXDownloadImageCached* ImageCached = ImageCaches.FindByKey(ImageID);
+	return ImageCached ? GetImageData(*ImageCached) : nullptr;
+}
+
+const TArray<uint8>* UXDownloaderSaveGame::GetImageData(const FXDownloadImageCached& ImageCached) const
+{
+	const FXDownloadImageBlob* ImageBlob = ImageBlobs.Find(ImageCached.ContentHash);
+	return ImageBlob ? &ImageBlob->ImageData : nullptr;
+}
+
+void UXDownloaderSaveGame::RemoveImageCache(const FString& ImageID)
 {
+	if (ImageCaches.RemoveAll([&ImageID](const FXDownloadImageCached& ImageCached) { return ImageCached.ImageID == ImageID; }))
+	{
+		MarkDirty();
+		RemoveUnusedBlobs();
+	}
+}
+
+int64 UXDownloaderSaveGame::RemoveUnusedBlobs()
+{
+	TSet<FString> UsedHashes;
 	for (const FXDownloadImageCached& ImageCached : ImageCaches)
 	{
-		ImageCached.Texture->RemoveFromRoot();
+		UsedHashes.Add(ImageCached.ContentHash);
+	}
+	int64 FreedBytes = 0;
+	for (auto It = ImageBlobs.CreateIterator(); It; ++It)
+	{
+		if (!UsedHashes.Contains(It.Key()))
+		{
+			FreedBytes += It.Value().ImageData.Num();
+			It.RemoveCurrent();
+		}
+	}
+	return FreedBytes;
+}
+
+void UXDownloaderSaveGame::MoveImageDataToBlobs()
+{
+	LLM_SCOPE_BYTAG(XDownloader_SaveGame);
+	for (FXDownloadImageCached& ImageCached : ImageCaches)
+	{
+		if (ImageCached.ImageData.Num())
+		{
+			MarkDirty();
+			ImageCached.ContentHash = FXDownloadImageCached::ComputeContentHash(ImageCached.ImageData);
+			FXDownloadImageBlob& ImageBlob = ImageBlobs.FindOrAdd(ImageCached.ContentHash);
+			if (ImageBlob.ImageData.IsEmpty())
+			{
+				ImageBlob.ImageData = MoveTemp(ImageCached.ImageData);
+			}
+			ImageCached.ImageData.Empty();
+		}
+	}
+}
+
+void UXDownloaderSaveGame::ReleaseSaveGame(bool bClearImageCaches)
+{
+	//the textures stay alive as long as a handle or a result holds them
+	for (FXDownloadImageCached& ImageCached : ImageCaches)
+	{
+		ImageCached.Texture = nullptr;
 	}
 	if (bClearImageCaches)
 	{
 		ImageCaches.Empty();
+		ImageBlobs.Empty();
 		UGameplayStatics::SaveGameToSlot(this, SlotNameOverride, UserIndex);
 	}
 }
@@ -4,6 +4,7 @@
 #include "XDownloaderSettings.h"
 
 #include "HAL/FileManagerGeneric.h"
+#include "XDownloadBandwidth.h"
 
 UXDownloaderSettings::UXDownloaderSettings()
 {
@@ -16,6 +17,53 @@ UXDownloaderSettings::UXDownloaderSettings()
 	{
 		DownloadImageDefaultPath.Path = IFileManager::Get().ConvertToRelativePath(*FPaths::Combine(FPaths::ProjectSavedDir(),TEXT("XDownload/DownloadImages")));
 	}
+	if (CachePackDirectory.Path.IsEmpty())
+	{
+		CachePackDirectory.Path = IFileManager::Get().ConvertToRelativePath(*FPaths::Combine(FPaths::ProjectContentDir(),TEXT("XDownload/CachePacks")));
+	}
+}
+
+TArray<EXDownloadCacheTier> UXDownloaderSettings::GetCacheTiers() const
+{
+	TArray<EXDownloadCacheTier> Tiers;
+	if (CacheTiers.Num())
+	{
+		for (const EXDownloadCacheTier Tier : CacheTiers)
+		{
+			if (Tier != EXDownloadCacheTier::Num)
+			{
+				Tiers.AddUnique(Tier);
+			}
+		}
+	}
+	else
+	{
+		Tiers.Add(EXDownloadCacheTier::Memory);
+		//the loaded slot is read before the files, a file hit is then promoted into the slot
+		if (CacheType != ECacheType::CT_LocalFile)
+		{
+			Tiers.Add(EXDownloadCacheTier::SaveGame);
+		}
+		if (CacheType != ECacheType::CT_SaveGame)
+		{
+			Tiers.Add(EXDownloadCacheTier::LocalFile);
+		}
+		Tiers.Add(EXDownloadCacheTier::Pack);
+	}
+	if (MemoryCacheMB <= 0)
+	{
+		Tiers.Remove(EXDownloadCacheTier::Memory);
+	}
+	return Tiers;
+}
+
+int32 UXDownloaderSettings::GetNegativeCacheTTL(int32 StatusCode) const
+{
+	if (const int32* TTL = NegativeCacheTTLs.Find(StatusCode))
+	{
+		return *TTL;
+	}
+	return StatusCode >= 400 ? NegativeCacheDefaultTTL : 0;
 }
 
 #if WITH_EDITOR
@@ -34,6 +82,16 @@ void UXDownloaderSettings::PostEditChangeProperty(FPropertyChangedEvent& Propert
 	{
 		DownloadImageDefaultPath.Path = IFileManager::Get().ConvertToRelativePath(*DownloadImageDefaultPath.Path);
 	}
+	if (CachePackDirectory.Path.IsEmpty())
+	{
+		CachePackDirectory.Path = IFileManager::Get().ConvertToRelativePath(*FPaths::Combine(FPaths::ProjectContentDir(),TEXT("XDownload/CachePacks")));
+	}
+	//edited budgets apply to the running downloads, replacing the limits set at runtime
+	const FName PropertyName = PropertyChangedEvent.GetPropertyName();
+	if (PropertyName == GET_MEMBER_NAME_CHECKED(UXDownloaderSettings, ForegroundBandwidthKBps) || PropertyName == GET_MEMBER_NAME_CHECKED(UXDownloaderSettings, PrefetchBandwidthKBps))
+	{
+		FXDownloadBandwidthLimiter::Get().ResetLimits();
+	}
 	SaveConfig();
 }
 #endif
@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "XDownloaderStats.h"
+
+UE_TRACE_CHANNEL_DEFINE(XDownloaderChannel);
+
+LLM_DEFINE_TAG(XDownloader);
+LLM_DEFINE_TAG(XDownloader_SaveGame, TEXT("SaveGame"), TEXT("XDownloader"));
+LLM_DEFINE_TAG(XDownloader_Results, TEXT("Results"), TEXT("XDownloader"));
+LLM_DEFINE_TAG(XDownloader_Textures, TEXT("Textures"), TEXT("XDownloader"));
+LLM_DEFINE_TAG(XDownloader_Http, TEXT("Http"), TEXT("XDownloader"));
+LLM_DEFINE_TAG(XDownloader_FileCache, TEXT("FileCache"), TEXT("XDownloader"));
+LLM_DEFINE_TAG(XDownloader_Prefetch, TEXT("Prefetch"), TEXT("XDownloader"));
+
+DEFINE_STAT(STAT_XDownloaderFinalize);
+DEFINE_STAT(STAT_XDownloaderFinalizeMs);
+DEFINE_STAT(STAT_XDownloaderFinalizedNum);
+DEFINE_STAT(STAT_XDownloaderPendingFinalize);
+
+DEFINE_STAT(STAT_XDownloaderDecode);
+DEFINE_STAT(STAT_XDownloaderCreateTexture);
+DEFINE_STAT(STAT_XDownloaderCacheRead);
+DEFINE_STAT(STAT_XDownloaderCacheWrite);
+DEFINE_STAT(STAT_XDownloaderSaveGameLoad);
+DEFINE_STAT(STAT_XDownloaderFileWritesPending);
+DEFINE_STAT(STAT_XDownloaderFileWritesCoalesced);
+DEFINE_STAT(STAT_XDownloaderQueueWaits);
+DEFINE_STAT(STAT_XDownloaderQueueWaitAvgMs);
+DEFINE_STAT(STAT_XDownloaderQueueWaitMaxMs);
+DEFINE_STAT(STAT_XDownloaderNetworkRequests);
+DEFINE_STAT(STAT_XDownloaderNetworkAvgMs);
+DEFINE_STAT(STAT_XDownloaderNetworkMaxMs);
+
+DEFINE_STAT(STAT_XDownloaderQueuedTasks);
+DEFINE_STAT(STAT_XDownloaderInFlightTasks);
+
+DEFINE_STAT(STAT_XDownloaderMemoryHits);
+DEFINE_STAT(STAT_XDownloaderSaveGameHits);
+DEFINE_STAT(STAT_XDownloaderLocalFileHits);
+DEFINE_STAT(STAT_XDownloaderPackHits);
+DEFINE_STAT(STAT_XDownloaderCacheMisses);
+DEFINE_STAT(STAT_XDownloaderHitRatio);
+DEFINE_STAT(STAT_XDownloaderCachePromotions);
+DEFINE_STAT(STAT_XDownloaderMemoryCacheSize);
+DEFINE_STAT(STAT_XDownloaderMemoryReads);
+DEFINE_STAT(STAT_XDownloaderMemoryReadAvgMs);
+DEFINE_STAT(STAT_XDownloaderMemoryReadMaxMs);
+DEFINE_STAT(STAT_XDownloaderMemoryHitRatio);
+DEFINE_STAT(STAT_XDownloaderLocalFileReads);
+DEFINE_STAT(STAT_XDownloaderLocalFileReadAvgMs);
+DEFINE_STAT(STAT_XDownloaderLocalFileReadMaxMs);
+DEFINE_STAT(STAT_XDownloaderLocalFileHitRatio);
+DEFINE_STAT(STAT_XDownloaderSaveGameReads);
+DEFINE_STAT(STAT_XDownloaderSaveGameReadAvgMs);
+DEFINE_STAT(STAT_XDownloaderSaveGameReadMaxMs);
+DEFINE_STAT(STAT_XDownloaderSaveGameHitRatio);
+DEFINE_STAT(STAT_XDownloaderPackReads);
+DEFINE_STAT(STAT_XDownloaderPackReadAvgMs);
+DEFINE_STAT(STAT_XDownloaderPackReadMaxMs);
+DEFINE_STAT(STAT_XDownloaderPackHitRatio);
+
+DEFINE_STAT(STAT_XDownloaderBytesDownloaded);
+DEFINE_STAT(STAT_XDownloaderBytesFromCache);
+DEFINE_STAT(STAT_XDownloaderBytesResumed);
+
+DEFINE_STAT(STAT_XDownloaderFailedURLs);
+DEFINE_STAT(STAT_XDownloaderFailedFast);
+
+DEFINE_STAT(STAT_XDownloaderPacedStarts);
+DEFINE_STAT(STAT_XDownloaderBandwidthWaiting);
+
+DEFINE_STAT(STAT_XDownloaderStaleHits);
+DEFINE_STAT(STAT_XDownloaderRefreshes);
+DEFINE_STAT(STAT_XDownloaderRefreshesChanged);
+DEFINE_STAT(STAT_XDownloaderRefreshesNotModified);
+
+DEFINE_STAT(STAT_XDownloaderWarmedImages);
+DEFINE_STAT(STAT_XDownloaderWarmupTime);
+
+DEFINE_STAT(STAT_XDownloaderDedupBlobHits);
+DEFINE_STAT(STAT_XDownloaderDedupBlobBytesSaved);
+DEFINE_STAT(STAT_XDownloaderDedupTextureHits);
+DEFINE_STAT(STAT_XDownloaderDedupTextureBytesSaved);
+
+DEFINE_STAT(STAT_XDownloaderPrefetch);
+DEFINE_STAT(STAT_XDownloaderPrefetchPending);
+DEFINE_STAT(STAT_XDownloaderBytesPrefetched);
+
+DEFINE_STAT(STAT_XDownloaderPreviewDecode);
+DEFINE_STAT(STAT_XDownloaderPreviewsShown);
+DEFINE_STAT(STAT_XDownloaderPlaceholderEncode);
+DEFINE_STAT(STAT_XDownloaderPlaceholdersDrawn);
+DEFINE_STAT(STAT_XDownloaderAtlasPages);
+DEFINE_STAT(STAT_XDownloaderAtlasImages);
+DEFINE_STAT(STAT_XDownloaderImageHandles);
+DEFINE_STAT(STAT_XDownloaderImagesReleased);
+DEFINE_STAT(STAT_XDownloaderBoundImages);
@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+#include "HAL/LowLevelMemTracker.h"
+
+/**
+ * Stats and Unreal Insights instrumentation of the download pipeline.
+ * Use "stat XDownloader" in game, or enable the XDownloader trace channel ("-trace=cpu,counters,xdownloader").
+ * Stats and trace compile out when STATS / CPUPROFILERTRACE_ENABLED are off, as in shipping builds.
+ */
+DECLARE_STATS_GROUP(TEXT("XDownloader"), STATGROUP_XDownloader, STATCAT_Advanced);
+
+UE_TRACE_CHANNEL_EXTERN(XDownloaderChannel);
+
+//Low-Level Memory Tracker tags, under XDownloader in "stat LLMFULL" and Insights ("-llm")
+LLM_DECLARE_TAG(XDownloader);
+LLM_DECLARE_TAG(XDownloader_SaveGame);
+LLM_DECLARE_TAG(XDownloader_Results);
+LLM_DECLARE_TAG(XDownloader_Textures);
+LLM_DECLARE_TAG(XDownloader_Http);
+LLM_DECLARE_TAG(XDownloader_FileCache);
+LLM_DECLARE_TAG(XDownloader_Prefetch);
+
+//scopes a pipeline stage both as a stat and as an Insights timing event on the XDownloader channel
+#define XDOWNLOADER_SCOPE_STAGE(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, XDownloaderChannel)
+
+//游戏线程每帧纹理创建耗时
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Finalize Textures"), STAT_XDownloaderFinalize, STATGROUP_XDownloader, );
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Finalize Time (ms)"), STAT_XDownloaderFinalizeMs, STATGROUP_XDownloader, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Finalized Per Frame"), STAT_XDownloaderFinalizedNum, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pending Finalize"), STAT_XDownloaderPendingFinalize, STATGROUP_XDownloader, );
+
+//各阶段耗时
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode"), STAT_XDownloaderDecode, STATGROUP_XDownloader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Create Texture"), STAT_XDownloaderCreateTexture, STATGROUP_XDownloader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cache Read"), STAT_XDownloaderCacheRead, STATGROUP_XDownloader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cache Write"), STAT_XDownloaderCacheWrite, STATGROUP_XDownloader, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SaveGame Load"), STAT_XDownloaderSaveGameLoad, STATGROUP_XDownloader, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("File Writes Pending"), STAT_XDownloaderFileWritesPending, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("File Writes Coalesced"), STAT_XDownloaderFileWritesCoalesced, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Queue Waits"), STAT_XDownloaderQueueWaits, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Avg Queue Wait (ms)"), STAT_XDownloaderQueueWaitAvgMs, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Max Queue Wait (ms)"), STAT_XDownloaderQueueWaitMaxMs, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Network Requests"), STAT_XDownloaderNetworkRequests, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Avg Network (ms)"), STAT_XDownloaderNetworkAvgMs, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Max Network (ms)"), STAT_XDownloaderNetworkMaxMs, STATGROUP_XDownloader, );
+
+//队列与并发
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Queued Tasks"), STAT_XDownloaderQueuedTasks, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("In-Flight Tasks"), STAT_XDownloaderInFlightTasks, STATGROUP_XDownloader, );
+
+//缓存命中
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Memory Hits"), STAT_XDownloaderMemoryHits, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("SaveGame Hits"), STAT_XDownloaderSaveGameHits, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("LocalFile Hits"), STAT_XDownloaderLocalFileHits, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pack Hits"), STAT_XDownloaderPackHits, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Cache Misses"), STAT_XDownloaderCacheMisses, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Cache Hit Ratio"), STAT_XDownloaderHitRatio, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Cache Promotions"), STAT_XDownloaderCachePromotions, STATGROUP_XDownloader, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Memory Cache Size"), STAT_XDownloaderMemoryCacheSize, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Memory Reads"), STAT_XDownloaderMemoryReads, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Avg Memory Read (ms)"), STAT_XDownloaderMemoryReadAvgMs, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Max Memory Read (ms)"), STAT_XDownloaderMemoryReadMaxMs, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Memory Hit Ratio"), STAT_XDownloaderMemoryHitRatio, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("LocalFile Reads"), STAT_XDownloaderLocalFileReads, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Avg LocalFile Read (ms)"), STAT_XDownloaderLocalFileReadAvgMs, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Max LocalFile Read (ms)"), STAT_XDownloaderLocalFileReadMaxMs, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("LocalFile Hit Ratio"), STAT_XDownloaderLocalFileHitRatio, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("SaveGame Reads"), STAT_XDownloaderSaveGameReads, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Avg SaveGame Read (ms)"), STAT_XDownloaderSaveGameReadAvgMs, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Max SaveGame Read (ms)"), STAT_XDownloaderSaveGameReadMaxMs, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("SaveGame Hit Ratio"), STAT_XDownloaderSaveGameHitRatio, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pack Reads"), STAT_XDownloaderPackReads, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Avg Pack Read (ms)"), STAT_XDownloaderPackReadAvgMs, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Max Pack Read (ms)"), STAT_XDownloaderPackReadMaxMs, STATGROUP_XDownloader, );
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Pack Hit Ratio"), STAT_XDownloaderPackHitRatio, STATGROUP_XDownloader, );
+
+//流量
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Bytes Downloaded"), STAT_XDownloaderBytesDownloaded, STATGROUP_XDownloader, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Bytes From Cache"), STAT_XDownloaderBytesFromCache, STATGROUP_XDownloader, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Bytes Resumed"), STAT_XDownloaderBytesResumed, STATGROUP_XDownloader, );
+
+//失败缓存
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Failed URLs"), STAT_XDownloaderFailedURLs, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Failed Fast"), STAT_XDownloaderFailedFast, STATGROUP_XDownloader, );
+
+//带宽限制
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Paced Starts"), STAT_XDownloaderPacedStarts, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Waiting For Bandwidth"), STAT_XDownloaderBandwidthWaiting, STATGROUP_XDownloader, );
+
+//过期刷新
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Stale Hits"), STAT_XDownloaderStaleHits, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Refreshes"), STAT_XDownloaderRefreshes, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Refreshes Changed"), STAT_XDownloaderRefreshesChanged, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Refreshes Not Modified"), STAT_XDownloaderRefreshesNotModified, STATGROUP_XDownloader, );
+
+//启动预热
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Warmed Images"), STAT_XDownloaderWarmedImages, STATGROUP_XDownloader, );
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Warmup Time (ms)"), STAT_XDownloaderWarmupTime, STATGROUP_XDownloader, );
+
+//内容哈希去重
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Dedup Blob Hits"), STAT_XDownloaderDedupBlobHits, STATGROUP_XDownloader, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Dedup Compressed Bytes Saved"), STAT_XDownloaderDedupBlobBytesSaved, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Dedup Texture Hits"), STAT_XDownloaderDedupTextureHits, STATGROUP_XDownloader, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Dedup Texture Memory Saved"), STAT_XDownloaderDedupTextureBytesSaved, STATGROUP_XDownloader, );
+
+//空闲预取
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Prefetch"), STAT_XDownloaderPrefetch, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Prefetch Pending"), STAT_XDownloaderPrefetchPending, STATGROUP_XDownloader, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Bytes Prefetched"), STAT_XDownloaderBytesPrefetched, STATGROUP_XDownloader, );
+
+//渐进预览
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Preview Decode"), STAT_XDownloaderPreviewDecode, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Previews Shown"), STAT_XDownloaderPreviewsShown, STATGROUP_XDownloader, );
+
+//占位图
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Placeholder Encode"), STAT_XDownloaderPlaceholderEncode, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Placeholders Drawn"), STAT_XDownloaderPlaceholdersDrawn, STATGROUP_XDownloader, );
+
+//缩略图图集
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Atlas Pages"), STAT_XDownloaderAtlasPages, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Atlas Images"), STAT_XDownloaderAtlasImages, STATGROUP_XDownloader, );
+
+//图片句柄
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Images With Handles"), STAT_XDownloaderImageHandles, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Images Released"), STAT_XDownloaderImagesReleased, STATGROUP_XDownloader, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Bound Images"), STAT_XDownloaderBoundImages, STATGROUP_XDownloader, );
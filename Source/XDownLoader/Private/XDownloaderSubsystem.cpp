@@ -4,19 +4,557 @@
 #include "XDownloaderSubsystem.h"
 
 #include "XDownloaderSaveGame.h"
+#include "XDownLoader.h"
 #include "Kismet/GameplayStatics.h"
+#include "Async/Async.h"
+#include "UObject/UObjectGlobals.h"
 #include "XDownloaderSettings.h"
+#include "XDownloaderStats.h"
+#include "XDownloadManager.h"
+#include "XDownloadPrefetcher.h"
+#include "XDownloadBandwidth.h"
+#include "XDownloadCachePack.h"
+#include "XDownloadFileCache.h"
+#include "XDownloadCacheTier.h"
+#include "XDownloadNegativeCache.h"
+#include "XDownloadScheduler.h"
+#include "XDownloadWarmup.h"
+#include "XDownloadTransport.h"
+#include "XDownloadPlaceholder.h"
+#include "XDownloadAtlas.h"
+#include "XDownloadImageRegistry.h"
+#include "XDownloadImageBinder.h"
+#include "HAL/FileManager.h"
+#include "Engine/Texture2D.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+namespace XDownloaderSubsystem
+{
+	//the batches finishing meanwhile share one save of their slot
+	static constexpr double SaveGameSaveIntervalSeconds = 2.0;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs XDownloaderMemReportCommand(
+	TEXT("XDownloader.MemReport"),
+	TEXT("Logs the memory held by XDownloader per category, slot and batch, and its largest images and textures.\n")
+	TEXT("Args: TopN=10"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		int32 TopEntryNum = 10;
+		for (const FString& Arg : Args)
+		{
+			FParse::Value(*Arg, TEXT("TopN="), TopEntryNum);
+		}
+		UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+		UXDownloaderSubsystem* DownloaderSubsystem = GameInstance ? GameInstance->GetSubsystem<UXDownloaderSubsystem>() : nullptr;
+		if (!DownloaderSubsystem)
+		{
+			UE_LOG(LogXDownloader, Warning, TEXT("XDownloader.MemReport needs a game world!!!"));
+			return;
+		}
+		UE_LOG(LogXDownloader, Display, TEXT("%s"), *DownloaderSubsystem->GetMemoryReport(TopEntryNum).ToString());
+	}));
 
 void UXDownloaderSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
+	//the limiter outlives game instances, a budget left by a benchmark or a previous session goes back to the settings
+	FXDownloadBandwidthLimiter::Get().ResetLimits();
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &UXDownloaderSubsystem::OnPostGarbageCollect);
+	FileCache = MakeShared<FXDownloadFileCache, ESPMode::ThreadSafe>();
+	NegativeCache = MakeShared<FXDownloadNegativeCache, ESPMode::ThreadSafe>();
+	NegativeCache->Load(GetNegativeCachePath());
+	MemoryCache = MakeShared<FXDownloadMemoryCache, ESPMode::ThreadSafe>(static_cast<int64>(GetXDownloadSettings()->GetMemoryCacheMB()) * 1024 * 1024);
+	Scheduler = MakeShared<FXDownloadScheduler, ESPMode::ThreadSafe>(GetXDownloadSettings()->GetMaxParallelDownloads());
+	Prefetcher = MakeShared<FXDownloadPrefetcher>(this);
+	ImageRegistry = MakeShared<FXDownloadImageRegistry, ESPMode::ThreadSafe>();
+	ImageRegistry->OnImageReleased = [this](UTexture2D* Texture) { OnImageReleased(Texture); };
+	ImageBinder = MakeShared<FXDownloadImageBinder>(this);
+	RegisterTransport(TEXT("file"), MakeShared<FXDownloadFileTransport, ESPMode::ThreadSafe>());
+	RegisterTransport(TEXT("pak"), MakeShared<FXDownloadPakTransport, ESPMode::ThreadSafe>());
+	const FString CachePackDirectory = GetXDownloadSettings()->GetCachePackDirectory();
+	TArray<FString> PackNames;
+	IFileManager::Get().FindFiles(PackNames, *FPaths::Combine(CachePackDirectory, TEXT("*.xdpack")), true, false);
+	PackNames.Sort();
+	for (const FString& PackName : PackNames)
+	{
+		MountCachePack(FPaths::Combine(CachePackDirectory, PackName));
+	}
+	//the slot loads without blocking, the first screens find the textures the warm-up has created by then
+	if (HasCacheTier(EXDownloadCacheTier::SaveGame) && GetXDownloadSettings()->GetWarmupImageNum() > 0)
+	{
+		Warmup = MakeShared<FXDownloadWarmup, ESPMode::ThreadSafe>(this);
+		Warmup->Start(GetXDownloadSettings()->GetSaveGameDefaultSlotName());
+	}
 }
 
 void UXDownloaderSubsystem::Deinitialize()
 {
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+	ImageBinder->UnbindAll();
+	ImageBinder.Reset();
+	//only the batches of this game instance, the other instances keep downloading
+	Scheduler->Shutdown();
+	Scheduler.Reset();
+	FinalizeQueue.Empty();
+	PendingFinalizeNum = 0;
+	PendingFinalizeBytes = 0;
+	if (Prefetcher.IsValid())
+	{
+		Prefetcher->Cancel();
+		Prefetcher.Reset();
+	}
+	if (Warmup.IsValid())
+	{
+		Warmup->Cancel();
+		Warmup.Reset();
+	}
+	{
+		FScopeLock ScopeLock(&CachePacksLock);
+		CachePacks.Empty();
+	}
+	//the promotions still queued hold the cache, only the images are dropped
+	MemoryCache->Empty();
+	PendingSaveGameLoads.Empty();
+	Atlas.Reset();
+	//the remaining handles return null textures from now on
+	ImageRegistry.Reset();
+	{
+		FScopeLock ScopeLock(&TransportsLock);
+		Transports.Empty();
+	}
+	//the changed slots and the queued cache files are written before the game shuts down
+	SaveDirtySaveGames(true);
+	FileCache->Flush();
+	NegativeCache->Save(GetNegativeCachePath());
 	Super::Deinitialize();
 }
 
+void UXDownloaderSubsystem::Tick(float DeltaTime)
+{
+	//priorities first, so the slots freed by this frame's results go to what is on screen
+	if (ImageBinder.IsValid())
+	{
+		ImageBinder->Tick();
+	}
+	TickFinalization();
+	if (Warmup.IsValid())
+	{
+		Warmup->Tick();
+	}
+	FileCache->Tick();
+	SaveDirtySaveGames(false);
+	FXDownloadBandwidthLimiter::Get().Tick();
+	if (Prefetcher.IsValid())
+	{
+		Prefetcher->Tick(DeltaTime);
+	}
+}
+
+void UXDownloaderSubsystem::TickFinalization()
+{
+	SCOPE_CYCLE_COUNTER(STAT_XDownloaderFinalize);
+	const double BudgetSeconds = GetXDownloadSettings()->GetFinalizationBudgetMs() / 1000.0;
+	const double StartTime = FPlatformTime::Seconds();
+	int32 FinalizedNum = 0;
+	FXDownloadFinalizeItem Item;
+	//at least one item per frame, so a tiny budget still makes progress
+	while ((FinalizedNum == 0 || FPlatformTime::Seconds() - StartTime < BudgetSeconds) && FinalizeQueue.Dequeue(Item))
+	{
+		FPlatformAtomics::InterlockedDecrement(&PendingFinalizeNum);
+		FPlatformAtomics::InterlockedAdd(&PendingFinalizeBytes, -static_cast<int64>(Item.Result.ImageData.Num()));
+		++FinalizedNum;
+		if (UXDownloadManager* DownloadManager = Item.DownloadManager.Get())
+		{
+			if (Item.bAllTaskFinished)
+			{
+				DownloadManager->FinalizeAllTask();
+			}
+			else
+			{
+				DownloadManager->FinalizeSubTask(Item.Result);
+			}
+		}
+	}
+	INC_DWORD_STAT_BY(STAT_XDownloaderFinalizedNum, FinalizedNum);
+	SET_FLOAT_STAT(STAT_XDownloaderFinalizeMs, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	SET_DWORD_STAT(STAT_XDownloaderPendingFinalize, PendingFinalizeNum);
+}
+
+ETickableTickType UXDownloaderSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UXDownloaderSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UXDownloaderSubsystem, STATGROUP_Tickables);
+}
+
+void UXDownloaderSubsystem::EnqueueFinalization(UXDownloadManager* InDownloadManager, const FDownloadResult& InTaskResult)
+{
+	LLM_SCOPE_BYTAG(XDownloader_Results);
+	FXDownloadFinalizeItem Item;
+	Item.DownloadManager = InDownloadManager;
+	Item.Result = InTaskResult;
+	FPlatformAtomics::InterlockedAdd(&PendingFinalizeBytes, static_cast<int64>(InTaskResult.ImageData.Num()));
+	FinalizeQueue.Enqueue(MoveTemp(Item));
+	FPlatformAtomics::InterlockedIncrement(&PendingFinalizeNum);
+}
+
+void UXDownloaderSubsystem::EnqueueAllTaskFinished(UXDownloadManager* InDownloadManager)
+{
+	FXDownloadFinalizeItem Item;
+	Item.DownloadManager = InDownloadManager;
+	Item.bAllTaskFinished = true;
+	FinalizeQueue.Enqueue(MoveTemp(Item));
+	FPlatformAtomics::InterlockedIncrement(&PendingFinalizeNum);
+}
+
+void UXDownloaderSubsystem::PrefetchImages(const TArray<FImageDownloadTask>& Tasks, const FString& InSaveGameSlotName)
+{
+	if (Prefetcher.IsValid())
+	{
+		Prefetcher->Enqueue(Tasks, InSaveGameSlotName.IsEmpty() ? GetXDownloadSettings()->GetSaveGameDefaultSlotName() : InSaveGameSlotName);
+	}
+}
+
+void UXDownloaderSubsystem::RefreshImage(const FImageDownloadTask& Task, const FString& InSaveGameSlotName, const FString& StaleContentHash, const FXDownloadCacheFreshness& StaleFreshness)
+{
+	if (Prefetcher.IsValid())
+	{
+		Prefetcher->EnqueueRefresh(Task, InSaveGameSlotName.IsEmpty() ? GetXDownloadSettings()->GetSaveGameDefaultSlotName() : InSaveGameSlotName, StaleContentHash, StaleFreshness);
+	}
+}
+
+void UXDownloaderSubsystem::NotifyImageRefreshed(const FString& ImageID)
+{
+	UE_LOG(LogXDownloader, Verbose, TEXT("Stale image refreshed with new content!!! ImageID :%s"), *ImageID);
+	if (ImageBinder.IsValid())
+	{
+		ImageBinder->Reload(ImageID);
+	}
+	OnImageRefreshed.Broadcast(ImageID);
+}
+
+bool UXDownloaderSubsystem::PrefetchManifest(const FString& ManifestPath, const FString& InSaveGameSlotName)
+{
+	TArray<FImageDownloadTask> Tasks;
+	if (!FXDownloadPrefetcher::LoadManifest(ManifestPath, Tasks))
+	{
+		return false;
+	}
+	PrefetchImages(Tasks, InSaveGameSlotName);
+	return true;
+}
+
+void UXDownloaderSubsystem::CancelPrefetch()
+{
+	if (Prefetcher.IsValid())
+	{
+		Prefetcher->Cancel();
+	}
+}
+
+int32 UXDownloaderSubsystem::GetPendingPrefetchNum() const
+{
+	return Prefetcher.IsValid() ? Prefetcher->GetPendingNum() : 0;
+}
+
+bool UXDownloaderSubsystem::HasForegroundWork() const
+{
+	return PendingFinalizeNum > 0 || (Scheduler.IsValid() && Scheduler->HasPendingTasks());
+}
+
+void UXDownloaderSubsystem::SetMaxParallelDownloads(int32 InMaxParallelDownloads)
+{
+	if (Scheduler.IsValid())
+	{
+		Scheduler->SetMaxParallelDownloads(InMaxParallelDownloads);
+	}
+}
+
+int32 UXDownloaderSubsystem::GetMaxParallelDownloads() const
+{
+	return Scheduler.IsValid() ? Scheduler->GetMaxParallelDownloads() : 0;
+}
+
+void UXDownloaderSubsystem::SetBandwidthLimit(EXDownloadTrafficClass TrafficClass, int32 LimitKBps)
+{
+	if (TrafficClass < EXDownloadTrafficClass::Num)
+	{
+		UE_LOG(LogXDownloader, Log, TEXT("Bandwidth limit of %s set to %d KB/s"), *UEnum::GetValueAsString(TrafficClass), LimitKBps);
+		FXDownloadBandwidthLimiter::Get().SetLimitKBps(TrafficClass, LimitKBps);
+	}
+}
+
+int32 UXDownloaderSubsystem::GetBandwidthLimit(EXDownloadTrafficClass TrafficClass) const
+{
+	return TrafficClass < EXDownloadTrafficClass::Num ? FXDownloadBandwidthLimiter::Get().GetLimitKBps(TrafficClass) : 0;
+}
+
+void UXDownloaderSubsystem::ResetBandwidthLimits()
+{
+	FXDownloadBandwidthLimiter::Get().ResetLimits();
+}
+
+void UXDownloaderSubsystem::SetCacheTiers(const TArray<EXDownloadCacheTier>& InCacheTiers)
+{
+	CacheTiersOverride.Reset();
+	for (const EXDownloadCacheTier Tier : InCacheTiers)
+	{
+		if (Tier != EXDownloadCacheTier::Num)
+		{
+			CacheTiersOverride.AddUnique(Tier);
+		}
+	}
+}
+
+TArray<EXDownloadCacheTier> UXDownloaderSubsystem::GetCacheTiers()
+{
+	if (CacheTiersOverride.IsEmpty())
+	{
+		return GetXDownloadSettings()->GetCacheTiers();
+	}
+	TArray<EXDownloadCacheTier> Tiers = CacheTiersOverride;
+	//the memory tier is not created without a budget
+	if (GetXDownloadSettings()->GetMemoryCacheMB() <= 0)
+	{
+		Tiers.Remove(EXDownloadCacheTier::Memory);
+	}
+	return Tiers;
+}
+
+bool UXDownloaderSubsystem::MountCachePack(const FString& PackPath)
+{
+	const TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe> CachePack = FXDownloadCachePack::Mount(PackPath);
+	if (!CachePack.IsValid())
+	{
+		return false;
+	}
+	FScopeLock ScopeLock(&CachePacksLock);
+	CachePacks.Add(CachePack);
+	return true;
+}
+
+void UXDownloaderSubsystem::RegisterTransport(const FString& Scheme, const TSharedPtr<IXDownloadTransport, ESPMode::ThreadSafe>& Transport)
+{
+	const FString LowerScheme = Scheme.ToLower();
+	if (LowerScheme == TEXT("http") || LowerScheme == TEXT("https"))
+	{
+		UE_LOG(LogXDownloader, Warning, TEXT("The %s scheme always uses the HTTP module!!!"), *LowerScheme);
+		return;
+	}
+	FScopeLock ScopeLock(&TransportsLock);
+	if (Transport.IsValid())
+	{
+		Transports.Add(LowerScheme, Transport);
+	}
+	else
+	{
+		Transports.Remove(LowerScheme);
+	}
+}
+
+TSharedPtr<IXDownloadTransport, ESPMode::ThreadSafe> UXDownloaderSubsystem::FindTransport(const FString& ImageURL) const
+{
+	const int32 SchemeEnd = ImageURL.Find(TEXT("://"));
+	if (SchemeEnd == INDEX_NONE)
+	{
+		return nullptr;
+	}
+	FScopeLock ScopeLock(&TransportsLock);
+	const TSharedPtr<IXDownloadTransport, ESPMode::ThreadSafe>* Transport = Transports.Find(ImageURL.Left(SchemeEnd).ToLower());
+	return Transport ? *Transport : nullptr;
+}
+
+TArray<TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe>> UXDownloaderSubsystem::GetCachePacks() const
+{
+	FScopeLock ScopeLock(&CachePacksLock);
+	return CachePacks;
+}
+
+bool UXDownloaderSubsystem::ReadFromCachePacks(const FString& ImageID, TArray<uint8>& OutImageData) const
+{
+	for (const TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe>& CachePack : GetCachePacks())
+	{
+		if (CachePack->Read(ImageID, OutImageData))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+UTexture2D* UXDownloaderSubsystem::FindSharedTexture(const FString& ContentHash) const
+{
+	check(IsInGameThread());
+	const TWeakObjectPtr<UTexture2D>* SharedTexture = SharedTextures.Find(ContentHash);
+	UTexture2D* Texture = SharedTexture ? SharedTexture->Get() : nullptr;
+	if (Texture)
+	{
+		INC_DWORD_STAT(STAT_XDownloaderDedupTextureHits);
+		INC_MEMORY_STAT_BY(STAT_XDownloaderDedupTextureBytesSaved, Texture->CalcTextureMemorySizeEnum(TMC_AllMips));
+	}
+	return Texture;
+}
+
+void UXDownloaderSubsystem::AddSharedTexture(const FString& ContentHash, UTexture2D* Texture)
+{
+	check(IsInGameThread());
+	if (Texture && !ContentHash.IsEmpty())
+	{
+		SharedTextures.Add(ContentHash, Texture);
+	}
+}
+
+FXDownloadImageHandle UXDownloaderSubsystem::AcquireImageHandle(UTexture2D* Texture, const FString& ImageID)
+{
+	return ImageRegistry.IsValid() ? ImageRegistry->Acquire(Texture, ImageID) : FXDownloadImageHandle();
+}
+
+void UXDownloaderSubsystem::OnImageReleased(UTexture2D* Texture)
+{
+	check(IsInGameThread());
+	INC_DWORD_STAT(STAT_XDownloaderImagesReleased);
+	if (!Scheduler.IsValid())
+	{
+		return;
+	}
+	//the compressed bytes stay cached, the texture is created again on the next hit
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	for (const TPair<FString, UXDownloaderSaveGame*>& SaveGame : XDownloaderSaveGames)
+	{
+		for (FXDownloadImageCached& ImageCached : SaveGame.Value->ImageCaches)
+		{
+			if (ImageCached.Texture == Texture)
+			{
+				ImageCached.Texture = nullptr;
+			}
+		}
+	}
+}
+
+FXDownloadAtlas& UXDownloaderSubsystem::GetAtlas()
+{
+	check(IsInGameThread());
+	if (!Atlas.IsValid())
+	{
+		Atlas = MakeShared<FXDownloadAtlas>(GetXDownloadSettings()->GetAtlasPageSize(), GetXDownloadSettings()->GetAtlasMaxImageSize());
+	}
+	return *Atlas;
+}
+
+void UXDownloaderSubsystem::ReleaseAtlasRegion(FXDownloadAtlasRegion& Region)
+{
+	if (Region.IsValid() && Atlas.IsValid())
+	{
+		Atlas->Release(Region.ContentHash);
+	}
+	Region = FXDownloadAtlasRegion();
+}
+
+FString UXDownloaderSubsystem::FindPlaceholderHash(const FString& ImageID, const FString& InSaveGameSlotName)
+{
+	const UXDownloaderSaveGame* SaveGame = FindSaveGame(InSaveGameSlotName.IsEmpty() ? GetXDownloadSettings()->GetSaveGameDefaultSlotName() : InSaveGameSlotName);
+	if (!SaveGame || !Scheduler.IsValid())
+	{
+		return FString();
+	}
+	FScopeLock ScopeLock(&Scheduler->GetLock());
+	const FXDownloadImageCached* ImageCached = SaveGame ? SaveGame->ImageCaches.FindByKey(ImageID) : nullptr;
+	return ImageCached ? ImageCached->PlaceholderHash : FString();
+}
+
+UTexture2D* UXDownloaderSubsystem::GetPlaceholderTexture(const FString& ImageID, const FString& InSaveGameSlotName)
+{
+	check(IsInGameThread());
+	const FString PlaceholderHash = FindPlaceholderHash(ImageID, InSaveGameSlotName);
+	if (PlaceholderHash.IsEmpty())
+	{
+		return nullptr;
+	}
+	TWeakObjectPtr<UTexture2D>& PlaceholderTexture = PlaceholderTextures.FindOrAdd(PlaceholderHash);
+	if (!PlaceholderTexture.IsValid())
+	{
+		LLM_SCOPE_BYTAG(XDownloader_Textures);
+		PlaceholderTexture = FXDownloadPlaceholder::CreateTexture(PlaceholderHash, 32, 32);
+	}
+	INC_DWORD_STAT(STAT_XDownloaderPlaceholdersDrawn);
+	return PlaceholderTexture.Get();
+}
+
+bool UXDownloaderSubsystem::GetPlaceholderColors(const FString& ImageID, int32 GridWidth, int32 GridHeight, TArray<FLinearColor>& OutColors, const FString& InSaveGameSlotName)
+{
+	TArray<FColor> Colors;
+	if (!FXDownloadPlaceholder::Decode(FindPlaceholderHash(ImageID, InSaveGameSlotName), GridWidth, GridHeight, Colors))
+	{
+		return false;
+	}
+	INC_DWORD_STAT(STAT_XDownloaderPlaceholdersDrawn);
+	OutColors.Reset(Colors.Num());
+	for (const FColor& Color : Colors)
+	{
+		OutColors.Add(FLinearColor(Color));
+	}
+	return true;
+}
+
+bool UXDownloaderSubsystem::IsInCachePacks(const FString& ImageID) const
+{
+	return GetCachePacks().ContainsByPredicate([&ImageID](const TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe>& CachePack) { return CachePack->Contains(ImageID); });
+}
+
+void UXDownloaderSubsystem::SaveDirtySaveGames(bool bWait)
+{
+	const double Now = FPlatformTime::Seconds();
+	if (!bWait && Now < NextSaveGameSaveTime)
+	{
+		return;
+	}
+	NextSaveGameSaveTime = Now + XDownloaderSubsystem::SaveGameSaveIntervalSeconds;
+	for (auto It = SaveGameWrites.CreateIterator(); It; ++It)
+	{
+		if (bWait)
+		{
+			It.Value().Wait();
+		}
+		if (It.Value().IsReady())
+		{
+			UE_CLOG(!It.Value().Get(), LogXDownloader, Warning, TEXT("Save of slot %s failed!!!"), *It.Key());
+			It.RemoveCurrent();
+		}
+	}
+	for (const TPair<FString, UXDownloaderSaveGame*>& SaveGame : XDownloaderSaveGames)
+	{
+		if (!SaveGame.Value || !SaveGame.Value->IsDirty() || SaveGameWrites.Contains(SaveGame.Key))
+		{
+			continue;
+		}
+		//serialized on the game thread where the slot is changed, written to the platform save system in the background
+		LLM_SCOPE_BYTAG(XDownloader_SaveGame);
+		TArray<uint8> SaveData;
+		SaveGame.Value->ClearDirty();
+		if (UGameplayStatics::SaveGameToMemory(SaveGame.Value, SaveData))
+		{
+			SaveGameWrites.Add(SaveGame.Key, Async(EAsyncExecution::ThreadPool, [SaveData = MoveTemp(SaveData), SlotName = SaveGame.Key]()
+			{
+				return UGameplayStatics::SaveDataToSlot(SaveData, SlotName, UXDownloaderSaveGame::UserIndex);
+			}));
+		}
+	}
+	if (bWait)
+	{
+		for (TPair<FString, TFuture<bool>>& SaveGameWrite : SaveGameWrites)
+		{
+			SaveGameWrite.Value.Wait();
+		}
+		SaveGameWrites.Empty();
+	}
+}
+
 UXDownloaderSaveGame* UXDownloaderSubsystem::LoadSaveGame(const FString& InSlotName)
 {
 	UXDownloaderSaveGame* XDownloaderSaveGame = nullptr;
@@ -35,6 +573,7 @@ UXDownloaderSaveGame* UXDownloaderSubsystem::LoadSaveGame(const FString& InSlotN
 		{
 			XDownloaderSaveGame = Cast<UXDownloaderSaveGame>(SaveGame);
 			XDownloaderSaveGame->SetSlotName(InSlotName);
+			XDownloaderSaveGame->MoveImageDataToBlobs();
 		}
 	}
 	return XDownloaderSaveGame;
@@ -42,27 +581,177 @@ UXDownloaderSaveGame* UXDownloaderSubsystem::LoadSaveGame(const FString& InSlotN
 
 UXDownloaderSaveGame* UXDownloaderSubsystem::GetSaveGame(const FString& InSlotName)
 {
-	UXDownloaderSaveGame* XDownloaderSaveGame = nullptr;
-	for (USaveGame* DownloaderSaveGame : XDownloaderSaveGames)
+	UXDownloaderSaveGame* XDownloaderSaveGame = FindSaveGame(InSlotName);
+	if (!XDownloaderSaveGame)
 	{
-		UXDownloaderSaveGame* TempXDownloaderSaveGame = Cast<UXDownloaderSaveGame>(DownloaderSaveGame);
-		if (TempXDownloaderSaveGame->SlotNameOverride == InSlotName)
+		SCOPE_CYCLE_COUNTER(STAT_XDownloaderSaveGameLoad);
+		LLM_SCOPE_BYTAG(XDownloader_SaveGame);
+		XDownloaderSaveGame = LoadSaveGame(InSlotName);
+		if (XDownloaderSaveGame)
 		{
-			XDownloaderSaveGame = TempXDownloaderSaveGame;
-			break;
+			XDownloaderSaveGames.Add(InSlotName, XDownloaderSaveGame);
 		}
 	}
+	return XDownloaderSaveGame;
+}
+
+void UXDownloaderSubsystem::LoadSaveGameAsync(const FString& InSlotName, const FOnXDownloaderSaveGameLoaded& OnLoaded)
+{
+	check(IsInGameThread());
+	if (UXDownloaderSaveGame* XDownloaderSaveGame = FindSaveGame(InSlotName))
+	{
+		OnLoaded.ExecuteIfBound(XDownloaderSaveGame);
+		return;
+	}
+	if (TArray<FOnXDownloaderSaveGameLoaded>* PendingCallbacks = PendingSaveGameLoads.Find(InSlotName))
+	{
+		PendingCallbacks->Add(OnLoaded);
+		return;
+	}
+	if (!UGameplayStatics::DoesSaveGameExist(InSlotName, UXDownloaderSaveGame::UserIndex))
+	{
+		//a new slot is empty, nothing to wait for
+		OnLoaded.ExecuteIfBound(GetSaveGame(InSlotName));
+		return;
+	}
+	PendingSaveGameLoads.Add(InSlotName).Add(OnLoaded);
+	LLM_SCOPE_BYTAG(XDownloader_SaveGame);
+	UGameplayStatics::AsyncLoadGameFromSlot(InSlotName, UXDownloaderSaveGame::UserIndex,
+		FAsyncLoadGameFromSlotDelegate::CreateUObject(this, &UXDownloaderSubsystem::OnSaveGameLoaded));
+}
+
+void UXDownloaderSubsystem::OnSaveGameLoaded(const FString& InSlotName, const int32 InUserIndex, USaveGame* SaveGame)
+{
+	TArray<FOnXDownloaderSaveGameLoaded> Callbacks;
+	PendingSaveGameLoads.RemoveAndCopyValue(InSlotName, Callbacks);
+	//a synchronous GetSaveGame may have loaded the slot in the meantime, keep that one
+	UXDownloaderSaveGame* XDownloaderSaveGame = FindSaveGame(InSlotName);
 	if (!XDownloaderSaveGame)
 	{
-		XDownloaderSaveGame = LoadSaveGame(InSlotName);
-		for (FXDownloadImageCached& ImageCached : XDownloaderSaveGame->ImageCaches)
+		SCOPE_CYCLE_COUNTER(STAT_XDownloaderSaveGameLoad);
+		LLM_SCOPE_BYTAG(XDownloader_SaveGame);
+		XDownloaderSaveGame = Cast<UXDownloaderSaveGame>(SaveGame);
+		if (XDownloaderSaveGame)
 		{
-			ImageCached.LoadTextureFromImageData();
-			ImageCached.Texture->AddToRoot();
+			XDownloaderSaveGame->SetSlotName(InSlotName);
+			XDownloaderSaveGame->MoveImageDataToBlobs();
+			XDownloaderSaveGames.Add(InSlotName, XDownloaderSaveGame);
+		}
+		else
+		{
+			UE_LOG(LogXDownloader, Warning, TEXT("SaveGame slot %s can not be loaded, load it again synchronously!!!"), *InSlotName);
+			XDownloaderSaveGame = GetSaveGame(InSlotName);
 		}
-		XDownloaderSaveGames.Add(XDownloaderSaveGame);
 	}
-	return XDownloaderSaveGame;
+	UE_LOG(LogXDownloader, Verbose, TEXT("SaveGame slot %s loaded, %d images"), *InSlotName, XDownloaderSaveGame ? XDownloaderSaveGame->ImageCaches.Num() : 0);
+	for (const FOnXDownloaderSaveGameLoaded& Callback : Callbacks)
+	{
+		Callback.ExecuteIfBound(XDownloaderSaveGame);
+	}
+}
+
+void UXDownloaderSubsystem::ClearFailedURLs()
+{
+	NegativeCache->Empty();
+}
+
+FString UXDownloaderSubsystem::GetNegativeCachePath()
+{
+	return FPaths::Combine(GetXDownloadSettings()->GetDownloadImageDefaultPath(), TEXT("FailedURLs.json"));
+}
+
+FXDownloadMemoryReport UXDownloaderSubsystem::GetMemoryReport(int32 TopEntryNum)
+{
+	check(IsInGameThread());
+	FXDownloadMemoryReport Report;
+	TArray<FXDownloadMemoryEntry> ImageEntries;
+	TSet<UTexture2D*> Textures;
+	//the slots are read under the lock of the batches, which read them on background threads
+	TOptional<FScopeLock> SlotsLock;
+	if (Scheduler.IsValid())
+	{
+		SlotsLock.Emplace(&Scheduler->GetLock());
+	}
+	for (const TPair<FString, UXDownloaderSaveGame*>& SaveGame : XDownloaderSaveGames)
+	{
+		int64 SlotBytes = 0;
+		for (const TPair<FString, FXDownloadImageBlob>& ImageBlob : SaveGame.Value->ImageBlobs)
+		{
+			SlotBytes += ImageBlob.Value.ImageData.Num();
+		}
+		for (const FXDownloadImageCached& ImageCached : SaveGame.Value->ImageCaches)
+		{
+			if (const TArray<uint8>* ImageData = SaveGame.Value->GetImageData(ImageCached))
+			{
+				FXDownloadMemoryEntry& ImageEntry = ImageEntries.AddDefaulted_GetRef();
+				ImageEntry.Name = FString::Printf(TEXT("%s/%s"), *SaveGame.Key, *ImageCached.ImageID);
+				ImageEntry.Bytes = ImageData->Num();
+			}
+			if (ImageCached.Texture)
+			{
+				Textures.Add(ImageCached.Texture);
+			}
+		}
+		Report.SaveGameBytes += SlotBytes;
+		FXDownloadMemoryEntry& SlotEntry = Report.Slots.AddDefaulted_GetRef();
+		SlotEntry.Name = FString::Printf(TEXT("%s, %d images, %d blobs"), *SaveGame.Key, SaveGame.Value->ImageCaches.Num(), SaveGame.Value->ImageBlobs.Num());
+		SlotEntry.Bytes = SlotBytes;
+	}
+	SlotsLock.Reset();
+	if (Scheduler.IsValid())
+	{
+		Scheduler->CollectMemoryUsage(Report, ImageEntries, Textures);
+	}
+	Report.PendingFinalizeBytes = PendingFinalizeBytes;
+	Report.FileCacheBytes = FileCache->GetPendingBytes();
+	Report.MemoryCacheBytes = MemoryCache->GetBytes();
+	Report.PrefetchBytes = Prefetcher.IsValid() ? Prefetcher->GetPendingBytes() : 0;
+	for (const TPair<FString, TWeakObjectPtr<UTexture2D>>& SharedTexture : SharedTextures)
+	{
+		if (UTexture2D* Texture = SharedTexture.Value.Get())
+		{
+			Textures.Add(Texture);
+		}
+	}
+	if (Atlas.IsValid())
+	{
+		TArray<UTexture2D*> AtlasPages;
+		Atlas->GetPages(AtlasPages);
+		Textures.Append(AtlasPages);
+	}
+	for (const TPair<FString, TWeakObjectPtr<UTexture2D>>& PlaceholderTexture : PlaceholderTextures)
+	{
+		if (UTexture2D* Texture = PlaceholderTexture.Value.Get())
+		{
+			Textures.Add(Texture);
+		}
+	}
+	for (UTexture2D* Texture : Textures)
+	{
+		FXDownloadMemoryEntry& TextureEntry = ImageEntries.AddDefaulted_GetRef();
+		TextureEntry.Name = FString::Printf(TEXT("Texture %s %dx%d"), *Texture->GetName(), Texture->GetSizeX(), Texture->GetSizeY());
+		TextureEntry.Bytes = Texture->CalcTextureMemorySizeEnum(TMC_AllMips);
+		Report.TextureBytes += TextureEntry.Bytes;
+	}
+	for (const TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe>& CachePack : GetCachePacks())
+	{
+		Report.MappedPackBytes += CachePack->GetMappedBytes();
+	}
+	ImageEntries.Sort([](const FXDownloadMemoryEntry& A, const FXDownloadMemoryEntry& B) { return A.Bytes > B.Bytes; });
+	ImageEntries.SetNum(FMath::Clamp(TopEntryNum, 0, ImageEntries.Num()));
+	Report.TopEntries = MoveTemp(ImageEntries);
+	return Report;
+}
+
+UXDownloaderSaveGame* UXDownloaderSubsystem::FindSaveGame(const FString& InSlotName) const
+{
+	UXDownloaderSaveGame* const* XDownloaderSaveGame = XDownloaderSaveGames.Find(InSlotName);
+	return XDownloaderSaveGame ? *XDownloaderSaveGame : nullptr;
+}
+
+bool UXDownloaderSubsystem::IsLoadingSaveGame(const FString& InSlotName) const
+{
+	return PendingSaveGameLoads.Contains(InSlotName);
 }
 
 UXDownloaderSettings* UXDownloaderSubsystem::GetXDownloadSettings()
@@ -74,6 +763,21 @@ UXDownloaderSettings* UXDownloaderSubsystem::GetXDownloadSettings()
 	return XDownloaderSettings;
 }
 
+void UXDownloaderSubsystem::OnPostGarbageCollect()
+{
+	if (Scheduler.IsValid())
+	{
+		Scheduler->CancelOrphanedTasks();
+	}
+	for (auto It = PlaceholderTextures.CreateIterator(); It; ++It)
+	{
+		if (!It->Value.IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
 UXDownloaderSaveGame* UXDownloaderSubsystem::FindOrLoadSaveGame(const FString& InSlotName)
 {
 	return nullptr;
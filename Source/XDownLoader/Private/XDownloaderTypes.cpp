@@ -4,8 +4,57 @@
 #include "XDownloaderTypes.h"
 
 #include "ImageUtils.h"
+#include "Hash/xxhash.h"
+#include "XDownloadImageRegistry.h"
 
-void FXDownloadImageCached::LoadTextureFromImageData()
+void FXDownloadImageCached::LoadTextureFromImageData(const TArray<uint8>& InImageData)
 {
-	Texture = FImageUtils::ImportBufferAsTexture2D(ImageData);
+	Texture = FImageUtils::ImportBufferAsTexture2D(InImageData);
+}
+
+UTexture2D* FXDownloadImageHandle::GetTexture() const
+{
+	return Ref.IsValid() && Ref->Registry.IsValid() ? Ref->Texture : nullptr;
+}
+
+FString FXDownloadImageHandle::GetImageID() const
+{
+	return Ref.IsValid() ? Ref->ImageID : FString();
+}
+
+FString FXDownloadImageCached::ComputeContentHash(const TArray<uint8>& InImageData)
+{
+	return FString::Printf(TEXT("%016llx"), FXxHash64::HashBuffer(InImageData.GetData(), InImageData.Num()).Hash);
+}
+
+int64 FXDownloadMemoryReport::GetTotalBytes() const
+{
+	return SaveGameBytes + ResultBytes + PendingFinalizeBytes + HttpBytes + FileCacheBytes + MemoryCacheBytes + PrefetchBytes + TextureBytes;
+}
+
+FString FXDownloadMemoryReport::ToString() const
+{
+	auto ToKB = [](int64 Bytes) { return Bytes / 1024.0; };
+	FString Report = FString::Printf(TEXT("XDownloader memory: %.1f KB\n"), ToKB(GetTotalBytes()));
+	Report += FString::Printf(TEXT("  SaveGame        %10.1f KB\n"), ToKB(SaveGameBytes));
+	Report += FString::Printf(TEXT("  Results         %10.1f KB\n"), ToKB(ResultBytes));
+	Report += FString::Printf(TEXT("  PendingFinalize %10.1f KB\n"), ToKB(PendingFinalizeBytes));
+	Report += FString::Printf(TEXT("  Http            %10.1f KB\n"), ToKB(HttpBytes));
+	Report += FString::Printf(TEXT("  FileCache       %10.1f KB\n"), ToKB(FileCacheBytes));
+	Report += FString::Printf(TEXT("  MemoryCache     %10.1f KB\n"), ToKB(MemoryCacheBytes));
+	Report += FString::Printf(TEXT("  Prefetch        %10.1f KB\n"), ToKB(PrefetchBytes));
+	Report += FString::Printf(TEXT("  Textures        %10.1f KB\n"), ToKB(TextureBytes));
+	Report += FString::Printf(TEXT("  Packs (mapped)  %10.1f KB\n"), ToKB(MappedPackBytes));
+	auto AppendEntries = [&Report, &ToKB](const TCHAR* Title, const TArray<FXDownloadMemoryEntry>& Entries)
+	{
+		Report += FString::Printf(TEXT("%s: %d\n"), Title, Entries.Num());
+		for (const FXDownloadMemoryEntry& Entry : Entries)
+		{
+			Report += FString::Printf(TEXT("  %10.1f KB  %s\n"), ToKB(Entry.Bytes), *Entry.Name);
+		}
+	};
+	AppendEntries(TEXT("Slots"), Slots);
+	AppendEntries(TEXT("Managers"), Managers);
+	AppendEntries(TEXT("Top entries"), TopEntries);
+	return Report;
 }
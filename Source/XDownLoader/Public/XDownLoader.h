@@ -5,6 +5,13 @@
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
 
+//verbose download logs are compiled out of shipping builds
+#if UE_BUILD_SHIPPING
+XDOWNLOADER_API DECLARE_LOG_CATEGORY_EXTERN(LogXDownloader, Warning, Warning);
+#else
+XDOWNLOADER_API DECLARE_LOG_CATEGORY_EXTERN(LogXDownloader, Log, All);
+#endif
+
 /**
  * @class FXDownLoaderModule
  * @brief A class that represents a module for downloading files.
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "XDownloaderTypes.h"
+#include "XDownloadImageLibrary.generated.h"
+
+class UImage;
+
+/**
+ * @class UXDownloadImageLibrary
+ * @brief Per-widget image loading for list and tile views, so the download and decode work follows what is on screen.
+ *
+ * Call LoadImageAsync from the entry widget when its item is set, e.g. in OnListItemObjectSet. The image is downloaded
+ * at Visible priority and set on the widget once ready, with the placeholder of the cached image shown until then.
+ * A widget that is hidden, not constructed or marked with SetImageVisible(false) drops to Offscreen priority.
+ * Loading another image into the same widget, as a recycled entry does, cancels the previous one.
+ */
+UCLASS()
+class XDOWNLOADER_API UXDownloadImageLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * @brief Loads an image into a widget.
+	 *
+	 * @param Image The widget to set the image on.
+	 * @param Task The image to load, its priority is managed by the widget.
+	 * @param bMatchSize Whether the widget takes the size of the image.
+	 * @param InSaveGameSlotName The slot the image is cached in, the default slot if empty.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	static void LoadImageAsync(UImage* Image, const FImageDownloadTask& Task, bool bMatchSize = false, const FString& InSaveGameSlotName = "");
+
+	//marks the widget as scrolled in or out of view, for containers that keep their off-screen entries
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	static void SetImageVisible(UImage* Image, bool bVisible);
+
+	//cancels the image of the widget if it is still loading, e.g. from OnEntryReleased
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	static void CancelImageLoad(UImage* Image);
+};
@@ -8,12 +8,36 @@
 #include "Kismet/BlueprintAsyncActionBase.h"
 #include "XDownloadManager.generated.h"
 
+class UXDownloaderSaveGame;
+class FXDownloadScheduler;
+class FXDownloadBodyStream;
+struct FXDownloadPartial;
+class IXDownloadCacheTier;
+struct FXDownloadCacheHit;
+struct FXDownloadCacheFreshness;
+struct FImage;
+
 // 声明下载状态改变的事件
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnDownloadStatusChanged, const FTotalDownloadResult&, DownloadResult);
 
 // 声明下载进度改变的事件
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnDownloadProgressChanged, const FTotalDownloadResult&, DownloadProgress);
 
+// 声明单个子任务完成的事件
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnSubTaskResult, const FDownloadResult&, SubTaskResult);
+
+//progressive preview progress of a downloading image
+struct FXDownloadPreviewState
+{
+	//bytes the last preview decode started from
+	int32 DecodedBytes = 0;
+
+	bool bDecoding = false;
+
+	//a baseline JPEG or non-interlaced PNG, never decoded again
+	bool bUnsupported = false;
+};
+
 /**
  * @class UXDownloadManager
  * @brief Class for managing image downloading tasks asynchronously.
@@ -65,6 +89,40 @@ public:
 	UPROPERTY(BlueprintAssignable, Category="XDownload")
 	FOnDownloadStatusChanged OnTotalDownloadFailed;
 
+	/**
+	 * @brief A delegate called once for every finished sub task, succeeded or failed.
+	 *
+	 * The broadcast result carries the running counts of the batch and only the finished sub task in SubTaskDownloadResults.
+	 * In streaming mode this and OnSubTaskResult are the only places a sub task result is delivered, it is released right after the broadcast.
+	 *
+	 * @see FOnDownloadStatusChanged
+	 */
+	UPROPERTY(BlueprintAssignable, Category="XDownload")
+	FOnDownloadStatusChanged OnSubTaskDownloaded;
+
+	/**
+	 * @brief A delegate called once for every finished sub task with only its result.
+	 *
+	 * The lightweight payload of OnSubTaskDownloaded, without the counts of the batch. Preferred in streaming mode,
+	 * where the result is released right after the broadcast.
+	 *
+	 * @see FOnSubTaskResult
+	 */
+	UPROPERTY(BlueprintAssignable, Category="XDownload")
+	FOnSubTaskResult OnSubTaskResult;
+
+	/**
+	 * @brief A delegate called with a coarse preview of an image still downloading, possibly several times as more data arrives.
+	 *
+	 * The result in SubTaskDownloadResults has the InProgress status and the preview texture, without image data.
+	 * The texture has the size of the full image and is upgraded in place once the image is finished, so a widget
+	 * showing it needs no further update. Only progressive JPEGs and interlaced PNGs are previewed, see the ProgressivePreview setting.
+	 *
+	 * @see FOnDownloadStatusChanged
+	 */
+	UPROPERTY(BlueprintAssignable, Category="XDownload")
+	FOnDownloadStatusChanged OnSubTaskPreview;
+
 
 	int32 MaxRetryTimes;
 
@@ -75,64 +133,95 @@ public:
 	 *
 	 * @param Tasks The array of image download tasks.
 	 * @param InSaveGameSlotName The name of the save game slot to save the downloaded images.
+	 * @param bStreamResults If true, each sub task result is delivered once through OnSubTaskResult and OnSubTaskDownloaded and then released,
+	 *                       the progress and total events only carry counts, failures and timings. Keeps the memory of the results flat
+	 *                       for large batches. It bounds the results only: the SaveGame cache tier still keeps every stored image in its
+	 *                       loaded slot, use the LocalFile tier alone for batches that must not grow memory.
+	 * @param WorldContextObject The owner of the batch, usually the calling widget. When it is garbage collected the batch is cancelled.
 	 *
 	 * @return An instance of UXDownloadManager that handles the image download process.
 	 */
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"), Category = "XDownload")
-	static UXDownloadManager* DownloadImages(const TArray<FImageDownloadTask>& Tasks, FString InSaveGameSlotName = "");
+	static UXDownloadManager* DownloadImages(const TArray<FImageDownloadTask>& Tasks, FString InSaveGameSlotName = "", bool bStreamResults = false, UObject* WorldContextObject = nullptr);
 
 	/**
-	 * @brief Starts the download of image tasks.
+	 * @brief Cancels one image of this batch.
 	 *
-	 * This method starts the download of a given array of image tasks.
+	 * A queued image is removed from the scheduler, an in-flight request is aborted and a pending decode is dropped.
+	 * The image is reported once with EDownloadStatus::Cancelled and counts towards FTotalDownloadResult::CancelledNum.
 	 *
-	 * @param Tasks The array of image download tasks to start.
-	 * @param MaxDownloads The maximum number of concurrent downloads (default value is 3).
+	 * @param ImageID The ID of the image to cancel.
 	 */
-	void ExecuteTask(const TArray<FImageDownloadTask>& Tasks, int32 MaxDownloads = 3);
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void CancelImage(const FString& ImageID);
 
 	/**
-	 * Invoked when a sub-task of downloading an image is finished.
+	 * @brief Cancels every unfinished image of this batch.
 	 *
-	 * @param HttpRequest - Pointer to the HTTP request object.
-	 * @param Response - Pointer to the HTTP response object.
-	 * @param bWasSuccessful - Flag indicating whether the sub-task was successful or not.
-	 * @param ImageID - The ID of the image being downloaded.
-	 * @param ImageURL - The URL of the image being downloaded.
+	 * The batch then ends with OnTotalDownloadFailed, as a cancelled batch did not deliver all of its images.
 	 */
-	void OnSubTaskFinished(TSharedPtr<IHttpRequest> HttpRequest, TSharedPtr<IHttpResponse> Response, bool bWasSuccessful, FString ImageID, FString ImageURL);
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void CancelAll();
 
 	/**
-	 * @brief Maximum number of parallel downloads allowed.
+	 * @brief Changes the priority of a queued image of this batch, e.g. when its list entry scrolls in or out of view.
 	 *
-	 * This variable represents the maximum number of download operations that can be performed in parallel when using the UXDownloadManager class.
-	 * It is a static member variable of the UXDownloadManager class.
-	 * Changes to this value will affect all instances of the UXDownloadManager class. The default value is 5.
+	 * An image already downloading, decoding or finished keeps going.
+	 *
+	 * @param ImageID The ID of the image.
+	 * @param Priority The new priority.
 	 */
-	static int32 MaxParallelDownloads;
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void SetImagePriority(const FString& ImageID, EXDownloadPriority Priority);
 
+	//whether the owner of the batch has been garbage collected
+	bool IsOrphaned() const;
 
 	/**
-	 * @brief The number of parallel downloads currently being processed.
+	 * @brief Drops the batch without broadcasting.
 	 *
-	 * This variable tracks the number of parallel downloads that are currently
-	 * being processed by the UXDownloadManager class. It is a static variable
-	 * shared among all instances of the class, and is initialized to 0.
+	 * Called when the subsystem of the game instance running the batch deinitializes. The in-flight requests are aborted.
+	 */
+	void Shutdown();
+
+	/**
+	 * @brief Adds the memory held by this batch to a report, see UXDownloaderSubsystem::GetMemoryReport.
 	 *
-	 * @note The value of this variable should only be modified via the
-	 *       UXDownloadManager class methods.
+	 * @param OutReport Receives the result and in-flight bytes and one entry for the batch.
+	 * @param OutImageEntries Receives one entry per kept sub task result.
+	 * @param OutTextures Receives the textures of the kept sub task results.
 	 */
-	static int32 CurrentParallelDownloads;
+	void CollectMemoryUsage(FXDownloadMemoryReport& OutReport, TArray<FXDownloadMemoryEntry>& OutImageEntries, TSet<UTexture2D*>& OutTextures) const;
 
 	/**
-	 * @brief A static variable representing the task queue for image download tasks.
+	 * @brief Starts the download of image tasks.
+	 *
+	 * This method starts the download of a given array of image tasks.
 	 *
-	 * The TaskQueue variable is of type TQueue<FImageDownloadTask> and is used to store and manage the image download tasks.
-	 * It is a static member of the UXDownloadManager class, which means that it is shared among all instances of the class.
-	 * The TaskQueue variable can be accessed and modified by any member function of the UXDownloadManager class.
-	 * It is recommended to use appropriate synchronization mechanisms when accessing or modifying the TaskQueue variable in a multi-threaded environment.
+	 * @param Tasks The array of image download tasks to start.
+	 * @param MaxDownloads The maximum number of concurrent downloads (default value is 3).
 	 */
-	static TQueue<FImageDownloadTask> TaskQueue;
+	void ExecuteTask(const TArray<FImageDownloadTask>& Tasks, int32 MaxDownloads = 3);
+
+	/**
+	 * @brief Called once the save game slot of this batch is loaded.
+	 *
+	 * The tasks waiting in CurrentTasks are then handed to the scheduler.
+	 *
+	 * @param InSaveGame The loaded slot.
+	 */
+	void OnSaveGameLoaded(UXDownloaderSaveGame* InSaveGame);
+
+	/**
+	 * Invoked when a sub-task of downloading an image is finished.
+	 *
+	 * @param HttpRequest - Pointer to the HTTP request object.
+	 * @param Response - Pointer to the HTTP response object.
+	 * @param bWasSuccessful - Flag indicating whether the sub-task was successful or not.
+	 * @param ImageID - The ID of the image being downloaded.
+	 * @param ImageURL - The URL of the image being downloaded.
+	 */
+	void OnSubTaskFinished(TSharedPtr<IHttpRequest> HttpRequest, TSharedPtr<IHttpResponse> Response, bool bWasSuccessful, FString ImageID, FString ImageURL);
 
 	/**
 	 * @brief The number of currently downloading tasks.
@@ -168,6 +257,30 @@ public:
 	 */
 	void ExecuteDownloadTask(const FImageDownloadTask& Task);
 
+	/**
+	 * @brief Serves a task from the cache tiers, or downloads it on a miss.
+	 *
+	 * Reads the tier at TierIndex and goes on with the next one where the read completes, on a background thread.
+	 *
+	 * @param Task The download task.
+	 * @param TierIndex The index of the tier in CacheTiers to read.
+	 */
+	void LookupCache(const FImageDownloadTask& Task, int32 TierIndex);
+
+	/**
+	 * @brief Whether a hit past its expiry is served, see UXDownloaderSettings::IsStaleWhileRevalidateEnabled.
+	 *
+	 * A served stale image is refreshed in the background by the prefetcher of the subsystem.
+	 * Without stale-while-revalidate the lookup goes on with the next tier and the download replaces the entry.
+	 */
+	bool ServeStaleHit(const FImageDownloadTask& Task, const FXDownloadCacheHit& Hit) const;
+
+	//finishes a task served by the tier at TierIndex and promotes the image into the tiers before it
+	void OnCacheHit(const FImageDownloadTask& Task, int32 TierIndex, FXDownloadCacheHit& Hit);
+
+	//creates the tiers of UXDownloaderSubsystem::GetCacheTiers, once the slot is loaded
+	void BuildCacheTiers();
+
 	/**
 	 * @brief Initializes the download task.
 	 *
@@ -192,12 +305,30 @@ public:
 
 	TArray<FImageDownloadTask> CurrentTasks;
 
+	/**
+	 * @brief Finalizes a finished sub task on the game thread.
+	 *
+	 * Called by UXDownloaderSubsystem while draining its finalization queue. Creates the texture from the
+	 * downloaded image data if needed, adds the result to the total download result and broadcasts the progress.
+	 *
+	 * @param InTaskResult The result of the sub task, its texture is filled in place.
+	 */
+	void FinalizeSubTask(FDownloadResult& InTaskResult);
+
+	/**
+	 * @brief Finalizes the whole batch on the game thread.
+	 *
+	 * Called by UXDownloaderSubsystem after all queued sub task results of this manager have been finalized.
+	 * Saves the cache, broadcasts the total succeed or failed event and destroys the task.
+	 */
+	void FinalizeAllTask();
+
 private:
 	/**
 	 * @brief Destroys the task.
 	 *
 	 * This method is responsible for destroying the task. It unbinds the callbacks for request completion and request progress, cancels the request, clears the list of download requests
-	 *, sets the reference to the game world to nullptr, removes the task from the root, and prints a log message indicating that the task has been destroyed.
+	 *, sets the reference to the game world to nullptr, releases it from its scheduler so it can be garbage collected, and prints a log message indicating that the task has been destroyed.
 	 *
 	 * Use this method to properly clean up and destroy a task.
 	 *
@@ -217,6 +348,50 @@ private:
 	 */
 	bool bStopDownload = false;
 
+	//deliver sub task results only through OnSubTaskDownloaded instead of accumulating them
+	bool bStreamResults = false;
+
+	//owner of the batch, the batch is cancelled once it is gone
+	TWeakObjectPtr<UObject> Owner;
+
+	bool bHasOwner = false;
+
+	//images cancelled while their cache lookup or decode was pending
+	TSet<FString> CancelledImageIDs;
+
+	//set once the batch end has been queued, guards against finishing twice
+	bool bAllTaskFinished = false;
+
+	//set while CancelAll reports the cancelled images
+	bool bCancellingAll = false;
+
+	//set until the save game slot is loaded, the tasks are not scheduled before
+	bool bWaitingForSaveGame = false;
+
+	//hands the tasks of CurrentTasks to the scheduler of the game instance
+	void EnqueueCurrentTasks();
+
+	/**
+	 * @brief Makes a sub task cancelled.
+	 *
+	 * Reports the image as cancelled and, if it was running, frees its parallel download slot for the next task.
+	 *
+	 * @param ImageID The ID of the cancelled image.
+	 * @param ImageURL The URL of the cancelled image.
+	 * @param bWasRunning Whether the sub task held a parallel download slot.
+	 */
+	void MakeSubTaskCancelled(const FString& ImageID, const FString& ImageURL, bool bWasRunning);
+
+	/**
+	 * @brief Aborts the in-flight request of an image without invoking its completion callback.
+	 *
+	 * @return The aborted request's image URL, or an empty string if the image has no in-flight request.
+	 */
+	FString AbortRequest(const FString& ImageID);
+
+	//time ExecuteTask was called, for FTotalDownloadResult::ElapsedSeconds
+	double StartTime = 0.0;
+
 	/**
 	 * Makes a sub task succeed.
 	 *
@@ -274,40 +449,19 @@ private:
 	void MakeSubTaskProgress(FHttpRequestPtr Request, int32 BytesSent, int32 BytesReceived, FString ImageID);
 
 	/**
-	 * @brief The GameWorld variable represents the Unreal Engine world the game is running in.
-	 *
-	 * @details The GameWorld variable is a static member of the UXDownloadManager class and it is used to store a pointer to the UWorld object.
-	 * This variable is of type UWorld*, which is a pointer to the Unreal Engine World object.
-	 *
-	 * The GameWorld variable is declared as static to allow easy access to it from different parts of the codebase, without having to pass the UWorld object as a parameter.
-	 *
-	 * The initial value of the GameWorld variable is nullptr, which means that it is not pointing to any valid UWorld object.
+	 * @brief The world the batch was started in.
 	 *
-	 * Note that being a static member, the GameWorld variable is shared among all instances of the UXDownloadManager class.
-	 * Changing its value in one instance will affect all instances.
-	 *
-	 * In order to use the GameWorld variable, you should include the "UXDownloadManager.h" header file in your code.
-	 *
-	 * Example usage:
-	 * @code
-	 * // Set the GameWorld variable to the current Unreal Engine world
-	 * UXDownloadManager::GameWorld = GetWorld();
-	 *
-	 * // Check if the GameWorld variable is pointing to a valid UWorld object
-	 * if (!IsGameWorldValid())
-	 * {
-	 *     // Do something with the GameWorld object
-	 * }
-	 * @endcode
+	 * The world of the WorldContextObject passed to DownloadImages, or the first game world without one.
+	 * Its game instance provides the subsystem and scheduler of the batch, the batch is destroyed once the world is gone.
 	 */
-	static UWorld* GameWorld;
+	TWeakObjectPtr<UWorld> GameWorld;
 
 	/**
 	 * @brief Checks if the game world is valid.
 	 *
 	 * @return true if the game world is valid, false otherwise.
 	 */
-	static bool IsGameWorldValid();
+	bool IsGameWorldValid() const;
 	/**
 	 * Retrieves the game world.
 	 *
@@ -350,13 +504,15 @@ private:
 	UPROPERTY(Transient)
 	class UXDownloaderSaveGame* DownloaderSaveGame;
 
-	ECacheType CacheType = ECacheType::CT_SaveGame;
+	//the lookup chain of the batch, fastest first
+	TArray<TSharedPtr<IXDownloadCacheTier, ESPMode::ThreadSafe>> CacheTiers;
 
 	UPROPERTY(Transient)
 	class UXDownloaderSubsystem* DownloaderSubsystem;
 
-	static TArray<UXDownloadManager*> DownloadManagers;
-	
+	//queue and parallel slots of the game instance, kept alive by the pending callbacks of the batch
+	TSharedPtr<FXDownloadScheduler, ESPMode::ThreadSafe> Scheduler;
+
 	FString SaveGameSlotName;
 
 	FString DownloadImageDefaultPath;
@@ -364,13 +520,87 @@ private:
 
 	bool ImageHasCached(FString FileName);
 
-	//download image
+	//download image, through the transport registered for the URL scheme if there is one, HTTP paced by the foreground bandwidth budget
 	void DownloadImage(const FString& ImageURL, const FString& ImageID);
 
+	//reads the partial body sidecar of an image once the bandwidth budget lets it start, then sends its HTTP request
+	void StartHttpRequest(const FString& ImageURL, const FString& ImageID);
+
+	//sends the HTTP request of an image, a Range request continuing the partial body if there is one
+	void SendHttpRequest(const FString& ImageURL, const FString& ImageID, const FXDownloadPartial* Partial);
+
+	/**
+	 * @brief Called when a transport has fetched an image, on any thread.
+	 *
+	 * @param Content The image bytes, or nullptr if the fetch failed.
+	 * @param bCacheResult Whether the image is written to the cache tiers.
+	 */
+	void OnTransportFetched(TArray<uint8>* Content, FString ImageID, FString ImageURL, bool bCacheResult);
+
+	//writes a fetched image to every writable tier of CacheTiers
+	void StoreInCache(const FString& ImageID, const FString& ImageURL, const TArray<uint8>& Content, const FXDownloadCacheFreshness& Freshness);
+
+	//retries spent per image
+	TMap<FString, int32> RetryTimesMap;
+
+	//images whose saved partial body was refused with a 416, their one retry without a Range header is not counted
+	TSet<FString> RangeRefusedImageIDs;
+
+	//bytes received so far by the in-flight requests, for the memory report and the bandwidth budget
+	TMap<FString, int32> InFlightReceivedBytes;
+
+	//preview progress of the downloading images, game thread only
+	TMap<FString, FXDownloadPreviewState> PreviewStates;
+
+	//the bodies of the previewed requests as they are read, under the scheduler lock
+	TMap<FString, TSharedRef<FXDownloadBodyStream, ESPMode::ThreadSafe>> BodyStreams;
+
+	//when each sub task left the queue, a retry keeps the first time, under the scheduler lock
+	TMap<FString, double> DispatchTimes;
+
+	//content hashes known from the cache hit of a sub task, so FinalizeSubTask does not hash the bytes again, under the scheduler lock
+	TMap<FString, FString> ContentHashes;
+
+	//the body of a finished request, from its body stream if it was previewed
+	TArray<uint8> TakeResponseBody(const FString& ImageID, const FHttpResponsePtr& Response);
+
+	//the preview textures handed out by OnSubTaskPreview, upgraded in place by FinalizeSubTask
+	UPROPERTY(Transient)
+	TMap<FString, UTexture2D*> PreviewTextures;
+
+	//starts a preview decode of the received bytes on a background thread once enough new bytes arrived
+	void UpdatePreview(const FHttpRequestPtr& Request, int32 BytesReceived, const FString& ImageID);
+
+	//the counters of the batch without the per-item results, the payload of OnSubTaskDownloaded and OnSubTaskPreview
+	//prefer OnSubTaskResult, which carries the sub task alone
+	FTotalDownloadResult MakeItemResult() const;
+
+	//creates or updates the preview texture of an image and broadcasts OnSubTaskPreview, game thread
+	void ApplyPreview(const FString& ImageID, const FString& ImageURL, FImage& PreviewImage, bool bDecoded, bool bUnsupported);
+
+	//directory of the partial bodies of interrupted downloads
+	FString GetPartialDownloadPath() const;
+
+	/**
+	 * @brief Stitches a 206 response onto the saved partial body of the image.
+	 *
+	 * @param ImageID The ID of the image.
+	 * @param Response The 206 response.
+	 * @param Body The body of the response.
+	 * @param Partial The saved partial body, nullptr if there is none.
+	 * @param OutContent The partial body followed by the response body.
+	 * @return False if the response does not continue the saved partial body, which is then deleted.
+	 */
+	bool ResumePartialDownload(const FString& ImageID, const FHttpResponsePtr& Response, const TArray<uint8>& Body, const FXDownloadPartial* Partial, TArray<uint8>& OutContent) const;
+
+	//keeps the body of an interrupted response with its validator, so the next attempt sends a Range request
+	void SavePartialDownload(const FString& ImageID, const FString& ImageURL, const FHttpResponsePtr& Response, const TArray<uint8>& Body, const FXDownloadPartial* LoadedPartial) const;
 
-	//execute next task
-	static void ExecuteNextTask();
+	//capped exponential backoff before a retry, from the RetryBackoffMs and RetryMaxBackoffMs settings
+	float GetRetryBackoffSeconds(int32 RetryTimes) const;
 
+	//the completion of a request once the partial body it continues has been read, game thread
+	void FinishHttpResponse(const FHttpRequestPtr& HttpRequest, const FHttpResponsePtr& Response, bool bWasSuccessful, const FString& ImageID, const FString& ImageURL,
+		const TArray<uint8>& Body, const FXDownloadPartial* Partial);
 
-	
 };
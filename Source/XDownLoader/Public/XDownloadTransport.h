@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * @class IXDownloadTransport
+ * @brief Fetches the bytes of an image for a URL scheme other than http and https.
+ *
+ * Transports are registered on UXDownloaderSubsystem by scheme. A cache miss whose URL has a registered scheme is
+ * fetched by the transport instead of an HTTP request, without retries, Range resume or progress events.
+ * The file and pak schemes are registered on initialization, http and https always use the HTTP module.
+ */
+class XDOWNLOADER_API IXDownloadTransport
+{
+public:
+	virtual ~IXDownloadTransport() = default;
+
+	/**
+	 * @brief Fetches an image.
+	 *
+	 * @param ImageURL The URL of the image, including the scheme.
+	 * @param OnFetched Called on any thread, possibly before Fetch returns, with the image bytes or nullptr if the fetch failed.
+	 */
+	virtual void Fetch(const FString& ImageURL, TFunction<void(TArray<uint8>*)> OnFetched) = 0;
+
+	//whether the fetched images are written to the cache tiers, false for sources that are already local
+	virtual bool ShouldCacheResults() const { return false; }
+};
+
+/**
+ * @class FXDownloadFileTransport
+ * @brief Reads file:// URLs from the local file system without blocking, e.g. file:///D:/Images/a.png or file://Saved/a.png.
+ *
+ * A relative path is relative to the project directory.
+ */
+class XDOWNLOADER_API FXDownloadFileTransport : public IXDownloadTransport
+{
+public:
+	virtual void Fetch(const FString& ImageURL, TFunction<void(TArray<uint8>*)> OnFetched) override;
+};
+
+/**
+ * @class FXDownloadPakTransport
+ * @brief Reads pak:// URLs from the mounted pak files only, never from loose files.
+ *
+ * The path is relative to the root directory, as the pak mount points are, e.g. pak://MyGame/Content/Images/a.png.
+ * Every fetch fails while no pak file is mounted, as in the editor.
+ */
+class XDOWNLOADER_API FXDownloadPakTransport : public IXDownloadTransport
+{
+public:
+	virtual void Fetch(const FString& ImageURL, TFunction<void(TArray<uint8>*)> OnFetched) override;
+};
+
+/**
+ * @class FXDownloadMemoryTransport
+ * @brief Serves images from memory, for tests and benchmarks that must not depend on sockets.
+ *
+ * Not registered by default, register it for a scheme such as "mem" and add the images by their full URL.
+ * Fetches complete right away, a URL that was not added fails. Thread-safe.
+ */
+class XDOWNLOADER_API FXDownloadMemoryTransport : public IXDownloadTransport
+{
+public:
+	/**
+	 * @param bInCacheResults Whether the served images go through the cache tiers like downloaded ones.
+	 */
+	explicit FXDownloadMemoryTransport(bool bInCacheResults = true)
+		: bCacheResults(bInCacheResults)
+	{
+	}
+
+	void AddImage(const FString& ImageURL, TArray<uint8> ImageData);
+
+	void RemoveImage(const FString& ImageURL);
+
+	//number of fetches served so far, failed ones included
+	int32 GetFetchNum() const;
+
+	virtual void Fetch(const FString& ImageURL, TFunction<void(TArray<uint8>*)> OnFetched) override;
+
+	virtual bool ShouldCacheResults() const override { return bCacheResults; }
+
+private:
+	mutable FCriticalSection ImagesLock;
+
+	TMap<FString, TArray<uint8>> Images;
+
+	int32 FetchNum = 0;
+
+	bool bCacheResults = true;
+};
@@ -21,17 +21,32 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="UXDownloaderSaveGame")
 	TArray<FXDownloadImageCached> ImageCaches;
 
+	//compressed image bytes by content hash, shared by every entry with the same bytes
+	UPROPERTY()
+	TMap<FString, FXDownloadImageBlob> ImageBlobs;
+
 	//init slot name
 	void SetSlotName(const FString& InSlotName);
 
 	/**
 	 * Adds an image cache to the save game object.
 	 *
+	 * The image data is hashed and moved into ImageBlobs, bytes already stored under another ID are not stored again.
+	 *
 	 * @param IMageInstance The image cache object to add.
 	 * @param NewSlotName (Optional) The name of the slot to save the game. If not provided, the default slot name will be used.
 	 */
 	void AddImageCache(const FXDownloadImageCached& IMageInstance, FString NewSlotName = "");
 
+	/**
+	 * Adds an image cache, or replaces the entry with the same ImageID and renews its ImageTime, ExpireTime and validators.
+	 *
+	 * @param IMageInstance The image cache object to store.
+	 * @param NewSlotName (Optional) The name of the slot to save the game.
+	 * @return True if the entry is new or its image data changed, false if only its times and validators were renewed.
+	 */
+	bool UpdateImageCache(const FXDownloadImageCached& IMageInstance, FString NewSlotName = "");
+
 	/**
 	 * Retrieves an image cache with the specified ImageID.
 	 *
@@ -48,6 +63,29 @@ public:
 	 */
 	bool HasImageCache(const FString& ImageID) const;
 
+	/**
+	 * Retrieves the compressed bytes of a cached image.
+	 *
+	 * @param ImageID The ID of the image cache.
+	 * @return The shared image data, or nullptr if the image is not cached.
+	 */
+	const TArray<uint8>* GetImageData(const FString& ImageID) const;
+
+	const TArray<uint8>* GetImageData(const FXDownloadImageCached& ImageCached) const;
+
+	//removes the cache entries of an image and their blob if no other entry shares it
+	void RemoveImageCache(const FString& ImageID);
+
+	/**
+	 * Removes the blobs no entry refers to any more.
+	 *
+	 * @return The number of bytes freed.
+	 */
+	int64 RemoveUnusedBlobs();
+
+	//moves the image data of entries saved before content hashing into ImageBlobs, called after loading
+	void MoveImageDataToBlobs();
+
 
 	/**
 	 * Release the save game object by removing all image caches.
@@ -57,6 +95,13 @@ public:
 	void ReleaseSaveGame(bool bClearImageCaches = false);
 
 	void SaveImageCacheData();
+
+	//marks the slot for the next deferred save of UXDownloaderSubsystem, the entry changes of this class mark it themselves
+	void MarkDirty() { bDirty = true; }
+
+	bool IsDirty() const { return bDirty; }
+
+	void ClearDirty() { bDirty = false; }
 	
 	FString SlotNameOverride;
 	
@@ -68,4 +113,7 @@ public:
 
 private:
 	//UXDownloaderSaveGame* XDownloaderSaveGame;
+
+	//changed since the last save, not saved itself
+	bool bDirty = false;
 };
@@ -30,6 +30,19 @@ public:
 	//获取缓存方式
 	ECacheType GetCacheType() const { return CacheType; }
 
+	/**
+	 * @brief 获取缓存查找链,按顺序查找,命中后提升到之前的各级缓存
+	 *
+	 * CacheTiers为空时由CacheType推导:内存(MemoryCacheMB大于0时)、SaveGame、本地文件、只读缓存包,本地文件命中时回填SaveGame。
+	 */
+	TArray<EXDownloadCacheTier> GetCacheTiers() const;
+
+	//获取缓存查找链是否包含该级缓存
+	bool HasCacheTier(EXDownloadCacheTier Tier) const { return GetCacheTiers().Contains(Tier); }
+
+	//获取内存缓存上限(MB)
+	int32 GetMemoryCacheMB() const { return MemoryCacheMB; }
+
 	//获取SaveGame默认缓存路径
 	FString GetSaveGameDefaultSlotName() const { return SaveGameDefaultSlotName; }
 
@@ -42,14 +55,94 @@ public:
 	//获取下载图片的最大重试次数
 	int32 GetMaxRetryTimes() const { return MaxRetryTimes; }
 
+	//获取第一次重试前的退避时间(毫秒)
+	int32 GetRetryBackoffMs() const { return RetryBackoffMs; }
+
+	//获取重试退避时间的上限(毫秒)
+	int32 GetRetryMaxBackoffMs() const { return RetryMaxBackoffMs; }
+
 	//获取下载图片的超时时间
 	int32 GetDownloadTimeout() const { return DownloadTimeoutSecond; }
 
+	//获取每帧纹理创建的时间预算(毫秒)
+	float GetFinalizationBudgetMs() const { return FinalizationBudgetMs; }
+
+	//获取只读缓存包目录
+	FString GetCachePackDirectory() const { return CachePackDirectory.Path; }
+
+	//获取空闲预取的最大带宽(KB/s)
+	int32 GetPrefetchBandwidthKBps() const { return PrefetchBandwidthKBps; }
+
+	//获取前台下载的最大带宽(KB/s)
+	int32 GetForegroundBandwidthKBps() const { return ForegroundBandwidthKBps; }
+
+	//获取空闲预取每帧的时间预算(毫秒)
+	float GetPrefetchFrameBudgetMs() const { return PrefetchFrameBudgetMs; }
+
+	//获取空闲预取的最大并发数
+	int32 GetPrefetchParallelDownloads() const { return PrefetchParallelDownloads; }
+
+	//获取本地文件缓存写队列的内存上限(MB)
+	int32 GetFileCacheMaxPendingMB() const { return FileCacheMaxPendingMB; }
+
+	//获取本地文件缓存写队列的刷新阈值(KB)
+	int32 GetFileCacheFlushThresholdKB() const { return FileCacheFlushThresholdKB; }
+
+	//获取本地文件缓存写队列的刷新间隔(毫秒)
+	float GetFileCacheFlushIntervalMs() const { return FileCacheFlushIntervalMs; }
+
+	//获取某个HTTP状态码的失败缓存时长(秒),0为不缓存,连接错误不缓存
+	int32 GetNegativeCacheTTL(int32 StatusCode) const;
+
+	//获取失败缓存的最大条目数
+	int32 GetNegativeCacheMaxEntries() const { return NegativeCacheMaxEntries; }
+
+	//获取没有Cache-Control/Expires时缓存的有效期(秒),0为永不过期
+	int32 GetDefaultCacheTTL() const { return DefaultCacheTTL; }
+
+	//获取是否按响应的Cache-Control/Expires计算缓存有效期
+	bool IsCacheControlEnabled() const { return bUseCacheControl; }
+
+	//获取是否先返回过期缓存再在后台刷新
+	bool IsStaleWhileRevalidateEnabled() const { return bStaleWhileRevalidate; }
+
+	//获取同一图片两次后台刷新的最小间隔(秒)
+	int32 GetRefreshMinIntervalSeconds() const { return RefreshMinIntervalSeconds; }
+
+	//获取启动预热解码的最大图片数
+	int32 GetWarmupImageNum() const { return WarmupImageNum; }
+
+	//获取启动预热解码后像素的最大内存(MB)
+	int32 GetWarmupBudgetMB() const { return WarmupBudgetMB; }
+
+	//获取是否在下载中解码渐进预览
+	bool IsProgressivePreviewEnabled() const { return bProgressivePreview; }
+
+	//获取两次预览解码之间最少新收到的字节数(KB)
+	int32 GetPreviewStepKB() const { return PreviewStepKB; }
+
+	//获取是否将小图打包进缩略图图集
+	bool IsThumbnailAtlasEnabled() const { return bThumbnailAtlas; }
+
+	//获取图集页尺寸
+	int32 GetAtlasPageSize() const { return AtlasPageSize; }
+
+	//获取打包进图集的图片最大边长
+	int32 GetAtlasMaxImageSize() const { return AtlasMaxImageSize; }
+
 private:
 	//缓存方式
 	UPROPERTY(Config, EditAnywhere, Category = "XDownloader", meta=(AllowPrivateAccess=true))
 	TEnumAsByte<enum ECacheType> CacheType = ECacheType::CT_SaveGame;
 
+	//缓存查找链,按顺序查找并将命中提升到之前的各级缓存,为空时由CacheType推导
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader", meta=(AllowPrivateAccess=true))
+	TArray<EXDownloadCacheTier> CacheTiers;
+
+	//内存缓存上限(MB),按最近最少使用淘汰,0为关闭内存缓存;默认关闭,与未引入内存缓存时的内存占用一致
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader", meta=(AllowPrivateAccess=true, ClampMin=0, ClampMax=1024))
+	int32 MemoryCacheMB = 0;
+
 	//SaveGame默认缓存路径
 	UPROPERTY(Config, EditAnywhere, Category = "XDownloader", meta=(AllowPrivateAccess=true, EditCondition="CacheType==ECacheType::CT_SaveGame||CacheType==ECacheType::CT_BothSaveGameAndFile", EditConditionHides))
 	FString SaveGameDefaultSlotName;
@@ -66,7 +159,107 @@ private:
 	UPROPERTY(Config, EditAnywhere, Category = "XDownloader", meta=(AllowPrivateAccess=true, ClampMin=1, ClampMax=5))
 	int32 MaxRetryTimes = 3;
 
+	//第一次重试前的退避时间(毫秒),之后每次重试翻倍,0为立即重试
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader", meta=(AllowPrivateAccess=true, ClampMin=0, ClampMax=10000))
+	int32 RetryBackoffMs = 500;
+
+	//重试退避时间的上限(毫秒)
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader", meta=(AllowPrivateAccess=true, ClampMin=0, ClampMax=60000))
+	int32 RetryMaxBackoffMs = 8000;
+
 	//下载图片的超时时间
 	UPROPERTY(Config, EditAnywhere, Category = "XDownloader", meta=(AllowPrivateAccess=true, ClampMin=10, ClampMax=300))
 	int32 DownloadTimeoutSecond = 10;
+
+	//每帧纹理创建的时间预算(毫秒),超出的下载结果顺延到下一帧处理
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader", meta=(AllowPrivateAccess=true, ClampMin=0.1, ClampMax=33.0))
+	float FinalizationBudgetMs = 2.0f;
+
+	//只读缓存包(*.xdpack)目录,启动时挂载为最低一级缓存,打包时需加入Additional Non-Asset Directories to Package
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader", meta=(AllowPrivateAccess=true))
+	FDirectoryPath CachePackDirectory;
+
+	//前台下载的最大带宽(KB/s),0为不限制,按令牌桶控制请求的发起,运行时可通过UXDownloaderSubsystem::SetBandwidthLimit调整
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Bandwidth", meta=(AllowPrivateAccess=true, ClampMin=0))
+	int32 ForegroundBandwidthKBps = 0;
+
+	//空闲预取的最大带宽(KB/s),0为不限制
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Prefetch", meta=(AllowPrivateAccess=true, ClampMin=0))
+	int32 PrefetchBandwidthKBps = 512;
+
+	//空闲预取每帧的时间预算(毫秒),用于发起请求和写入缓存
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Prefetch", meta=(AllowPrivateAccess=true, ClampMin=0.05, ClampMax=10.0))
+	float PrefetchFrameBudgetMs = 0.5f;
+
+	//空闲预取的最大并发数
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Prefetch", meta=(AllowPrivateAccess=true, ClampMin=1, ClampMax=4))
+	int32 PrefetchParallelDownloads = 1;
+
+	//本地文件缓存写队列的内存上限(MB),超出时后台写入方同步写盘,游戏线程丢弃本次写入
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|FileCache", meta=(AllowPrivateAccess=true, ClampMin=1, ClampMax=1024))
+	int32 FileCacheMaxPendingMB = 32;
+
+	//本地文件缓存写队列积累到该大小(KB)时立即刷新
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|FileCache", meta=(AllowPrivateAccess=true, ClampMin=0))
+	int32 FileCacheFlushThresholdKB = 1024;
+
+	//本地文件缓存写队列最早一次写入等待该时长(毫秒)后刷新
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|FileCache", meta=(AllowPrivateAccess=true, ClampMin=0))
+	float FileCacheFlushIntervalMs = 500.f;
+
+	//按HTTP状态码配置的失败缓存时长(秒),期间再次请求该URL直接失败,不再发起连接
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|NegativeCache", meta=(AllowPrivateAccess=true))
+	TMap<int32, int32> NegativeCacheTTLs = {{403, 600}, {404, 3600}, {410, 86400}};
+
+	//其余4xx/5xx状态码的失败缓存时长(秒),0为不缓存
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|NegativeCache", meta=(AllowPrivateAccess=true, ClampMin=0))
+	int32 NegativeCacheDefaultTTL = 60;
+
+	//失败缓存的最大条目数,超出时淘汰最先过期的条目,0为关闭失败缓存
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|NegativeCache", meta=(AllowPrivateAccess=true, ClampMin=0))
+	int32 NegativeCacheMaxEntries = 1024;
+
+	//没有Cache-Control/Expires的缓存有效期(秒),超过后视为过期,0为永不过期
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Expiry", meta=(AllowPrivateAccess=true, ClampMin=0))
+	int32 DefaultCacheTTL = 0;
+
+	//按响应的Cache-Control的max-age/no-cache或Expires计算缓存有效期
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Expiry", meta=(AllowPrivateAccess=true))
+	bool bUseCacheControl = true;
+
+	//过期缓存照常返回,同时在后台以低优先级重新下载,内容变化时刷新已绑定的图片;关闭时过期缓存按未命中重新下载
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Expiry", meta=(AllowPrivateAccess=true))
+	bool bStaleWhileRevalidate = true;
+
+	//同一图片两次后台刷新的最小间隔(秒),避免no-cache/max-age=0的图片每次命中都重新请求;刷新带If-None-Match/If-Modified-Since,304时只续期缓存
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Expiry", meta=(AllowPrivateAccess=true, ClampMin=0))
+	int32 RefreshMinIntervalSeconds = 60;
+
+	//启动时在后台多线程并行解码默认存档槽中最近使用和最常使用的图片数,游戏线程只创建纹理,0为关闭预热
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Warmup", meta=(AllowPrivateAccess=true, ClampMin=0))
+	int32 WarmupImageNum = 64;
+
+	//启动预热解码后像素的最大内存(MB),超出预算的图片留到首次命中时解码
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Warmup", meta=(AllowPrivateAccess=true, ClampMin=1))
+	int32 WarmupBudgetMB = 64;
+
+	//下载中为渐进式JPEG和隔行PNG解码低清预览,通过OnSubTaskPreview发出,完成后原纹理就地升级为完整图片
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Preview", meta=(AllowPrivateAccess=true))
+	bool bProgressivePreview = true;
+
+	//两次预览解码之间最少新收到的数据量(KB)
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Preview", meta=(AllowPrivateAccess=true, ClampMin=1, EditCondition="bProgressivePreview"))
+	int32 PreviewStepKB = 16;
+
+	//将小图打包进共享的图集页,下载结果返回AtlasRegion而不是独立纹理,不再显示时需调用ReleaseAtlasRegion
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Atlas", meta=(AllowPrivateAccess=true))
+	bool bThumbnailAtlas = false;
+
+	//图集页尺寸
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Atlas", meta=(AllowPrivateAccess=true, ClampMin=256, ClampMax=4096, EditCondition="bThumbnailAtlas"))
+	int32 AtlasPageSize = 2048;
+
+	//宽高都不超过该值的图片才打包进图集
+	UPROPERTY(Config, EditAnywhere, Category = "XDownloader|Atlas", meta=(AllowPrivateAccess=true, ClampMin=16, ClampMax=1024, EditCondition="bThumbnailAtlas"))
+	int32 AtlasMaxImageSize = 256;
 };
@@ -5,10 +5,49 @@
 #include "CoreMinimal.h"
 #include "XDownloaderTypes.h"
 #include "XDownloaderSaveGame.h"
+#include "Async/Future.h"
+#include "Containers/Queue.h"
+#include "Tickable.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "XDownloaderSubsystem.generated.h"
 
 class UXDownloaderSettings;
+class UXDownloadManager;
+class FXDownloadPrefetcher;
+class FXDownloadCachePack;
+class FXDownloadFileCache;
+class FXDownloadMemoryCache;
+class FXDownloadNegativeCache;
+class FXDownloadScheduler;
+class FXDownloadWarmup;
+class FXDownloadAtlas;
+class FXDownloadImageRegistry;
+class FXDownloadImageBinder;
+class IXDownloadTransport;
+struct FXDownloadCacheFreshness;
+
+//called on the game thread once a save game slot is ready
+DECLARE_DELEGATE_OneParam(FOnXDownloaderSaveGameLoaded, UXDownloaderSaveGame*);
+
+// 声明过期图片刷新后内容变化的事件
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnXDownloadImageRefreshed, const FString&, ImageID);
+
+/**
+ * @struct FXDownloadFinalizeItem
+ * @brief A finished sub task waiting for game thread finalization.
+ *
+ * Finalization creates the texture of the result and broadcasts the progress of the owning manager.
+ * An item with bAllTaskFinished set marks the end of the manager's batch.
+ */
+struct FXDownloadFinalizeItem
+{
+	TWeakObjectPtr<UXDownloadManager> DownloadManager;
+
+	FDownloadResult Result;
+
+	bool bAllTaskFinished = false;
+};
+
 /**
  * @class UXDownloaderSubsystem
  * @brief A class representing the downloader subsystem of the XDownloader API in Unreal Engine.
@@ -18,11 +57,12 @@ class UXDownloaderSettings;
  *
  * Usage:
  * - Initialize the subsystem by calling the Initialize() function.
- * - Load and get the saved game with LoadSaveGame() and GetSaveGame() functions respectively.
+ * - Load and get the saved game with LoadSaveGame() and GetSaveGame() functions respectively,
+ *   or without blocking the game thread with LoadSaveGameAsync().
  * - Save the current game state with the SaveSaveGame() function.
  */
 UCLASS()
-class XDOWNLOADER_API UXDownloaderSubsystem : public UGameInstanceSubsystem
+class XDOWNLOADER_API UXDownloaderSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
 {
 	GENERATED_BODY()
 
@@ -30,7 +70,278 @@ protected:
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void Deinitialize() override;
 
-private:
+public:
+	//FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickableWhenPaused() const override { return true; }
+	virtual TStatId GetStatId() const override;
+
+	/**
+	 * @brief Queues a finished sub task for finalization on the game thread.
+	 *
+	 * Can be called from any thread. The queue is drained in Tick within the FinalizationBudgetMs setting,
+	 * so a large batch landing at once is spread over several frames.
+	 *
+	 * @param InDownloadManager The manager owning the sub task.
+	 * @param InTaskResult The result of the sub task.
+	 */
+	void EnqueueFinalization(UXDownloadManager* InDownloadManager, const FDownloadResult& InTaskResult);
+
+	/**
+	 * @brief Queues the end of a manager's batch behind its pending sub task results.
+	 *
+	 * @param InDownloadManager The manager whose tasks have all finished.
+	 */
+	void EnqueueAllTaskFinished(UXDownloadManager* InDownloadManager);
+
+	/**
+	 * @brief Prefetches images into the cache while no foreground download is running.
+	 *
+	 * The images are downloaded at the lowest priority within the prefetch bandwidth and frame budgets of the settings,
+	 * and cached as compressed bytes only. A later DownloadImages call for them is served from the cache.
+	 *
+	 * @param Tasks The images the next screens will need.
+	 * @param InSaveGameSlotName The slot the images are cached in, the default slot if empty.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void PrefetchImages(const TArray<FImageDownloadTask>& Tasks, const FString& InSaveGameSlotName = "");
+
+	/**
+	 * @brief Prefetches the images listed in a manifest file, see PrefetchImages.
+	 *
+	 * @param ManifestPath A JSON array of {"ImageID", "ImageURL"} objects, or an object holding that array as "Images".
+	 * @param InSaveGameSlotName The slot the images are cached in, the default slot if empty.
+	 * @return False if the manifest cannot be read.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	bool PrefetchManifest(const FString& ManifestPath, const FString& InSaveGameSlotName = "");
+
+	//drops the pending prefetches
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void CancelPrefetch();
+
+	//number of images still waiting to be prefetched
+	UFUNCTION(BlueprintPure, Category = "XDownload")
+	int32 GetPendingPrefetchNum() const;
+
+	//whether a foreground batch is queued, downloading or waiting for finalization
+	bool HasForegroundWork() const;
+
+	/**
+	 * @brief Fires on the game thread when a stale image served from the cache was downloaded again with other bytes.
+	 *
+	 * The cache tiers already hold the new bytes, a new DownloadImages call for the ID gets them.
+	 * Widgets bound through UXDownloadImageLibrary reload the image by themselves.
+	 */
+	UPROPERTY(BlueprintAssignable, Category="XDownload")
+	FOnXDownloadImageRefreshed OnImageRefreshed;
+
+	/**
+	 * @brief Downloads a stale cached image again in the background, at the priority of the prefetches.
+	 *
+	 * Called by the batches serving a stale image while the bStaleWhileRevalidate setting is on. Game thread only.
+	 *
+	 * @param Task The image.
+	 * @param InSaveGameSlotName The slot the image is cached in, the default slot if empty.
+	 * @param StaleContentHash The content hash of the served bytes, OnImageRefreshed fires if the new bytes differ.
+	 * @param StaleFreshness The freshness of the served bytes, their validators make the request conditional.
+	 */
+	void RefreshImage(const FImageDownloadTask& Task, const FString& InSaveGameSlotName, const FString& StaleContentHash, const FXDownloadCacheFreshness& StaleFreshness);
+
+	//reloads the bound widgets showing a refreshed image and broadcasts OnImageRefreshed
+	void NotifyImageRefreshed(const FString& ImageID);
+
+	/**
+	 * @brief Sets how many images of this game instance download at once.
+	 *
+	 * Each game instance runs its batches on its own queue and parallel slots, starting from the MaxParallelDownloads setting.
+	 * A raised limit starts queued images right away, a lowered one takes effect as the running ones finish.
+	 *
+	 * @param InMaxParallelDownloads The new limit, at least 1.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void SetMaxParallelDownloads(int32 InMaxParallelDownloads);
+
+	UFUNCTION(BlueprintPure, Category = "XDownload")
+	int32 GetMaxParallelDownloads() const;
+
+	/**
+	 * @brief Changes the bandwidth budget of a traffic class at runtime, e.g. lowered for the duration of a match.
+	 *
+	 * The budget is shared by every game instance of the process. HTTP requests start only while their budget has
+	 * tokens left, the bodies being read are taken from it, so a lowered budget slows the next requests down.
+	 *
+	 * @param TrafficClass Foreground batches or prefetches.
+	 * @param LimitKBps The budget in KB per second, 0 for unlimited.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void SetBandwidthLimit(EXDownloadTrafficClass TrafficClass, int32 LimitKBps);
+
+	//the current budget of a traffic class in KB per second, 0 for unlimited
+	UFUNCTION(BlueprintPure, Category = "XDownload")
+	int32 GetBandwidthLimit(EXDownloadTrafficClass TrafficClass) const;
+
+	//restores the ForegroundBandwidthKBps and PrefetchBandwidthKBps settings
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void ResetBandwidthLimits();
+
+	/**
+	 * @brief Overrides the cache tier chain of this game instance, e.g. per scenario of the benchmark.
+	 *
+	 * The batches and prefetches started afterwards use the override, the running ones keep their tiers.
+	 *
+	 * @param InCacheTiers The tiers in lookup order, empty to restore the CacheTiers setting.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void SetCacheTiers(const TArray<EXDownloadCacheTier>& InCacheTiers);
+
+	//the override of SetCacheTiers, otherwise UXDownloaderSettings::GetCacheTiers
+	TArray<EXDownloadCacheTier> GetCacheTiers();
+
+	bool HasCacheTier(EXDownloadCacheTier Tier) { return GetCacheTiers().Contains(Tier); }
+
+	//the queue and parallel slots of this game instance, null once deinitialized
+	TSharedPtr<FXDownloadScheduler, ESPMode::ThreadSafe> GetScheduler() const { return Scheduler; }
+
+	/**
+	 * @brief Mounts a read-only cache pack as the lowest cache tier, below the SaveGame and local file caches.
+	 *
+	 * The packs of the CachePackDirectory setting are mounted on initialization, this mounts additional ones such as DLC packs.
+	 *
+	 * @param PackPath The path of the .xdpack file.
+	 * @return False if the file is missing or not a cache pack.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	bool MountCachePack(const FString& PackPath);
+
+	/**
+	 * @brief Reads an image from the mounted cache packs. Thread-safe.
+	 *
+	 * @param ImageID The ID of the image.
+	 * @param OutImageData The compressed bytes of the image.
+	 * @return False if no mounted pack holds the image.
+	 */
+	bool ReadFromCachePacks(const FString& ImageID, TArray<uint8>& OutImageData) const;
+
+	//the mounted packs at the time of the call, searched outside the lock. Thread-safe
+	TArray<TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe>> GetCachePacks() const;
+
+	bool IsInCachePacks(const FString& ImageID) const;
+
+	/**
+	 * @brief Fetches the images whose URL has the given scheme through a transport instead of HTTP.
+	 *
+	 * "file" and "pak" are registered on initialization, registering a scheme again replaces its transport.
+	 * http and https always use the HTTP module. Thread-safe.
+	 *
+	 * @param Scheme The URL scheme without "://", case-insensitive.
+	 * @param Transport The transport, or nullptr to unregister the scheme.
+	 */
+	void RegisterTransport(const FString& Scheme, const TSharedPtr<IXDownloadTransport, ESPMode::ThreadSafe>& Transport);
+
+	//the transport registered for the scheme of the URL, nullptr for HTTP. Thread-safe.
+	TSharedPtr<IXDownloadTransport, ESPMode::ThreadSafe> FindTransport(const FString& ImageURL) const;
+
+	//the asynchronous I/O stage of the local file tier
+	FXDownloadFileCache& GetFileCache() const { return *FileCache; }
+
+	//the recently failed URLs, failed again without a connection until they expire. Thread-safe.
+	FXDownloadNegativeCache& GetNegativeCache() const { return *NegativeCache; }
+
+	//forgets the recently failed URLs, so the next batch downloads them again
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void ClearFailedURLs();
+
+	//the memory tier shared by the batches of the game instance
+	TSharedRef<FXDownloadMemoryCache, ESPMode::ThreadSafe> GetMemoryCache() const { return MemoryCache.ToSharedRef(); }
+
+	/**
+	 * @brief Finds the texture already decoded from the same image bytes, under any image ID or slot.
+	 *
+	 * Game thread only. A hit is counted as a deduplicated decode.
+	 *
+	 * @param ContentHash The content hash of the image bytes, see FXDownloadImageCached::ComputeContentHash.
+	 * @return The shared texture, or nullptr if these bytes have not been decoded or the texture was collected.
+	 */
+	UTexture2D* FindSharedTexture(const FString& ContentHash) const;
+
+	//registers a decoded texture for FindSharedTexture, game thread only
+	void AddSharedTexture(const FString& ContentHash, UTexture2D* Texture);
+
+	/**
+	 * @brief Hands out a reference-counted handle to a downloaded texture, see FXDownloadImageHandle.
+	 *
+	 * Game thread only. When the last handle of the texture is dropped, the cache entries of the loaded slots
+	 * stop referencing it, so it is collected unless something else holds it.
+	 *
+	 * @param Texture The texture of the image.
+	 * @param ImageID The ID the image was requested with.
+	 * @return The handle, invalid for a null texture.
+	 */
+	FXDownloadImageHandle AcquireImageHandle(UTexture2D* Texture, const FString& ImageID);
+
+	//the texture of a handle, null if it is invalid
+	UFUNCTION(BlueprintPure, Category = "XDownload")
+	static UTexture2D* GetHandleTexture(const FXDownloadImageHandle& Handle) { return Handle.GetTexture(); }
+
+	//drops a handle, the texture may be collected once no handle to it is left
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	static void ReleaseImageHandle(UPARAM(ref) FXDownloadImageHandle& Handle) { Handle.Reset(); }
+
+	//the per-widget image loading of UXDownloadImageLibrary, null once deinitialized
+	FXDownloadImageBinder* GetImageBinder() const { return ImageBinder.Get(); }
+
+	//the thumbnail atlas, created on first use, game thread only
+	FXDownloadAtlas& GetAtlas();
+
+	/**
+	 * @brief Drops a reference to an image of the thumbnail atlas, its space is reused once every result holding it is released.
+	 *
+	 * Call it once per result with a valid AtlasRegion when the image is no longer shown. Game thread only.
+	 *
+	 * @param Region The region of the result, reset by the call.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	void ReleaseAtlasRegion(UPARAM(ref) FXDownloadAtlasRegion& Region);
+
+	/**
+	 * @brief Creates a blurred stand-in for a cached image from the placeholder hash of its cache entry.
+	 *
+	 * Needs neither I/O nor a full decode, so a list can draw it in the frame it shows an image whose texture is not resident.
+	 * The hash is computed on the first decode of the image and saved with its entry in the slot. Game thread only.
+	 *
+	 * @param ImageID The ID of the cached image.
+	 * @param InSaveGameSlotName The slot of the image, the default slot if empty. The slot is never loaded by this call.
+	 * @return A 32x32 texture to draw stretched, shared by the images with the same hash, or nullptr if the image has no placeholder.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	UTexture2D* GetPlaceholderTexture(const FString& ImageID, const FString& InSaveGameSlotName = "");
+
+	/**
+	 * @brief Decodes the placeholder of a cached image into a grid of colours, see GetPlaceholderTexture.
+	 *
+	 * @param ImageID The ID of the cached image.
+	 * @param GridWidth The number of columns.
+	 * @param GridHeight The number of rows.
+	 * @param OutColors The GridWidth * GridHeight colours, row by row.
+	 * @param InSaveGameSlotName The slot of the image, the default slot if empty.
+	 * @return False if the image has no placeholder.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	bool GetPlaceholderColors(const FString& ImageID, int32 GridWidth, int32 GridHeight, TArray<FLinearColor>& OutColors, const FString& InSaveGameSlotName = "");
+
+	/**
+	 * @brief Reports the memory the downloader holds, per category, per loaded slot and per running batch.
+	 *
+	 * The same data is logged by the "XDownloader.MemReport [TopN=10]" console command.
+	 * Allocations are also tagged for the Low-Level Memory Tracker under XDownloader.
+	 *
+	 * @param TopEntryNum The number of largest images and textures to list.
+	 * @return The report.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "XDownload")
+	FXDownloadMemoryReport GetMemoryReport(int32 TopEntryNum = 10);
 
 public:
 	static UXDownloaderSaveGame* LoadSaveGame(const FString& InSlotName);
@@ -39,12 +350,30 @@ public:
 	 * @brief Retrieves the save game data.
 	 *
 	 * This method retrieves the save game data from the UXDownloaderSubsystem.
-	 * If the save game data is not loaded yet, it loads the save game data and initializes the image caches.
+	 * If the save game data is not loaded yet, it is loaded synchronously. Prefer LoadSaveGameAsync on the game thread.
+	 * Textures of the cached images are created on their first hit, not on load.
 	 *
 	 * @return A pointer to the UXDownloaderSaveGame object containing the save game data.
 	 */
 	UXDownloaderSaveGame* GetSaveGame(const FString& InSlotName="");
 
+	/**
+	 * @brief Loads a save game slot without blocking the game thread.
+	 *
+	 * The slot is read with UGameplayStatics::AsyncLoadGameFromSlot, concurrent requests for the same slot share one load.
+	 * OnLoaded runs right away if the slot is already loaded or does not exist yet, and on a later frame otherwise.
+	 *
+	 * @param InSlotName The name of the slot.
+	 * @param OnLoaded Called on the game thread with the slot.
+	 */
+	void LoadSaveGameAsync(const FString& InSlotName, const FOnXDownloaderSaveGameLoaded& OnLoaded);
+
+	//the slot if it is loaded, never loads it
+	UXDownloaderSaveGame* FindSaveGame(const FString& InSlotName) const;
+
+	//whether an asynchronous load of the slot is in flight
+	bool IsLoadingSaveGame(const FString& InSlotName) const;
+
 	/**
 	 * @brief Retrieves the XDownload settings.
 	 *
@@ -56,12 +385,19 @@ public:
 	UXDownloaderSettings* GetXDownloadSettings();
 
 private:
+	//FailedURLs.json next to the local file cache
+	FString GetNegativeCachePath();
+
 	/**
-	 * @struct FXDownloadImageCached
-	 * This struct represents the cached data for a downloaded image.
+	 * @brief The loaded save game slots, by slot name.
 	 */
 	UPROPERTY(BlueprintReadOnly, Category="XDownloader", meta=(AllowPrivateAccess=true))
-	TArray<USaveGame*> XDownloaderSaveGames;
+	TMap<FString, UXDownloaderSaveGame*> XDownloaderSaveGames;
+
+	//callbacks waiting for an asynchronous slot load, by slot name
+	TMap<FString, TArray<FOnXDownloaderSaveGameLoaded>> PendingSaveGameLoads;
+
+	void OnSaveGameLoaded(const FString& InSlotName, const int32 InUserIndex, USaveGame* SaveGame);
 
 	/**
 	 * @class XDownloaderSettings
@@ -72,5 +408,87 @@ private:
 	UPROPERTY(BlueprintReadOnly, Category="XDownloader", meta=(AllowPrivateAccess=true))
 	UXDownloaderSettings* XDownloaderSettings;
 
+	//set by SetCacheTiers, empty for the CacheTiers setting
+	TArray<EXDownloadCacheTier> CacheTiersOverride;
+
 	UXDownloaderSaveGame* FindOrLoadSaveGame(const FString& InSlotName);
+
+	/**
+	 * @brief Saves the loaded slots changed since their last save, at most once per interval.
+	 *
+	 * A slot is written by one save at a time, a slot changed while it is written is saved by a later call.
+	 *
+	 * @param bWait Saves right away and waits until every slot is written, on deinitialization.
+	 */
+	void SaveDirtySaveGames(bool bWait);
+
+	//the slot writes in flight, by slot name
+	TMap<FString, TFuture<bool>> SaveGameWrites;
+
+	double NextSaveGameSaveTime = 0.0;
+
+	//drains the finalization queue within the frame budget
+	void TickFinalization();
+
+	//cancels the batches of this game instance whose owner was collected
+	void OnPostGarbageCollect();
+
+	FDelegateHandle PostGarbageCollectHandle;
+
+	//finished sub tasks waiting for texture creation and progress broadcast
+	TQueue<FXDownloadFinalizeItem, EQueueMode::Mpsc> FinalizeQueue;
+
+	int32 PendingFinalizeNum = 0;
+
+	//image bytes of the queued results
+	int64 PendingFinalizeBytes = 0;
+
+	//decoded textures by content hash, kept alive by the cache entries and results referencing them
+	TMap<FString, TWeakObjectPtr<UTexture2D>> SharedTextures;
+
+	//the placeholder hash of a cached image in a loaded slot, empty if it has none
+	FString FindPlaceholderHash(const FString& ImageID, const FString& InSaveGameSlotName);
+
+	//drops the cache references to a texture whose last handle is gone
+	void OnImageReleased(UTexture2D* Texture);
+
+	//keeps the textures with live handles alive for the garbage collector
+	TSharedPtr<FXDownloadImageRegistry, ESPMode::ThreadSafe> ImageRegistry;
+
+	//images bound to widgets, ticked before the finalization queue
+	TSharedPtr<FXDownloadImageBinder> ImageBinder;
+
+	//small images packed into shared pages while the bThumbnailAtlas setting is on
+	TSharedPtr<FXDownloadAtlas> Atlas;
+
+	//placeholder textures by placeholder hash, kept alive by the widgets drawing them, collected ones are dropped after GC
+	TMap<FString, TWeakObjectPtr<UTexture2D>> PlaceholderTextures;
+
+	//read-only cache packs, first mounted first searched, read by the lookups on background threads
+	TArray<TSharedPtr<FXDownloadCachePack, ESPMode::ThreadSafe>> CachePacks;
+
+	mutable FCriticalSection CachePacksLock;
+
+	//idle time prefetch, ticked after the finalization queue
+	TSharedPtr<FXDownloadPrefetcher> Prefetcher;
+
+	//decodes the most used images of the default slot at startup, ticked after the finalization queue
+	TSharedPtr<FXDownloadWarmup, ESPMode::ThreadSafe> Warmup;
+
+	//asynchronous reads and write-behind of the local file tier, flushed on deinitialization
+	TSharedPtr<FXDownloadFileCache, ESPMode::ThreadSafe> FileCache;
+
+	//loaded on initialization and saved on deinitialization
+	TSharedPtr<FXDownloadNegativeCache, ESPMode::ThreadSafe> NegativeCache;
+
+	//encoded images of this session, the fastest cache tier
+	TSharedPtr<FXDownloadMemoryCache, ESPMode::ThreadSafe> MemoryCache;
+
+	//transports by lower case URL scheme
+	TMap<FString, TSharedPtr<IXDownloadTransport, ESPMode::ThreadSafe>> Transports;
+
+	mutable FCriticalSection TransportsLock;
+
+	//runs the batches of this game instance, its batches are dropped on deinitialization
+	TSharedPtr<FXDownloadScheduler, ESPMode::ThreadSafe> Scheduler;
 };
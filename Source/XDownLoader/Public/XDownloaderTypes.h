@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
+#include "Styling/SlateBrush.h"
 #include "XDownloaderTypes.generated.h"
 
 
@@ -22,6 +23,53 @@ enum class ECacheType : uint8
 	CT_BothSaveGameAndFile UMETA(DisplayName = "Both")
 };
 
+/**
+ * @enum EXDownloadCacheTier
+ * @brief One level of the cache lookup chain, see UXDownloaderSettings::GetCacheTiers.
+ *
+ * The tiers are looked up in the configured order, a hit is promoted into the tiers before it.
+ */
+UENUM(BlueprintType)
+enum class EXDownloadCacheTier : uint8
+{
+	//encoded images of this session, bounded by MemoryCacheMB
+	Memory UMETA(DisplayName = "Memory"),
+	LocalFile UMETA(DisplayName = "LocalFile"),
+	SaveGame UMETA(DisplayName = "SaveGame"),
+	//read-only packs shipped with the build
+	Pack UMETA(DisplayName = "Pack"),
+	Num UMETA(Hidden)
+};
+
+/**
+ * @enum EXDownloadTrafficClass
+ * @brief The bandwidth budget an HTTP download is paced by, see UXDownloaderSubsystem::SetBandwidthLimit.
+ */
+UENUM(BlueprintType)
+enum class EXDownloadTrafficClass : uint8
+{
+	//the batches of UXDownloadManager::DownloadImages
+	Foreground UMETA(DisplayName = "Foreground"),
+	//idle time prefetches and stale image refreshes
+	Prefetch UMETA(DisplayName = "Prefetch"),
+	Num UMETA(Hidden)
+};
+
+/**
+ * @enum EXDownloadPriority
+ * @brief The order queued images are started in, images of a higher priority first and equal ones in queue order.
+ */
+UENUM(BlueprintType)
+enum class EXDownloadPriority : uint8
+{
+	//shown on screen right now
+	Visible UMETA(DisplayName = "Visible"),
+	Normal UMETA(DisplayName = "Normal"),
+	//scrolled out of view, started once nothing else is queued
+	Offscreen UMETA(DisplayName = "Offscreen"),
+	Num UMETA(Hidden)
+};
+
 /**
  * @struct FDownloadProgress
  * @brief Data structure representing the download progress of an image.
@@ -66,6 +114,12 @@ struct FImageDownloadTask
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
 	FString ImageID;
 
+	//queued images of a higher priority start first, see UXDownloadManager::SetImagePriority
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
+	EXDownloadPriority Priority = EXDownloadPriority::Normal;
+
+	//time the task entered the task queue, for the queue wait stat
+	double EnqueueTime = 0.0;
 
 	//override operator ==
 	bool operator==(const FImageDownloadTask& Other) const
@@ -75,7 +129,6 @@ struct FImageDownloadTask
 	//operator ==
 	bool operator==(const FString& InID) const
 	{
-		UE_LOG(LogTemp, Warning, TEXT("maybe find by key ImageID: %s"), *ImageID);
 		return ImageID == InID;
 	}
 };
@@ -93,7 +146,81 @@ enum class EDownloadStatus : uint8
 	Pending UMETA(DisplayName = "Pending"),
 	InProgress UMETA(DisplayName = "InProgress"),
 	Success UMETA(DisplayName = "Success"),
-	Failed UMETA(DisplayName = "Failed")
+	Failed UMETA(DisplayName = "Failed"),
+	Cancelled UMETA(DisplayName = "Cancelled")
+};
+
+/**
+ * @struct FXDownloadAtlasRegion
+ * @brief The place of a small image in a shared atlas page, set on the results instead of a texture while the bThumbnailAtlas setting is on.
+ *
+ * Every result holding a region holds a reference to it, release it with UXDownloaderSubsystem::ReleaseAtlasRegion
+ * once the image is no longer shown so its space can be reused. The results of OnSubTaskResult and OnSubTaskDownloaded and the one kept in
+ * the SubTaskDownloadResults of the batch are separate copies with a reference each, the progress and finish events pass the latter again.
+ */
+USTRUCT(BlueprintType)
+struct FXDownloadAtlasRegion
+{
+	GENERATED_BODY()
+
+	//the atlas page, shared with other images
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	UTexture2D* Page = nullptr;
+
+	//top left corner of the image in the page, in UV space
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FVector2D UVMin = FVector2D::ZeroVector;
+
+	//bottom right corner of the image in the page, in UV space
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FVector2D UVMax = FVector2D::ZeroVector;
+
+	//size of the image in pixels
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FIntPoint Size = FIntPoint::ZeroValue;
+
+	//a brush drawing the page with the UV region of the image, for UImage::SetBrush
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FSlateBrush Brush;
+
+	//the key of the image in the atlas
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FString ContentHash;
+
+	bool IsValid() const { return Page != nullptr; }
+};
+
+struct FXDownloadImageRef;
+
+/**
+ * @struct FXDownloadImageHandle
+ * @brief A reference-counted handle to a downloaded image, set on the successful results.
+ *
+ * Copies share one count per texture. While any copy exists the texture is kept alive for the garbage collector,
+ * once the last copy is gone the cache entries drop the texture so it can be collected, the compressed bytes stay cached.
+ * Keep a copy for as long as the image is shown and reset it afterwards.
+ */
+USTRUCT(BlueprintType)
+struct XDOWNLOADER_API FXDownloadImageHandle
+{
+	GENERATED_BODY()
+
+	bool IsValid() const { return Ref.IsValid(); }
+
+	//the texture, null for an invalid handle or once the downloader subsystem is gone
+	UTexture2D* GetTexture() const;
+
+	FString GetImageID() const;
+
+	//number of handles sharing the texture
+	int32 GetRefNum() const { return Ref.GetSharedReferenceCount(); }
+
+	void Reset() { Ref.Reset(); }
+
+private:
+	friend class FXDownloadImageRegistry;
+
+	TSharedPtr<FXDownloadImageRef, ESPMode::ThreadSafe> Ref;
 };
 
 /**
@@ -126,6 +253,18 @@ struct FDownloadResult
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
 	UTexture2D* Texture = nullptr;
+
+	//keeps Texture alive and tells the cache when it is no longer used, see FXDownloadImageHandle
+	UPROPERTY(BlueprintReadOnly, Category="Download")
+	FXDownloadImageHandle ImageHandle;
+
+	//the region of the image in the thumbnail atlas, set instead of Texture for small images while the bThumbnailAtlas setting is on
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FXDownloadAtlasRegion AtlasRegion;
+
+	//seconds from the sub task leaving the queue to its result, 0 for a sub task that never left the queue
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	float LatencySeconds = 0.f;
 };
 
 /**
@@ -143,6 +282,39 @@ struct FTotalDownloadResult
 	//total num
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
 	int32 TotalNum = 0;
+
+	//finished sub tasks that succeeded so far
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
+	int32 SucceedNum = 0;
+
+	//finished sub tasks that failed so far
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
+	int32 FailedNum = 0;
+
+	//ids of the failed sub tasks
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
+	TArray<FString> FailedImageIDs;
+
+	//finished sub tasks that were cancelled so far
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
+	int32 CancelledNum = 0;
+
+	//seconds since DownloadImages was called
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
+	float ElapsedSeconds = 0.f;
+};
+
+/**
+ * @struct FXDownloadImageBlob
+ * @brief The compressed bytes of a cached image, stored once per content hash in a UXDownloaderSaveGame.
+ */
+USTRUCT()
+struct FXDownloadImageBlob
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<uint8> ImageData;
 };
 
 /**
@@ -150,6 +322,8 @@ struct FTotalDownloadResult
  * @brief Represents a cached image for download
  *
  * This structure is used to store cached image information for downloads. It includes the image ID, URL, optional time, image data, and texture.
+ * Images with identical bytes share one blob of the slot and one texture, found by ContentHash.
+ * An entry past its ExpireTime, or DefaultCacheTTL after its ImageTime without one, is stale and refreshed from its URL.
  */
 USTRUCT(BlueprintType)
 struct FXDownloadImageCached
@@ -162,13 +336,42 @@ struct FXDownloadImageCached
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
 	FString ImageURL;
 
-	//optional image time
-	FDateTime ImageTime = FDateTime::Now();
+	//time the image was stored, UTC
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FDateTime ImageTime = FDateTime::UtcNow();
+
+	//expiry from the Cache-Control or Expires header of the response, UTC, left default without one
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FDateTime ExpireTime;
 
-	//optional image data
+	//ETag of the response, sent back as If-None-Match when the image is revalidated
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FString ETag;
+
+	//Last-Modified of the response, sent back as If-Modified-Since when the image is revalidated
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FString LastModified;
+
+	//optional image data, moved into the slot's shared blobs by UXDownloaderSaveGame::AddImageCache and on load
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
 	TArray<uint8> ImageData;
 
+	//xxHash64 of the image data, the key of the shared blob and texture
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FString ContentHash;
+
+	//BlurHash of the image computed on its first decode, see UXDownloaderSubsystem::GetPlaceholderTexture
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FString PlaceholderHash;
+
+	//last time a batch got the image, UTC, ranks the entries decoded by the startup warm-up
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FDateTime LastUsedTime;
+
+	//number of batches that got the image
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int32 UseCount = 0;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Download")
 	UTexture2D* Texture = nullptr;
 
@@ -188,5 +391,88 @@ struct FXDownloadImageCached
 	}
 
 	//load texture from image data
-	void LoadTextureFromImageData();
+	void LoadTextureFromImageData(const TArray<uint8>& InImageData);
+
+	//hashes image bytes with xxHash64, as a hex string
+	static FString ComputeContentHash(const TArray<uint8>& InImageData);
+};
+
+/**
+ * @struct FXDownloadMemoryEntry
+ * @brief A named holder of downloader memory in a FXDownloadMemoryReport, a slot, a manager or a single image.
+ */
+USTRUCT(BlueprintType)
+struct FXDownloadMemoryEntry
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	FString Name;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int64 Bytes = 0;
+};
+
+/**
+ * @struct FXDownloadMemoryReport
+ * @brief The live memory held by the downloader, see UXDownloaderSubsystem::GetMemoryReport.
+ *
+ * Bytes shared by several holders, such as a slot blob referenced by a result, are counted once per holder.
+ */
+USTRUCT(BlueprintType)
+struct FXDownloadMemoryReport
+{
+	GENERATED_BODY()
+
+	//compressed image bytes of the loaded save game slots
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int64 SaveGameBytes = 0;
+
+	//image data of the results kept by the running managers
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int64 ResultBytes = 0;
+
+	//image data of the results waiting for game thread finalization
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int64 PendingFinalizeBytes = 0;
+
+	//bytes received by the in-flight requests
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int64 HttpBytes = 0;
+
+	//files queued for the local file cache writer
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int64 FileCacheBytes = 0;
+
+	//encoded images held by the memory cache tier
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int64 MemoryCacheBytes = 0;
+
+	//prefetched images waiting to be stored
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int64 PrefetchBytes = 0;
+
+	//resource size of the live textures created by the downloader
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int64 TextureBytes = 0;
+
+	//memory-mapped cache pack data, paged in by the OS and not part of the heap
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	int64 MappedPackBytes = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	TArray<FXDownloadMemoryEntry> Slots;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	TArray<FXDownloadMemoryEntry> Managers;
+
+	//the largest single images and textures, largest first
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Download")
+	TArray<FXDownloadMemoryEntry> TopEntries;
+
+	//heap bytes of every category
+	int64 GetTotalBytes() const;
+
+	//a multi-line text report, as printed by the XDownloader.MemReport console command
+	FString ToString() const;
 };
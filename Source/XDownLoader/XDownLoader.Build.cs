@@ -28,7 +28,8 @@ public class XDownLoader : ModuleRules
 			new string[]
 			{
 				"Core", "HTTP", "Engine",
-				"RenderCore"
+				"RenderCore",
+				"SlateCore"
 				// ... add other public dependencies that you statically link with here ...
 			}
 		);
@@ -40,12 +41,24 @@ public class XDownLoader : ModuleRules
 				"CoreUObject",
 				"Engine",
 				"Slate",
-				"SlateCore",
-				"ImageWrapper"
+				"UMG",
+				"ImageWrapper",
+				"ImageCore",
+				"Json",
+				"PakFile"
 				// ... add private dependencies that you statically link with here ...	
 			}
 		);
 
+		//inflates the first pass of interlaced PNG previews
+		AddEngineThirdPartyPrivateStaticDependencies(Target, "zlib");
+
+		if (Target.Configuration != UnrealTargetConfiguration.Shipping)
+		{
+			// loopback stand-in server for the XDownloader.Benchmark console command
+			PrivateDependencyModuleNames.Add("HTTPServer");
+		}
+
 
 		DynamicallyLoadedModuleNames.AddRange(
 			new string[]